@@ -0,0 +1,601 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_GRAPH_SCHEDULER_H__
+#define __SPA_GRAPH_SCHEDULER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <spa/graph/graph.h>
+
+/*
+ * Non-recursive scheduler.
+ *
+ * The nodes of the graph are kept in a list sorted in topological order
+ * (upstream nodes first). The list is only rebuilt when the version of the
+ * graph changes, which happens when nodes or ports are added, removed or
+ * (un)linked.
+ *
+ * A cycle is executed as a sequence of linear passes over the sorted list.
+ * The pull pass walks the list backwards and calls process_output on the
+ * peers that have all their outputs requested. The push pass walks the list
+ * forwards and calls process_input on the peers that have all their inputs
+ * available. Instead of recursing, a node that needs more work is marked
+ * pending and picked up later in the same pass or in the next one.
+ *
+ * When an executor is set, the peers that become ready in a pass are
+ * collected in a batch instead of being processed right away. The batch
+ * is handed to the executor, which can process the nodes in parallel,
+ * before a node that is in the batch or linked to a node in the batch
+ * is looked at again. Nodes that are linked to each other are never in
+ * the same batch.
+ *
+ * The nodes in a batch can call back into the graph from the threads of
+ * the executor. The need_input and have_output triggers made while a batch
+ * runs are queued and replayed by the scheduling thread when the executor
+ * returns. reuse_buffer calls are queued as well because the peers can be
+ * shared. A batch holds nodes with at most SPA_GRAPH_MAX_REUSE input
+ * ports, so that every input port can give back one buffer.
+ *
+ * Nodes with a timing get their signal time when they are scheduled.
+ */
+
+#define SPA_GRAPH_PENDING_PULL	(1 << 0)
+#define SPA_GRAPH_PENDING_PUSH	(1 << 1)
+#define SPA_GRAPH_PENDING_BATCH	(1 << 2)
+/* triggers made while a batch runs, the pull and push flags shifted */
+#define SPA_GRAPH_PENDING_DEFER_SHIFT	3
+#define SPA_GRAPH_PENDING_DEFER	((SPA_GRAPH_PENDING_PULL | SPA_GRAPH_PENDING_PUSH) << \
+					SPA_GRAPH_PENDING_DEFER_SHIFT)
+
+#define SPA_GRAPH_MAX_BATCH	64u
+#define SPA_GRAPH_MAX_DEFERRED	(SPA_GRAPH_MAX_BATCH * 2u)
+#define SPA_GRAPH_MAX_REUSE	(SPA_GRAPH_MAX_BATCH * 4u)
+
+/** a buffer to give back to the peer of an input port */
+struct spa_graph_reuse {
+	struct spa_graph_node *node;
+	uint32_t port_id;
+	uint32_t buffer_id;
+};
+
+struct spa_graph_data {
+	struct spa_graph *graph;
+	uint32_t version;		/**< version of the graph when sorted */
+	struct spa_list order;		/**< nodes in topological order */
+	uint32_t n_nodes;		/**< number of nodes in order */
+	uint32_t n_pending;		/**< number of pending nodes */
+	bool running;			/**< if the passes are running */
+
+	const struct spa_graph_executor *executor;	/**< optional executor */
+	void *executor_data;
+	enum spa_direction batch_direction;
+	uint32_t n_batch;
+	uint32_t n_batch_inputs;	/**< input ports of the nodes in the batch */
+	struct spa_graph_node *batch[SPA_GRAPH_MAX_BATCH];
+
+	bool executing;			/**< a batch is being processed */
+	bool parallel;			/**< the executor processes the batch */
+	uint32_t n_reuse;		/**< queued reuse_buffer calls, can be
+					  *  larger than the array */
+	uint32_t n_reuse_dropped;	/**< reuse_buffer calls that did not fit */
+	struct spa_graph_reuse reuse[SPA_GRAPH_MAX_REUSE];
+	uint32_t n_deferred;		/**< nodes with deferred triggers, can
+					  *  be larger than the array */
+	struct spa_graph_node *deferred[SPA_GRAPH_MAX_DEFERRED];
+};
+
+static inline void spa_graph_data_init(struct spa_graph_data *data,
+				       struct spa_graph *graph)
+{
+	data->graph = graph;
+	data->version = graph->version - 1;
+	spa_list_init(&data->order);
+	data->n_nodes = 0;
+	data->n_pending = 0;
+	data->running = false;
+	data->executor = NULL;
+	data->n_batch = 0;
+	data->n_batch_inputs = 0;
+	data->executing = false;
+	data->parallel = false;
+	data->n_reuse = 0;
+	data->n_reuse_dropped = 0;
+	data->n_deferred = 0;
+}
+
+static inline void
+spa_graph_data_set_executor(struct spa_graph_data *data,
+			    const struct spa_graph_executor *executor,
+			    void *executor_data)
+{
+	data->executor = executor;
+	data->executor_data = executor_data;
+}
+
+static inline void spa_graph_data_sort(struct spa_graph_data *data)
+{
+	struct spa_graph *graph = data->graph;
+	struct spa_graph_node *n, *pnode;
+	struct spa_graph_port *p;
+
+	spa_debug("graph %p sort version %d", graph, graph->version);
+
+	/* count the incoming edges of each node in the graph, we use the
+	 * pending field for this because nothing is pending between cycles */
+	data->n_nodes = 0;
+	spa_list_for_each(n, &graph->nodes, link) {
+		n->pending = 0;
+		n->ready_link.next = NULL;
+		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
+			if (p->peer && p->peer->node && p->peer->node->graph == graph)
+				n->pending++;
+		}
+		data->n_nodes++;
+	}
+
+	/* start with the nodes without incoming edges, the order list is
+	 * also the work queue: nodes appended while iterating are visited */
+	spa_list_init(&data->order);
+	spa_list_for_each(n, &graph->nodes, link) {
+		if (n->pending == 0)
+			spa_list_append(&data->order, &n->ready_link);
+	}
+	spa_list_for_each(n, &data->order, ready_link) {
+		spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
+			if (p->peer == NULL || (pnode = p->peer->node) == NULL ||
+			    pnode->graph != graph || pnode->pending == 0)
+				continue;
+			if (--pnode->pending == 0)
+				spa_list_append(&data->order, &pnode->ready_link);
+		}
+	}
+
+	/* nodes in a cycle never reach 0, schedule them last */
+	spa_list_for_each(n, &graph->nodes, link) {
+		if (n->ready_link.next == NULL) {
+			spa_debug("graph %p node %p is in a cycle", graph, n);
+			spa_list_append(&data->order, &n->ready_link);
+		}
+		n->pending = 0;
+	}
+	data->n_pending = 0;
+	data->version = graph->version;
+}
+
+static inline void spa_graph_data_mark(struct spa_graph_data *data,
+				       struct spa_graph_node *node, uint32_t flag)
+{
+	if (!(node->pending & flag)) {
+		node->pending |= flag;
+		data->n_pending++;
+	}
+}
+
+static inline bool spa_graph_data_take(struct spa_graph_data *data,
+				       struct spa_graph_node *node, uint32_t flag)
+{
+	if (!(node->pending & flag))
+		return false;
+	node->pending &= ~flag;
+	data->n_pending--;
+	return true;
+}
+
+static inline void spa_graph_data_result(struct spa_graph_data *data,
+					 struct spa_graph_node *node)
+{
+	if (node->state == SPA_STATUS_HAVE_BUFFER)
+		spa_graph_data_mark(data, node, SPA_GRAPH_PENDING_PUSH);
+	else if (node->state == SPA_STATUS_NEED_BUFFER)
+		spa_graph_data_mark(data, node, SPA_GRAPH_PENDING_PULL);
+}
+
+static inline int spa_graph_data_trigger(struct spa_graph_data *data,
+					 struct spa_graph_node *node, uint32_t flag);
+
+/* called from the executor threads, remember the trigger in the node and
+ * queue the node the first time */
+static inline void spa_graph_data_defer(struct spa_graph_data *data,
+					struct spa_graph_node *node, uint32_t flag)
+{
+	uint32_t old, index;
+
+	old = __atomic_fetch_or(&node->pending, flag << SPA_GRAPH_PENDING_DEFER_SHIFT,
+				__ATOMIC_RELAXED);
+	if (old & SPA_GRAPH_PENDING_DEFER)
+		return;
+
+	/* when the array is full, the replay looks at the whole cycle */
+	index = __atomic_fetch_add(&data->n_deferred, 1, __ATOMIC_RELAXED);
+	if (index < SPA_GRAPH_MAX_DEFERRED)
+		data->deferred[index] = node;
+}
+
+static inline void spa_graph_data_replay_node(struct spa_graph_data *data,
+					      struct spa_graph_node *node)
+{
+	uint32_t flags = (node->pending & SPA_GRAPH_PENDING_DEFER) >> SPA_GRAPH_PENDING_DEFER_SHIFT;
+
+	node->pending &= ~SPA_GRAPH_PENDING_DEFER;
+	if (flags & SPA_GRAPH_PENDING_PULL)
+		spa_graph_data_trigger(data, node, SPA_GRAPH_PENDING_PULL);
+	if (flags & SPA_GRAPH_PENDING_PUSH)
+		spa_graph_data_trigger(data, node, SPA_GRAPH_PENDING_PUSH);
+}
+
+/* replay the deferred triggers of all the nodes of the cycle, the nodes
+ * of the graph and their peers, which can be outside of the graph */
+static inline void spa_graph_data_replay_all(struct spa_graph_data *data)
+{
+	struct spa_graph_node *n;
+	struct spa_graph_port *p;
+	int i;
+
+	spa_debug("graph %p too many deferred triggers, replay the cycle", data->graph);
+
+	spa_list_for_each(n, &data->order, ready_link) {
+		if (n->pending & SPA_GRAPH_PENDING_DEFER)
+			spa_graph_data_replay_node(data, n);
+
+		for (i = 0; i < 2; i++) {
+			spa_list_for_each(p, &n->ports[i], link) {
+				if (p->peer && p->peer->node &&
+				    (p->peer->node->pending & SPA_GRAPH_PENDING_DEFER))
+					spa_graph_data_replay_node(data, p->peer->node);
+			}
+		}
+	}
+}
+
+/* run the triggers of the batch in the scheduling thread */
+static inline void spa_graph_data_replay(struct spa_graph_data *data)
+{
+	uint32_t i, n_deferred = data->n_deferred;
+
+	if (n_deferred == 0)
+		return;
+
+	data->n_deferred = 0;
+	if (n_deferred > SPA_GRAPH_MAX_DEFERRED) {
+		spa_graph_data_replay_all(data);
+		return;
+	}
+	for (i = 0; i < n_deferred; i++)
+		spa_graph_data_replay_node(data, data->deferred[i]);
+}
+
+/* give the buffers of the batch back to the peers in the scheduling thread */
+static inline void spa_graph_data_reuse(struct spa_graph_data *data)
+{
+	uint32_t i, n_reuse = data->n_reuse;
+
+	if (n_reuse == 0)
+		return;
+
+	data->n_reuse = 0;
+	if (n_reuse > SPA_GRAPH_MAX_REUSE) {
+		spa_debug("graph %p %d buffers not reused", data->graph,
+				n_reuse - SPA_GRAPH_MAX_REUSE);
+		data->n_reuse_dropped += n_reuse - SPA_GRAPH_MAX_REUSE;
+		n_reuse = SPA_GRAPH_MAX_REUSE;
+	}
+	for (i = 0; i < n_reuse; i++) {
+		struct spa_graph_reuse *r = &data->reuse[i];
+		spa_graph_node_reuse_buffer(r->node, r->port_id, r->buffer_id);
+	}
+}
+
+static inline void spa_graph_data_flush(struct spa_graph_data *data)
+{
+	uint32_t i, n_batch = data->n_batch;
+
+	if (n_batch == 0)
+		return;
+
+	spa_debug("graph %p flush %d nodes", data->graph, n_batch);
+	data->n_batch = 0;
+	data->n_batch_inputs = 0;
+
+	/* the nodes can call back while the batch array is in use */
+	data->executing = true;
+	if (n_batch == 1) {
+		spa_graph_node_process(data->batch[0], data->batch_direction);
+	} else {
+		data->parallel = true;
+		spa_graph_executor_process(data->executor, data->executor_data,
+				data->batch_direction, data->batch, n_batch);
+		data->parallel = false;
+	}
+	data->executing = false;
+
+	for (i = 0; i < n_batch; i++) {
+		struct spa_graph_node *n = data->batch[i];
+		n->pending &= ~SPA_GRAPH_PENDING_BATCH;
+		spa_graph_data_result(data, n);
+	}
+	spa_graph_data_reuse(data);
+	spa_graph_data_replay(data);
+}
+
+static inline bool spa_graph_data_linked_to_batch(struct spa_graph_node *node)
+{
+	struct spa_graph_port *p;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		spa_list_for_each(p, &node->ports[i], link) {
+			if (p->peer && p->peer->node &&
+			    (p->peer->node->pending & SPA_GRAPH_PENDING_BATCH))
+				return true;
+		}
+	}
+	return false;
+}
+
+/* make sure the batch does not touch node before looking at it */
+static inline void spa_graph_data_sync(struct spa_graph_data *data, struct spa_graph_node *node)
+{
+	if (data->n_batch > 0 &&
+	    ((node->pending & SPA_GRAPH_PENDING_BATCH) || spa_graph_data_linked_to_batch(node)))
+		spa_graph_data_flush(data);
+}
+
+static inline void spa_graph_data_process(struct spa_graph_data *data,
+					  struct spa_graph_node *node,
+					  enum spa_direction direction)
+{
+	struct spa_graph_port *p;
+	uint32_t n_inputs;
+
+	if (node->timing && !(node->pending & SPA_GRAPH_PENDING_BATCH))
+		spa_graph_timing_signal(node->timing);
+
+	if (data->executor == NULL) {
+		spa_graph_node_process(node, direction);
+		spa_debug("peer %p processed %d", node, node->state);
+		spa_graph_data_result(data, node);
+		return;
+	}
+	if (node->pending & SPA_GRAPH_PENDING_BATCH)
+		return;
+
+	n_inputs = 0;
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
+		n_inputs++;
+
+	if (data->n_batch == SPA_GRAPH_MAX_BATCH ||
+	    data->n_batch_inputs + n_inputs > SPA_GRAPH_MAX_REUSE ||
+	    (data->n_batch > 0 && data->batch_direction != direction) ||
+	    spa_graph_data_linked_to_batch(node))
+		spa_graph_data_flush(data);
+
+	node->pending |= SPA_GRAPH_PENDING_BATCH;
+	data->batch_direction = direction;
+	data->batch[data->n_batch++] = node;
+	data->n_batch_inputs += n_inputs;
+}
+
+static inline void spa_graph_data_pull(struct spa_graph_data *data, struct spa_graph_node *node)
+{
+	struct spa_graph_port *p;
+
+	spa_debug("node %p pull", node);
+
+	node->required[SPA_DIRECTION_INPUT] = 0;
+	node->ready[SPA_DIRECTION_INPUT] = 0;
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		struct spa_graph_port *pport;
+		struct spa_graph_node *pnode;
+		uint32_t prequired, pready;
+
+		if (p->io->status == SPA_STATUS_NEED_BUFFER)
+			node->required[SPA_DIRECTION_INPUT]++;
+
+		if ((pport = p->peer) == NULL || (pport->flags & SPA_GRAPH_PORT_FLAG_DISABLED)) {
+			spa_debug("node %p port %p has no peer", node, p);
+			continue;
+		}
+		pnode = pport->node;
+
+		if (pport->io->status == SPA_STATUS_NEED_BUFFER)
+			pnode->ready[SPA_DIRECTION_OUTPUT]++;
+
+		pready = pnode->ready[SPA_DIRECTION_OUTPUT];
+		prequired = pnode->required[SPA_DIRECTION_OUTPUT];
+
+		spa_debug("node %p peer %p io %d %d %d %d", node, pnode, pport->io->status,
+				pport->io->buffer_id, pready, prequired);
+
+		if (prequired > 0 && pready >= prequired)
+			spa_graph_data_process(data, pnode, SPA_DIRECTION_OUTPUT);
+	}
+}
+
+static inline void spa_graph_data_push(struct spa_graph_data *data, struct spa_graph_node *node)
+{
+	struct spa_graph_port *p;
+
+	spa_debug("node %p push", node);
+
+	node->required[SPA_DIRECTION_OUTPUT] = 0;
+	node->ready[SPA_DIRECTION_OUTPUT] = 0;
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_OUTPUT], link) {
+		struct spa_graph_port *pport;
+		struct spa_graph_node *pnode;
+		uint32_t prequired, pready;
+
+		if (p->io->status == SPA_STATUS_HAVE_BUFFER &&
+		    !(p->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
+			node->required[SPA_DIRECTION_OUTPUT]++;
+
+		if ((pport = p->peer) == NULL || (pport->flags & SPA_GRAPH_PORT_FLAG_DISABLED)) {
+			spa_debug("node %p port %p has no peer", node, p);
+			continue;
+		}
+		pnode = pport->node;
+
+		if (pport->io->status == SPA_STATUS_HAVE_BUFFER)
+			pnode->ready[SPA_DIRECTION_INPUT]++;
+
+		pready = pnode->ready[SPA_DIRECTION_INPUT];
+		prequired = pnode->required[SPA_DIRECTION_INPUT];
+
+		spa_debug("node %p peer %p io %d %d %d %d", node, pnode, pport->io->status,
+				pport->io->buffer_id, pready, prequired);
+
+		if (prequired > 0 && pready >= prequired)
+			spa_graph_data_process(data, pnode, SPA_DIRECTION_INPUT);
+	}
+}
+
+static inline void spa_graph_data_clear(struct spa_graph_data *data)
+{
+	struct spa_graph_node *n;
+
+	spa_list_for_each(n, &data->order, ready_link)
+		n->pending = 0;
+	data->n_pending = 0;
+}
+
+static inline void spa_graph_data_run(struct spa_graph_data *data)
+{
+	struct spa_graph_node *n;
+	uint32_t passes = 0;
+
+	data->running = true;
+	/* a trigger from outside of the graph could have batched nodes */
+	spa_graph_data_flush(data);
+
+	while (data->n_pending > 0) {
+		/* nodes in a pull can only mark upstream nodes for pull, which
+		 * come later in this reverse pass */
+		spa_list_for_each_reverse(n, &data->order, ready_link) {
+			if (!(n->pending & SPA_GRAPH_PENDING_PULL))
+				continue;
+			spa_graph_data_sync(data, n);
+			if (spa_graph_data_take(data, n, SPA_GRAPH_PENDING_PULL))
+				spa_graph_data_pull(data, n);
+		}
+		spa_graph_data_flush(data);
+
+		/* nodes in a push can only mark downstream nodes for push, which
+		 * come later in this pass */
+		spa_list_for_each(n, &data->order, ready_link) {
+			if (!(n->pending & SPA_GRAPH_PENDING_PUSH))
+				continue;
+			spa_graph_data_sync(data, n);
+			if (spa_graph_data_take(data, n, SPA_GRAPH_PENDING_PUSH))
+				spa_graph_data_push(data, n);
+		}
+		spa_graph_data_flush(data);
+
+		/* pulls caused by a push need another round, bound the number of
+		 * rounds so that a misbehaving node can't stall the graph */
+		if (++passes > data->n_nodes) {
+			spa_debug("graph %p too many passes %d", data->graph, passes);
+			spa_graph_data_clear(data);
+			break;
+		}
+	}
+	data->running = false;
+}
+
+static inline int spa_graph_data_trigger(struct spa_graph_data *data,
+					 struct spa_graph_node *node, uint32_t flag)
+{
+	if (data->executing) {
+		spa_graph_data_defer(data, node, flag);
+		return 0;
+	}
+
+	if (data->version != data->graph->version)
+		spa_graph_data_sort(data);
+
+	/* an async node calls back when it completed */
+	if (node->timing && (node->flags & SPA_GRAPH_NODE_FLAG_ASYNC))
+		spa_graph_timing_finish(node->timing);
+
+	if (node->graph == data->graph && node->ready_link.next != NULL) {
+		spa_graph_data_mark(data, node, flag);
+	}
+	else if (flag == SPA_GRAPH_PENDING_PULL) {
+		/* nodes outside of the graph only feed their peers */
+		spa_graph_data_pull(data, node);
+	}
+	else {
+		spa_graph_data_push(data, node);
+	}
+	/* when called from inside a pass, the running passes will
+	 * pick up the new pending work */
+	if (!data->running)
+		spa_graph_data_run(data);
+
+	return 0;
+}
+
+static inline int spa_graph_impl_need_input(void *data, struct spa_graph_node *node)
+{
+	spa_debug("node %p need input", node);
+	return spa_graph_data_trigger(data, node, SPA_GRAPH_PENDING_PULL);
+}
+
+static inline int spa_graph_impl_have_output(void *data, struct spa_graph_node *node)
+{
+	spa_debug("node %p have output", node);
+	return spa_graph_data_trigger(data, node, SPA_GRAPH_PENDING_PUSH);
+}
+
+static inline int spa_graph_impl_reuse_buffer(void *data, struct spa_graph_node *node,
+					      uint32_t port_id, uint32_t buffer_id)
+{
+	struct spa_graph_data *d = data;
+	uint32_t index;
+
+	spa_debug("node %p reuse buffer %d %d", node, port_id, buffer_id);
+
+	if (!d->parallel)
+		return spa_graph_node_reuse_buffer(node, port_id, buffer_id);
+
+	/* called from an executor thread, the peer can be shared with other
+	 * nodes of the batch */
+	index = __atomic_fetch_add(&d->n_reuse, 1, __ATOMIC_RELAXED);
+	if (index < SPA_GRAPH_MAX_REUSE) {
+		d->reuse[index].node = node;
+		d->reuse[index].port_id = port_id;
+		d->reuse[index].buffer_id = buffer_id;
+	}
+	return 0;
+}
+
+static const struct spa_graph_callbacks spa_graph_impl_default = {
+	SPA_VERSION_GRAPH_CALLBACKS,
+	.need_input = spa_graph_impl_need_input,
+	.have_output = spa_graph_impl_have_output,
+	.reuse_buffer = spa_graph_impl_reuse_buffer,
+};
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_GRAPH_SCHEDULER_H__ */
@@ -24,6 +24,8 @@
 extern "C" {
 #endif
 
+#include <time.h>
+
 #include <spa/utils/defs.h>
 #include <spa/utils/list.h>
 #include <spa/node/node.h>
@@ -38,22 +40,92 @@ struct spa_graph_node;
 struct spa_graph_port;
 
 struct spa_graph_callbacks {
-#define SPA_VERSION_GRAPH_CALLBACKS	0
+#define SPA_VERSION_GRAPH_CALLBACKS	1
 	uint32_t version;
 
 	int (*need_input) (void *data, struct spa_graph_node *node);
 	int (*have_output) (void *data, struct spa_graph_node *node);
+	/** give a buffer of input port \a port_id back to the peer, optional.
+	 * Since version 1 */
+	int (*reuse_buffer) (void *data, struct spa_graph_node *node,
+			     uint32_t port_id, uint32_t buffer_id);
+};
+
+/** Executes a batch of independent nodes, possibly in parallel */
+struct spa_graph_executor {
+#define SPA_VERSION_GRAPH_EXECUTOR	0
+	uint32_t version;
+
+	/** Call process_input (direction SPA_DIRECTION_INPUT) or process_output
+	 * on each of the \a n_nodes and store the result in the node state.
+	 * The nodes are not linked to each other. Returns when all nodes
+	 * are processed. */
+	void (*process) (void *data, enum spa_direction direction,
+			 struct spa_graph_node **nodes, uint32_t n_nodes);
 };
 
+#define spa_graph_executor_process(e,d,...)	((e)->process((d), __VA_ARGS__))
+
+/** Timing of a node in a cycle, times are in nanoseconds of CLOCK_MONOTONIC */
+struct spa_graph_timing {
+	uint64_t signal;		/**< when the node was scheduled */
+	uint64_t awake;			/**< when the node started processing */
+	uint64_t finish;		/**< when the node completed or 0 when the
+					  *  node did not complete before it was
+					  *  scheduled again */
+	bool pending;			/**< node is scheduled and did not complete */
+
+	/** Called from the thread that processed the node when the timing
+	 * of a cycle is complete */
+	void (*complete) (void *data, struct spa_graph_timing *timing);
+	void *data;
+};
+
+static inline uint64_t spa_graph_timing_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static inline void spa_graph_timing_signal(struct spa_graph_timing *timing)
+{
+	if (timing->pending) {
+		timing->finish = 0;
+		timing->complete(timing->data, timing);
+	}
+	timing->signal = spa_graph_timing_now();
+	timing->awake = timing->finish = 0;
+	timing->pending = true;
+}
+
+static inline void spa_graph_timing_awake(struct spa_graph_timing *timing)
+{
+	timing->awake = spa_graph_timing_now();
+}
+
+static inline void spa_graph_timing_finish(struct spa_graph_timing *timing)
+{
+	if (!timing->pending)
+		return;
+	timing->finish = spa_graph_timing_now();
+	timing->pending = false;
+	timing->complete(timing->data, timing);
+}
+
 struct spa_graph {
 	struct spa_list nodes;
+	uint32_t version;		/**< incremented on topology changes */
 	const struct spa_graph_callbacks *callbacks;
 	void *callbacks_data;
 };
 
 #define spa_graph_need_input(g,n)	((g)->callbacks->need_input((g)->callbacks_data, (n)))
 #define spa_graph_have_output(g,n)	((g)->callbacks->have_output((g)->callbacks_data, (n)))
-#define spa_graph_reuse_buffer(g,n,p,i)	((g)->callbacks->reuse_buffer((g)->callbacks_data, (n),(p),(i)))
+#define spa_graph_reuse_buffer(g,n,p,i)						\
+	((g)->callbacks->version >= 1 && (g)->callbacks->reuse_buffer ?		\
+	 (g)->callbacks->reuse_buffer((g)->callbacks_data, (n),(p),(i)) :	\
+	 spa_graph_node_reuse_buffer((n),(p),(i)))
 
 struct spa_graph_node {
 	struct spa_list link;		/**< link in graph nodes list */
@@ -65,8 +137,12 @@ struct spa_graph_node {
 	uint32_t required[2];		/**< required number of ports */
 	uint32_t ready[2];		/**< number of ports with data */
 	int state;			/**< state of the node */
+	uint32_t pending;		/**< scheduler private pending work */
 	struct spa_node *implementation;/**< node implementation */
 	void *scheduler_data;		/**< scheduler private data */
+	struct spa_graph_timing *timing;/**< optional timing of the node, an
+					  *  async node completes when it calls
+					  *  back into the graph */
 };
 
 struct spa_graph_port {
@@ -81,9 +157,34 @@ struct spa_graph_port {
 	void *scheduler_data;		/**< scheduler private data */
 };
 
+/** give a buffer of input port \a port_id of \a node back to the peer
+ * directly, for schedulers without a reuse_buffer callback */
+static inline int spa_graph_node_reuse_buffer(struct spa_graph_node *node,
+					      uint32_t port_id, uint32_t buffer_id)
+{
+	struct spa_graph_port *p, *pp;
+
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		if (p->port_id != port_id)
+			continue;
+		if ((pp = p->peer) != NULL)
+			return spa_node_port_reuse_buffer(pp->node->implementation,
+							  pp->port_id, buffer_id);
+		break;
+	}
+	return 0;
+}
+
 static inline void spa_graph_init(struct spa_graph *graph)
 {
 	spa_list_init(&graph->nodes);
+	graph->version = 0;
+}
+
+static inline void spa_graph_topology_changed(struct spa_graph *graph)
+{
+	if (graph)
+		graph->version++;
 }
 
 static inline void
@@ -100,7 +201,10 @@ spa_graph_node_init(struct spa_graph_node *node)
 {
 	spa_list_init(&node->ports[SPA_DIRECTION_INPUT]);
 	spa_list_init(&node->ports[SPA_DIRECTION_OUTPUT]);
+	node->graph = NULL;
 	node->flags = 0;
+	node->pending = 0;
+	node->timing = NULL;
 	node->required[SPA_DIRECTION_INPUT] = node->ready[SPA_DIRECTION_INPUT] = 0;
 	node->required[SPA_DIRECTION_OUTPUT] = node->ready[SPA_DIRECTION_OUTPUT] = 0;
 	spa_debug("node %p init", node);
@@ -113,6 +217,25 @@ spa_graph_node_set_implementation(struct spa_graph_node *node,
 	node->implementation = implementation;
 }
 
+static inline int
+spa_graph_node_process(struct spa_graph_node *node, enum spa_direction direction)
+{
+	struct spa_graph_timing *timing = node->timing;
+
+	if (timing)
+		spa_graph_timing_awake(timing);
+
+	if (direction == SPA_DIRECTION_INPUT)
+		node->state = spa_node_process_input(node->implementation);
+	else
+		node->state = spa_node_process_output(node->implementation);
+
+	if (timing && !(node->flags & SPA_GRAPH_NODE_FLAG_ASYNC))
+		spa_graph_timing_finish(timing);
+
+	return node->state;
+}
+
 static inline void
 spa_graph_node_add(struct spa_graph *graph,
 		   struct spa_graph_node *node)
@@ -120,7 +243,9 @@ spa_graph_node_add(struct spa_graph *graph,
 	node->graph = graph;
 	node->state = SPA_STATUS_OK;
 	node->ready_link.next = NULL;
+	node->pending = 0;
 	spa_list_append(&graph->nodes, &node->link);
+	spa_graph_topology_changed(graph);
 	spa_debug("node %p add", node);
 }
 
@@ -147,6 +272,7 @@ spa_graph_port_add(struct spa_graph_node *node,
 	spa_list_append(&node->ports[port->direction], &port->link);
 	if (!(port->flags & SPA_PORT_INFO_FLAG_OPTIONAL))
 		node->required[port->direction]++;
+	spa_graph_topology_changed(node->graph);
 }
 
 static inline void spa_graph_node_remove(struct spa_graph_node *node)
@@ -155,6 +281,8 @@ static inline void spa_graph_node_remove(struct spa_graph_node *node)
 	spa_list_remove(&node->link);
 	if (node->ready_link.next)
 		spa_list_remove(&node->ready_link);
+	node->ready_link.next = NULL;
+	spa_graph_topology_changed(node->graph);
 }
 
 static inline void spa_graph_port_remove(struct spa_graph_port *port)
@@ -165,6 +293,7 @@ static inline void spa_graph_port_remove(struct spa_graph_port *port)
 	    port->node->required[port->direction] > 0) {
 		port->node->required[port->direction]--;
 	}
+	spa_graph_topology_changed(port->node->graph);
 }
 
 static inline void
@@ -173,6 +302,10 @@ spa_graph_port_link(struct spa_graph_port *out, struct spa_graph_port *in)
 	spa_debug("port %p link to %p", out, in);
 	out->peer = in;
 	in->peer = out;
+	if (out->node)
+		spa_graph_topology_changed(out->node->graph);
+	else if (in->node)
+		spa_graph_topology_changed(in->node->graph);
 }
 
 static inline void
@@ -182,6 +315,8 @@ spa_graph_port_unlink(struct spa_graph_port *port)
 	if (port->peer) {
 		port->peer->peer = NULL;
 		port->peer = NULL;
+		if (port->node)
+			spa_graph_topology_changed(port->node->graph);
 	}
 }
 
@@ -35,6 +35,9 @@ extern "C" {
 #define SPA_TYPE_PARAM_BUFFERS__stride		SPA_TYPE_PARAM_BUFFERS_BASE "stride"
 #define SPA_TYPE_PARAM_BUFFERS__buffers		SPA_TYPE_PARAM_BUFFERS_BASE "buffers"
 #define SPA_TYPE_PARAM_BUFFERS__align		SPA_TYPE_PARAM_BUFFERS_BASE "align"
+/** the data types that can be used for the buffer memory, an id enum with
+ * the preferred type first, see \ref spa_type_data */
+#define SPA_TYPE_PARAM_BUFFERS__dataType	SPA_TYPE_PARAM_BUFFERS_BASE "dataType"
 
 struct spa_type_param_buffers {
 	uint32_t Buffers;
@@ -42,6 +45,7 @@ struct spa_type_param_buffers {
 	uint32_t stride;
 	uint32_t buffers;
 	uint32_t align;
+	uint32_t dataType;
 };
 
 static inline void
@@ -54,6 +58,7 @@ spa_type_param_buffers_map(struct spa_type_map *map,
 		type->stride = spa_type_map_get_id(map, SPA_TYPE_PARAM_BUFFERS__stride);
 		type->buffers = spa_type_map_get_id(map, SPA_TYPE_PARAM_BUFFERS__buffers);
 		type->align = spa_type_map_get_id(map, SPA_TYPE_PARAM_BUFFERS__align);
+		type->dataType = spa_type_map_get_id(map, SPA_TYPE_PARAM_BUFFERS__dataType);
 	}
 }
 
@@ -44,12 +44,17 @@ extern "C" {
 #define SPA_TYPE_PROPS__periods		SPA_TYPE_PROPS_BASE "periods"
 #define SPA_TYPE_PROPS__periodSize	SPA_TYPE_PROPS_BASE "periodSize"
 #define SPA_TYPE_PROPS__periodEvent	SPA_TYPE_PROPS_BASE "periodEvent"
+#define SPA_TYPE_PROPS__rateMatch	SPA_TYPE_PROPS_BASE "rateMatch"
+#define SPA_TYPE_PROPS__quantum		SPA_TYPE_PROPS_BASE "quantum"
 
 #define SPA_TYPE_PROPS__live		SPA_TYPE_PROPS_BASE "live"
 #define SPA_TYPE_PROPS__waveType	SPA_TYPE_PROPS_BASE "waveType"
 #define SPA_TYPE_PROPS__frequency	SPA_TYPE_PROPS_BASE "frequency"
 #define SPA_TYPE_PROPS__volume		SPA_TYPE_PROPS_BASE "volume"
 #define SPA_TYPE_PROPS__mute		SPA_TYPE_PROPS_BASE "mute"
+#define SPA_TYPE_PROPS__channelVolumes	SPA_TYPE_PROPS_BASE "channelVolumes"
+#define SPA_TYPE_PROPS__rampSamples	SPA_TYPE_PROPS_BASE "rampSamples"
+#define SPA_TYPE_PROPS__rampCurve	SPA_TYPE_PROPS_BASE "rampCurve"
 #define SPA_TYPE_PROPS__patternType	SPA_TYPE_PROPS_BASE "patternType"
 
 #define SPA_TYPE_PROPS__brightness	SPA_TYPE_PROPS_BASE "brightness"
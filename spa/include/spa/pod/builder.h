@@ -187,6 +187,12 @@ static inline uint32_t spa_pod_builder_none(struct spa_pod_builder *builder)
 	return spa_pod_builder_primitive(builder, &p);
 }
 
+/* copy \a pod, a NULL pod is written as NONE */
+static inline uint32_t spa_pod_builder_pod(struct spa_pod_builder *builder, const struct spa_pod *pod)
+{
+	return pod ? spa_pod_builder_primitive(builder, pod) : spa_pod_builder_none(builder);
+}
+
 #define SPA_POD_BOOL_INIT(val) (struct spa_pod_bool){ { sizeof(uint32_t), SPA_POD_TYPE_BOOL }, val ? 1 : 0, 0 }
 
 static inline uint32_t spa_pod_builder_bool(struct spa_pod_builder *builder, bool val)
@@ -308,6 +308,199 @@ static inline int spa_pod_parser_get(struct spa_pod_parser *parser,
 	return res;
 }
 
+/* typed parser functions, they read exactly one pod of the given type and
+ * don't need to interpret a format string. Like spa_pod_parser_get() they
+ * return -ESRCH and don't advance when the next pod has the wrong type. */
+static inline struct spa_pod *spa_pod_parser_current(struct spa_pod_parser *parser)
+{
+	return spa_pod_iter_current(&parser->iter[parser->depth]);
+}
+
+static inline void spa_pod_parser_advance(struct spa_pod_parser *parser, struct spa_pod *pod)
+{
+	spa_pod_iter_advance(&parser->iter[parser->depth], pod);
+}
+
+static inline struct spa_pod *spa_pod_parser_next(struct spa_pod_parser *parser, uint32_t type)
+{
+	struct spa_pod *pod = spa_pod_parser_current(parser);
+
+	if (pod == NULL || SPA_POD_TYPE(pod) != type)
+		return NULL;
+
+	spa_pod_parser_advance(parser, pod);
+	return pod;
+}
+
+static inline int spa_pod_parser_get_bool(struct spa_pod_parser *parser, bool *value)
+{
+	struct spa_pod *pod = spa_pod_parser_next(parser, SPA_POD_TYPE_BOOL);
+	if (pod == NULL)
+		return -ESRCH;
+	*value = SPA_POD_VALUE(struct spa_pod_bool, pod) ? true : false;
+	return 0;
+}
+
+static inline int spa_pod_parser_get_id(struct spa_pod_parser *parser, uint32_t *value)
+{
+	struct spa_pod *pod = spa_pod_parser_next(parser, SPA_POD_TYPE_ID);
+	if (pod == NULL)
+		return -ESRCH;
+	*value = SPA_POD_VALUE(struct spa_pod_id, pod);
+	return 0;
+}
+
+static inline int spa_pod_parser_get_int(struct spa_pod_parser *parser, int32_t *value)
+{
+	struct spa_pod *pod = spa_pod_parser_next(parser, SPA_POD_TYPE_INT);
+	if (pod == NULL)
+		return -ESRCH;
+	*value = SPA_POD_VALUE(struct spa_pod_int, pod);
+	return 0;
+}
+
+static inline int spa_pod_parser_get_long(struct spa_pod_parser *parser, int64_t *value)
+{
+	struct spa_pod *pod = spa_pod_parser_next(parser, SPA_POD_TYPE_LONG);
+	if (pod == NULL)
+		return -ESRCH;
+	*value = SPA_POD_VALUE(struct spa_pod_long, pod);
+	return 0;
+}
+
+static inline int spa_pod_parser_get_float(struct spa_pod_parser *parser, float *value)
+{
+	struct spa_pod *pod = spa_pod_parser_next(parser, SPA_POD_TYPE_FLOAT);
+	if (pod == NULL)
+		return -ESRCH;
+	*value = SPA_POD_VALUE(struct spa_pod_float, pod);
+	return 0;
+}
+
+static inline int spa_pod_parser_get_double(struct spa_pod_parser *parser, double *value)
+{
+	struct spa_pod *pod = spa_pod_parser_next(parser, SPA_POD_TYPE_DOUBLE);
+	if (pod == NULL)
+		return -ESRCH;
+	*value = SPA_POD_VALUE(struct spa_pod_double, pod);
+	return 0;
+}
+
+/* a NONE pod is parsed as a NULL string */
+static inline int spa_pod_parser_get_string(struct spa_pod_parser *parser, const char **value)
+{
+	struct spa_pod *pod = spa_pod_parser_current(parser);
+
+	if (pod == NULL)
+		return -ESRCH;
+
+	switch (SPA_POD_TYPE(pod)) {
+	case SPA_POD_TYPE_NONE:
+		*value = NULL;
+		break;
+	case SPA_POD_TYPE_STRING:
+		*value = (const char *) SPA_POD_CONTENTS(struct spa_pod_string, pod);
+		break;
+	default:
+		return -ESRCH;
+	}
+	spa_pod_parser_advance(parser, pod);
+	return 0;
+}
+
+static inline int spa_pod_parser_get_bytes(struct spa_pod_parser *parser,
+					   const void **value, uint32_t *len)
+{
+	struct spa_pod *pod = spa_pod_parser_next(parser, SPA_POD_TYPE_BYTES);
+	if (pod == NULL)
+		return -ESRCH;
+	*value = SPA_POD_CONTENTS(struct spa_pod_bytes, pod);
+	*len = SPA_POD_BODY_SIZE(pod);
+	return 0;
+}
+
+static inline int spa_pod_parser_get_fd(struct spa_pod_parser *parser, int *value)
+{
+	struct spa_pod *pod = spa_pod_parser_next(parser, SPA_POD_TYPE_FD);
+	if (pod == NULL)
+		return -ESRCH;
+	*value = SPA_POD_VALUE(struct spa_pod_fd, pod);
+	return 0;
+}
+
+/* any pod, a NONE pod is parsed as NULL */
+static inline int spa_pod_parser_get_pod(struct spa_pod_parser *parser, struct spa_pod **value)
+{
+	struct spa_pod *pod = spa_pod_parser_current(parser);
+
+	if (pod == NULL)
+		return -ESRCH;
+
+	*value = SPA_POD_TYPE(pod) == SPA_POD_TYPE_NONE ? NULL : pod;
+	spa_pod_parser_advance(parser, pod);
+	return 0;
+}
+
+/* a pod of \a type or NONE, which is parsed as NULL */
+static inline int spa_pod_parser_get_type_or_none(struct spa_pod_parser *parser,
+						  uint32_t type, struct spa_pod **value)
+{
+	struct spa_pod *pod = spa_pod_parser_current(parser);
+
+	if (pod == NULL)
+		return -ESRCH;
+
+	if (SPA_POD_TYPE(pod) == SPA_POD_TYPE_NONE)
+		*value = NULL;
+	else if (SPA_POD_TYPE(pod) == type)
+		*value = pod;
+	else
+		return -ESRCH;
+
+	spa_pod_parser_advance(parser, pod);
+	return 0;
+}
+
+/* an object or NONE, like 'O' */
+static inline int spa_pod_parser_get_object(struct spa_pod_parser *parser, struct spa_pod **value)
+{
+	return spa_pod_parser_get_type_or_none(parser, SPA_POD_TYPE_OBJECT, value);
+}
+
+/* a struct or NONE without entering it, like 'T' */
+static inline int spa_pod_parser_get_struct(struct spa_pod_parser *parser, struct spa_pod **value)
+{
+	return spa_pod_parser_get_type_or_none(parser, SPA_POD_TYPE_STRUCT, value);
+}
+
+/* enter the struct at the current position, like '[' */
+static inline int spa_pod_parser_push_struct(struct spa_pod_parser *parser)
+{
+	struct spa_pod *pod = spa_pod_parser_current(parser);
+	struct spa_pod_iter *it;
+
+	if (pod == NULL || SPA_POD_TYPE(pod) != SPA_POD_TYPE_STRUCT)
+		return -EINVAL;
+	if (parser->depth + 1 >= SPA_POD_MAX_DEPTH)
+		return -EINVAL;
+
+	it = &parser->iter[++parser->depth];
+	spa_pod_iter_init(it, pod, SPA_POD_SIZE(pod), sizeof(struct spa_pod_struct));
+	return 0;
+}
+
+/* leave the current struct and continue after it, like ']'. All fields
+ * of the struct must have been read. */
+static inline int spa_pod_parser_pop(struct spa_pod_parser *parser)
+{
+	if (parser->depth == 0 || spa_pod_parser_current(parser) != NULL)
+		return -EINVAL;
+
+	parser->depth--;
+	spa_pod_parser_advance(parser, spa_pod_parser_current(parser));
+	return 0;
+}
+
 #define spa_pod_object_parse(pod,...)				\
 ({								\
 	struct spa_pod_parser __p;				\
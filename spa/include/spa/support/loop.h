@@ -66,13 +66,22 @@ typedef int (*spa_invoke_func_t) (struct spa_loop *loop,
 				  size_t size,
 				  void *user_data);
 
+/** The completion of functions queued with spa_loop_invoke_queue(). It
+ * can be shared by functions queued on different loops. */
+struct spa_loop_completion {
+	int32_t pending;	/**< number of queued functions that were not called */
+	int res;		/**< result of the last function that did not return 0 */
+};
+
+#define SPA_LOOP_COMPLETION_INIT (struct spa_loop_completion) { 0, 0 }
+
 /**
  * Register sources and work items to an event loop
  */
 struct spa_loop {
 	/* the version of this structure. This can be used to expand this
 	 * structure in the future */
-#define SPA_VERSION_LOOP	0
+#define SPA_VERSION_LOOP	1
 	uint32_t version;
 
 	/** add a source to the loop */
@@ -93,12 +102,30 @@ struct spa_loop {
 		       size_t size,
 		       bool block,
 		       void *user_data);
+
+	/** invoke a function in the context of this loop without waiting for
+	 * it. \a completion is updated when the function was called. Since
+	 * version 1. */
+	int (*invoke_queue) (struct spa_loop *loop,
+			     spa_invoke_func_t func,
+			     uint32_t seq,
+			     const void *data,
+			     size_t size,
+			     void *user_data,
+			     struct spa_loop_completion *completion);
+
+	/** wait until all the functions of \a completion were called.
+	 * \return the res field of the completion. Since version 1. */
+	int (*invoke_wait) (struct spa_loop *loop,
+			    struct spa_loop_completion *completion);
 };
 
 #define spa_loop_add_source(l,...)	(l)->add_source((l),__VA_ARGS__)
 #define spa_loop_update_source(l,...)	(l)->update_source(__VA_ARGS__)
 #define spa_loop_remove_source(l,...)	(l)->remove_source(__VA_ARGS__)
 #define spa_loop_invoke(l,...)		(l)->invoke((l),__VA_ARGS__)
+#define spa_loop_invoke_queue(l,...)	(l)->invoke_queue((l),__VA_ARGS__)
+#define spa_loop_invoke_wait(l,...)	(l)->invoke_wait((l),__VA_ARGS__)
 
 
 /** Control hooks */
@@ -136,6 +163,11 @@ struct spa_loop_control {
 	void (*enter) (struct spa_loop_control *ctrl);
 	void (*leave) (struct spa_loop_control *ctrl);
 
+	/** Wait for events and dispatch them
+	 * \param ctrl the control
+	 * \param timeout the maximum time to wait in milliseconds, -1 waits
+	 *	forever and 0 does not block
+	 * \return the number of dispatched sources or a negative errno */
 	int (*iterate) (struct spa_loop_control *ctrl, int timeout);
 };
 
@@ -180,6 +212,9 @@ struct spa_loop_utils {
 
 	struct spa_source *(*add_timer) (struct spa_loop_utils *utils,
 					 spa_source_timer_func_t func, void *data);
+	/** arm or disarm a timer. This changes the timers of the loop and
+	 * should only be called from the context of the running loop or,
+	 * from another thread, with the lock of the loop held */
 	int (*update_timer) (struct spa_source *source,
 			     struct timespec *value,
 			     struct timespec *interval,
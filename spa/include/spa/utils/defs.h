@@ -133,6 +133,9 @@ struct spa_fraction {
 #define SPA_DEPRECATED
 #endif
 
+/** size of a cache line, used to keep data written by different threads apart */
+#define SPA_CACHE_LINE_SIZE	64
+
 #define SPA_ROUND_DOWN_N(num,align)	((num) & ~((align) - 1))
 #define SPA_ROUND_UP_N(num,align)	SPA_ROUND_DOWN_N((num) + ((align) - 1),align)
 
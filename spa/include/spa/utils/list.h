@@ -78,6 +78,9 @@ static inline void spa_list_remove(struct spa_list *elem)
 #define spa_list_next(pos, member)					\
 	SPA_CONTAINER_OF((pos)->member.next, __typeof__(*pos), member)
 
+#define spa_list_prev(pos, member)					\
+	SPA_CONTAINER_OF((pos)->member.prev, __typeof__(*pos), member)
+
 #define spa_list_for_each_next(pos, head, curr, member)			\
 	for (pos = spa_list_first(curr, __typeof__(*pos), member);	\
 	     !spa_list_is_end(pos, head, member);			\
@@ -86,6 +89,14 @@ static inline void spa_list_remove(struct spa_list *elem)
 #define spa_list_for_each(pos, head, member)				\
 	spa_list_for_each_next(pos, head, head, member)
 
+#define spa_list_for_each_prev(pos, head, curr, member)			\
+	for (pos = spa_list_last(curr, __typeof__(*pos), member);	\
+	     !spa_list_is_end(pos, head, member);			\
+	     pos = spa_list_prev(pos, member))
+
+#define spa_list_for_each_reverse(pos, head, member)			\
+	spa_list_for_each_prev(pos, head, head, member)
+
 #define spa_list_for_each_safe_next(pos, tmp, head, curr, member)	\
 	for (pos = spa_list_first(curr, __typeof__(*pos), member),	\
 	     tmp = spa_list_next(pos, member);				\
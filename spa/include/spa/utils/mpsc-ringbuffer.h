@@ -0,0 +1,148 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_MPSC_RINGBUFFER_H__
+#define __SPA_MPSC_RINGBUFFER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/ringbuffer.h>
+
+/**
+ * A multiple producer, single consumer ringbuffer.
+ *
+ * Producers claim space by moving the reserve index with a compare and
+ * swap. After writing their data, they add the number of bytes to the
+ * commit index. Producers never wait for each other.
+ *
+ * The consumer only reads up to a point where all claimed space has been
+ * written. It sees this when the commit index matches the reserve index.
+ * Every producer should wake up the consumer after committing its data,
+ * so the data of a slower producer is read on the next wakeup.
+ *
+ * A producer writes a batch of items by reserving space for all of them
+ * and committing them together.
+ */
+struct spa_mpsc_ringbuffer {
+	/* written by the producers */
+	uint32_t reserveindex;	/*< the space claimed by producers */
+	uint32_t commitindex;	/*< the total number of bytes written */
+	uint8_t _pad0[SPA_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+	/* written by the consumer */
+	uint32_t readindex;	/*< the current read index */
+	uint32_t writeindex;	/*< index up to where all data is written */
+	uint8_t _pad1[SPA_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+};
+
+/**
+ * Initialize a spa_mpsc_ringbuffer.
+ *
+ * \param rbuf a spa_mpsc_ringbuffer
+ */
+static inline void spa_mpsc_ringbuffer_init(struct spa_mpsc_ringbuffer *rbuf)
+{
+	memset(rbuf, 0, sizeof(struct spa_mpsc_ringbuffer));
+}
+
+/**
+ * Get the next free write index and the fill level.
+ *
+ * \param rbuf a spa_mpsc_ringbuffer
+ * \param index the next free index, should be passed to
+ *         spa_mpsc_ringbuffer_write_reserve()
+ * \return the fill level of \a rbuf.
+ */
+static inline int32_t spa_mpsc_ringbuffer_get_write_index(struct spa_mpsc_ringbuffer *rbuf, uint32_t *index)
+{
+	*index = __atomic_load_n(&rbuf->reserveindex, __ATOMIC_RELAXED);
+	return (int32_t) (*index - __atomic_load_n(&rbuf->readindex, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * Claim \a len bytes starting from \a index.
+ *
+ * \param rbuf a spa_mpsc_ringbuffer
+ * \param index the index from spa_mpsc_ringbuffer_get_write_index()
+ * \param len the number of bytes to claim
+ * \return true when the space is claimed, false when an other producer
+ *         claimed the space first. The index should be retrieved again
+ *         in that case.
+ */
+static inline bool
+spa_mpsc_ringbuffer_write_reserve(struct spa_mpsc_ringbuffer *rbuf, uint32_t index, uint32_t len)
+{
+	return __atomic_compare_exchange_n(&rbuf->reserveindex, &index, index + len,
+					   false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+}
+
+/**
+ * Mark \a len claimed bytes as written.
+ *
+ * \param rbuf a spa_mpsc_ringbuffer
+ * \param len the number of bytes claimed with spa_mpsc_ringbuffer_write_reserve()
+ */
+static inline void spa_mpsc_ringbuffer_write_commit(struct spa_mpsc_ringbuffer *rbuf, uint32_t len)
+{
+	__atomic_add_fetch(&rbuf->commitindex, len, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the read index and available bytes for reading.
+ *
+ * \param rbuf a spa_mpsc_ringbuffer
+ * \param index the value of readindex, should be taken modulo the size of the
+ *         ringbuffer memory to get the offset in the ringbuffer memory
+ * \return number of bytes that are completely written and can be read.
+ */
+static inline int32_t spa_mpsc_ringbuffer_get_read_index(struct spa_mpsc_ringbuffer *rbuf, uint32_t *index)
+{
+	uint32_t commit, reserve;
+
+	*index = rbuf->readindex;
+	/* the commit index is read first, when the reserve index read after it
+	 * is the same, all space claimed at that point is written */
+	commit = __atomic_load_n(&rbuf->commitindex, __ATOMIC_ACQUIRE);
+	reserve = __atomic_load_n(&rbuf->reserveindex, __ATOMIC_ACQUIRE);
+	if (commit == reserve)
+		rbuf->writeindex = commit;
+
+	return (int32_t) (rbuf->writeindex - *index);
+}
+
+/**
+ * Update the read pointer to \a index.
+ *
+ * \param rbuf a spa_mpsc_ringbuffer
+ * \param index new index
+ */
+static inline void spa_mpsc_ringbuffer_read_update(struct spa_mpsc_ringbuffer *rbuf, uint32_t index)
+{
+	__atomic_store_n(&rbuf->readindex, index, __ATOMIC_RELEASE);
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_MPSC_RINGBUFFER_H__ */
@@ -0,0 +1,176 @@
+/* Simple Plugin API
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_SPSC_RINGBUFFER_H__
+#define __SPA_SPSC_RINGBUFFER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <errno.h>
+
+#include <spa/utils/defs.h>
+#include <spa/utils/ringbuffer.h>
+
+/**
+ * A single producer, single consumer ringbuffer.
+ *
+ * The index of the producer and the consumer live in separate cache lines
+ * so that they don't false-share. Each side also keeps a copy of the index
+ * of the other side and only reloads it when the copy says there is not
+ * enough space or data. This avoids touching the cache line of the other
+ * side for most operations.
+ *
+ * Space is reserved with spa_spsc_ringbuffer_write_reserve() and made
+ * visible with spa_spsc_ringbuffer_write_commit(). Multiple items can be
+ * written between those calls to publish them in one batch. The reading
+ * side does the same with spa_spsc_ringbuffer_read_peek() and
+ * spa_spsc_ringbuffer_read_release().
+ *
+ * The structure can be placed in shared memory. Aligning it to
+ * SPA_CACHE_LINE_SIZE also keeps it apart from the data around it.
+ */
+struct spa_spsc_ringbuffer {
+	/* written by the producer */
+	uint32_t writeindex;	/*< the current write index */
+	uint32_t readcache;	/*< last readindex seen by the producer */
+	uint8_t _pad0[SPA_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+	/* written by the consumer */
+	uint32_t readindex;	/*< the current read index */
+	uint32_t writecache;	/*< last writeindex seen by the consumer */
+	uint8_t _pad1[SPA_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+};
+
+/**
+ * Initialize a spa_spsc_ringbuffer.
+ *
+ * \param rbuf a spa_spsc_ringbuffer
+ */
+static inline void spa_spsc_ringbuffer_init(struct spa_spsc_ringbuffer *rbuf)
+{
+	memset(rbuf, 0, sizeof(struct spa_spsc_ringbuffer));
+}
+
+/**
+ * Reserve at least \a len bytes for writing.
+ *
+ * \param rbuf a spa_spsc_ringbuffer
+ * \param size the size of the ringbuffer memory
+ * \param len the minimum number of bytes to reserve
+ * \param index the value of writeindex, should be taken modulo \a size
+ *         to get the offset in the ringbuffer memory
+ * \return the number of bytes that can be written at \a index, this is
+ *         at least \a len, or -ENOSPC when there is not enough space.
+ */
+static inline int32_t
+spa_spsc_ringbuffer_write_reserve(struct spa_spsc_ringbuffer *rbuf,
+				  uint32_t size, uint32_t len, uint32_t *index)
+{
+	int32_t avail;
+
+	*index = rbuf->writeindex;
+	avail = size - (*index - rbuf->readcache);
+	if (avail < (int32_t) len) {
+		rbuf->readcache = __atomic_load_n(&rbuf->readindex, __ATOMIC_ACQUIRE);
+		avail = size - (*index - rbuf->readcache);
+		if (avail < (int32_t) len)
+			return -ENOSPC;
+	}
+	return avail;
+}
+
+/**
+ * Make the data written up to \a index available to the consumer.
+ *
+ * \param rbuf a spa_spsc_ringbuffer
+ * \param index new write index
+ */
+static inline void spa_spsc_ringbuffer_write_commit(struct spa_spsc_ringbuffer *rbuf, uint32_t index)
+{
+	__atomic_store_n(&rbuf->writeindex, index, __ATOMIC_RELEASE);
+}
+
+/**
+ * Get the read index and the number of bytes available for reading.
+ *
+ * The producer is only checked for new data when less than \a len bytes
+ * are known to be available.
+ *
+ * \param rbuf a spa_spsc_ringbuffer
+ * \param len the number of bytes needed
+ * \param index the value of readindex, should be taken modulo the size
+ *         of the ringbuffer memory to get the offset in the ringbuffer memory
+ * \return number of bytes available for reading, this can be less than
+ *         \a len.
+ */
+static inline int32_t
+spa_spsc_ringbuffer_read_peek(struct spa_spsc_ringbuffer *rbuf, uint32_t len, uint32_t *index)
+{
+	int32_t avail;
+
+	*index = rbuf->readindex;
+	avail = rbuf->writecache - *index;
+	if (avail < (int32_t) len) {
+		rbuf->writecache = __atomic_load_n(&rbuf->writeindex, __ATOMIC_ACQUIRE);
+		avail = rbuf->writecache - *index;
+	}
+	return avail;
+}
+
+/**
+ * Release the data up to \a index to the producer.
+ *
+ * \param rbuf a spa_spsc_ringbuffer
+ * \param index new read index
+ */
+static inline void spa_spsc_ringbuffer_read_release(struct spa_spsc_ringbuffer *rbuf, uint32_t index)
+{
+	__atomic_store_n(&rbuf->readindex, index, __ATOMIC_RELEASE);
+}
+
+/**
+ * Read \a len bytes from \a buffer starting \a offset, see
+ * spa_ringbuffer_read_data().
+ */
+static inline void
+spa_spsc_ringbuffer_read_data(struct spa_spsc_ringbuffer *rbuf,
+			      const void *buffer, uint32_t size,
+			      uint32_t offset, void *data, uint32_t len)
+{
+	spa_ringbuffer_read_data(NULL, buffer, size, offset, data, len);
+}
+
+/**
+ * Write \a len bytes to \a buffer starting \a offset, see
+ * spa_ringbuffer_write_data().
+ */
+static inline void
+spa_spsc_ringbuffer_write_data(struct spa_spsc_ringbuffer *rbuf,
+			       void *buffer, uint32_t size,
+			       uint32_t offset, const void *data, uint32_t len)
+{
+	spa_ringbuffer_write_data(NULL, buffer, size, offset, data, len);
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_SPSC_RINGBUFFER_H__ */
@@ -34,12 +34,16 @@
 static const char default_device[] = "hw:0";
 static const uint32_t default_min_latency = 128;
 static const uint32_t default_max_latency = 1024;
+static const bool default_rate_match = false;
+static const uint32_t default_quantum = 0;
 
 static void reset_props(struct props *props)
 {
 	strncpy(props->device, default_device, 64);
 	props->min_latency = default_min_latency;
 	props->max_latency = default_max_latency;
+	props->rate_match = default_rate_match;
+	props->quantum = default_quantum;
 }
 
 static int impl_node_enum_params(struct spa_node *node,
@@ -115,6 +119,13 @@ static int impl_node_enum_params(struct spa_node *node,
 				":", t->param.propType, "ir", p->max_latency,
 					SPA_POD_PROP_MIN_MAX(1, INT32_MAX));
 			break;
+		case 5:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId,   "I", t->prop_rate_match,
+				":", t->param.propName, "s", "Follow the rate of the graph",
+				":", t->param.propType, "b", p->rate_match);
+			break;
 		default:
 			return 0;
 		}
@@ -130,7 +141,9 @@ static int impl_node_enum_params(struct spa_node *node,
 				":", t->prop_device_name, "S-r", p->device_name, sizeof(p->device_name),
 				":", t->prop_card_name,   "S-r", p->card_name, sizeof(p->card_name),
 				":", t->prop_min_latency, "i",   p->min_latency,
-				":", t->prop_max_latency, "i",   p->max_latency);
+				":", t->prop_max_latency, "i",   p->max_latency,
+				":", t->prop_rate_match,  "b",   p->rate_match,
+				":", t->prop_quantum,     "i",   p->quantum);
 			break;
 		default:
 			return 0;
@@ -168,7 +181,12 @@ static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flag
 		spa_pod_object_parse(param,
 			":", t->prop_device,      "?S", p->device, sizeof(p->device),
 			":", t->prop_min_latency, "?i", &p->min_latency,
-			":", t->prop_max_latency, "?i", &p->max_latency, NULL);
+			":", t->prop_max_latency, "?i", &p->max_latency,
+			":", t->prop_rate_match,  "?b", &p->rate_match,
+			":", t->prop_quantum,     "?i", &p->quantum, NULL);
+
+		if (this->started)
+			this->threshold = spa_alsa_get_threshold(this);
 	}
 	else
 		return -ENOENT;
@@ -594,6 +612,7 @@ static int impl_node_process_input(struct spa_node *node)
 
 		spa_list_append(&this->ready, &b->link);
 		b->outstanding = false;
+		this->quantum = b->outbuf->datas[0].chunk->size / this->frame_size;
 		input->buffer_id = SPA_ID_INVALID;
 		input->status = SPA_STATUS_OK;
 	}
@@ -713,6 +732,10 @@ impl_init(const struct spa_handle_factory *factory,
 		if (!strcmp(info->items[i].key, "alsa.card")) {
 			snprintf(this->props.device, 63, "%s", info->items[i].value);
 		}
+		else if (!strcmp(info->items[i].key, "alsa.rate-match")) {
+			this->props.rate_match = strcmp(info->items[i].value, "true") == 0 ||
+				atoi(info->items[i].value) == 1;
+		}
 	}
 
 	return 0;
@@ -34,11 +34,15 @@
 
 static const char default_device[] = "hw:0";
 static const uint32_t default_min_latency = 1024;
+static const bool default_rate_match = false;
+static const uint32_t default_quantum = 0;
 
 static void reset_props(struct props *props)
 {
 	strncpy(props->device, default_device, 64);
 	props->min_latency = default_min_latency;
+	props->rate_match = default_rate_match;
+	props->quantum = default_quantum;
 }
 
 static int impl_node_enum_params(struct spa_node *node,
@@ -107,6 +111,13 @@ static int impl_node_enum_params(struct spa_node *node,
 				":", t->param.propType, "ir", p->min_latency,
 					SPA_POD_PROP_MIN_MAX(1, INT32_MAX));
 			break;
+		case 4:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId, "I", t->prop_rate_match,
+				":", t->param.propName, "s", "Follow the rate of the graph",
+				":", t->param.propType, "b", p->rate_match);
+			break;
 		default:
 			return 0;
 		}
@@ -119,7 +130,9 @@ static int impl_node_enum_params(struct spa_node *node,
 				":", t->prop_device,      "S",   p->device, sizeof(p->device),
 				":", t->prop_device_name, "S-r", p->device_name, sizeof(p->device_name),
 				":", t->prop_card_name,   "S-r", p->card_name, sizeof(p->card_name),
-				":", t->prop_min_latency, "i",   p->min_latency);
+				":", t->prop_min_latency, "i",   p->min_latency,
+				":", t->prop_rate_match,  "b",   p->rate_match,
+				":", t->prop_quantum,     "i",   p->quantum);
 			break;
 		default:
 			return 0;
@@ -156,7 +169,12 @@ static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flag
 		}
 		spa_pod_object_parse(param,
 			":", t->prop_device,      "?S", p->device, sizeof(p->device),
-			":", t->prop_min_latency, "?i", &p->min_latency, NULL);
+			":", t->prop_min_latency, "?i", &p->min_latency,
+			":", t->prop_rate_match,  "?b", &p->rate_match,
+			":", t->prop_quantum,     "?i", &p->quantum, NULL);
+
+		if (this->started)
+			this->threshold = spa_alsa_get_threshold(this);
 	}
 	else
 		return -ENOENT;
@@ -617,6 +635,11 @@ static int impl_node_process_output(struct spa_node *node)
 		recycle_buffer(this, io->buffer_id);
 		io->buffer_id = SPA_ID_INVALID;
 	}
+
+	/* when matching the rate of the graph, we produce a buffer when asked */
+	if (this->matching && io->status == SPA_STATUS_NEED_BUFFER)
+		return spa_alsa_read_ring(this);
+
 	return 0;
 }
 
@@ -779,6 +802,10 @@ impl_init(const struct spa_handle_factory *factory,
 		if (!strcmp(info->items[i].key, "alsa.card")) {
 			snprintf(this->props.device, 63, "%s", info->items[i].value);
 		}
+		else if (!strcmp(info->items[i].key, "alsa.rate-match")) {
+			this->props.rate_match = strcmp(info->items[i].value, "true") == 0 ||
+				atoi(info->items[i].value) == 1;
+		}
 	}
 	return 0;
 }
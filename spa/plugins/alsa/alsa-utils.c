@@ -15,6 +15,9 @@
 
 #define CHECK(s,msg) if ((err = (s)) < 0) { spa_log_error(state->log, msg ": %s", snd_strerror(err)); return err; }
 
+/* the size of the ringbuffer of a rate matched capture device */
+#define RING_FRAMES	8192
+
 static int spa_alsa_open(struct state *state)
 {
 	int err;
@@ -334,6 +337,294 @@ static inline void calc_timeout(size_t target, size_t current,
 	}
 }
 
+static void free_matching(struct state *state)
+{
+	resample_free(&state->resample);
+	free(state->tmp);
+	state->tmp = NULL;
+	free(state->ring_data);
+	state->ring_data = NULL;
+	state->matching = false;
+}
+
+/* prepare the resampler when the device needs to follow the rate of the
+ * graph, only formats we can convert are supported */
+static int init_matching(struct state *state)
+{
+	uint32_t i, n_floats;
+	int res;
+
+	state->matching = false;
+
+	if (!state->props.rate_match)
+		return 0;
+
+	switch (state->format) {
+	case SND_PCM_FORMAT_S16:
+		state->conv_fmt = CONV_FMT_S16;
+		break;
+#if __BYTE_ORDER == __BIG_ENDIAN
+	case SND_PCM_FORMAT_S24_3BE:
+#else
+	case SND_PCM_FORMAT_S24_3LE:
+#endif
+		state->conv_fmt = CONV_FMT_S24;
+		break;
+	case SND_PCM_FORMAT_S32:
+		state->conv_fmt = CONV_FMT_S32;
+		break;
+	case SND_PCM_FORMAT_FLOAT:
+		state->conv_fmt = CONV_FMT_F32;
+		break;
+	default:
+		spa_log_warn(state->log, "alsa %p: can't rate match format %s", state,
+				snd_pcm_format_name(state->format));
+		return 0;
+	}
+	if (state->channels > CONV_MAX_CHANNELS) {
+		spa_log_warn(state->log, "alsa %p: can't rate match %d channels", state,
+				state->channels);
+		return 0;
+	}
+
+	conv_get_ops(&state->conv);
+	if ((res = resample_init(&state->resample, state->channels,
+				 state->rate, state->rate, conv_get_cpu_flags())) < 0)
+		return res;
+
+	n_floats = 2 * state->channels * RESAMPLE_BLOCK;
+	state->tmp = malloc(n_floats * sizeof(float) + RESAMPLE_BLOCK * state->frame_size);
+	if (state->tmp == NULL)
+		goto no_mem;
+
+	for (i = 0; i < state->channels; i++) {
+		state->tmp_in[i] = state->tmp + i * RESAMPLE_BLOCK;
+		state->tmp_out[i] = state->tmp + (state->channels + i) * RESAMPLE_BLOCK;
+	}
+	state->tmp_frames = (uint8_t *) (state->tmp + n_floats);
+
+	if (state->stream == SND_PCM_STREAM_CAPTURE) {
+		for (state->ring_size = 1;
+		     state->ring_size < RING_FRAMES * state->frame_size;
+		     state->ring_size <<= 1);
+		state->ring_data = malloc(state->ring_size);
+		if (state->ring_data == NULL)
+			goto no_mem;
+		spa_ringbuffer_init(&state->ring);
+	}
+
+	dll_init(&state->dll);
+	dll_set_bw(&state->dll, DLL_BW_MAX, state->threshold, state->rate);
+	state->corr = 1.0;
+	state->quantum = state->threshold;
+	state->matching = true;
+
+	spa_log_info(state->log, "alsa %p: rate matching enabled", state);
+
+	return 0;
+
+      no_mem:
+	free_matching(state);
+	return -ENOMEM;
+}
+
+/* feed the difference between the wanted and the current amount of queued
+ * frames to the DLL, the result is used as the resampler rate */
+static void update_matching(struct state *state, int64_t queued)
+{
+	double err, corr;
+
+	err = (double) (state->threshold + state->quantum) - queued;
+	corr = dll_update(&state->dll, err);
+	state->corr = SPA_CLAMP(corr, 0.95, 1.05);
+
+	/* when the loop settled, lower the bandwidth to filter out jitter */
+	if (state->dll.bw > DLL_BW_MIN && state->sample_count > 4 * state->rate)
+		dll_set_bw(&state->dll, DLL_BW_MIN, state->threshold, state->rate);
+
+	spa_log_trace(state->log, "alsa %p: queued %ld err %f corr %f", state,
+			queued, err, state->corr);
+}
+
+/* the number of frames in the ready buffers and the resampler that are not
+ * yet written to the device */
+static int64_t queued_frames(struct state *state)
+{
+	struct buffer *b;
+	int64_t queued = -state->ready_offset;
+
+	spa_list_for_each(b, &state->ready, link)
+		queued += b->outbuf->datas[0].chunk->size;
+
+	queued /= state->frame_size;
+	queued += state->resample.hist_len - (int64_t) state->resample.pos;
+
+	return queued;
+}
+
+/* resample the ready buffers into the device */
+static snd_pcm_uframes_t
+pull_frames_match(struct state *state,
+		  const snd_pcm_channel_area_t *my_areas,
+		  snd_pcm_uframes_t offset,
+		  snd_pcm_uframes_t frames)
+{
+	struct resample *r = &state->resample;
+	snd_pcm_uframes_t total_frames = 0;
+
+	resample_update_rate(r, state->corr);
+
+	while (total_frames < frames) {
+		struct buffer *b = NULL;
+		struct spa_data *d = NULL;
+		const void *src;
+		void *dst;
+		uint32_t in_len = 0, out_len, offs, avail;
+
+		if (!spa_list_is_empty(&state->ready)) {
+			b = spa_list_first(&state->ready, struct buffer, link);
+			d = b->outbuf->datas;
+
+			offs = (d[0].chunk->offset + state->ready_offset) % d[0].maxsize;
+			avail = SPA_MIN(d[0].chunk->size - state->ready_offset, d[0].maxsize - offs);
+			in_len = SPA_MIN(avail / state->frame_size, RESAMPLE_BLOCK);
+
+			src = SPA_MEMBER(d[0].data, offs, void);
+			state->conv.to_f32p[state->conv_fmt]((void **) state->tmp_in,
+					&src, state->channels, in_len);
+		}
+
+		out_len = SPA_MIN(frames - total_frames, RESAMPLE_BLOCK);
+		resample_process(r, (const float **) state->tmp_in, &in_len,
+				state->tmp_out, &out_len);
+
+		dst = SPA_MEMBER(my_areas[0].addr, (offset + total_frames) * state->frame_size, void);
+		state->conv.from_f32p[state->conv_fmt](&dst,
+				(const void **) state->tmp_out, state->channels, out_len);
+
+		total_frames += out_len;
+
+		if (b) {
+			state->ready_offset += in_len * state->frame_size;
+
+			if (d[0].chunk->size - state->ready_offset < state->frame_size) {
+				spa_list_remove(&b->link);
+				b->outstanding = true;
+				spa_log_trace(state->log, "alsa-util %p: reuse buffer %u", state, b->outbuf->id);
+				state->callbacks->reuse_buffer(state->callbacks_data, 0, b->outbuf->id);
+				state->ready_offset = 0;
+			}
+		}
+		else if (out_len == 0)
+			break;
+	}
+	return total_frames;
+}
+
+/* resample the captured frames into the ringbuffer, the graph takes them
+ * out again with spa_alsa_read_ring() */
+static snd_pcm_uframes_t
+push_frames_match(struct state *state,
+		  const snd_pcm_channel_area_t *my_areas,
+		  snd_pcm_uframes_t offset,
+		  snd_pcm_uframes_t frames)
+{
+	struct resample *r = &state->resample;
+	snd_pcm_uframes_t total_frames = 0;
+	uint32_t index;
+	int32_t filled;
+
+	resample_update_rate(r, state->corr);
+
+	filled = spa_ringbuffer_get_write_index(&state->ring, &index);
+
+	while (total_frames < frames) {
+		const void *src;
+		void *dst = state->tmp_frames;
+		uint32_t in_len, out_len, n_bytes;
+
+		out_len = SPA_MIN((state->ring_size - filled) / state->frame_size, RESAMPLE_BLOCK);
+		if (out_len == 0) {
+			spa_log_trace(state->log, "alsa-util %p: overrun, drop %lu frames",
+					state, frames - total_frames);
+			total_frames = frames;
+			break;
+		}
+		in_len = SPA_MIN(frames - total_frames, RESAMPLE_BLOCK);
+
+		src = SPA_MEMBER(my_areas[0].addr, (offset + total_frames) * state->frame_size, void);
+		state->conv.to_f32p[state->conv_fmt]((void **) state->tmp_in,
+				&src, state->channels, in_len);
+
+		resample_process(r, (const float **) state->tmp_in, &in_len,
+				state->tmp_out, &out_len);
+
+		state->conv.from_f32p[state->conv_fmt](&dst,
+				(const void **) state->tmp_out, state->channels, out_len);
+
+		n_bytes = out_len * state->frame_size;
+		spa_ringbuffer_write_data(&state->ring, state->ring_data, state->ring_size,
+				index % state->ring_size, state->tmp_frames, n_bytes);
+		index += n_bytes;
+		filled += n_bytes;
+
+		total_frames += in_len;
+	}
+	spa_ringbuffer_write_update(&state->ring, index);
+
+	return total_frames;
+}
+
+/** Take a quantum of rate matched capture frames from the ringbuffer
+ * \param state the capture state
+ * \return SPA_STATUS_HAVE_BUFFER when a buffer was placed in the io area
+ */
+int spa_alsa_read_ring(struct state *state)
+{
+	struct spa_io_buffers *io = state->io;
+	struct buffer *b;
+	struct spa_data *d;
+	uint32_t index, n_bytes;
+	int32_t avail;
+
+	if (state->range && state->range->min_size != 0)
+		state->quantum = state->range->min_size / state->frame_size;
+
+	avail = spa_ringbuffer_get_read_index(&state->ring, &index);
+	n_bytes = state->quantum * state->frame_size;
+
+	if (avail < (int32_t) n_bytes || spa_list_is_empty(&state->free)) {
+		spa_log_trace(state->log, "alsa-util %p: %d of %u bytes queued", state, avail, n_bytes);
+		return SPA_STATUS_OK;
+	}
+
+	b = spa_list_first(&state->free, struct buffer, link);
+	spa_list_remove(&b->link);
+
+	if (b->h) {
+		b->h->seq = state->sample_count;
+		b->h->pts = state->last_monotonic;
+		b->h->dts_offset = 0;
+	}
+
+	d = b->outbuf->datas;
+	n_bytes = SPA_MIN(n_bytes, d[0].maxsize - d[0].maxsize % state->frame_size);
+
+	spa_ringbuffer_read_data(&state->ring, state->ring_data, state->ring_size,
+			index % state->ring_size, d[0].data, n_bytes);
+	spa_ringbuffer_read_update(&state->ring, index + n_bytes);
+
+	d[0].chunk->offset = 0;
+	d[0].chunk->size = n_bytes;
+	d[0].chunk->stride = state->frame_size;
+
+	b->outstanding = true;
+	io->buffer_id = b->outbuf->id;
+	io->status = SPA_STATUS_HAVE_BUFFER;
+
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
 static inline void try_pull(struct state *state, snd_pcm_uframes_t frames,
 		snd_pcm_uframes_t written, bool do_pull)
 {
@@ -362,6 +653,12 @@ pull_frames(struct state *state,
 	snd_pcm_uframes_t total_frames = 0, to_write = SPA_MIN(frames, state->props.max_latency);
 	bool underrun = false;
 
+	if (state->matching) {
+		total_frames = pull_frames_match(state, my_areas, offset, to_write);
+		offset += total_frames;
+		goto done;
+	}
+
 	try_pull(state, frames, 0, do_pull);
 
 	while (!spa_list_is_empty(&state->ready) && to_write > 0) {
@@ -411,7 +708,7 @@ pull_frames(struct state *state,
 				state, total_frames, to_write);
 	}
 
-
+      done:
 	if (total_frames == 0 && do_pull) {
 		total_frames = SPA_MIN(frames, state->threshold);
 		snd_pcm_areas_silence(my_areas, offset, state->channels, total_frames, state->format);
@@ -535,6 +832,9 @@ static void alsa_on_playback_timeout_event(struct spa_source *source)
 	spa_log_trace(state->log, "timeout %ld %d %ld %ld %ld", state->filled, state->threshold,
 		      state->sample_count, state->now.tv_sec, state->now.tv_nsec);
 
+	if (state->matching && state->alsa_started)
+		update_matching(state, state->filled + queued_frames(state));
+
 	if (state->filled > state->threshold) {
 		if (snd_pcm_state(hndl) == SND_PCM_STATE_SUSPENDED) {
 			spa_log_error(state->log, "suspended: try resume");
@@ -638,7 +938,10 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 				return;
 			}
 
-			read = push_frames(state, my_areas, offset, frames);
+			if (state->matching)
+				read = push_frames_match(state, my_areas, offset, frames);
+			else
+				read = push_frames(state, my_areas, offset, frames);
 			if (read < frames)
 				to_read = 0;
 
@@ -650,6 +953,12 @@ static void alsa_on_capture_timeout_event(struct spa_source *source)
 			total_read += read;
 		}
 		state->sample_count += total_read;
+
+		if (state->matching) {
+			uint32_t index;
+			int32_t filled = spa_ringbuffer_get_write_index(&state->ring, &index);
+			update_matching(state, filled / state->frame_size);
+		}
 	}
 	calc_timeout(state->threshold, avail - total_read, state->rate, &htstamp, &ts.it_value);
 
@@ -688,7 +997,10 @@ int spa_alsa_start(struct state *state, bool xrun_recover)
 	state->source.rmask = 0;
 	spa_loop_add_source(state->data_loop, &state->source);
 
-	state->threshold = state->props.min_latency;
+	state->threshold = spa_alsa_get_threshold(state);
+
+	if ((err = init_matching(state)) < 0)
+		return err;
 
 	if (state->stream == SND_PCM_STREAM_PLAYBACK) {
 		state->alsa_started = false;
@@ -741,6 +1053,7 @@ int spa_alsa_pause(struct state *state, bool xrun_recover)
 	spa_log_debug(state->log, "alsa %p: pause", state);
 
 	spa_loop_invoke(state->data_loop, do_remove_source, 0, NULL, 0, true, state);
+	free_matching(state);
 
 	if ((err = snd_pcm_drop(state->hndl)) < 0)
 		spa_log_error(state->log, "snd_pcm_drop %s", snd_strerror(err));
@@ -32,6 +32,7 @@ extern "C" {
 #include <spa/support/loop.h>
 #include <spa/support/log.h>
 #include <spa/utils/list.h>
+#include <spa/utils/ringbuffer.h>
 
 #include <spa/clock/clock.h>
 #include <spa/node/node.h>
@@ -40,12 +41,18 @@ extern "C" {
 #include <spa/param/meta.h>
 #include <spa/param/audio/format-utils.h>
 
+#include "fmt-ops.h"
+#include "resample.h"
+#include "dll.h"
+
 struct props {
 	char device[64];
 	char device_name[128];
 	char card_name[128];
 	uint32_t min_latency;
 	uint32_t max_latency;
+	bool rate_match;
+	uint32_t quantum;
 };
 
 #define MAX_BUFFERS 32
@@ -67,6 +74,8 @@ struct type {
 	uint32_t prop_card_name;
 	uint32_t prop_min_latency;
 	uint32_t prop_max_latency;
+	uint32_t prop_rate_match;
+	uint32_t prop_quantum;
 	struct spa_type_io io;
 	struct spa_type_param param;
 	struct spa_type_meta meta;
@@ -93,6 +102,8 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->prop_card_name = spa_type_map_get_id(map, SPA_TYPE_PROPS__cardName);
 	type->prop_min_latency = spa_type_map_get_id(map, SPA_TYPE_PROPS__minLatency);
 	type->prop_max_latency = spa_type_map_get_id(map, SPA_TYPE_PROPS__maxLatency);
+	type->prop_rate_match = spa_type_map_get_id(map, SPA_TYPE_PROPS__rateMatch);
+	type->prop_quantum = spa_type_map_get_id(map, SPA_TYPE_PROPS__quantum);
 
 	spa_type_io_map(map, &type->io);
 	spa_type_param_map(map, &type->param);
@@ -168,6 +179,24 @@ struct state {
 	int64_t last_monotonic;
 
 	uint64_t underrun;
+
+	/* rate matching, the device is resampled to follow the rate of
+	 * the graph */
+	bool matching;
+	uint32_t conv_fmt;
+	struct conv_ops conv;
+	struct resample resample;
+	struct dll dll;
+	double corr;
+	uint32_t quantum;
+	float *tmp;
+	float *tmp_in[CONV_MAX_CHANNELS];
+	float *tmp_out[CONV_MAX_CHANNELS];
+	uint8_t *tmp_frames;
+
+	struct spa_ringbuffer ring;
+	uint8_t *ring_data;
+	uint32_t ring_size;
 };
 
 int
@@ -183,6 +212,14 @@ int spa_alsa_start(struct state *state, bool xrun_recover);
 int spa_alsa_pause(struct state *state, bool xrun_recover);
 int spa_alsa_close(struct state *state);
 
+int spa_alsa_read_ring(struct state *state);
+
+/* the quantum of the graph, when set, overrides the configured latency */
+static inline int spa_alsa_get_threshold(struct state *state)
+{
+	return state->props.quantum != 0 ? state->props.quantum : state->props.min_latency;
+}
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -0,0 +1,79 @@
+/* Spa ALSA
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_ALSA_DLL_H__
+#define __SPA_ALSA_DLL_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <math.h>
+
+#define DLL_BW_MAX	0.128
+#define DLL_BW_MIN	0.016
+
+/** A delay locked loop
+ *
+ * The loop is fed with the difference between the wanted and the measured
+ * fill level of a buffer and returns the correction for the rate of the
+ * consumer of the buffer. A correction > 1.0 means that the buffer should
+ * be drained faster.
+ */
+struct dll {
+	double bw;
+	double z1, z2, z3;
+	double w0, w1, w2;
+};
+
+static inline void dll_init(struct dll *dll)
+{
+	dll->bw = 0.0;
+	dll->z1 = dll->z2 = dll->z3 = 0.0;
+}
+
+/** Set the bandwidth of the loop
+ * \param dll the loop
+ * \param bw the bandwidth in Hz
+ * \param period the number of samples between updates
+ * \param rate the sample rate
+ */
+static inline void dll_set_bw(struct dll *dll, double bw, unsigned int period, unsigned int rate)
+{
+	double w = 2 * M_PI * bw * period / rate;
+
+	dll->w0 = 1.0 - exp(-20.0 * w);
+	dll->w1 = w * 1.5 / period;
+	dll->w2 = w / 1.5;
+	dll->bw = bw;
+}
+
+static inline double dll_update(struct dll *dll, double err)
+{
+	dll->z1 += dll->w0 * (dll->w1 * err - dll->z1);
+	dll->z2 += dll->w0 * (dll->z1 - dll->z2);
+	dll->z3 += dll->w2 * dll->z2;
+	return 1.0 - (dll->z2 + dll->z3);
+}
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* __SPA_ALSA_DLL_H__ */
@@ -0,0 +1,1134 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <spa/support/log.h>
+#include <spa/support/type-map.h>
+#include <spa/utils/list.h>
+#include <spa/node/node.h>
+#include <spa/node/io.h>
+#include <spa/param/audio/format-utils.h>
+#include <spa/param/buffers.h>
+#include <spa/param/meta.h>
+#include <spa/param/io.h>
+#include <spa/pod/filter.h>
+
+#include "fmt-ops.h"
+#include "channelmix.h"
+#include "resample.h"
+
+#define NAME "audioconvert"
+
+#define DEFAULT_RATE		44100
+#define DEFAULT_CHANNELS	2
+
+/* the number of frames we convert at once */
+#define MAX_SAMPLES		1024
+
+#define MAX_BUFFERS		16
+
+struct buffer {
+	struct spa_buffer *outbuf;
+	bool outstanding;
+	struct spa_meta_header *h;
+	struct spa_list link;
+};
+
+struct port {
+	bool have_format;
+	struct spa_audio_info format;
+	uint32_t fmt;			/**< CONV_FMT_* */
+	uint32_t n_channels;
+	uint32_t n_planes;
+	uint32_t stride;		/**< bytes per frame in a plane */
+
+	struct spa_port_info info;
+
+	struct buffer buffers[MAX_BUFFERS];
+	uint32_t n_buffers;
+	struct spa_io_buffers *io;
+	struct spa_io_control_range *range;
+
+	struct spa_list empty;
+};
+
+struct type {
+	uint32_t node;
+	uint32_t format;
+	struct spa_type_io io;
+	struct spa_type_param param;
+	struct spa_type_meta meta;
+	struct spa_type_data data;
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+	struct spa_type_command_node command_node;
+	struct spa_type_param_buffers param_buffers;
+	struct spa_type_param_meta param_meta;
+	struct spa_type_param_io param_io;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	type->node = spa_type_map_get_id(map, SPA_TYPE__Node);
+	type->format = spa_type_map_get_id(map, SPA_TYPE__Format);
+	spa_type_io_map(map, &type->io);
+	spa_type_param_map(map, &type->param);
+	spa_type_meta_map(map, &type->meta);
+	spa_type_data_map(map, &type->data);
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+	spa_type_command_node_map(map, &type->command_node);
+	spa_type_param_buffers_map(map, &type->param_buffers);
+	spa_type_param_meta_map(map, &type->param_meta);
+	spa_type_param_io_map(map, &type->param_io);
+}
+
+struct impl {
+	struct spa_handle handle;
+	struct spa_node node;
+
+	struct type type;
+	struct spa_type_map *map;
+	struct spa_log *log;
+
+	const struct spa_node_callbacks *callbacks;
+	void *callbacks_data;
+
+	struct port in_ports[1];
+	struct port out_ports[1];
+
+	uint32_t cpu_flags;
+	struct conv_ops ops;
+
+	/* the conversion is done in F32P in 3 steps: channel mixing,
+	 * resampling and conversion to the output format, steps that
+	 * don't change anything are skipped */
+	bool configured;
+	struct channelmix mix;
+	bool use_resample;
+	struct resample resample;
+
+	float *tmp;
+	float *tmp_in[CONV_MAX_CHANNELS];
+	float *tmp_mix[CONV_MAX_CHANNELS];
+	float *tmp_out[CONV_MAX_CHANNELS];
+
+	bool started;
+};
+
+#define CHECK_IN_PORT(this,d,p)  ((d) == SPA_DIRECTION_INPUT && (p) == 0)
+#define CHECK_OUT_PORT(this,d,p) ((d) == SPA_DIRECTION_OUTPUT && (p) == 0)
+#define CHECK_PORT(this,d,p)     ((p) == 0)
+#define GET_IN_PORT(this,p)	 (&this->in_ports[p])
+#define GET_OUT_PORT(this,p)	 (&this->out_ports[p])
+#define GET_PORT(this,d,p)	 (d == SPA_DIRECTION_INPUT ? GET_IN_PORT(this,p) : GET_OUT_PORT(this,p))
+#define GET_OTHER_PORT(this,d,p) (d == SPA_DIRECTION_INPUT ? GET_OUT_PORT(this,p) : GET_IN_PORT(this,p))
+
+static int impl_node_enum_params(struct spa_node *node,
+				 uint32_t id, uint32_t *index,
+				 const struct spa_pod *filter,
+				 struct spa_pod **result,
+				 struct spa_pod_builder *builder)
+{
+	return -ENOTSUP;
+}
+
+static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flags,
+			       const struct spa_pod *param)
+{
+	return -ENOTSUP;
+}
+
+static int impl_node_send_command(struct spa_node *node, const struct spa_command *command)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(command != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	if (SPA_COMMAND_TYPE(command) == this->type.command_node.Start) {
+		this->started = true;
+	} else if (SPA_COMMAND_TYPE(command) == this->type.command_node.Pause) {
+		this->started = false;
+	} else
+		return -ENOTSUP;
+
+	return 0;
+}
+
+static int
+impl_node_set_callbacks(struct spa_node *node,
+			const struct spa_node_callbacks *callbacks,
+			void *data)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	this->callbacks = callbacks;
+	this->callbacks_data = data;
+
+	return 0;
+}
+
+static int
+impl_node_get_n_ports(struct spa_node *node,
+		      uint32_t *n_input_ports,
+		      uint32_t *max_input_ports,
+		      uint32_t *n_output_ports,
+		      uint32_t *max_output_ports)
+{
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	if (n_input_ports)
+		*n_input_ports = 1;
+	if (max_input_ports)
+		*max_input_ports = 1;
+	if (n_output_ports)
+		*n_output_ports = 1;
+	if (max_output_ports)
+		*max_output_ports = 1;
+
+	return 0;
+}
+
+static int
+impl_node_get_port_ids(struct spa_node *node,
+		       uint32_t *input_ids,
+		       uint32_t n_input_ids,
+		       uint32_t *output_ids,
+		       uint32_t n_output_ids)
+{
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	if (n_input_ids > 0 && input_ids)
+		input_ids[0] = 0;
+	if (n_output_ids > 0 && output_ids)
+		output_ids[0] = 0;
+
+	return 0;
+}
+
+static int impl_node_add_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_remove_port(struct spa_node *node, enum spa_direction direction, uint32_t port_id)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_port_get_info(struct spa_node *node,
+			enum spa_direction direction,
+			uint32_t port_id,
+			const struct spa_port_info **info)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+	*info = &port->info;
+
+	return 0;
+}
+
+/* we can convert to and from any format, prefer the format of the other
+ * port so that we don't convert when we don't need to */
+static int port_enum_formats(struct spa_node *node,
+			     enum spa_direction direction, uint32_t port_id,
+			     uint32_t *index,
+			     const struct spa_pod *filter,
+			     struct spa_pod **param,
+			     struct spa_pod_builder *builder)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct type *t = &this->type;
+	struct port *other = GET_OTHER_PORT(this, direction, port_id);
+	uint32_t format = t->audio_format.S16, layout = SPA_AUDIO_LAYOUT_INTERLEAVED;
+	uint32_t rate = DEFAULT_RATE, channels = DEFAULT_CHANNELS;
+
+	if (other->have_format) {
+		format = other->format.info.raw.format;
+		layout = other->format.info.raw.layout;
+		rate = other->format.info.raw.rate;
+		channels = other->format.info.raw.channels;
+	}
+
+	switch (*index) {
+	case 0:
+		*param = spa_pod_builder_object(builder,
+			t->param.idEnumFormat, t->format,
+			"I", t->media_type.audio,
+			"I", t->media_subtype.raw,
+			":", t->format_audio.format,  "Ieu", format,
+				SPA_POD_PROP_ENUM(4, t->audio_format.S16,
+						     t->audio_format.S24,
+						     t->audio_format.S32,
+						     t->audio_format.F32),
+			":", t->format_audio.layout,  "ieu", layout,
+				SPA_POD_PROP_ENUM(2, SPA_AUDIO_LAYOUT_INTERLEAVED,
+						     SPA_AUDIO_LAYOUT_NON_INTERLEAVED),
+			":", t->format_audio.rate,    "iru", rate,
+				SPA_POD_PROP_MIN_MAX(1, INT32_MAX),
+			":", t->format_audio.channels,"iru", channels,
+				SPA_POD_PROP_MIN_MAX(1, CONV_MAX_CHANNELS));
+		break;
+	default:
+		return 0;
+	}
+	return 1;
+}
+
+static int port_get_format(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t *index,
+			   const struct spa_pod *filter,
+			   struct spa_pod **param,
+			   struct spa_pod_builder *builder)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct port *port;
+	struct type *t = &this->type;
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return -EIO;
+	if (*index > 0)
+		return 0;
+
+	*param = spa_pod_builder_object(builder,
+			t->param.idFormat, t->format,
+			"I", t->media_type.audio,
+			"I", t->media_subtype.raw,
+			":", t->format_audio.format,   "I", port->format.info.raw.format,
+			":", t->format_audio.layout,   "i", port->format.info.raw.layout,
+			":", t->format_audio.rate,     "i", port->format.info.raw.rate,
+			":", t->format_audio.channels, "i", port->format.info.raw.channels);
+
+	return 1;
+}
+
+/* the size of the buffers on a port, when we upsample, the output buffers
+ * need to be larger than the input buffers */
+static uint32_t port_get_buffer_size(struct impl *this, enum spa_direction direction,
+				     struct port *port)
+{
+	struct port *other = GET_OTHER_PORT(this, direction, 0);
+	uint64_t size = MAX_SAMPLES * port->stride;
+
+	if (direction == SPA_DIRECTION_OUTPUT && other->have_format &&
+	    other->format.info.raw.rate < port->format.info.raw.rate)
+		size = size * port->format.info.raw.rate / other->format.info.raw.rate + port->stride;
+
+	return SPA_MIN(size, INT32_MAX);
+}
+
+static int
+impl_node_port_enum_params(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t id, uint32_t *index,
+			   const struct spa_pod *filter,
+			   struct spa_pod **result,
+			   struct spa_pod_builder *builder)
+{
+	struct impl *this;
+	struct type *t;
+	struct port *port;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buffer[1024];
+	struct spa_pod *param;
+	int res;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+	spa_return_val_if_fail(builder != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+      next:
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+
+	if (id == t->param.idList) {
+		uint32_t list[] = { t->param.idEnumFormat,
+				    t->param.idFormat,
+				    t->param.idBuffers,
+				    t->param.idMeta,
+				    t->param_io.idBuffers,
+				    t->param_io.idControl };
+
+		if (*index < SPA_N_ELEMENTS(list))
+			param = spa_pod_builder_object(&b, id, t->param.List,
+				":", t->param.listId, "I", list[*index]);
+		else
+			return 0;
+	}
+	else if (id == t->param.idEnumFormat) {
+		if ((res = port_enum_formats(node, direction, port_id, index, filter, &param, &b)) <= 0)
+			return res;
+	}
+	else if (id == t->param.idFormat) {
+		if ((res = port_get_format(node, direction, port_id, index, filter, &param, &b)) <= 0)
+			return res;
+	}
+	else if (id == t->param.idBuffers) {
+		if (!port->have_format)
+			return -EIO;
+		if (*index > 0)
+			return 0;
+
+		param = spa_pod_builder_object(&b,
+			id, t->param_buffers.Buffers,
+			":", t->param_buffers.size,    "iru", port_get_buffer_size(this, direction, port),
+				SPA_POD_PROP_MIN_MAX(16 * port->stride, INT32_MAX / port->stride),
+			":", t->param_buffers.stride,  "i", 0,
+			":", t->param_buffers.buffers, "iru", 2,
+				SPA_POD_PROP_MIN_MAX(1, MAX_BUFFERS),
+			":", t->param_buffers.align,   "i", 16);
+	}
+	else if (id == t->param.idMeta) {
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_meta.Meta,
+				":", t->param_meta.type, "I", t->meta.Header,
+				":", t->param_meta.size, "i", sizeof(struct spa_meta_header));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else if (id == t->param_io.idBuffers) {
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_io.Buffers,
+				":", t->param_io.id, "I", t->io.Buffers,
+				":", t->param_io.size, "i", sizeof(struct spa_io_buffers));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else if (id == t->param_io.idControl) {
+		switch (*index) {
+		case 0:
+			param = spa_pod_builder_object(&b,
+				id, t->param_io.Control,
+				":", t->param_io.id, "I", t->io.ControlRange,
+				":", t->param_io.size, "i", sizeof(struct spa_io_control_range));
+			break;
+		default:
+			return 0;
+		}
+	}
+	else
+		return -ENOENT;
+
+	(*index)++;
+
+	if (spa_pod_filter(builder, result, param, filter) < 0)
+		goto next;
+
+	return 1;
+}
+
+static int clear_buffers(struct impl *this, struct port *port)
+{
+	if (port->n_buffers > 0) {
+		spa_log_info(this->log, NAME " %p: clear buffers", this);
+		port->n_buffers = 0;
+		spa_list_init(&port->empty);
+	}
+	return 0;
+}
+
+static void clear_convert(struct impl *this)
+{
+	if (this->use_resample)
+		resample_free(&this->resample);
+	this->use_resample = false;
+	free(this->tmp);
+	this->tmp = NULL;
+	this->configured = false;
+}
+
+/* prepare the conversion when the formats of both ports are known */
+static int setup_convert(struct impl *this)
+{
+	struct port *in_port = GET_IN_PORT(this, 0), *out_port = GET_OUT_PORT(this, 0);
+	uint32_t i, in_channels, out_channels, in_rate, out_rate;
+	float *p;
+	int res;
+
+	clear_convert(this);
+
+	if (!in_port->have_format || !out_port->have_format)
+		return 0;
+
+	in_channels = in_port->n_channels;
+	out_channels = out_port->n_channels;
+	in_rate = in_port->format.info.raw.rate;
+	out_rate = out_port->format.info.raw.rate;
+
+	spa_log_info(this->log, NAME " %p: %d channels %d Hz -> %d channels %d Hz", this,
+			in_channels, in_rate, out_channels, out_rate);
+
+	if ((res = channelmix_init(&this->mix, in_channels, out_channels)) < 0)
+		return res;
+
+	if (in_rate != out_rate) {
+		if ((res = resample_init(&this->resample, out_channels, in_rate, out_rate,
+					 this->cpu_flags)) < 0)
+			return res;
+		this->use_resample = true;
+	}
+
+	this->tmp = calloc((in_channels + out_channels * 2) * MAX_SAMPLES, sizeof(float));
+	if (this->tmp == NULL) {
+		clear_convert(this);
+		return -ENOMEM;
+	}
+	p = this->tmp;
+	for (i = 0; i < in_channels; i++, p += MAX_SAMPLES)
+		this->tmp_in[i] = p;
+	for (i = 0; i < out_channels; i++, p += MAX_SAMPLES)
+		this->tmp_mix[i] = p;
+	for (i = 0; i < out_channels; i++, p += MAX_SAMPLES)
+		this->tmp_out[i] = p;
+
+	this->configured = true;
+
+	return 0;
+}
+
+static int parse_format(struct impl *this, struct port *port, const struct spa_pod *format)
+{
+	struct type *t = &this->type;
+	struct spa_audio_info info = { 0 };
+	uint32_t fmt, size;
+
+	spa_pod_object_parse(format,
+		"I", &info.media_type,
+		"I", &info.media_subtype);
+
+	if (info.media_type != t->media_type.audio ||
+	    info.media_subtype != t->media_subtype.raw)
+		return -EINVAL;
+
+	if (spa_format_audio_raw_parse(format, &info.info.raw, &t->format_audio) < 0)
+		return -EINVAL;
+
+	if (info.info.raw.format == t->audio_format.S16) {
+		fmt = CONV_FMT_S16;
+		size = sizeof(int16_t);
+	}
+	else if (info.info.raw.format == t->audio_format.S24) {
+		fmt = CONV_FMT_S24;
+		size = 3;
+	}
+	else if (info.info.raw.format == t->audio_format.S32) {
+		fmt = CONV_FMT_S32;
+		size = sizeof(int32_t);
+	}
+	else if (info.info.raw.format == t->audio_format.F32) {
+		fmt = CONV_FMT_F32;
+		size = sizeof(float);
+	}
+	else
+		return -EINVAL;
+
+	if (info.info.raw.channels == 0 || info.info.raw.channels > CONV_MAX_CHANNELS ||
+	    info.info.raw.rate == 0)
+		return -EINVAL;
+
+	port->format = info;
+	port->n_channels = info.info.raw.channels;
+	if (info.info.raw.layout == SPA_AUDIO_LAYOUT_NON_INTERLEAVED) {
+		port->fmt = fmt + 1;
+		port->n_planes = port->n_channels;
+		port->stride = size;
+	} else {
+		port->fmt = fmt;
+		port->n_planes = 1;
+		port->stride = size * port->n_channels;
+	}
+	return 0;
+}
+
+static int port_set_format(struct spa_node *node,
+			   enum spa_direction direction, uint32_t port_id,
+			   uint32_t flags,
+			   const struct spa_pod *format)
+{
+	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct port *port;
+	int res;
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (format == NULL) {
+		port->have_format = false;
+		clear_buffers(this, port);
+		clear_convert(this);
+	} else {
+		if ((res = parse_format(this, port, format)) < 0)
+			return res;
+
+		port->have_format = true;
+
+		if ((res = setup_convert(this)) < 0)
+			return res;
+	}
+
+	return 0;
+}
+
+static int
+impl_node_port_set_param(struct spa_node *node,
+			 enum spa_direction direction, uint32_t port_id,
+			 uint32_t id, uint32_t flags,
+			 const struct spa_pod *param)
+{
+	struct impl *this;
+	struct type *t;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	if (id == t->param.idFormat) {
+		return port_set_format(node, direction, port_id, flags, param);
+	}
+	else
+		return -ENOENT;
+}
+
+static int
+impl_node_port_use_buffers(struct spa_node *node,
+			   enum spa_direction direction,
+			   uint32_t port_id,
+			   struct spa_buffer **buffers,
+			   uint32_t n_buffers)
+{
+	struct impl *this;
+	struct port *port;
+	uint32_t i, j;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (!port->have_format)
+		return -EIO;
+
+	clear_buffers(this, port);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct buffer *b;
+		struct spa_data *d = buffers[i]->datas;
+
+		if (buffers[i]->n_datas < port->n_planes) {
+			spa_log_error(this->log, NAME " %p: not enough planes on buffer %p", this,
+				      buffers[i]);
+			return -EINVAL;
+		}
+
+		for (j = 0; j < port->n_planes; j++) {
+			if ((d[j].type != this->type.data.MemPtr &&
+			     d[j].type != this->type.data.MemFd &&
+			     d[j].type != this->type.data.DmaBuf) || d[j].data == NULL) {
+				spa_log_error(this->log, NAME " %p: invalid memory on buffer %p", this,
+					      buffers[i]);
+				return -EINVAL;
+			}
+		}
+
+		b = &port->buffers[i];
+		b->outbuf = buffers[i];
+		b->outstanding = direction == SPA_DIRECTION_INPUT;
+		b->h = spa_buffer_find_meta(buffers[i], this->type.meta.Header);
+
+		if (!b->outstanding)
+			spa_list_append(&port->empty, &b->link);
+	}
+	port->n_buffers = n_buffers;
+
+	return 0;
+}
+
+static int
+impl_node_port_alloc_buffers(struct spa_node *node,
+			     enum spa_direction direction,
+			     uint32_t port_id,
+			     struct spa_pod **params,
+			     uint32_t n_params,
+			     struct spa_buffer **buffers,
+			     uint32_t *n_buffers)
+{
+	return -ENOTSUP;
+}
+
+static int
+impl_node_port_set_io(struct spa_node *node,
+		      enum spa_direction direction,
+		      uint32_t port_id,
+		      uint32_t id,
+		      void *data, size_t size)
+{
+	struct impl *this;
+	struct port *port;
+	struct type *t;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+	t = &this->type;
+
+	spa_return_val_if_fail(CHECK_PORT(this, direction, port_id), -EINVAL);
+
+	port = GET_PORT(this, direction, port_id);
+
+	if (id == t->io.Buffers)
+		port->io = data;
+	else if (id == t->io.ControlRange)
+		port->range = data;
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static void recycle_buffer(struct impl *this, uint32_t id)
+{
+	struct port *port = GET_OUT_PORT(this, 0);
+	struct buffer *b = &port->buffers[id];
+
+	if (!b->outstanding) {
+		spa_log_warn(this->log, NAME " %p: buffer %d not outstanding", this, id);
+		return;
+	}
+
+	spa_list_append(&port->empty, &b->link);
+	b->outstanding = false;
+	spa_log_trace(this->log, NAME " %p: recycle buffer %d", this, id);
+}
+
+static int impl_node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+{
+	struct impl *this;
+	struct port *port;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	spa_return_val_if_fail(CHECK_PORT(this, SPA_DIRECTION_OUTPUT, port_id),
+			       -EINVAL);
+
+	port = GET_OUT_PORT(this, port_id);
+
+	if (buffer_id >= port->n_buffers)
+		return -EINVAL;
+
+	recycle_buffer(this, buffer_id);
+
+	return 0;
+}
+
+static int
+impl_node_port_send_command(struct spa_node *node,
+			    enum spa_direction direction,
+			    uint32_t port_id,
+			    const struct spa_command *command)
+{
+	return -ENOTSUP;
+}
+
+static struct spa_buffer *find_free_buffer(struct impl *this, struct port *port)
+{
+	struct buffer *b;
+
+	if (spa_list_is_empty(&port->empty))
+		return NULL;
+
+	b = spa_list_first(&port->empty, struct buffer, link);
+	spa_list_remove(&b->link);
+	b->outstanding = true;
+
+	return b->outbuf;
+}
+
+/* convert F32P samples to the output format and append them to the
+ * output buffer */
+static void write_output(struct impl *this, struct spa_data *dd, uint32_t offset,
+			 const float *src[], uint32_t n_frames)
+{
+	struct port *port = GET_OUT_PORT(this, 0);
+	void *dst[CONV_MAX_CHANNELS];
+	uint32_t i;
+
+	for (i = 0; i < port->n_planes; i++)
+		dst[i] = SPA_MEMBER(dd[i].data, offset * port->stride, void);
+
+	this->ops.from_f32p[port->fmt](dst, (const void **) src, port->n_channels, n_frames);
+}
+
+static void do_convert(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
+{
+	struct port *in_port = GET_IN_PORT(this, 0), *out_port = GET_OUT_PORT(this, 0);
+	struct spa_data *sd = sbuf->datas, *dd = dbuf->datas;
+	const void *src[CONV_MAX_CHANNELS];
+	const float *in[CONV_MAX_CHANNELS], *mixed[CONV_MAX_CHANNELS];
+	uint32_t i, c, n_frames, max_frames, done, n, out_done = 0;
+
+	n_frames = UINT32_MAX;
+	for (i = 0; i < in_port->n_planes; i++) {
+		uint32_t soffset = sd[i].chunk->offset % sd[i].maxsize;
+		n_frames = SPA_MIN(n_frames, SPA_MIN(sd[i].chunk->size, sd[i].maxsize - soffset) /
+				in_port->stride);
+	}
+	max_frames = UINT32_MAX;
+	for (i = 0; i < out_port->n_planes; i++)
+		max_frames = SPA_MIN(max_frames, dd[i].maxsize / out_port->stride);
+
+	for (done = 0; done < n_frames && out_done < max_frames; done += n) {
+		n = SPA_MIN(n_frames - done, MAX_SAMPLES);
+
+		for (i = 0; i < in_port->n_planes; i++)
+			src[i] = SPA_MEMBER(sd[i].data,
+					(sd[i].chunk->offset % sd[i].maxsize) + done * in_port->stride, void);
+
+		/* convert to F32P, F32P input can be used as is */
+		if (in_port->fmt == CONV_FMT_F32P) {
+			for (c = 0; c < in_port->n_channels; c++)
+				in[c] = src[c];
+		} else {
+			this->ops.to_f32p[in_port->fmt]((void **) this->tmp_in, src,
+					in_port->n_channels, n);
+			for (c = 0; c < in_port->n_channels; c++)
+				in[c] = this->tmp_in[c];
+		}
+
+		if (this->mix.identity) {
+			for (c = 0; c < out_port->n_channels; c++)
+				mixed[c] = in[c];
+		} else {
+			channelmix_process(&this->mix, this->tmp_mix, in, n);
+			for (c = 0; c < out_port->n_channels; c++)
+				mixed[c] = this->tmp_mix[c];
+		}
+
+		if (!this->use_resample) {
+			uint32_t n_out = SPA_MIN(n, max_frames - out_done);
+			write_output(this, dd, out_done, mixed, n_out);
+			out_done += n_out;
+		} else {
+			uint32_t in_done = 0, in_len, out_len;
+
+			/* the resampler takes what it can from the input, loop until
+			 * all input is used or the output buffer is full */
+			while (true) {
+				in_len = n - in_done;
+				out_len = SPA_MIN(MAX_SAMPLES, max_frames - out_done);
+
+				resample_process(&this->resample, mixed, &in_len,
+						 this->tmp_out, &out_len);
+
+				if (out_len > 0) {
+					write_output(this, dd, out_done,
+						     (const float **) this->tmp_out, out_len);
+					out_done += out_len;
+				}
+				in_done += in_len;
+				for (c = 0; c < out_port->n_channels; c++)
+					mixed[c] += in_len;
+
+				if (in_done == n || (in_len == 0 && out_len == 0))
+					break;
+			}
+			if ((n = in_done) == 0)
+				break;
+		}
+	}
+	if (done < n_frames)
+		spa_log_warn(this->log, NAME " %p: output buffer too small, dropped %d frames",
+				this, n_frames - done);
+
+	for (i = 0; i < out_port->n_planes; i++) {
+		dd[i].chunk->offset = 0;
+		dd[i].chunk->size = out_done * out_port->stride;
+		dd[i].chunk->stride = 0;
+	}
+}
+
+static int impl_node_process_input(struct spa_node *node)
+{
+	struct impl *this;
+	struct spa_io_buffers *input, *output;
+	struct port *in_port, *out_port;
+	struct spa_buffer *dbuf, *sbuf;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, -EIO);
+
+	if (output->status == SPA_STATUS_HAVE_BUFFER)
+		return SPA_STATUS_HAVE_BUFFER;
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, -EIO);
+
+	if (!this->configured)
+		return -EIO;
+
+	if (input->buffer_id >= in_port->n_buffers) {
+		input->status = -EINVAL;
+		return -EINVAL;
+	}
+
+	if ((dbuf = find_free_buffer(this, out_port)) == NULL) {
+		spa_log_error(this->log, NAME " %p: out of buffers", this);
+		return -EPIPE;
+	}
+
+	sbuf = in_port->buffers[input->buffer_id].outbuf;
+
+	input->status = SPA_STATUS_OK;
+
+	spa_log_trace(this->log, NAME " %p: convert %d -> %d", this, sbuf->id, dbuf->id);
+	do_convert(this, dbuf, sbuf);
+
+	output->buffer_id = dbuf->id;
+	output->status = SPA_STATUS_HAVE_BUFFER;
+
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+static int impl_node_process_output(struct spa_node *node)
+{
+	struct impl *this;
+	struct port *in_port, *out_port;
+	struct spa_io_buffers *input, *output;
+
+	spa_return_val_if_fail(node != NULL, -EINVAL);
+
+	this = SPA_CONTAINER_OF(node, struct impl, node);
+
+	out_port = GET_OUT_PORT(this, 0);
+	output = out_port->io;
+	spa_return_val_if_fail(output != NULL, -EIO);
+
+	if (output->status == SPA_STATUS_HAVE_BUFFER)
+		return SPA_STATUS_HAVE_BUFFER;
+
+	/* recycle */
+	if (output->buffer_id < out_port->n_buffers) {
+		recycle_buffer(this, output->buffer_id);
+		output->buffer_id = SPA_ID_INVALID;
+	}
+
+	in_port = GET_IN_PORT(this, 0);
+	input = in_port->io;
+	spa_return_val_if_fail(input != NULL, -EIO);
+
+	/* ask for the amount of input that makes the requested output */
+	if (in_port->range && out_port->range && this->configured) {
+		uint64_t in_rate = in_port->format.info.raw.rate;
+		uint64_t out_rate = out_port->format.info.raw.rate;
+
+		in_port->range->offset = out_port->range->offset * in_rate / out_rate;
+		in_port->range->min_size = (uint64_t) out_port->range->min_size / out_port->stride *
+			in_rate / out_rate * in_port->stride;
+		in_port->range->max_size = (uint64_t) out_port->range->max_size / out_port->stride *
+			in_rate / out_rate * in_port->stride;
+	}
+	input->status = SPA_STATUS_NEED_BUFFER;
+
+	return SPA_STATUS_NEED_BUFFER;
+}
+
+static const struct spa_node impl_node = {
+	SPA_VERSION_NODE,
+	NULL,
+	impl_node_enum_params,
+	impl_node_set_param,
+	impl_node_send_command,
+	impl_node_set_callbacks,
+	impl_node_get_n_ports,
+	impl_node_get_port_ids,
+	impl_node_add_port,
+	impl_node_remove_port,
+	impl_node_port_get_info,
+	impl_node_port_enum_params,
+	impl_node_port_set_param,
+	impl_node_port_use_buffers,
+	impl_node_port_alloc_buffers,
+	impl_node_port_set_io,
+	impl_node_port_reuse_buffer,
+	impl_node_port_send_command,
+	impl_node_process_input,
+	impl_node_process_output,
+};
+
+static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id, void **interface)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+	spa_return_val_if_fail(interface != NULL, -EINVAL);
+
+	this = (struct impl *) handle;
+
+	if (interface_id == this->type.node)
+		*interface = &this->node;
+	else
+		return -ENOENT;
+
+	return 0;
+}
+
+static int impl_clear(struct spa_handle *handle)
+{
+	struct impl *this;
+
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	this = (struct impl *) handle;
+
+	clear_convert(this);
+
+	return 0;
+}
+
+static int
+impl_init(const struct spa_handle_factory *factory,
+	  struct spa_handle *handle,
+	  const struct spa_dict *info,
+	  const struct spa_support *support,
+	  uint32_t n_support)
+{
+	struct impl *this;
+	uint32_t i;
+
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(handle != NULL, -EINVAL);
+
+	handle->get_interface = impl_get_interface;
+	handle->clear = impl_clear;
+
+	this = (struct impl *) handle;
+
+	for (i = 0; i < n_support; i++) {
+		if (strcmp(support[i].type, SPA_TYPE__TypeMap) == 0)
+			this->map = support[i].data;
+		else if (strcmp(support[i].type, SPA_TYPE__Log) == 0)
+			this->log = support[i].data;
+	}
+	if (this->map == NULL) {
+		spa_log_error(this->log, "a type-map is needed");
+		return -EINVAL;
+	}
+	init_type(&this->type, this->map);
+
+	this->node = impl_node;
+	this->cpu_flags = conv_get_cpu_flags();
+	conv_get_ops_cpu(&this->ops, this->cpu_flags);
+
+	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+	spa_list_init(&this->in_ports[0].empty);
+
+	this->out_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
+	    SPA_PORT_INFO_FLAG_NO_REF;
+	spa_list_init(&this->out_ports[0].empty);
+
+	return 0;
+}
+
+static const struct spa_interface_info impl_interfaces[] = {
+	{SPA_TYPE__Node,},
+};
+
+static int
+impl_enum_interface_info(const struct spa_handle_factory *factory,
+			 const struct spa_interface_info **info,
+			 uint32_t *index)
+{
+	spa_return_val_if_fail(factory != NULL, -EINVAL);
+	spa_return_val_if_fail(info != NULL, -EINVAL);
+	spa_return_val_if_fail(index != NULL, -EINVAL);
+
+	switch (*index) {
+	case 0:
+		*info = &impl_interfaces[*index];
+		break;
+	default:
+		return 0;
+	}
+	(*index)++;
+	return 1;
+}
+
+const struct spa_handle_factory spa_audioconvert_factory = {
+	SPA_VERSION_HANDLE_FACTORY,
+	NAME,
+	NULL,
+	sizeof(struct impl),
+	impl_init,
+	impl_enum_interface_info,
+};
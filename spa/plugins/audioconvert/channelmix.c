@@ -0,0 +1,102 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <errno.h>
+
+#include "channelmix.h"
+
+/** Make the default mixing matrix
+ * \param mix the channelmix to initialize
+ * \param src_chan the number of input channels
+ * \param dst_chan the number of output channels
+ * \return 0 on success, < 0 on error
+ *
+ * Without channel positions we can only make a simple matrix: matching
+ * layouts are copied, a mono output gets the average of all input channels
+ * and the other cases spread the input channels over the output channels.
+ */
+int channelmix_init(struct channelmix *mix, uint32_t src_chan, uint32_t dst_chan)
+{
+	uint32_t i, j, n;
+
+	if (src_chan == 0 || src_chan > CONV_MAX_CHANNELS ||
+	    dst_chan == 0 || dst_chan > CONV_MAX_CHANNELS)
+		return -EINVAL;
+
+	mix->src_chan = src_chan;
+	mix->dst_chan = dst_chan;
+	mix->identity = src_chan == dst_chan;
+	memset(mix->matrix, 0, sizeof(mix->matrix));
+
+	if (dst_chan >= src_chan) {
+		/* upmix, repeat the input channels */
+		for (i = 0; i < dst_chan; i++)
+			mix->matrix[i][i % src_chan] = 1.0f;
+	}
+	else {
+		/* downmix, average the input channels that map to the
+		 * same output channel */
+		for (i = 0; i < dst_chan; i++) {
+			for (j = i, n = 0; j < src_chan; j += dst_chan)
+				n++;
+			for (j = i; j < src_chan; j += dst_chan)
+				mix->matrix[i][j] = 1.0f / n;
+		}
+	}
+	return 0;
+}
+
+/** Mix channels
+ * \param mix a channelmix
+ * \param dst dst_chan planes of n_frames samples
+ * \param src src_chan planes of n_frames samples
+ * \param n_frames the number of frames
+ */
+void channelmix_process(struct channelmix *mix, float *dst[], const float *src[], int n_frames)
+{
+	uint32_t i, j;
+	int n;
+
+	for (i = 0; i < mix->dst_chan; i++) {
+		float *d = dst[i];
+		bool first = true;
+
+		for (j = 0; j < mix->src_chan; j++) {
+			const float *s = src[j];
+			float v = mix->matrix[i][j];
+
+			if (v == 0.0f)
+				continue;
+
+			if (first) {
+				if (v == 1.0f)
+					memcpy(d, s, n_frames * sizeof(float));
+				else
+					for (n = 0; n < n_frames; n++)
+						d[n] = s[n] * v;
+				first = false;
+			}
+			else {
+				for (n = 0; n < n_frames; n++)
+					d[n] += s[n] * v;
+			}
+		}
+		if (first)
+			memset(d, 0, n_frames * sizeof(float));
+	}
+}
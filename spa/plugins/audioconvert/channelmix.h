@@ -0,0 +1,41 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_AUDIOCONVERT_CHANNELMIX_H__
+#define __SPA_AUDIOCONVERT_CHANNELMIX_H__
+
+#include <stdbool.h>
+
+#include <spa/utils/defs.h>
+
+#include "fmt-ops.h"
+
+/** Mixes n_src F32P channels into n_dst F32P channels with a matrix */
+struct channelmix {
+	uint32_t src_chan;
+	uint32_t dst_chan;
+	bool identity;			/**< the matrix is the identity matrix */
+	float matrix[CONV_MAX_CHANNELS][CONV_MAX_CHANNELS];
+};
+
+int channelmix_init(struct channelmix *mix, uint32_t src_chan, uint32_t dst_chan);
+
+void channelmix_process(struct channelmix *mix, float *dst[], const float *src[], int n_frames);
+
+#endif /* __SPA_AUDIOCONVERT_CHANNELMIX_H__ */
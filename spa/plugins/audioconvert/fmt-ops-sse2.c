@@ -0,0 +1,160 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include "fmt-ops.h"
+
+#include <emmintrin.h>
+
+/* the optimized versions handle mono and stereo, which are the most common
+ * layouts, other layouts use the generic C versions */
+
+static inline __m128 s16_to_f32_sse2(__m128i in)
+{
+	return _mm_mul_ps(_mm_cvtepi32_ps(in), _mm_set1_ps(1.0f / 32768.0f));
+}
+
+static inline __m128i f32_to_s16_sse2(__m128 in)
+{
+	in = _mm_min_ps(_mm_max_ps(in, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+	return _mm_cvttps_epi32(_mm_mul_ps(in, _mm_set1_ps(32767.0f)));
+}
+
+static void
+conv_s16_to_f32p_sse2(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const int16_t *s = src[0];
+	float *d0 = dst[0], *d1 = n_channels > 1 ? dst[1] : NULL;
+	int n = 0;
+
+	if (n_channels == 1) {
+		for (; n + 8 <= n_frames; n += 8) {
+			__m128i in = _mm_loadu_si128((const __m128i *) &s[n]);
+			_mm_storeu_ps(&d0[n], s16_to_f32_sse2(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16)));
+			_mm_storeu_ps(&d0[n + 4], s16_to_f32_sse2(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16)));
+		}
+	}
+	else if (n_channels == 2) {
+		for (; n + 4 <= n_frames; n += 4) {
+			__m128i in = _mm_loadu_si128((const __m128i *) &s[n * 2]);
+			__m128 lo = s16_to_f32_sse2(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+			__m128 hi = s16_to_f32_sse2(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+			_mm_storeu_ps(&d0[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(&d1[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	if (n < n_frames) {
+		void *d[CONV_MAX_CHANNELS];
+		const void *sp[1] = { &s[n * n_channels] };
+		int c;
+
+		for (c = 0; c < n_channels; c++)
+			d[c] = (float *) dst[c] + n;
+		conv_s16_to_f32p_c(d, sp, n_channels, n_frames - n);
+	}
+}
+
+static void
+conv_f32_to_f32p_sse2(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const float *s = src[0];
+	float *d0 = dst[0], *d1 = n_channels > 1 ? dst[1] : NULL;
+	int n = 0;
+
+	if (n_channels == 2) {
+		for (; n + 4 <= n_frames; n += 4) {
+			__m128 lo = _mm_loadu_ps(&s[n * 2]), hi = _mm_loadu_ps(&s[n * 2 + 4]);
+			_mm_storeu_ps(&d0[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(&d1[n], _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	if (n < n_frames) {
+		void *d[CONV_MAX_CHANNELS];
+		const void *sp[1] = { &s[n * n_channels] };
+		int c;
+
+		for (c = 0; c < n_channels; c++)
+			d[c] = (float *) dst[c] + n;
+		conv_f32_to_f32p_c(d, sp, n_channels, n_frames - n);
+	}
+}
+
+static void
+conv_f32p_to_s16_sse2(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const float *s0 = src[0], *s1 = n_channels > 1 ? src[1] : NULL;
+	int16_t *d = dst[0];
+	int n = 0;
+
+	if (n_channels == 1) {
+		for (; n + 8 <= n_frames; n += 8) {
+			__m128i lo = f32_to_s16_sse2(_mm_loadu_ps(&s0[n]));
+			__m128i hi = f32_to_s16_sse2(_mm_loadu_ps(&s0[n + 4]));
+			_mm_storeu_si128((__m128i *) &d[n], _mm_packs_epi32(lo, hi));
+		}
+	}
+	else if (n_channels == 2) {
+		for (; n + 4 <= n_frames; n += 4) {
+			__m128i l = f32_to_s16_sse2(_mm_loadu_ps(&s0[n]));
+			__m128i r = f32_to_s16_sse2(_mm_loadu_ps(&s1[n]));
+			_mm_storeu_si128((__m128i *) &d[n * 2],
+					_mm_packs_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r)));
+		}
+	}
+	if (n < n_frames) {
+		void *dp[1] = { &d[n * n_channels] };
+		const void *s[CONV_MAX_CHANNELS];
+		int c;
+
+		for (c = 0; c < n_channels; c++)
+			s[c] = (const float *) src[c] + n;
+		conv_f32p_to_s16_c(dp, s, n_channels, n_frames - n);
+	}
+}
+
+static void
+conv_f32p_to_f32_sse2(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const float *s0 = src[0], *s1 = n_channels > 1 ? src[1] : NULL;
+	float *d = dst[0];
+	int n = 0;
+
+	if (n_channels == 2) {
+		for (; n + 4 <= n_frames; n += 4) {
+			__m128 l = _mm_loadu_ps(&s0[n]), r = _mm_loadu_ps(&s1[n]);
+			_mm_storeu_ps(&d[n * 2], _mm_unpacklo_ps(l, r));
+			_mm_storeu_ps(&d[n * 2 + 4], _mm_unpackhi_ps(l, r));
+		}
+	}
+	if (n < n_frames) {
+		void *dp[1] = { &d[n * n_channels] };
+		const void *s[CONV_MAX_CHANNELS];
+		int c;
+
+		for (c = 0; c < n_channels; c++)
+			s[c] = (const float *) src[c] + n;
+		conv_f32p_to_f32_c(dp, s, n_channels, n_frames - n);
+	}
+}
+
+void conv_init_ops_sse2(struct conv_ops *ops)
+{
+	ops->to_f32p[CONV_FMT_S16] = conv_s16_to_f32p_sse2;
+	ops->to_f32p[CONV_FMT_F32] = conv_f32_to_f32p_sse2;
+	ops->from_f32p[CONV_FMT_S16] = conv_f32p_to_s16_sse2;
+	ops->from_f32p[CONV_FMT_F32] = conv_f32p_to_f32_sse2;
+}
@@ -0,0 +1,330 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <endian.h>
+
+#include "fmt-ops.h"
+
+#define S16_SCALE	32767.0f
+#define S24_SCALE	8388607.0f
+
+static inline int32_t read_s24(const uint8_t *s)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	return (int32_t) (((uint32_t) s[0] << 8) | ((uint32_t) s[1] << 16) | ((uint32_t) s[2] << 24)) >> 8;
+#else
+	return (int32_t) (((uint32_t) s[2] << 8) | ((uint32_t) s[1] << 16) | ((uint32_t) s[0] << 24)) >> 8;
+#endif
+}
+
+static inline void write_s24(uint8_t *d, int32_t v)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	d[0] = v;
+	d[1] = v >> 8;
+	d[2] = v >> 16;
+#else
+	d[0] = v >> 16;
+	d[1] = v >> 8;
+	d[2] = v;
+#endif
+}
+
+static inline float s16_to_f32(int16_t s)
+{
+	return s * (1.0f / 32768.0f);
+}
+
+static inline float s24_to_f32(int32_t s)
+{
+	return s * (1.0f / 8388608.0f);
+}
+
+static inline float s32_to_f32(int32_t s)
+{
+	/* only the upper 24 bits fit in the mantissa */
+	return (s >> 8) * (1.0f / 8388608.0f);
+}
+
+static inline int16_t f32_to_s16(float f)
+{
+	return SPA_CLAMP(f, -1.0f, 1.0f) * S16_SCALE;
+}
+
+static inline int32_t f32_to_s24(float f)
+{
+	return SPA_CLAMP(f, -1.0f, 1.0f) * S24_SCALE;
+}
+
+static inline int32_t f32_to_s32(float f)
+{
+	return (int32_t) ((uint32_t) f32_to_s24(f) << 8);
+}
+
+void
+conv_s16_to_f32p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const int16_t *s = src[0];
+	float **d = (float **) dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c][i] = s16_to_f32(*s++);
+	}
+}
+
+static void
+conv_s16p_to_f32p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	int i, c;
+
+	for (c = 0; c < n_channels; c++) {
+		const int16_t *s = src[c];
+		float *d = dst[c];
+
+		for (i = 0; i < n_frames; i++)
+			d[i] = s16_to_f32(s[i]);
+	}
+}
+
+static void
+conv_s24_to_f32p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const uint8_t *s = src[0];
+	float **d = (float **) dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++) {
+			d[c][i] = s24_to_f32(read_s24(s));
+			s += 3;
+		}
+	}
+}
+
+static void
+conv_s24p_to_f32p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	int i, c;
+
+	for (c = 0; c < n_channels; c++) {
+		const uint8_t *s = src[c];
+		float *d = dst[c];
+
+		for (i = 0; i < n_frames; i++)
+			d[i] = s24_to_f32(read_s24(&s[i * 3]));
+	}
+}
+
+static void
+conv_s32_to_f32p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const int32_t *s = src[0];
+	float **d = (float **) dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c][i] = s32_to_f32(*s++);
+	}
+}
+
+static void
+conv_s32p_to_f32p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	int i, c;
+
+	for (c = 0; c < n_channels; c++) {
+		const int32_t *s = src[c];
+		float *d = dst[c];
+
+		for (i = 0; i < n_frames; i++)
+			d[i] = s32_to_f32(s[i]);
+	}
+}
+
+void
+conv_f32_to_f32p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const float *s = src[0];
+	float **d = (float **) dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c][i] = *s++;
+	}
+}
+
+static void
+conv_f32p_to_f32p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	int c;
+
+	for (c = 0; c < n_channels; c++) {
+		if (dst[c] != src[c])
+			memcpy(dst[c], src[c], n_frames * sizeof(float));
+	}
+}
+
+void
+conv_f32p_to_s16_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const float **s = (const float **) src;
+	int16_t *d = dst[0];
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			*d++ = f32_to_s16(s[c][i]);
+	}
+}
+
+static void
+conv_f32p_to_s16p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	int i, c;
+
+	for (c = 0; c < n_channels; c++) {
+		const float *s = src[c];
+		int16_t *d = dst[c];
+
+		for (i = 0; i < n_frames; i++)
+			d[i] = f32_to_s16(s[i]);
+	}
+}
+
+static void
+conv_f32p_to_s24_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const float **s = (const float **) src;
+	uint8_t *d = dst[0];
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++) {
+			write_s24(d, f32_to_s24(s[c][i]));
+			d += 3;
+		}
+	}
+}
+
+static void
+conv_f32p_to_s24p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	int i, c;
+
+	for (c = 0; c < n_channels; c++) {
+		const float *s = src[c];
+		uint8_t *d = dst[c];
+
+		for (i = 0; i < n_frames; i++)
+			write_s24(&d[i * 3], f32_to_s24(s[i]));
+	}
+}
+
+static void
+conv_f32p_to_s32_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const float **s = (const float **) src;
+	int32_t *d = dst[0];
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			*d++ = f32_to_s32(s[c][i]);
+	}
+}
+
+static void
+conv_f32p_to_s32p_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	int i, c;
+
+	for (c = 0; c < n_channels; c++) {
+		const float *s = src[c];
+		int32_t *d = dst[c];
+
+		for (i = 0; i < n_frames; i++)
+			d[i] = f32_to_s32(s[i]);
+	}
+}
+
+void
+conv_f32p_to_f32_c(void *dst[], const void *src[], int n_channels, int n_frames)
+{
+	const float **s = (const float **) src;
+	float *d = dst[0];
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			*d++ = s[c][i];
+	}
+}
+
+/** Get the optimizations supported by the CPU we are running on
+ * \return a mask of CONV_CPU_FLAG_* values
+ */
+uint32_t conv_get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		flags |= CONV_CPU_FLAG_SSE2;
+#endif
+	return flags;
+}
+
+/** Get the conversion functions
+ * \param ops the functions to fill
+ * \param cpu_flags the allowed optimizations, 0 for the generic C versions
+ */
+void conv_get_ops_cpu(struct conv_ops *ops, uint32_t cpu_flags)
+{
+	ops->to_f32p[CONV_FMT_S16] = conv_s16_to_f32p_c;
+	ops->to_f32p[CONV_FMT_S16P] = conv_s16p_to_f32p_c;
+	ops->to_f32p[CONV_FMT_S24] = conv_s24_to_f32p_c;
+	ops->to_f32p[CONV_FMT_S24P] = conv_s24p_to_f32p_c;
+	ops->to_f32p[CONV_FMT_S32] = conv_s32_to_f32p_c;
+	ops->to_f32p[CONV_FMT_S32P] = conv_s32p_to_f32p_c;
+	ops->to_f32p[CONV_FMT_F32] = conv_f32_to_f32p_c;
+	ops->to_f32p[CONV_FMT_F32P] = conv_f32p_to_f32p_c;
+
+	ops->from_f32p[CONV_FMT_S16] = conv_f32p_to_s16_c;
+	ops->from_f32p[CONV_FMT_S16P] = conv_f32p_to_s16p_c;
+	ops->from_f32p[CONV_FMT_S24] = conv_f32p_to_s24_c;
+	ops->from_f32p[CONV_FMT_S24P] = conv_f32p_to_s24p_c;
+	ops->from_f32p[CONV_FMT_S32] = conv_f32p_to_s32_c;
+	ops->from_f32p[CONV_FMT_S32P] = conv_f32p_to_s32p_c;
+	ops->from_f32p[CONV_FMT_F32] = conv_f32p_to_f32_c;
+	ops->from_f32p[CONV_FMT_F32P] = conv_f32p_to_f32p_c;
+
+#if defined(HAVE_SSE2)
+	if (cpu_flags & CONV_CPU_FLAG_SSE2)
+		conv_init_ops_sse2(ops);
+#endif
+}
+
+void conv_get_ops(struct conv_ops *ops)
+{
+	conv_get_ops_cpu(ops, conv_get_cpu_flags());
+}
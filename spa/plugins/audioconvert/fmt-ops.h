@@ -0,0 +1,73 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_AUDIOCONVERT_FMT_OPS_H__
+#define __SPA_AUDIOCONVERT_FMT_OPS_H__
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+
+#define CONV_MAX_CHANNELS	64
+
+/* the sample formats, the planar version of a format follows the
+ * interleaved version */
+enum {
+	CONV_FMT_S16,
+	CONV_FMT_S16P,
+	CONV_FMT_S24,
+	CONV_FMT_S24P,
+	CONV_FMT_S32,
+	CONV_FMT_S32P,
+	CONV_FMT_F32,
+	CONV_FMT_F32P,
+	CONV_FMT_MAX,
+};
+
+#define CONV_FMT_IS_PLANAR(f)	((f) & 1)
+
+#define CONV_CPU_FLAG_SSE2	(1 << 0)
+
+/* convert n_frames frames from the planes in src to the planes in dst,
+ * interleaved formats use 1 plane with n_channels channels, planar formats
+ * use n_channels planes */
+typedef void (*convert_func_t) (void *dst[], const void *src[], int n_channels, int n_frames);
+
+struct conv_ops {
+	convert_func_t to_f32p[CONV_FMT_MAX];		/**< convert from a format to F32P */
+	convert_func_t from_f32p[CONV_FMT_MAX];		/**< convert from F32P to a format */
+};
+
+uint32_t conv_get_cpu_flags(void);
+
+void conv_get_ops_cpu(struct conv_ops *ops, uint32_t cpu_flags);
+
+void conv_get_ops(struct conv_ops *ops);
+
+/* generic C versions, used by the optimized functions for the formats
+ * they don't handle */
+void conv_s16_to_f32p_c(void *dst[], const void *src[], int n_channels, int n_frames);
+void conv_f32_to_f32p_c(void *dst[], const void *src[], int n_channels, int n_frames);
+void conv_f32p_to_s16_c(void *dst[], const void *src[], int n_channels, int n_frames);
+void conv_f32p_to_f32_c(void *dst[], const void *src[], int n_channels, int n_frames);
+
+void conv_init_ops_sse2(struct conv_ops *ops);
+
+#endif /* __SPA_AUDIOCONVERT_FMT_OPS_H__ */
@@ -0,0 +1,223 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "resample.h"
+
+/* the number of zero crossings of the sinc on each side */
+#define RESAMPLE_ZEROS		16
+
+static inline double blackman(double x)
+{
+	return 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2.0 * M_PI * x);
+}
+
+static inline double sinc(double x)
+{
+	return x == 0.0 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+}
+
+static void build_filter(struct resample *r, double cutoff)
+{
+	uint32_t p, t, half = r->n_taps / 2;
+
+	for (p = 0; p <= RESAMPLE_PHASES; p++) {
+		float *f = &r->filter[p * r->n_taps];
+		double frac = (double) p / RESAMPLE_PHASES, sum = 0.0;
+
+		for (t = 0; t < r->n_taps; t++) {
+			double d = (double) t - (half - 1) - frac;
+			double v = cutoff * sinc(cutoff * d) * blackman(d / half);
+			f[t] = v;
+			sum += v;
+		}
+		/* unity gain for DC */
+		for (t = 0; t < r->n_taps; t++)
+			f[t] /= sum;
+	}
+}
+
+float resample_dot_c(const float *a, const float *b, int n)
+{
+	float sum = 0.0f;
+	int i;
+
+	for (i = 0; i < n; i++)
+		sum += a[i] * b[i];
+	return sum;
+}
+
+/** Initialize a resampler
+ * \param r the resampler
+ * \param channels the number of channels
+ * \param i_rate the input rate
+ * \param o_rate the output rate
+ * \param cpu_flags the allowed optimizations
+ * \return 0 on success, < 0 on error
+ */
+int resample_init(struct resample *r, uint32_t channels, uint32_t i_rate, uint32_t o_rate,
+		  uint32_t cpu_flags)
+{
+	double cutoff;
+	uint32_t c, half;
+	float *mem;
+
+	if (channels == 0 || channels > CONV_MAX_CHANNELS || i_rate == 0 || o_rate == 0)
+		return -EINVAL;
+
+	r->channels = channels;
+	r->i_rate = i_rate;
+	r->o_rate = o_rate;
+
+	/* when downsampling, filter below the new nyquist frequency and make the
+	 * filter longer to keep the same number of zero crossings */
+	cutoff = SPA_MIN(1.0, (double) o_rate / i_rate) * 0.95;
+	half = ceil(RESAMPLE_ZEROS / cutoff);
+	r->n_taps = SPA_ROUND_UP_N(half * 2, 4);
+	r->hist_size = r->n_taps + RESAMPLE_BLOCK;
+
+	mem = calloc((RESAMPLE_PHASES + 1) * r->n_taps + channels * r->hist_size, sizeof(float));
+	if (mem == NULL)
+		return -ENOMEM;
+
+	r->data = mem;
+	r->filter = mem;
+	mem += (RESAMPLE_PHASES + 1) * r->n_taps;
+	for (c = 0; c < channels; c++) {
+		r->history[c] = mem;
+		mem += r->hist_size;
+	}
+	build_filter(r, cutoff);
+
+	r->dot = resample_dot_c;
+#if defined(HAVE_SSE2)
+	if (cpu_flags & CONV_CPU_FLAG_SSE2)
+		r->dot = resample_dot_sse2;
+#endif
+	resample_update_rate(r, 1.0);
+	resample_reset(r);
+
+	return 0;
+}
+
+void resample_free(struct resample *r)
+{
+	free(r->data);
+	r->data = NULL;
+}
+
+/** Clear the history of the resampler */
+void resample_reset(struct resample *r)
+{
+	uint32_t c;
+
+	/* the first output sample is centered on the first input sample */
+	r->hist_len = r->n_taps / 2 - 1;
+	r->pos = 0.0;
+	for (c = 0; c < r->channels; c++)
+		memset(r->history[c], 0, r->hist_len * sizeof(float));
+}
+
+/** Change the resampling ratio
+ * \param r the resampler
+ * \param rate the adjustment of the ratio, values > 1.0 consume the input
+ *	faster, resulting in less output samples
+ */
+void resample_update_rate(struct resample *r, double rate)
+{
+	r->rate = rate;
+	r->step = (double) r->i_rate * rate / r->o_rate;
+}
+
+/** Get the number of input samples needed to produce output samples
+ * \param r the resampler
+ * \param out_len the number of output samples
+ * \return the number of input samples needed for \a out_len output samples
+ */
+uint32_t resample_in_len(struct resample *r, uint32_t out_len)
+{
+	double need;
+
+	if (out_len == 0)
+		return 0;
+
+	need = floor(r->pos + (out_len - 1) * r->step) + r->n_taps;
+	return need > r->hist_len ? (uint32_t) need - r->hist_len : 0;
+}
+
+/** Resample
+ * \param r the resampler
+ * \param src the input planes
+ * \param in_len the number of input samples, updated with the number of
+ *	consumed samples
+ * \param dst the output planes
+ * \param out_len the number of available output samples, updated with the
+ *	number of produced samples
+ */
+void resample_process(struct resample *r, const float *src[], uint32_t *in_len,
+		      float *dst[], uint32_t *out_len)
+{
+	uint32_t c, o, index, n_in, n_taps = r->n_taps;
+	double pos = r->pos, ph;
+
+	n_in = SPA_MIN(*in_len, r->hist_size - r->hist_len);
+	for (c = 0; c < r->channels; c++)
+		memcpy(r->history[c] + r->hist_len, src[c], n_in * sizeof(float));
+	r->hist_len += n_in;
+
+	for (o = 0; o < *out_len; o++) {
+		const float *f0, *f1;
+		uint32_t phase;
+		float a;
+
+		index = pos;
+		if (index + n_taps > r->hist_len)
+			break;
+
+		ph = (pos - index) * RESAMPLE_PHASES;
+		phase = ph;
+		a = ph - phase;
+		f0 = &r->filter[phase * n_taps];
+		f1 = f0 + n_taps;
+
+		for (c = 0; c < r->channels; c++) {
+			const float *h = r->history[c] + index;
+			float v0 = r->dot(h, f0, n_taps);
+			float v1 = r->dot(h, f1, n_taps);
+			dst[c][o] = v0 + (v1 - v0) * a;
+		}
+		pos += r->step;
+	}
+
+	/* remove the samples we don't need anymore from the history */
+	index = SPA_MIN((uint32_t) pos, r->hist_len);
+	if (index > 0) {
+		for (c = 0; c < r->channels; c++)
+			memmove(r->history[c], r->history[c] + index,
+				(r->hist_len - index) * sizeof(float));
+		r->hist_len -= index;
+		pos -= index;
+	}
+	r->pos = pos;
+
+	*in_len = n_in;
+	*out_len = o;
+}
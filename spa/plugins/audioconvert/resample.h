@@ -0,0 +1,74 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_AUDIOCONVERT_RESAMPLE_H__
+#define __SPA_AUDIOCONVERT_RESAMPLE_H__
+
+#include <spa/utils/defs.h>
+
+#include "fmt-ops.h"
+
+#define RESAMPLE_PHASES		256
+#define RESAMPLE_BLOCK		1024
+
+typedef float (*resample_dot_func_t) (const float *a, const float *b, int n);
+
+/** A windowed sinc polyphase resampler for F32P samples
+ *
+ * The filter is sampled at RESAMPLE_PHASES phases, values between phases
+ * are linearly interpolated. This makes it possible to change the
+ * resampling ratio while running.
+ */
+struct resample {
+	uint32_t channels;
+	uint32_t i_rate;
+	uint32_t o_rate;
+	double rate;			/**< rate adjustment */
+	double step;			/**< input samples per output sample */
+	double pos;			/**< position of the next output sample in the history */
+
+	uint32_t n_taps;
+	float *filter;			/**< RESAMPLE_PHASES + 1 filters of n_taps */
+
+	uint32_t hist_size;
+	uint32_t hist_len;
+	float *history[CONV_MAX_CHANNELS];
+
+	resample_dot_func_t dot;
+	void *data;
+};
+
+int resample_init(struct resample *r, uint32_t channels, uint32_t i_rate, uint32_t o_rate,
+		  uint32_t cpu_flags);
+
+void resample_free(struct resample *r);
+
+void resample_reset(struct resample *r);
+
+void resample_update_rate(struct resample *r, double rate);
+
+uint32_t resample_in_len(struct resample *r, uint32_t out_len);
+
+void resample_process(struct resample *r, const float *src[], uint32_t *in_len,
+		      float *dst[], uint32_t *out_len);
+
+float resample_dot_c(const float *a, const float *b, int n);
+float resample_dot_sse2(const float *a, const float *b, int n);
+
+#endif /* __SPA_AUDIOCONVERT_RESAMPLE_H__ */
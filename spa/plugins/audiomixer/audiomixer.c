@@ -383,8 +383,10 @@ static int port_enum_formats(struct spa_node *node,
 				"I", t->media_type.audio,
 				"I", t->media_subtype.raw,
 				":", t->format_audio.format,   "Ieu", t->audio_format.S16,
-					SPA_POD_PROP_ENUM(2, t->audio_format.S16,
-							     t->audio_format.F32),
+					SPA_POD_PROP_ENUM(4, t->audio_format.S16,
+							     t->audio_format.F32,
+							     t->audio_format.S32,
+							     t->audio_format.F64),
 				":", t->format_audio.rate,     "iru", 44100,
 					SPA_POD_PROP_MIN_MAX(1, INT32_MAX),
 				":", t->format_audio.channels, "iru", 2,
@@ -616,25 +618,34 @@ static int port_set_format(struct spa_node *node,
 			if (memcmp(&info, &this->format, sizeof(struct spa_audio_info)))
 				return -EINVAL;
 		} else {
+			uint32_t fmt, size;
+
 			if (info.info.raw.format == t->audio_format.S16) {
-				this->clear = this->ops.clear[FMT_S16];
-				this->copy = this->ops.copy[FMT_S16];
-				this->add = this->ops.add[FMT_S16];
-				this->copy_scale = this->ops.copy_scale[FMT_S16];
-				this->add_scale = this->ops.add_scale[FMT_S16];
-				this->bpf = sizeof(int16_t) * info.info.raw.channels;
+				fmt = FMT_S16;
+				size = sizeof(int16_t);
 			}
 			else if (info.info.raw.format == t->audio_format.F32) {
-				this->clear = this->ops.clear[FMT_F32];
-				this->copy = this->ops.copy[FMT_F32];
-				this->add = this->ops.add[FMT_F32];
-				this->copy_scale = this->ops.copy_scale[FMT_F32];
-				this->add_scale = this->ops.add_scale[FMT_F32];
-				this->bpf = sizeof(float) * info.info.raw.channels;
+				fmt = FMT_F32;
+				size = sizeof(float);
+			}
+			else if (info.info.raw.format == t->audio_format.S32) {
+				fmt = FMT_S32;
+				size = sizeof(int32_t);
+			}
+			else if (info.info.raw.format == t->audio_format.F64) {
+				fmt = FMT_F64;
+				size = sizeof(double);
 			}
 			else
 				return -EINVAL;
 
+			this->clear = this->ops.clear[fmt];
+			this->copy = this->ops.copy[fmt];
+			this->add = this->ops.add[fmt];
+			this->copy_scale = this->ops.copy_scale[fmt];
+			this->add_scale = this->ops.add_scale[fmt];
+			this->bpf = size * info.info.raw.channels;
+
 			this->have_format = true;
 			this->format = info;
 		}
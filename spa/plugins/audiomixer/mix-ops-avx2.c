@@ -0,0 +1,216 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "mix-ops.h"
+
+#include <immintrin.h>
+
+static void
+add_s16_avx2(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256i in = _mm256_loadu_si256((const __m256i *) &s[n]);
+		__m256i out = _mm256_loadu_si256((__m256i *) &d[n]);
+		_mm256_storeu_si256((__m256i *) &d[n], _mm256_adds_epi16(out, in));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_s16_c(&d[n], &s[n], (n_samples - n) * sizeof(int16_t));
+}
+
+/* multiply 16 samples with v and shift down, the result is 2 vectors of
+ * 32 bits values. unpack and pack work on each 128 bits lane so packing
+ * lo and hi again gives the samples in the original order */
+static inline void
+scale_s16_avx2(__m256i in, __m256i v, __m256i *lo, __m256i *hi)
+{
+	__m256i pl = _mm256_mullo_epi16(in, v);
+	__m256i ph = _mm256_mulhi_epi16(in, v);
+
+	*lo = _mm256_srai_epi32(_mm256_unpacklo_epi16(pl, ph), 11);
+	*hi = _mm256_srai_epi32(_mm256_unpackhi_epi16(pl, ph), 11);
+}
+
+static void
+copy_scale_s16_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11);
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m256i vv, lo, hi;
+
+	/* the full product needs more than 16 bits of gain */
+	if (v < INT16_MIN || v > INT16_MAX) {
+		spa_audiomixer_copy_scale_s16_c(dst, src, scale, n_bytes);
+		return;
+	}
+	vv = _mm256_set1_epi16(v);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		scale_s16_avx2(_mm256_loadu_si256((const __m256i *) &s[n]), vv, &lo, &hi);
+		_mm256_storeu_si256((__m256i *) &d[n], _mm256_packs_epi32(lo, hi));
+	}
+	if (n < n_samples)
+		spa_audiomixer_copy_scale_s16_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_scale_s16_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11);
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m256i vv, lo, hi, out;
+
+	if (v < INT16_MIN || v > INT16_MAX) {
+		spa_audiomixer_add_scale_s16_c(dst, src, scale, n_bytes);
+		return;
+	}
+	vv = _mm256_set1_epi16(v);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		scale_s16_avx2(_mm256_loadu_si256((const __m256i *) &s[n]), vv, &lo, &hi);
+		out = _mm256_loadu_si256((__m256i *) &d[n]);
+		lo = _mm256_add_epi32(lo, _mm256_srai_epi32(_mm256_unpacklo_epi16(out, out), 16));
+		hi = _mm256_add_epi32(hi, _mm256_srai_epi32(_mm256_unpackhi_epi16(out, out), 16));
+		_mm256_storeu_si256((__m256i *) &d[n], _mm256_packs_epi32(lo, hi));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_scale_s16_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_f32_avx2(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256 in0 = _mm256_loadu_ps(&s[n]), in1 = _mm256_loadu_ps(&s[n + 8]);
+		__m256 out0 = _mm256_loadu_ps(&d[n]), out1 = _mm256_loadu_ps(&d[n + 8]);
+		_mm256_storeu_ps(&d[n], _mm256_add_ps(out0, in0));
+		_mm256_storeu_ps(&d[n + 8], _mm256_add_ps(out1, in1));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_f32_c(&d[n], &s[n], (n_samples - n) * sizeof(float));
+}
+
+static void
+copy_scale_f32_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m256 v = _mm256_set1_ps(scale);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		_mm256_storeu_ps(&d[n], _mm256_mul_ps(_mm256_loadu_ps(&s[n]), v));
+		_mm256_storeu_ps(&d[n + 8], _mm256_mul_ps(_mm256_loadu_ps(&s[n + 8]), v));
+	}
+	if (n < n_samples)
+		spa_audiomixer_copy_scale_f32_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(float));
+}
+
+static void
+add_scale_f32_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m256 v = _mm256_set1_ps(scale);
+
+	for (n = 0; n + 16 <= n_samples; n += 16) {
+		__m256 in0 = _mm256_mul_ps(_mm256_loadu_ps(&s[n]), v);
+		__m256 in1 = _mm256_mul_ps(_mm256_loadu_ps(&s[n + 8]), v);
+		_mm256_storeu_ps(&d[n], _mm256_add_ps(_mm256_loadu_ps(&d[n]), in0));
+		_mm256_storeu_ps(&d[n + 8], _mm256_add_ps(_mm256_loadu_ps(&d[n + 8]), in1));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_scale_f32_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(float));
+}
+
+static void
+add_f64_avx2(void *dst, const void *src, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	int n, n_samples = n_bytes / sizeof(double);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m256d in0 = _mm256_loadu_pd(&s[n]), in1 = _mm256_loadu_pd(&s[n + 4]);
+		__m256d out0 = _mm256_loadu_pd(&d[n]), out1 = _mm256_loadu_pd(&d[n + 4]);
+		_mm256_storeu_pd(&d[n], _mm256_add_pd(out0, in0));
+		_mm256_storeu_pd(&d[n + 4], _mm256_add_pd(out1, in1));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_f64_c(&d[n], &s[n], (n_samples - n) * sizeof(double));
+}
+
+static void
+copy_scale_f64_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	int n, n_samples = n_bytes / sizeof(double);
+	__m256d v = _mm256_set1_pd(scale);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		_mm256_storeu_pd(&d[n], _mm256_mul_pd(_mm256_loadu_pd(&s[n]), v));
+		_mm256_storeu_pd(&d[n + 4], _mm256_mul_pd(_mm256_loadu_pd(&s[n + 4]), v));
+	}
+	if (n < n_samples)
+		spa_audiomixer_copy_scale_f64_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(double));
+}
+
+static void
+add_scale_f64_avx2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	int n, n_samples = n_bytes / sizeof(double);
+	__m256d v = _mm256_set1_pd(scale);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m256d in0 = _mm256_mul_pd(_mm256_loadu_pd(&s[n]), v);
+		__m256d in1 = _mm256_mul_pd(_mm256_loadu_pd(&s[n + 4]), v);
+		_mm256_storeu_pd(&d[n], _mm256_add_pd(_mm256_loadu_pd(&d[n]), in0));
+		_mm256_storeu_pd(&d[n + 4], _mm256_add_pd(_mm256_loadu_pd(&d[n + 4]), in1));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_scale_f64_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(double));
+}
+
+void spa_audiomixer_init_ops_avx2(struct spa_audiomixer_ops *ops)
+{
+	ops->add[FMT_S16] = add_s16_avx2;
+	ops->add[FMT_F32] = add_f32_avx2;
+	ops->add[FMT_F64] = add_f64_avx2;
+	ops->copy_scale[FMT_S16] = copy_scale_s16_avx2;
+	ops->copy_scale[FMT_F32] = copy_scale_f32_avx2;
+	ops->copy_scale[FMT_F64] = copy_scale_f64_avx2;
+	ops->add_scale[FMT_S16] = add_scale_s16_avx2;
+	ops->add_scale[FMT_F32] = add_scale_f32_avx2;
+	ops->add_scale[FMT_F64] = add_scale_f64_avx2;
+}
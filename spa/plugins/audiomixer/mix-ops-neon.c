@@ -0,0 +1,159 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "mix-ops.h"
+
+#include <arm_neon.h>
+
+static void
+add_s16_neon(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+
+	for (n = 0; n + 8 <= n_samples; n += 8)
+		vst1q_s16(&d[n], vqaddq_s16(vld1q_s16(&d[n]), vld1q_s16(&s[n])));
+
+	if (n < n_samples)
+		spa_audiomixer_add_s16_c(&d[n], &s[n], (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+copy_scale_s16_neon(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11);
+	int n, n_samples = n_bytes / sizeof(int16_t);
+
+	/* the full product needs more than 16 bits of gain */
+	if (v < INT16_MIN || v > INT16_MAX) {
+		spa_audiomixer_copy_scale_s16_c(dst, src, scale, n_bytes);
+		return;
+	}
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		int16x8_t in = vld1q_s16(&s[n]);
+		int32x4_t lo = vshrq_n_s32(vmull_n_s16(vget_low_s16(in), v), 11);
+		int32x4_t hi = vshrq_n_s32(vmull_n_s16(vget_high_s16(in), v), 11);
+		vst1q_s16(&d[n], vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+	if (n < n_samples)
+		spa_audiomixer_copy_scale_s16_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_scale_s16_neon(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11);
+	int n, n_samples = n_bytes / sizeof(int16_t);
+
+	if (v < INT16_MIN || v > INT16_MAX) {
+		spa_audiomixer_add_scale_s16_c(dst, src, scale, n_bytes);
+		return;
+	}
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		int16x8_t in = vld1q_s16(&s[n]), out = vld1q_s16(&d[n]);
+		int32x4_t lo = vshrq_n_s32(vmull_n_s16(vget_low_s16(in), v), 11);
+		int32x4_t hi = vshrq_n_s32(vmull_n_s16(vget_high_s16(in), v), 11);
+		lo = vaddw_s16(lo, vget_low_s16(out));
+		hi = vaddw_s16(hi, vget_high_s16(out));
+		vst1q_s16(&d[n], vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_scale_s16_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_f32_neon(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		vst1q_f32(&d[n], vaddq_f32(vld1q_f32(&d[n]), vld1q_f32(&s[n])));
+		vst1q_f32(&d[n + 4], vaddq_f32(vld1q_f32(&d[n + 4]), vld1q_f32(&s[n + 4])));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_f32_c(&d[n], &s[n], (n_samples - n) * sizeof(float));
+}
+
+static void
+copy_scale_f32_neon(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	float v = scale;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		vst1q_f32(&d[n], vmulq_n_f32(vld1q_f32(&s[n]), v));
+		vst1q_f32(&d[n + 4], vmulq_n_f32(vld1q_f32(&s[n + 4]), v));
+	}
+	if (n < n_samples)
+		spa_audiomixer_copy_scale_f32_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(float));
+}
+
+/* don't use a fused multiply-add, we want the same rounding as the C version */
+static void
+add_scale_f32_neon(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	float v = scale;
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		float32x4_t in0 = vmulq_n_f32(vld1q_f32(&s[n]), v);
+		float32x4_t in1 = vmulq_n_f32(vld1q_f32(&s[n + 4]), v);
+		vst1q_f32(&d[n], vaddq_f32(vld1q_f32(&d[n]), in0));
+		vst1q_f32(&d[n + 4], vaddq_f32(vld1q_f32(&d[n + 4]), in1));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_scale_f32_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(float));
+}
+
+static void
+add_f64_neon(void *dst, const void *src, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	int n, n_samples = n_bytes / sizeof(double);
+
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		vst1q_f64(&d[n], vaddq_f64(vld1q_f64(&d[n]), vld1q_f64(&s[n])));
+		vst1q_f64(&d[n + 2], vaddq_f64(vld1q_f64(&d[n + 2]), vld1q_f64(&s[n + 2])));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_f64_c(&d[n], &s[n], (n_samples - n) * sizeof(double));
+}
+
+void spa_audiomixer_init_ops_neon(struct spa_audiomixer_ops *ops)
+{
+	ops->add[FMT_S16] = add_s16_neon;
+	ops->add[FMT_F32] = add_f32_neon;
+	ops->add[FMT_F64] = add_f64_neon;
+	ops->copy_scale[FMT_S16] = copy_scale_s16_neon;
+	ops->copy_scale[FMT_F32] = copy_scale_f32_neon;
+	ops->add_scale[FMT_S16] = add_scale_s16_neon;
+	ops->add_scale[FMT_F32] = add_scale_f32_neon;
+}
@@ -0,0 +1,215 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "mix-ops.h"
+
+#include <emmintrin.h>
+
+static void
+add_s16_sse2(void *dst, const void *src, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int n, n_samples = n_bytes / sizeof(int16_t);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128i in = _mm_loadu_si128((const __m128i *) &s[n]);
+		__m128i out = _mm_loadu_si128((__m128i *) &d[n]);
+		_mm_storeu_si128((__m128i *) &d[n], _mm_adds_epi16(out, in));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_s16_c(&d[n], &s[n], (n_samples - n) * sizeof(int16_t));
+}
+
+/* multiply 8 samples with v and shift down, the result is 2 vectors of
+ * 32 bits values */
+static inline void
+scale_s16_sse2(__m128i in, __m128i v, __m128i *lo, __m128i *hi)
+{
+	__m128i pl = _mm_mullo_epi16(in, v);
+	__m128i ph = _mm_mulhi_epi16(in, v);
+
+	*lo = _mm_srai_epi32(_mm_unpacklo_epi16(pl, ph), 11);
+	*hi = _mm_srai_epi32(_mm_unpackhi_epi16(pl, ph), 11);
+}
+
+static void
+copy_scale_s16_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11);
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m128i vv, lo, hi;
+
+	/* the full product needs more than 16 bits of gain */
+	if (v < INT16_MIN || v > INT16_MAX) {
+		spa_audiomixer_copy_scale_s16_c(dst, src, scale, n_bytes);
+		return;
+	}
+	vv = _mm_set1_epi16(v);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		scale_s16_sse2(_mm_loadu_si128((const __m128i *) &s[n]), vv, &lo, &hi);
+		_mm_storeu_si128((__m128i *) &d[n], _mm_packs_epi32(lo, hi));
+	}
+	if (n < n_samples)
+		spa_audiomixer_copy_scale_s16_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_scale_s16_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int32_t v = scale * (1 << 11);
+	int n, n_samples = n_bytes / sizeof(int16_t);
+	__m128i vv, lo, hi, out;
+
+	if (v < INT16_MIN || v > INT16_MAX) {
+		spa_audiomixer_add_scale_s16_c(dst, src, scale, n_bytes);
+		return;
+	}
+	vv = _mm_set1_epi16(v);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		scale_s16_sse2(_mm_loadu_si128((const __m128i *) &s[n]), vv, &lo, &hi);
+		out = _mm_loadu_si128((__m128i *) &d[n]);
+		lo = _mm_add_epi32(lo, _mm_srai_epi32(_mm_unpacklo_epi16(out, out), 16));
+		hi = _mm_add_epi32(hi, _mm_srai_epi32(_mm_unpackhi_epi16(out, out), 16));
+		_mm_storeu_si128((__m128i *) &d[n], _mm_packs_epi32(lo, hi));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_scale_s16_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(int16_t));
+}
+
+static void
+add_f32_sse2(void *dst, const void *src, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128 in0 = _mm_loadu_ps(&s[n]), in1 = _mm_loadu_ps(&s[n + 4]);
+		__m128 out0 = _mm_loadu_ps(&d[n]), out1 = _mm_loadu_ps(&d[n + 4]);
+		_mm_storeu_ps(&d[n], _mm_add_ps(out0, in0));
+		_mm_storeu_ps(&d[n + 4], _mm_add_ps(out1, in1));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_f32_c(&d[n], &s[n], (n_samples - n) * sizeof(float));
+}
+
+static void
+copy_scale_f32_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m128 v = _mm_set1_ps(scale);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		_mm_storeu_ps(&d[n], _mm_mul_ps(_mm_loadu_ps(&s[n]), v));
+		_mm_storeu_ps(&d[n + 4], _mm_mul_ps(_mm_loadu_ps(&s[n + 4]), v));
+	}
+	if (n < n_samples)
+		spa_audiomixer_copy_scale_f32_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(float));
+}
+
+static void
+add_scale_f32_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const float *s = src;
+	float *d = dst;
+	int n, n_samples = n_bytes / sizeof(float);
+	__m128 v = _mm_set1_ps(scale);
+
+	for (n = 0; n + 8 <= n_samples; n += 8) {
+		__m128 in0 = _mm_mul_ps(_mm_loadu_ps(&s[n]), v);
+		__m128 in1 = _mm_mul_ps(_mm_loadu_ps(&s[n + 4]), v);
+		_mm_storeu_ps(&d[n], _mm_add_ps(_mm_loadu_ps(&d[n]), in0));
+		_mm_storeu_ps(&d[n + 4], _mm_add_ps(_mm_loadu_ps(&d[n + 4]), in1));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_scale_f32_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(float));
+}
+
+static void
+add_f64_sse2(void *dst, const void *src, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	int n, n_samples = n_bytes / sizeof(double);
+
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		__m128d in0 = _mm_loadu_pd(&s[n]), in1 = _mm_loadu_pd(&s[n + 2]);
+		__m128d out0 = _mm_loadu_pd(&d[n]), out1 = _mm_loadu_pd(&d[n + 2]);
+		_mm_storeu_pd(&d[n], _mm_add_pd(out0, in0));
+		_mm_storeu_pd(&d[n + 2], _mm_add_pd(out1, in1));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_f64_c(&d[n], &s[n], (n_samples - n) * sizeof(double));
+}
+
+static void
+copy_scale_f64_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	int n, n_samples = n_bytes / sizeof(double);
+	__m128d v = _mm_set1_pd(scale);
+
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		_mm_storeu_pd(&d[n], _mm_mul_pd(_mm_loadu_pd(&s[n]), v));
+		_mm_storeu_pd(&d[n + 2], _mm_mul_pd(_mm_loadu_pd(&s[n + 2]), v));
+	}
+	if (n < n_samples)
+		spa_audiomixer_copy_scale_f64_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(double));
+}
+
+static void
+add_scale_f64_sse2(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+	int n, n_samples = n_bytes / sizeof(double);
+	__m128d v = _mm_set1_pd(scale);
+
+	for (n = 0; n + 4 <= n_samples; n += 4) {
+		__m128d in0 = _mm_mul_pd(_mm_loadu_pd(&s[n]), v);
+		__m128d in1 = _mm_mul_pd(_mm_loadu_pd(&s[n + 2]), v);
+		_mm_storeu_pd(&d[n], _mm_add_pd(_mm_loadu_pd(&d[n]), in0));
+		_mm_storeu_pd(&d[n + 2], _mm_add_pd(_mm_loadu_pd(&d[n + 2]), in1));
+	}
+	if (n < n_samples)
+		spa_audiomixer_add_scale_f64_c(&d[n], &s[n], scale, (n_samples - n) * sizeof(double));
+}
+
+void spa_audiomixer_init_ops_sse2(struct spa_audiomixer_ops *ops)
+{
+	ops->add[FMT_S16] = add_s16_sse2;
+	ops->add[FMT_F32] = add_f32_sse2;
+	ops->add[FMT_F64] = add_f64_sse2;
+	ops->copy_scale[FMT_S16] = copy_scale_s16_sse2;
+	ops->copy_scale[FMT_F32] = copy_scale_f32_sse2;
+	ops->copy_scale[FMT_F64] = copy_scale_f64_sse2;
+	ops->add_scale[FMT_S16] = add_scale_s16_sse2;
+	ops->add_scale[FMT_F32] = add_scale_f32_sse2;
+	ops->add_scale[FMT_F64] = add_scale_f64_sse2;
+}
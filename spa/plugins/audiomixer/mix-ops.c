@@ -43,8 +43,8 @@ copy_f32(void *dst, const void *src, int n_bytes)
 	memcpy(dst, src, n_bytes);
 }
 
-static void
-add_s16(void *dst, const void *src, int n_bytes)
+void
+spa_audiomixer_add_s16_c(void *dst, const void *src, int n_bytes)
 {
 	const int16_t *s = src;
 	int16_t *d = dst;
@@ -59,8 +59,8 @@ add_s16(void *dst, const void *src, int n_bytes)
 	}
 }
 
-static void
-add_f32(void *dst, const void *src, int n_bytes)
+void
+spa_audiomixer_add_f32_c(void *dst, const void *src, int n_bytes)
 {
 	const float *s = src;
 	float *d = dst;
@@ -73,8 +73,38 @@ add_f32(void *dst, const void *src, int n_bytes)
 	}
 }
 
-static void
-copy_scale_s16(void *dst, const void *src, const double scale, int n_bytes)
+void
+spa_audiomixer_add_s32_c(void *dst, const void *src, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (int64_t) *d + *s;
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+spa_audiomixer_add_f64_c(void *dst, const void *src, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d += *s;
+		d++;
+		s++;
+	}
+}
+
+void
+spa_audiomixer_copy_scale_s16_c(void *dst, const void *src, const double scale, int n_bytes)
 {
 	const int16_t *s = src;
 	int16_t *d = dst;;
@@ -89,8 +119,8 @@ copy_scale_s16(void *dst, const void *src, const double scale, int n_bytes)
 	}
 }
 
-static void
-copy_scale_f32(void *dst, const void *src, const double scale, int n_bytes)
+void
+spa_audiomixer_copy_scale_f32_c(void *dst, const void *src, const double scale, int n_bytes)
 {
 	const float *s = src;
 	float *d = dst;
@@ -104,8 +134,38 @@ copy_scale_f32(void *dst, const void *src, const double scale, int n_bytes)
 	}
 }
 
-static void
-add_scale_s16(void *dst, const void *src, const double scale, int n_bytes)
+void
+spa_audiomixer_copy_scale_s32_c(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 16), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (*s * v) >> 16;
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+spa_audiomixer_copy_scale_f64_c(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d = *s * scale;
+		d++;
+		s++;
+	}
+}
+
+void
+spa_audiomixer_add_scale_s16_c(void *dst, const void *src, const double scale, int n_bytes)
 {
 	const int16_t *s = src;
 	int16_t *d = dst;
@@ -120,8 +180,8 @@ add_scale_s16(void *dst, const void *src, const double scale, int n_bytes)
 	}
 }
 
-static void
-add_scale_f32(void *dst, const void *src, const double scale, int n_bytes)
+void
+spa_audiomixer_add_scale_f32_c(void *dst, const void *src, const double scale, int n_bytes)
 {
 	const float *s = src;
 	float *d = dst;
@@ -135,6 +195,36 @@ add_scale_f32(void *dst, const void *src, const double scale, int n_bytes)
 	}
 }
 
+void
+spa_audiomixer_add_scale_s32_c(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 16), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = *d + ((*s * v) >> 16);
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d++;
+		s++;
+	}
+}
+
+void
+spa_audiomixer_add_scale_f64_c(void *dst, const void *src, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d += *s * scale;
+		d++;
+		s++;
+	}
+}
+
 static void
 copy_s16_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
 {
@@ -255,24 +345,206 @@ add_scale_f32_i(void *dst, int dst_stride, const void *src, int src_stride, cons
 	}
 }
 
-void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops)
+static void
+copy_s32_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		*d = *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+copy_f64_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d = *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+add_s32_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (int64_t) *d + *s;
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+add_f64_i(void *dst, int dst_stride, const void *src, int src_stride, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d += *s;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+copy_scale_s32_i(void *dst, int dst_stride, const void *src, int src_stride, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 16), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = (*s * v) >> 16;
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+copy_scale_f64_i(void *dst, int dst_stride, const void *src, int src_stride, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d = *s * scale;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+add_scale_s32_i(void *dst, int dst_stride, const void *src, int src_stride, const double scale, int n_bytes)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int64_t v = scale * (1 << 16), t;
+
+	n_bytes /= sizeof(int32_t);
+	while (n_bytes--) {
+		t = *d + ((*s * v) >> 16);
+		*d = SPA_CLAMP(t, INT32_MIN, INT32_MAX);
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+static void
+add_scale_f64_i(void *dst, int dst_stride, const void *src, int src_stride, const double scale, int n_bytes)
+{
+	const double *s = src;
+	double *d = dst;
+
+	n_bytes /= sizeof(double);
+	while (n_bytes--) {
+		*d += *s * scale;
+		d += dst_stride;
+		s += src_stride;
+	}
+}
+
+/** Get the optimizations supported by the CPU we are running on
+ * \return a mask of SPA_AUDIOMIXER_CPU_FLAG_* values
+ */
+uint32_t spa_audiomixer_get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		flags |= SPA_AUDIOMIXER_CPU_FLAG_SSE2;
+	if (__builtin_cpu_supports("avx2"))
+		flags |= SPA_AUDIOMIXER_CPU_FLAG_AVX2;
+#elif defined(__aarch64__)
+	/* NEON is mandatory on aarch64 */
+	flags |= SPA_AUDIOMIXER_CPU_FLAG_NEON;
+#endif
+	return flags;
+}
+
+/** Get the mixer functions
+ * \param ops the functions to fill
+ * \param cpu_flags the allowed optimizations, 0 for the generic C versions
+ *
+ * Optimizations that were not compiled in are ignored. The optimized
+ * functions produce exactly the same results as the generic C versions.
+ */
+void spa_audiomixer_get_ops_cpu(struct spa_audiomixer_ops *ops, uint32_t cpu_flags)
 {
 	ops->clear[FMT_S16] = clear_s16;
 	ops->clear[FMT_F32] = clear_f32;
+	ops->clear[FMT_S32] = clear_f32;
+	ops->clear[FMT_F64] = clear_f32;
 	ops->copy[FMT_S16] = copy_s16;
 	ops->copy[FMT_F32] = copy_f32;
-        ops->add[FMT_S16] = add_s16;
-        ops->add[FMT_F32] = add_f32;
-        ops->copy_scale[FMT_S16] = copy_scale_s16;
-        ops->copy_scale[FMT_F32] = copy_scale_f32;
-        ops->add_scale[FMT_S16] = add_scale_s16;
-        ops->add_scale[FMT_F32] = add_scale_f32;
-        ops->copy_i[FMT_S16] = copy_s16_i;
-        ops->copy_i[FMT_F32] = copy_f32_i;
-        ops->add_i[FMT_S16] = add_s16_i;
-        ops->add_i[FMT_F32] = add_f32_i;
-        ops->copy_scale_i[FMT_S16] = copy_scale_s16_i;
-        ops->copy_scale_i[FMT_F32] = copy_scale_f32_i;
-        ops->add_scale_i[FMT_S16] = add_scale_s16_i;
-        ops->add_scale_i[FMT_F32] = add_scale_f32_i;
+	ops->copy[FMT_S32] = copy_f32;
+	ops->copy[FMT_F64] = copy_f32;
+	ops->add[FMT_S16] = spa_audiomixer_add_s16_c;
+	ops->add[FMT_F32] = spa_audiomixer_add_f32_c;
+	ops->add[FMT_S32] = spa_audiomixer_add_s32_c;
+	ops->add[FMT_F64] = spa_audiomixer_add_f64_c;
+	ops->copy_scale[FMT_S16] = spa_audiomixer_copy_scale_s16_c;
+	ops->copy_scale[FMT_F32] = spa_audiomixer_copy_scale_f32_c;
+	ops->copy_scale[FMT_S32] = spa_audiomixer_copy_scale_s32_c;
+	ops->copy_scale[FMT_F64] = spa_audiomixer_copy_scale_f64_c;
+	ops->add_scale[FMT_S16] = spa_audiomixer_add_scale_s16_c;
+	ops->add_scale[FMT_F32] = spa_audiomixer_add_scale_f32_c;
+	ops->add_scale[FMT_S32] = spa_audiomixer_add_scale_s32_c;
+	ops->add_scale[FMT_F64] = spa_audiomixer_add_scale_f64_c;
+	ops->copy_i[FMT_S16] = copy_s16_i;
+	ops->copy_i[FMT_F32] = copy_f32_i;
+	ops->copy_i[FMT_S32] = copy_s32_i;
+	ops->copy_i[FMT_F64] = copy_f64_i;
+	ops->add_i[FMT_S16] = add_s16_i;
+	ops->add_i[FMT_F32] = add_f32_i;
+	ops->add_i[FMT_S32] = add_s32_i;
+	ops->add_i[FMT_F64] = add_f64_i;
+	ops->copy_scale_i[FMT_S16] = copy_scale_s16_i;
+	ops->copy_scale_i[FMT_F32] = copy_scale_f32_i;
+	ops->copy_scale_i[FMT_S32] = copy_scale_s32_i;
+	ops->copy_scale_i[FMT_F64] = copy_scale_f64_i;
+	ops->add_scale_i[FMT_S16] = add_scale_s16_i;
+	ops->add_scale_i[FMT_F32] = add_scale_f32_i;
+	ops->add_scale_i[FMT_S32] = add_scale_s32_i;
+	ops->add_scale_i[FMT_F64] = add_scale_f64_i;
+
+	/* later ones override the functions of earlier ones */
+#if defined(HAVE_SSE2)
+	if (cpu_flags & SPA_AUDIOMIXER_CPU_FLAG_SSE2)
+		spa_audiomixer_init_ops_sse2(ops);
+#endif
+#if defined(HAVE_AVX2)
+	if (cpu_flags & SPA_AUDIOMIXER_CPU_FLAG_AVX2)
+		spa_audiomixer_init_ops_avx2(ops);
+#endif
+#if defined(HAVE_NEON)
+	if (cpu_flags & SPA_AUDIOMIXER_CPU_FLAG_NEON)
+		spa_audiomixer_init_ops_neon(ops);
+#endif
+}
+
+void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops)
+{
+	spa_audiomixer_get_ops_cpu(ops, spa_audiomixer_get_cpu_flags());
 }
@@ -33,9 +33,19 @@ typedef void (*mix_scale_i_func_t) (void *dst, int dst_stride,
 enum {
 	FMT_S16,
 	FMT_F32,
+	FMT_S32,
+	FMT_F64,
 	FMT_MAX,
 };
 
+/* the functions are linked into the plugin and into libpipewire, keep them
+ * out of the exported symbols */
+#define SPA_AUDIOMIXER_HIDDEN	__attribute__((visibility("hidden")))
+
+#define SPA_AUDIOMIXER_CPU_FLAG_SSE2	(1 << 0)
+#define SPA_AUDIOMIXER_CPU_FLAG_AVX2	(1 << 1)
+#define SPA_AUDIOMIXER_CPU_FLAG_NEON	(1 << 2)
+
 struct spa_audiomixer_ops {
 	mix_clear_func_t clear[FMT_MAX];
 	mix_func_t copy[FMT_MAX];
@@ -48,4 +58,26 @@ struct spa_audiomixer_ops {
 	mix_scale_i_func_t add_scale_i[FMT_MAX];
 };
 
-void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops);
+SPA_AUDIOMIXER_HIDDEN uint32_t spa_audiomixer_get_cpu_flags(void);
+
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_get_ops_cpu(struct spa_audiomixer_ops *ops, uint32_t cpu_flags);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_get_ops(struct spa_audiomixer_ops *ops);
+
+/* generic C implementations, the optimized versions use these for the
+ * samples that don't fill a complete vector */
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_add_s16_c(void *dst, const void *src, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_add_f32_c(void *dst, const void *src, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_add_s32_c(void *dst, const void *src, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_add_f64_c(void *dst, const void *src, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_copy_scale_s16_c(void *dst, const void *src, const double scale, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_copy_scale_f32_c(void *dst, const void *src, const double scale, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_copy_scale_s32_c(void *dst, const void *src, const double scale, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_copy_scale_f64_c(void *dst, const void *src, const double scale, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_add_scale_s16_c(void *dst, const void *src, const double scale, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_add_scale_f32_c(void *dst, const void *src, const double scale, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_add_scale_s32_c(void *dst, const void *src, const double scale, int n_bytes);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_add_scale_f64_c(void *dst, const void *src, const double scale, int n_bytes);
+
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_init_ops_sse2(struct spa_audiomixer_ops *ops);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_init_ops_avx2(struct spa_audiomixer_ops *ops);
+SPA_AUDIOMIXER_HIDDEN void spa_audiomixer_init_ops_neon(struct spa_audiomixer_ops *ops);
@@ -52,6 +52,7 @@ struct type {
 	uint32_t prop_wave;
 	uint32_t prop_freq;
 	uint32_t prop_volume;
+	uint32_t prop_quantum;
 	uint32_t io_prop_wave;
 	uint32_t io_prop_freq;
 	uint32_t io_prop_volume;
@@ -80,6 +81,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->prop_wave = spa_type_map_get_id(map, SPA_TYPE_PROPS__waveType);
 	type->prop_freq = spa_type_map_get_id(map, SPA_TYPE_PROPS__frequency);
 	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
+	type->prop_quantum = spa_type_map_get_id(map, SPA_TYPE_PROPS__quantum);
 	type->io_prop_wave = spa_type_map_get_id(map, SPA_TYPE_IO_PROP_BASE "waveType");
 	type->io_prop_freq = spa_type_map_get_id(map, SPA_TYPE_IO_PROP_BASE "frequency");
 	type->io_prop_volume = spa_type_map_get_id(map, SPA_TYPE_IO_PROP_BASE "volume");
@@ -107,12 +109,14 @@ enum wave_type {
 #define DEFAULT_WAVE WAVE_SINE
 #define DEFAULT_FREQ 440.0
 #define DEFAULT_VOLUME 1.0
+#define DEFAULT_QUANTUM 0
 
 struct props {
 	bool live;
 	uint32_t wave;
 	double freq;
 	double volume;
+	uint32_t quantum;
 };
 
 static void reset_props(struct props *props)
@@ -121,6 +125,7 @@ static void reset_props(struct props *props)
 	props->wave = DEFAULT_WAVE;
 	props->freq = DEFAULT_FREQ;
 	props->volume = DEFAULT_VOLUME;
+	props->quantum = DEFAULT_QUANTUM;
 }
 
 #define MAX_BUFFERS 16
@@ -266,7 +271,8 @@ static int impl_node_enum_params(struct spa_node *node,
 				":", t->prop_live,   "b", p->live,
 				":", t->prop_wave,   "i", p->wave,
 				":", t->prop_freq,   "d", p->freq,
-				":", t->prop_volume, "d", p->volume);
+				":", t->prop_volume, "d", p->volume,
+				":", t->prop_quantum, "i", p->quantum);
 			break;
 		default:
 			return 0;
@@ -306,6 +312,7 @@ static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flag
 			":",t->prop_wave,   "?i", &p->wave,
 			":",t->prop_freq,   "?d", &p->freq,
 			":",t->prop_volume, "?d", &p->volume,
+			":",t->prop_quantum, "?i", &p->quantum,
 			NULL);
 
 		if (p->live)
@@ -379,6 +386,8 @@ static int make_buffer(struct impl *this)
 	data = d[0].data;
 
 	n_bytes = maxsize;
+	if (this->props.quantum != 0)
+		n_bytes = SPA_MIN(n_bytes, this->props.quantum * this->bpf);
 	if (range && range->min_size != 0) {
 		n_bytes = SPA_MIN(n_bytes, range->min_size);
 		if (range->max_size < n_bytes)
@@ -47,6 +47,7 @@
 struct props {
 	uint32_t min_latency;
 	uint32_t max_latency;
+	uint32_t quantum;
 };
 
 #define FILL_FRAMES 2
@@ -67,6 +68,7 @@ struct type {
 	uint32_t props;
 	uint32_t prop_min_latency;
 	uint32_t prop_max_latency;
+	uint32_t prop_quantum;
 	struct spa_type_io io;
 	struct spa_type_param param;
 	struct spa_type_meta meta;
@@ -90,6 +92,7 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
 	type->prop_min_latency = spa_type_map_get_id(map, SPA_TYPE_PROPS__minLatency);
 	type->prop_max_latency = spa_type_map_get_id(map, SPA_TYPE_PROPS__maxLatency);
+	type->prop_quantum = spa_type_map_get_id(map, SPA_TYPE_PROPS__quantum);
 
 	spa_type_io_map(map, &type->io);
 	spa_type_param_map(map, &type->param);
@@ -184,11 +187,19 @@ struct impl {
 
 static const uint32_t default_min_latency = 1024;
 static const uint32_t default_max_latency = 1024;
+static const uint32_t default_quantum = 0;
 
 static void reset_props(struct props *props)
 {
 	props->min_latency = default_min_latency;
 	props->max_latency = default_max_latency;
+	props->quantum = default_quantum;
+}
+
+/* the quantum of the graph, when set, overrides the configured latency */
+static inline int get_threshold(struct impl *this)
+{
+	return this->props.quantum != 0 ? this->props.quantum : this->props.min_latency;
 }
 
 static int impl_node_enum_params(struct spa_node *node,
@@ -255,7 +266,8 @@ static int impl_node_enum_params(struct spa_node *node,
 			param = spa_pod_builder_object(&b,
 				id, t->props,
 				":", t->prop_min_latency, "i",   p->min_latency,
-				":", t->prop_max_latency, "i",   p->max_latency);
+				":", t->prop_max_latency, "i",   p->max_latency,
+				":", t->prop_quantum,     "i",   p->quantum);
 			break;
 		default:
 			return 0;
@@ -292,7 +304,11 @@ static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flag
 		}
 		spa_pod_object_parse(param,
 			":", t->prop_min_latency, "?i", &p->min_latency,
-			":", t->prop_max_latency, "?i", &p->max_latency, NULL);
+			":", t->prop_max_latency, "?i", &p->max_latency,
+			":", t->prop_quantum,     "?i", &p->quantum, NULL);
+
+		if (this->have_format)
+			this->threshold = get_threshold(this);
 	}
 	else
 		return -ENOENT;
@@ -1115,7 +1131,7 @@ static int port_set_format(struct spa_node *node,
 			return -EINVAL;
 
 		this->frame_size = info.info.raw.channels * 2;
-		this->threshold = this->props.min_latency;
+		this->threshold = get_threshold(this);
 		this->current_format = info;
 		this->have_format = true;
 	}
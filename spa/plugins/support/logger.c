@@ -18,10 +18,14 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/eventfd.h>
 
 #include <spa/support/type-map.h>
@@ -36,6 +40,13 @@
 
 #define TRACE_BUFFER (16*1024)
 
+#define TRACE_RING_SIZE		(256*1024)	/* per thread, power of 2 */
+#define TRACE_MAX_RECORD	1024
+#define TRACE_MAX_STRING	256
+#define TRACE_MAX_NAME		64
+#define TRACE_SPARE_RINGS	16
+#define TRACE_FLUSH_INTERVAL	(10 * SPA_NSEC_PER_MSEC)
+
 struct type {
 	uint32_t log;
 };
@@ -57,8 +68,572 @@ struct impl {
 
 	bool have_source;
 	struct spa_source source;
+
+	bool binary_trace;
+	pthread_key_t key;		/* the ring of the thread */
+	struct trace_ring *rings;	/* lock-free list, rings are added on first use */
+	struct trace_ring *spare[TRACE_SPARE_RINGS];	/* taken by new threads */
+	uint32_t lost;			/* messages of threads without a ring */
+	uint32_t reported;
+	pthread_t thread;
+	bool running;
+};
+
+/* the trace messages of a thread in binary form. The thread is the only
+ * writer, the trace thread the only reader. Rings are allocated by the
+ * trace thread and kept until the logger is cleared. When a thread exits,
+ * its ring is marked free and taken by the next new thread. */
+struct trace_ring {
+	struct trace_ring *next;
+	bool used;
+	uint32_t dropped;
+	uint32_t reported;
+	struct spa_ringbuffer rb;
+	uint8_t data[TRACE_RING_SIZE];
+};
+
+/* a trace message in a ring, followed by the file name, function and
+ * format and then the arguments in slots of 8 bytes. All strings are
+ * copied because the module that logged the message can be unloaded
+ * before the message is written. */
+struct trace_record {
+	uint32_t size;			/* size with the strings and arguments, multiple of 8 */
+	int32_t line;
+	uint32_t n_args;		/* number of stored conversions */
+	uint32_t strings;		/* size of the strings, multiple of 8 */
+	uint64_t time;			/* CLOCK_MONOTONIC nanoseconds */
+};
+
+enum arg_type {
+	ARG_NONE,			/* %% */
+	ARG_INVALID,			/* unsupported, written without formatting */
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_INTMAX,
+	ARG_SIZE,
+	ARG_PTRDIFF,
+	ARG_DOUBLE,
+	ARG_LDOUBLE,
+	ARG_POINTER,
+	ARG_STRING,
+	ARG_COUNT,			/* %n, ignored */
+	ARG_ERRNO,			/* %m */
 };
 
+struct conversion {
+	const char *start;
+	size_t len;
+	int n_star;
+	enum arg_type type;
+};
+
+#define ARG_SLOTS(s)	(((s) + 7) / 8)
+
+/* find the next conversion in fmt, returns the position after it or NULL
+ * when there are no more conversions */
+static const char *next_conversion(const char *f, struct conversion *c)
+{
+	int length = 0;
+
+	if ((f = strchr(f, '%')) == NULL)
+		return NULL;
+
+	c->start = f++;
+	c->n_star = 0;
+
+	while (*f && strchr("-+ #0'", *f))
+		f++;
+	if (*f == '*') {
+		c->n_star++;
+		f++;
+	} else {
+		while (*f >= '0' && *f <= '9')
+			f++;
+	}
+	if (*f == '.') {
+		f++;
+		if (*f == '*') {
+			c->n_star++;
+			f++;
+		} else {
+			while (*f >= '0' && *f <= '9')
+				f++;
+		}
+	}
+	switch (*f) {
+	case 'h':
+		f += f[1] == 'h' ? 2 : 1;
+		break;
+	case 'l':
+		if (f[1] == 'l') {
+			length = 'q';
+			f += 2;
+		} else
+			length = *f++;
+		break;
+	case 'q': case 'j': case 'z': case 't': case 'L':
+		length = *f++;
+		break;
+	}
+
+	switch (*f) {
+	case '%':
+		c->type = ARG_NONE;
+		break;
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+		switch (length) {
+		case 'l': c->type = ARG_LONG; break;
+		case 'q': c->type = ARG_LLONG; break;
+		case 'j': c->type = ARG_INTMAX; break;
+		case 'z': c->type = ARG_SIZE; break;
+		case 't': c->type = ARG_PTRDIFF; break;
+		default: c->type = ARG_INT; break;
+		}
+		break;
+	case 'c':
+		c->type = ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+		c->type = length == 'L' ? ARG_LDOUBLE : ARG_DOUBLE;
+		break;
+	case 's':
+		c->type = length == 0 ? ARG_STRING : ARG_INVALID;
+		break;
+	case 'p':
+		c->type = ARG_POINTER;
+		break;
+	case 'n':
+		c->type = ARG_COUNT;
+		break;
+	case 'm':
+		c->type = ARG_ERRNO;
+		break;
+	default:
+		c->type = ARG_INVALID;
+		return f;
+	}
+	f++;
+	c->len = f - c->start;
+
+	return f;
+}
+
+static struct trace_ring *alloc_trace_ring(void)
+{
+	struct trace_ring *ring;
+	size_t i;
+
+	if ((ring = calloc(1, sizeof(struct trace_ring))) == NULL)
+		return NULL;
+
+	spa_ringbuffer_init(&ring->rb);
+	/* fault in the pages here and not in the thread that takes the ring */
+	for (i = 0; i < TRACE_RING_SIZE; i += 4096)
+		((volatile uint8_t *) ring->data)[i] = 0;
+
+	return ring;
+}
+
+/* replace the rings that were taken, only called by the trace thread and
+ * before it is started */
+static void fill_spare_rings(struct impl *impl)
+{
+	int i;
+
+	for (i = 0; i < TRACE_SPARE_RINGS; i++) {
+		if (__atomic_load_n(&impl->spare[i], __ATOMIC_ACQUIRE) == NULL)
+			__atomic_store_n(&impl->spare[i], alloc_trace_ring(), __ATOMIC_RELEASE);
+	}
+}
+
+/* called when a thread with a ring exits, the messages that are still in
+ * the ring are written before those of the next thread that takes it */
+static void release_trace_ring(void *data)
+{
+	struct trace_ring *ring = data;
+	__atomic_store_n(&ring->used, false, __ATOMIC_RELEASE);
+}
+
+static struct trace_ring *get_trace_ring(struct impl *impl)
+{
+	struct trace_ring *ring;
+	bool used;
+	int i;
+
+	if (SPA_LIKELY((ring = pthread_getspecific(impl->key)) != NULL))
+		return ring;
+
+	/* the first trace message of this thread takes the ring of a thread
+	 * that exited or else a spare ring, the message is lost when there is
+	 * none left */
+	for (ring = __atomic_load_n(&impl->rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		used = false;
+		if (__atomic_compare_exchange_n(&ring->used, &used, true, false,
+						__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			goto found;
+	}
+	for (i = 0; i < TRACE_SPARE_RINGS; i++) {
+		if ((ring = __atomic_exchange_n(&impl->spare[i], NULL, __ATOMIC_ACQUIRE)) != NULL)
+			break;
+	}
+	if (ring == NULL) {
+		__atomic_add_fetch(&impl->lost, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	ring->used = true;
+	ring->next = __atomic_load_n(&impl->rings, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&impl->rings, &ring->next, ring, false,
+					    __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+      found:
+	pthread_setspecific(impl->key, ring);
+	return ring;
+}
+
+/* copy at most max bytes of s and a 0 to p, returns the end of the copy */
+static char *copy_string(char *p, const char *s, size_t max)
+{
+	size_t len = strnlen(s, max);
+
+	memcpy(p, s, len);
+	p[len] = '\0';
+	return p + len + 1;
+}
+
+/* the strings of a record and the start of its arguments */
+static const uint64_t *record_strings(const struct trace_record *r, const char **file,
+				      const char **func, const char **fmt)
+{
+	*file = (const char *) (r + 1);
+	*func = *file + strlen(*file) + 1;
+	*fmt = *func + strlen(*func) + 1;
+	return SPA_MEMBER(r + 1, r->strings, const uint64_t);
+}
+
+/* store the message with its arguments in the ring of the thread, this
+ * does not format, allocate or make system calls */
+static void
+trace_log(struct impl *impl,
+	  const char *file,
+	  int line,
+	  const char *func,
+	  const char *fmt,
+	  va_list args)
+{
+	uint64_t buffer[TRACE_MAX_RECORD / 8];
+	struct trace_record *r = (struct trace_record *) buffer;
+	uint64_t *p, *end = buffer + SPA_N_ELEMENTS(buffer);
+	struct trace_ring *ring;
+	const char *base, *copy;
+	char *str;
+	struct conversion c;
+	struct timespec now;
+	uint32_t index;
+	int32_t filled;
+	int i;
+
+	if ((ring = get_trace_ring(impl)) == NULL)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	r->line = line;
+	r->n_args = 0;
+	r->time = SPA_TIMESPEC_TO_TIME(&now);
+
+	base = strrchr(file, '/');
+	str = copy_string((char *) (r + 1), base ? base + 1 : file, TRACE_MAX_NAME);
+	str = copy_string(str, func, TRACE_MAX_NAME);
+	copy = str;
+	str = copy_string(str, fmt, TRACE_MAX_STRING);
+	r->strings = SPA_ROUND_UP_N(str - (char *) (r + 1), 8);
+	p = SPA_MEMBER(r + 1, r->strings, uint64_t);
+
+	/* the arguments are stored for the conversions of the copy, it can
+	 * be truncated */
+	fmt = copy;
+
+	while ((fmt = next_conversion(fmt, &c)) != NULL) {
+		if (c.type == ARG_NONE)
+			continue;
+		if (c.type == ARG_INVALID || p + c.n_star + ARG_SLOTS(sizeof(long double)) > end)
+			break;
+
+		for (i = 0; i < c.n_star; i++)
+			*(int64_t *) p++ = va_arg(args, int);
+
+		switch (c.type) {
+		case ARG_INT:
+			*(int64_t *) p++ = va_arg(args, int);
+			break;
+		case ARG_LONG:
+			*(int64_t *) p++ = va_arg(args, long);
+			break;
+		case ARG_LLONG:
+			*(int64_t *) p++ = va_arg(args, long long);
+			break;
+		case ARG_INTMAX:
+			*(int64_t *) p++ = va_arg(args, intmax_t);
+			break;
+		case ARG_SIZE:
+			*(int64_t *) p++ = va_arg(args, size_t);
+			break;
+		case ARG_PTRDIFF:
+			*(int64_t *) p++ = va_arg(args, ptrdiff_t);
+			break;
+		case ARG_DOUBLE:
+			*(double *) p++ = va_arg(args, double);
+			break;
+		case ARG_LDOUBLE:
+		{
+			long double v = va_arg(args, long double);
+			memcpy(p, &v, sizeof(v));
+			p += ARG_SLOTS(sizeof(v));
+			break;
+		}
+		case ARG_POINTER:
+		case ARG_COUNT:
+			*(uint64_t *) p++ = (uintptr_t) va_arg(args, void *);
+			break;
+		case ARG_STRING:
+		{
+			const char *s = va_arg(args, const char *);
+			size_t len;
+
+			if (s == NULL) {
+				*(int64_t *) p++ = -1;
+				break;
+			}
+			len = SPA_MIN((size_t) (end - p - 1) * 8 - 1, TRACE_MAX_STRING);
+			len = strnlen(s, len);
+			*(int64_t *) p++ = len;
+			memcpy(p, s, len);
+			((char *) p)[len] = '\0';
+			p += ARG_SLOTS(len + 1);
+			break;
+		}
+		case ARG_ERRNO:
+			*(int64_t *) p++ = errno;
+			break;
+		default:
+			break;
+		}
+		r->n_args++;
+	}
+	r->size = (uint8_t *) p - (uint8_t *) buffer;
+
+	filled = spa_ringbuffer_get_write_index(&ring->rb, &index);
+	if (filled < 0 || filled + r->size > TRACE_RING_SIZE) {
+		__atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+		return;
+	}
+	spa_ringbuffer_write_data(&ring->rb, ring->data, TRACE_RING_SIZE,
+				  index & (TRACE_RING_SIZE - 1), buffer, r->size);
+	spa_ringbuffer_write_update(&ring->rb, index + r->size);
+}
+
+#define FORMAT_ARG(v)									\
+	(c.n_star == 0 ? snprintf(t, avail, spec, v) :					\
+	 c.n_star == 1 ? snprintf(t, avail, spec, (int) star[0], v) :			\
+	 snprintf(t, avail, spec, (int) star[0], (int) star[1], v))
+
+/* format a record with printf, one conversion at a time */
+static void trace_format(struct trace_record *r, const char *fmt, const uint64_t *p,
+			 char *text, size_t size)
+{
+	const char *f;
+	struct conversion c;
+	size_t pos = 0;
+	uint32_t i;
+
+#define APPEND(s,l)					\
+	do {						\
+		size_t _l = SPA_MIN((size_t)(l), size - 1 - pos);	\
+		memcpy(text + pos, s, _l);		\
+		pos += _l;				\
+	} while (0)
+
+	for (i = 0; (f = next_conversion(fmt, &c)) != NULL; fmt = f) {
+		char spec[64], *t;
+		size_t avail;
+		int64_t star[2] = { 0, 0 };
+		int j, res = 0;
+
+		APPEND(fmt, c.start - fmt);
+		fmt = c.start;
+		t = text + pos;
+		avail = size - pos;
+
+		if (c.type == ARG_NONE) {
+			APPEND("%", 1);
+			continue;
+		}
+		if (c.type == ARG_INVALID || i == r->n_args || c.len >= sizeof(spec))
+			break;
+
+		memcpy(spec, c.start, c.len);
+		spec[c.len] = '\0';
+
+		for (j = 0; j < c.n_star; j++)
+			star[j] = *(const int64_t *) p++;
+
+		switch (c.type) {
+		case ARG_INT:
+			res = FORMAT_ARG((int) *(const int64_t *) p++);
+			break;
+		case ARG_LONG:
+			res = FORMAT_ARG((long) *(const int64_t *) p++);
+			break;
+		case ARG_LLONG:
+			res = FORMAT_ARG((long long) *(const int64_t *) p++);
+			break;
+		case ARG_INTMAX:
+			res = FORMAT_ARG((intmax_t) *(const int64_t *) p++);
+			break;
+		case ARG_SIZE:
+			res = FORMAT_ARG((size_t) *(const int64_t *) p++);
+			break;
+		case ARG_PTRDIFF:
+			res = FORMAT_ARG((ptrdiff_t) *(const int64_t *) p++);
+			break;
+		case ARG_DOUBLE:
+			res = FORMAT_ARG(*(const double *) p++);
+			break;
+		case ARG_LDOUBLE:
+		{
+			long double v;
+			memcpy(&v, p, sizeof(v));
+			p += ARG_SLOTS(sizeof(v));
+			res = FORMAT_ARG(v);
+			break;
+		}
+		case ARG_POINTER:
+			res = FORMAT_ARG((void *) (uintptr_t) *p++);
+			break;
+		case ARG_STRING:
+		{
+			int64_t len = *(const int64_t *) p++;
+			if (len < 0) {
+				res = FORMAT_ARG((const char *) NULL);
+			} else {
+				res = FORMAT_ARG((const char *) p);
+				p += ARG_SLOTS(len + 1);
+			}
+			break;
+		}
+		case ARG_COUNT:
+			p++;
+			break;
+		case ARG_ERRNO:
+			res = snprintf(t, avail, "%s", strerror(*(const int64_t *) p++));
+			break;
+		default:
+			break;
+		}
+		if (res > 0)
+			pos += SPA_MIN((size_t) res, avail - 1);
+		i++;
+	}
+	/* the rest of the format after the last stored argument */
+	APPEND(fmt, strlen(fmt));
+	text[pos] = '\0';
+#undef APPEND
+}
+
+#undef FORMAT_ARG
+
+static struct trace_ring *oldest_ring(struct impl *impl, struct trace_record *r)
+{
+	struct trace_ring *ring, *oldest = NULL;
+	struct trace_record hdr;
+	uint64_t time = 0;
+	uint32_t index;
+
+	for (ring = __atomic_load_n(&impl->rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		if (spa_ringbuffer_get_read_index(&ring->rb, &index) < (int32_t) sizeof(hdr))
+			continue;
+		spa_ringbuffer_read_data(&ring->rb, ring->data, TRACE_RING_SIZE,
+					 index & (TRACE_RING_SIZE - 1), &hdr, sizeof(hdr));
+		if (oldest == NULL || hdr.time < time) {
+			oldest = ring;
+			time = hdr.time;
+			*r = hdr;
+		}
+	}
+	return oldest;
+}
+
+/* write the messages of all threads in the order they were logged */
+static void trace_flush(struct impl *impl)
+{
+	uint64_t buffer[TRACE_MAX_RECORD / 8];
+	struct trace_record *r = (struct trace_record *) buffer;
+	struct trace_ring *ring;
+	char text[1024], line[1280], out[16 * 1024];
+	size_t pos = 0;
+	uint32_t index, dropped;
+	int len;
+
+	dropped = __atomic_load_n(&impl->lost, __ATOMIC_RELAXED);
+	if (dropped != impl->reported) {
+		fprintf(stderr, "[W][logger] %u trace messages dropped, no ring for the thread\n",
+				dropped - impl->reported);
+		impl->reported = dropped;
+	}
+	for (ring = __atomic_load_n(&impl->rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+		if (dropped != ring->reported) {
+			fprintf(stderr, "[W][logger] %u trace messages dropped\n",
+					dropped - ring->reported);
+			ring->reported = dropped;
+		}
+	}
+
+	while ((ring = oldest_ring(impl, r)) != NULL) {
+		const char *file, *func, *fmt;
+		const uint64_t *args;
+
+		spa_ringbuffer_get_read_index(&ring->rb, &index);
+		spa_ringbuffer_read_data(&ring->rb, ring->data, TRACE_RING_SIZE,
+					 index & (TRACE_RING_SIZE - 1), buffer, r->size);
+		spa_ringbuffer_read_update(&ring->rb, index + r->size);
+
+		args = record_strings(r, &file, &func, &fmt);
+		trace_format(r, fmt, args, text, sizeof(text));
+
+		len = snprintf(line, sizeof(line), "[T][%" PRIu64 ".%06" PRIu64 "][%s:%i %s()] %s\n",
+				(uint64_t) (r->time / SPA_NSEC_PER_SEC),
+				(uint64_t) ((r->time % SPA_NSEC_PER_SEC) / 1000),
+				file, r->line, func, text);
+		len = SPA_MIN(len, (int) sizeof(line) - 1);
+
+		if (pos + len > sizeof(out)) {
+			fwrite(out, pos, 1, stderr);
+			pos = 0;
+		}
+		memcpy(out + pos, line, len);
+		pos += len;
+	}
+	if (pos > 0)
+		fwrite(out, pos, 1, stderr);
+}
+
+static void *trace_thread(void *data)
+{
+	struct impl *impl = data;
+	struct timespec interval = { 0, TRACE_FLUSH_INTERVAL };
+
+	while (__atomic_load_n(&impl->running, __ATOMIC_RELAXED)) {
+		fill_spare_rings(impl);
+		trace_flush(impl);
+		nanosleep(&interval, NULL);
+	}
+	trace_flush(impl);
+
+	return NULL;
+}
+
 static void
 impl_log_logv(struct spa_log *log,
 	      enum spa_log_level level,
@@ -74,6 +649,11 @@ impl_log_logv(struct spa_log *log,
 	int size;
 	bool do_trace;
 
+	if (level == SPA_LOG_LEVEL_TRACE && impl->binary_trace) {
+		trace_log(impl, file, line, func, fmt, args);
+		return;
+	}
+
 	if ((do_trace = (level == SPA_LOG_LEVEL_TRACE && impl->have_source)))
 		level++;
 
@@ -167,6 +747,7 @@ static int impl_get_interface(struct spa_handle *handle, uint32_t interface_id,
 static int impl_clear(struct spa_handle *handle)
 {
 	struct impl *this;
+	int i;
 
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
 
@@ -177,6 +758,23 @@ static int impl_clear(struct spa_handle *handle)
 		close(this->source.fd);
 		this->have_source = false;
 	}
+	if (this->binary_trace) {
+		struct trace_ring *ring;
+
+		__atomic_store_n(&this->running, false, __ATOMIC_RELAXED);
+		pthread_join(this->thread, NULL);
+		pthread_key_delete(this->key);
+
+		while ((ring = this->rings) != NULL) {
+			this->rings = ring->next;
+			free(ring);
+		}
+		for (i = 0; i < TRACE_SPARE_RINGS; i++) {
+			free(this->spare[i]);
+			this->spare[i] = NULL;
+		}
+		this->binary_trace = false;
+	}
 	return 0;
 }
 
@@ -190,6 +788,8 @@ impl_init(const struct spa_handle_factory *factory,
 	struct impl *this;
 	uint32_t i;
 	struct spa_loop *loop = NULL;
+	const char *str;
+	int res;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
@@ -225,6 +825,26 @@ impl_init(const struct spa_handle_factory *factory,
 
 	spa_ringbuffer_init(&this->trace_rb);
 
+	if (info && (str = spa_dict_lookup(info, "log.binary-trace")) != NULL &&
+	    (strcmp(str, "true") == 0 || atoi(str) == 1)) {
+		if ((res = pthread_key_create(&this->key, release_trace_ring)) != 0) {
+			spa_log_warn(&this->log, NAME " %p: can't create trace key: %s",
+					this, strerror(res));
+			goto done;
+		}
+		fill_spare_rings(this);
+		this->running = true;
+		if ((res = pthread_create(&this->thread, NULL, trace_thread, this)) == 0) {
+			this->binary_trace = true;
+		} else {
+			spa_log_warn(&this->log, NAME " %p: can't start trace thread: %s",
+					this, strerror(res));
+			pthread_key_delete(this->key);
+			for (i = 0; i < TRACE_SPARE_RINGS; i++)
+				free(this->spare[i]);
+		}
+	}
+      done:
 	spa_log_debug(&this->log, NAME " %p: initialized", this);
 
 	return 0;
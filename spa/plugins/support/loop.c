@@ -28,18 +28,37 @@
 #include <sys/eventfd.h>
 #include <sys/signalfd.h>
 #include <pthread.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
 #include <spa/support/loop.h>
 #include <spa/support/log.h>
 #include <spa/support/type-map.h>
 #include <spa/support/plugin.h>
 #include <spa/utils/list.h>
-#include <spa/utils/ringbuffer.h>
+#include <spa/utils/mpsc-ringbuffer.h>
+
+#ifdef HAVE_IO_URING
+#include "uring.h"
+#endif
 
 #define NAME "loop"
 
 #define DATAS_SIZE (4096 * 8)
 
+#define WHEEL_BITS	6
+#define WHEEL_SIZE	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SIZE - 1)
+#define WHEEL_LEVELS	4
+#define DEFAULT_TIMER_SLACK	SPA_NSEC_PER_MSEC
+
+#ifdef HAVE_IO_URING
+#define URING_ENTRIES	256
+#define URING_IGNORE	UINT64_MAX	/* user_data of cancel requests */
+#define URING_DATA(fd,gen)	(((uint64_t)(gen) << 32) | (uint32_t)(fd))
+#endif
+
 /** \cond */
 
 struct invoke_item {
@@ -48,9 +67,8 @@ struct invoke_item {
 	uint32_t seq;
 	void *data;
 	size_t size;
-	bool block;
+	struct spa_loop_completion *completion;
 	void *user_data;
-	int res;
 };
 
 struct type {
@@ -60,6 +78,7 @@ struct type {
 };
 
 static void loop_signal_event(struct spa_source *source);
+static void source_event_func(struct spa_source *source);
 
 static inline void init_type(struct type *type, struct spa_type_map *map)
 {
@@ -68,6 +87,35 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->loop_utils = spa_type_map_get_id(map, SPA_TYPE__LoopUtils);
 }
 
+#ifdef HAVE_IO_URING
+/* the state of the fd in the ring. The slots are never moved or freed
+ * while the ring exists because the kernel writes the result of a read
+ * into the value. Completions carry the fd and the generation of the
+ * request, a new generation is started when the request is cancelled so
+ * that stale completions can be ignored. */
+struct uring_slot {
+	struct spa_source *source;
+	uint32_t gen;
+	uint32_t pending;		/* number of requests in the ring */
+	bool armed;			/* a request of the current generation is queued */
+	bool read;			/* read the fd instead of polling it */
+	uint64_t value;
+};
+#endif
+
+/* hierarchical timer wheel. Timers are put in the slot of their expiration
+ * tick, the ticks are slack nanoseconds long so that timers that expire
+ * close together are handled with one wakeup. Level 0 has a slot per tick,
+ * the slots of the next levels are 64 times larger and are moved to the
+ * lower levels when the wheel reaches them. */
+struct timer_wheel {
+	uint64_t slack;			/* length of a tick in nanoseconds */
+	uint64_t now;			/* next tick to process */
+	uint64_t armed;			/* tick of the timerfd expiration or 0 */
+	uint64_t bitmap[WHEEL_LEVELS];	/* non-empty slots */
+	struct spa_list slots[WHEEL_LEVELS][WHEEL_SIZE];
+};
+
 struct impl {
 	struct spa_handle handle;
 	struct spa_loop loop;
@@ -85,10 +133,22 @@ struct impl {
 	int epoll_fd;
 	pthread_t thread;
 
+#ifdef HAVE_IO_URING
+	bool use_uring;
+	bool ring_exported;
+	struct uring ring;
+	pthread_mutex_t ring_lock;	/* sources can be added from other threads */
+	struct uring_slot **slots;	/* indexed by fd */
+	uint32_t n_slots;
+#endif
+
 	struct spa_source *wakeup;
-	int ack_fd;
+	bool wakeup_pending;		/* the wakeup was signaled and not handled */
 
-	struct spa_ringbuffer buffer;
+	struct spa_source *timer;	/* timerfd of the wheel, made on first use */
+	struct timer_wheel wheel;
+
+	struct spa_mpsc_ringbuffer buffer;
 	uint8_t buffer_data[DATAS_SIZE];
 };
 
@@ -108,6 +168,14 @@ struct source_impl {
 	} func;
 	int signal_number;
 	bool enabled;
+	bool have_count;		/* the ring already read the event fd */
+	uint64_t count;
+
+	struct spa_list timer_link;	/* in the wheel or being dispatched */
+	bool timer_armed;
+	uint64_t timer_expire;		/* CLOCK_MONOTONIC nanoseconds */
+	uint64_t timer_interval;
+	uint64_t timer_tick;
 };
 /** \endcond */
 
@@ -143,12 +211,173 @@ static inline enum spa_io spa_epoll_to_io(uint32_t events)
 	return mask;
 }
 
+#ifdef HAVE_IO_URING
+static struct uring_slot *uring_get_slot(struct impl *impl, int fd)
+{
+	if ((uint32_t) fd >= impl->n_slots) {
+		uint32_t n_slots = SPA_MAX(impl->n_slots, 64u);
+		struct uring_slot **slots;
+
+		while (n_slots <= (uint32_t) fd)
+			n_slots *= 2;
+
+		slots = realloc(impl->slots, n_slots * sizeof(struct uring_slot *));
+		if (slots == NULL)
+			return NULL;
+
+		memset(&slots[impl->n_slots], 0,
+		       (n_slots - impl->n_slots) * sizeof(struct uring_slot *));
+		impl->slots = slots;
+		impl->n_slots = n_slots;
+	}
+	if (impl->slots[fd] == NULL)
+		impl->slots[fd] = calloc(1, sizeof(struct uring_slot));
+
+	return impl->slots[fd];
+}
+
+static inline struct uring_slot *uring_find_slot(struct impl *impl, struct spa_source *source)
+{
+	struct uring_slot *slot;
+
+	if ((uint32_t) source->fd >= impl->n_slots)
+		return NULL;
+	slot = impl->slots[source->fd];
+	return slot && slot->source == source ? slot : NULL;
+}
+
+static struct io_uring_sqe *uring_sqe(struct impl *impl)
+{
+	struct io_uring_sqe *sqe;
+	int res;
+
+	/* submit what we have when the queue is full */
+	while ((sqe = uring_get_sqe(&impl->ring)) == NULL) {
+		res = uring_enter(&impl->ring, uring_publish(&impl->ring), false, 0);
+		if (res < 0 && res != -EINTR) {
+			spa_log_warn(impl->log, NAME " %p: failed to submit: %s",
+					impl, strerror(-res));
+			return NULL;
+		}
+	}
+	return sqe;
+}
+
+/* queue a one-shot poll or read for the current generation of the slot */
+static int uring_arm(struct impl *impl, int fd, struct uring_slot *slot)
+{
+	struct io_uring_sqe *sqe;
+	uint32_t events;
+
+	if ((sqe = uring_sqe(impl)) == NULL)
+		return -EBUSY;
+
+	sqe->fd = fd;
+	sqe->user_data = URING_DATA(fd, slot->gen);
+	if (slot->read) {
+		sqe->opcode = IORING_OP_READ;
+		sqe->addr = (uintptr_t) &slot->value;
+		sqe->len = sizeof(uint64_t);
+	} else {
+		/* the poll and epoll event bits are the same */
+		events = spa_io_to_epoll(slot->source->mask);
+#if __BYTE_ORDER == __BIG_ENDIAN
+		events = (events << 16) | (events >> 16);
+#endif
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->poll32_events = events;
+	}
+	slot->pending++;
+	slot->armed = true;
+
+	return 0;
+}
+
+/* cancel the queued request and start a new generation */
+static void uring_disarm(struct impl *impl, int fd, struct uring_slot *slot)
+{
+	struct io_uring_sqe *sqe;
+
+	if (slot->armed && (sqe = uring_sqe(impl)) != NULL) {
+		sqe->opcode = slot->read ? IORING_OP_ASYNC_CANCEL : IORING_OP_POLL_REMOVE;
+		sqe->fd = -1;
+		sqe->addr = URING_DATA(fd, slot->gen);
+		sqe->user_data = URING_IGNORE;
+	}
+	slot->armed = false;
+	slot->gen++;
+}
+
+static int uring_add_source(struct impl *impl, struct spa_source *source)
+{
+	struct uring_slot *slot;
+	int res;
+
+	pthread_mutex_lock(&impl->ring_lock);
+	if ((slot = uring_get_slot(impl, source->fd)) == NULL) {
+		res = -ENOMEM;
+	} else if (slot->source != NULL) {
+		res = -EEXIST;
+	} else {
+		slot->source = source;
+		/* the event fds are read by the ring, unless an old read on
+		 * the same fd number is still being cancelled */
+		slot->read = source->func == source_event_func && slot->pending == 0;
+		if ((res = uring_arm(impl, source->fd, slot)) == 0)
+			res = uring_enter(&impl->ring, uring_publish(&impl->ring), false, 0);
+		if (res < 0)
+			slot->source = NULL;
+	}
+	pthread_mutex_unlock(&impl->ring_lock);
+
+	return res < 0 ? -res : 0;
+}
+
+static int uring_update_source(struct impl *impl, struct spa_source *source)
+{
+	struct uring_slot *slot;
+	int res = 0;
+
+	pthread_mutex_lock(&impl->ring_lock);
+	if ((slot = uring_find_slot(impl, source)) == NULL) {
+		res = -ENOENT;
+	} else if (!slot->read) {
+		/* when the source is being dispatched it is not armed and we
+		 * can arm it with the new mask right away */
+		uring_disarm(impl, source->fd, slot);
+		if ((res = uring_arm(impl, source->fd, slot)) == 0)
+			res = uring_enter(&impl->ring, uring_publish(&impl->ring), false, 0);
+	}
+	pthread_mutex_unlock(&impl->ring_lock);
+
+	return res < 0 ? -res : 0;
+}
+
+static void uring_remove_source(struct impl *impl, struct spa_source *source)
+{
+	struct uring_slot *slot;
+
+	pthread_mutex_lock(&impl->ring_lock);
+	if ((slot = uring_find_slot(impl, source)) != NULL) {
+		uring_disarm(impl, source->fd, slot);
+		slot->source = NULL;
+		uring_enter(&impl->ring, uring_publish(&impl->ring), false, 0);
+	}
+	pthread_mutex_unlock(&impl->ring_lock);
+}
+#endif
+
 static int loop_add_source(struct spa_loop *loop, struct spa_source *source)
 {
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
 	source->loop = loop;
 
+#ifdef HAVE_IO_URING
+	if (impl->use_uring && source->fd != -1)
+		return uring_add_source(impl, source);
+#endif
+
 	if (source->fd != -1) {
 		struct epoll_event ep;
 
@@ -167,6 +396,10 @@ static int loop_update_source(struct spa_source *source)
 	struct spa_loop *loop = source->loop;
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
+#ifdef HAVE_IO_URING
+	if (impl->use_uring && source->fd != -1)
+		return uring_update_source(impl, source);
+#endif
 	if (source->fd != -1) {
 		struct epoll_event ep;
 
@@ -185,6 +418,12 @@ static void loop_remove_source(struct spa_source *source)
 	struct spa_loop *loop = source->loop;
 	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
 
+#ifdef HAVE_IO_URING
+	if (impl->use_uring) {
+		if (source->fd != -1)
+			uring_remove_source(impl, source);
+	} else
+#endif
 	if (source->fd != -1)
 		epoll_ctl(impl->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
 
@@ -192,101 +431,177 @@ static void loop_remove_source(struct spa_source *source)
 }
 
 static int
-loop_invoke(struct spa_loop *loop,
-	    spa_invoke_func_t func,
-	    uint32_t seq,
-	    const void *data,
-	    size_t size,
-	    bool block,
-	    void *user_data)
+loop_queue(struct impl *impl,
+	   spa_invoke_func_t func,
+	   uint32_t seq,
+	   const void *data,
+	   size_t size,
+	   void *user_data,
+	   struct spa_loop_completion *completion)
 {
-	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
-	bool in_thread = pthread_equal(impl->thread, pthread_self());
 	struct invoke_item *item;
-	int res;
-
-	if (in_thread) {
-		res = func(loop, false, seq, data, size, user_data);
-	} else {
-		int32_t filled, avail;
-		uint32_t idx, offset, l0;
-
-		filled = spa_ringbuffer_get_write_index(&impl->buffer, &idx);
+	int32_t filled, avail;
+	uint32_t idx, offset, l0, item_size;
+	void *item_data;
+
+	/* other threads can invoke at the same time, claim space for
+	 * the item first and retry when an other thread was faster */
+	do {
+		filled = spa_mpsc_ringbuffer_get_write_index(&impl->buffer, &idx);
 		if (filled < 0 || filled > DATAS_SIZE) {
 			spa_log_warn(impl->log, NAME " %p: queue xrun %d", impl, filled);
 			return -EPIPE;
 		}
 		avail = DATAS_SIZE - filled;
-		if (avail < sizeof(struct invoke_item)) {
-			spa_log_warn(impl->log, NAME " %p: queue full %d", impl, avail);
-			return -EPIPE;
-		}
 		offset = idx & (DATAS_SIZE - 1);
 
 		l0 = DATAS_SIZE - offset;
 
-		item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
-		item->func = func;
-		item->seq = seq;
-		item->size = size;
-		item->block = block;
-		item->user_data = user_data;
-
 		if (l0 > sizeof(struct invoke_item) + size) {
-			item->data = SPA_MEMBER(item, sizeof(struct invoke_item), void);
-			item->item_size = sizeof(struct invoke_item) + size;
-			if (l0 < sizeof(struct invoke_item) + item->item_size)
-				item->item_size = l0;
+			item_data = SPA_MEMBER(impl->buffer_data,
+					offset + sizeof(struct invoke_item), void);
+			item_size = sizeof(struct invoke_item) + size;
+			if (l0 < sizeof(struct invoke_item) + item_size)
+				item_size = l0;
 		} else {
-			item->data = impl->buffer_data;
-			item->item_size = l0 + size;
+			item_data = impl->buffer_data;
+			item_size = l0 + size;
+		}
+		if (avail < item_size) {
+			spa_log_warn(impl->log, NAME " %p: queue full %d", impl, avail);
+			return -EPIPE;
 		}
-		memcpy(item->data, data, size);
+	} while (!spa_mpsc_ringbuffer_write_reserve(&impl->buffer, idx, item_size));
 
-		spa_ringbuffer_write_update(&impl->buffer, idx + item->item_size);
+	item = SPA_MEMBER(impl->buffer_data, offset, struct invoke_item);
+	item->func = func;
+	item->seq = seq;
+	item->size = size;
+	item->completion = completion;
+	item->user_data = user_data;
+	item->data = item_data;
+	item->item_size = item_size;
+	memcpy(item->data, data, size);
 
+	spa_mpsc_ringbuffer_write_commit(&impl->buffer, item_size);
+
+	return 0;
+}
+
+/* signal the loop, the event fd is only written when the loop did not
+ * start draining the queue since the last signal */
+static void loop_wakeup(struct impl *impl)
+{
+	if (!__atomic_exchange_n(&impl->wakeup_pending, true, __ATOMIC_SEQ_CST))
 		spa_loop_utils_signal_event(&impl->utils, impl->wakeup);
+}
 
-		if (block) {
-			uint64_t count = 1;
+static void complete(struct spa_loop_completion *completion, int res)
+{
+	if (res != 0)
+		__atomic_store_n(&completion->res, res, __ATOMIC_RELAXED);
+	if (__atomic_sub_fetch(&completion->pending, 1, __ATOMIC_RELEASE) == 0)
+		syscall(SYS_futex, &completion->pending, FUTEX_WAKE_PRIVATE, INT_MAX,
+			NULL, NULL, 0);
+}
 
-			spa_loop_control_hook_before(&impl->hooks_list);
+static int
+loop_invoke_queue(struct spa_loop *loop,
+		  spa_invoke_func_t func,
+		  uint32_t seq,
+		  const void *data,
+		  size_t size,
+		  void *user_data,
+		  struct spa_loop_completion *completion)
+{
+	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
+	int res;
 
-			if (read(impl->ack_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-				spa_log_warn(impl->log, NAME " %p: failed to read event fd: %s",
-						impl, strerror(errno));
+	if (pthread_equal(impl->thread, pthread_self())) {
+		res = func(loop, false, seq, data, size, user_data);
+		if (completion && res != 0)
+			completion->res = res;
+		return res;
+	}
 
-			spa_loop_control_hook_after(&impl->hooks_list);
+	if (completion)
+		__atomic_add_fetch(&completion->pending, 1, __ATOMIC_RELAXED);
 
-			res = item->res;
-		}
-		else {
-			if (seq != SPA_ID_INVALID)
-				res = SPA_RESULT_RETURN_ASYNC(seq);
-			else
-				res = 0;
-		}
+	if ((res = loop_queue(impl, func, seq, data, size, user_data, completion)) < 0) {
+		if (completion)
+			__atomic_sub_fetch(&completion->pending, 1, __ATOMIC_RELAXED);
+		return res;
 	}
-	return res;
+	loop_wakeup(impl);
+
+	return seq != SPA_ID_INVALID ? SPA_RESULT_RETURN_ASYNC(seq) : 0;
+}
+
+static int
+loop_invoke_wait(struct spa_loop *loop, struct spa_loop_completion *completion)
+{
+	struct impl *impl = SPA_CONTAINER_OF(loop, struct impl, loop);
+	int32_t pending;
+
+	if ((pending = __atomic_load_n(&completion->pending, __ATOMIC_ACQUIRE)) == 0)
+		return completion->res;
+
+	spa_loop_control_hook_before(&impl->hooks_list);
+
+	while (pending != 0) {
+		if (syscall(SYS_futex, &completion->pending, FUTEX_WAIT_PRIVATE, pending,
+			    NULL, NULL, 0) < 0 && errno != EAGAIN && errno != EINTR)
+			spa_log_warn(impl->log, NAME " %p: failed to wait: %s",
+					impl, strerror(errno));
+		pending = __atomic_load_n(&completion->pending, __ATOMIC_ACQUIRE);
+	}
+
+	spa_loop_control_hook_after(&impl->hooks_list);
+
+	return completion->res;
+}
+
+static int
+loop_invoke(struct spa_loop *loop,
+	    spa_invoke_func_t func,
+	    uint32_t seq,
+	    const void *data,
+	    size_t size,
+	    bool block,
+	    void *user_data)
+{
+	struct spa_loop_completion completion = SPA_LOOP_COMPLETION_INIT;
+	int res;
+
+	if (!block)
+		return loop_invoke_queue(loop, func, seq, data, size, user_data, NULL);
+
+	if ((res = loop_invoke_queue(loop, func, seq, data, size, user_data, &completion)) < 0)
+		return res;
+
+	return loop_invoke_wait(loop, &completion);
 }
 
 static void wakeup_func(void *data, uint64_t count)
 {
 	struct impl *impl = data;
 	uint32_t index;
-	while (spa_ringbuffer_get_read_index(&impl->buffer, &index) > 0) {
+
+	__atomic_store_n(&impl->wakeup_pending, false, __ATOMIC_SEQ_CST);
+
+	while (spa_mpsc_ringbuffer_get_read_index(&impl->buffer, &index) > 0) {
 		struct invoke_item *item =
 		    SPA_MEMBER(impl->buffer_data, index & (DATAS_SIZE - 1), struct invoke_item);
-		item->res = item->func(&impl->loop, true, item->seq, item->data, item->size,
+		struct spa_loop_completion *completion = item->completion;
+		int res;
+
+		res = item->func(&impl->loop, true, item->seq, item->data, item->size,
 			   item->user_data);
-		spa_ringbuffer_read_update(&impl->buffer, index + item->item_size);
+		/* the item can be reused after this */
+		spa_mpsc_ringbuffer_read_update(&impl->buffer, index + item->item_size);
 
-		if (item->block) {
-			uint64_t count = 1;
-			if (write(impl->ack_fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
-				spa_log_warn(impl->log, NAME " %p: failed to write event fd: %s",
-						impl, strerror(errno));
-		}
+		if (completion)
+			complete(completion, res);
 	}
 }
 
@@ -294,6 +609,15 @@ static int loop_get_fd(struct spa_loop_control *ctrl)
 {
 	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
 
+#ifdef HAVE_IO_URING
+	if (impl->use_uring) {
+		/* the ring fd is readable when there are completions, the
+		 * requests must then be submitted before returning from
+		 * iterate */
+		impl->ring_exported = true;
+		return impl->ring.fd;
+	}
+#endif
 	return impl->epoll_fd;
 }
 
@@ -328,12 +652,132 @@ static void process_destroy(struct impl *impl)
 	spa_list_init(&impl->destroy_list);
 }
 
+#ifdef HAVE_IO_URING
+static int uring_iterate(struct impl *impl, int timeout)
+{
+	struct spa_loop *loop = &impl->loop;
+	struct {
+		struct spa_source *source;
+		struct uring_slot *slot;
+		uint32_t gen;
+		bool rearm;
+	} ready[32];
+	struct io_uring_cqe *cqe;
+	uint32_t to_submit;
+	int i, n_ready = 0, n_dispatched = 0, res;
+
+	/* the polls that were rearmed after the previous dispatch are submitted
+	 * together with the wait */
+	pthread_mutex_lock(&impl->ring_lock);
+	to_submit = uring_publish(&impl->ring);
+	pthread_mutex_unlock(&impl->ring_lock);
+
+	spa_loop_control_hook_before(&impl->hooks_list);
+
+	res = uring_enter(&impl->ring, to_submit, true, timeout);
+
+	spa_loop_control_hook_after(&impl->hooks_list);
+
+	if (SPA_UNLIKELY(res < 0 && res != -ETIME))
+		return res == -EINTR ? 0 : res;
+
+	pthread_mutex_lock(&impl->ring_lock);
+	while (n_ready < SPA_N_ELEMENTS(ready) &&
+	       (cqe = uring_peek_cqe(&impl->ring)) != NULL) {
+		uint64_t data = cqe->user_data;
+		int32_t result = cqe->res;
+		struct uring_slot *slot;
+		struct spa_source *s;
+		uint32_t gen = data >> 32;
+		int fd = (uint32_t) data;
+
+		uring_cqe_seen(&impl->ring);
+
+		if (data == URING_IGNORE)
+			continue;
+
+		slot = impl->slots[fd];
+		slot->pending--;
+		if (slot->gen != gen || slot->source == NULL)
+			continue;
+
+		slot->armed = false;
+		s = slot->source;
+
+		if (result == -ECANCELED) {
+			/* we only cancel old generations, the kernel cancels the
+			 * requests of a thread that exits */
+			uring_arm(impl, fd, slot);
+			continue;
+		}
+		if (slot->read) {
+			struct source_impl *si;
+
+			if (result != sizeof(uint64_t)) {
+				/* fall back to polling and reading the fd */
+				spa_log_warn(impl->log, NAME " %p: failed to read fd %d: %s",
+						impl, fd, strerror(result < 0 ? -result : EIO));
+				slot->read = false;
+				uring_arm(impl, fd, slot);
+				continue;
+			}
+			si = SPA_CONTAINER_OF(s, struct source_impl, source);
+			si->count = slot->value;
+			si->have_count = true;
+			s->rmask = SPA_IO_IN;
+		} else if (result < 0) {
+			s->rmask = SPA_IO_ERR;
+		} else {
+			s->rmask = spa_epoll_to_io(result);
+		}
+		ready[n_ready].source = s;
+		ready[n_ready].slot = slot;
+		ready[n_ready].gen = gen;
+		ready[n_ready].rearm = result >= 0;
+		n_ready++;
+	}
+	pthread_mutex_unlock(&impl->ring_lock);
+
+	/* all the rmasks are set, now dispatch like with epoll */
+	for (i = 0; i < n_ready; i++) {
+		struct spa_source *s = ready[i].source;
+		if (s->rmask && s->fd != -1 && s->loop == loop) {
+			s->func(s);
+			n_dispatched++;
+		}
+	}
+
+	/* requests are one-shot, rearm the slots that were not removed, updated
+	 * or rearmed from the callbacks. The fd is polled again, which keeps the
+	 * level triggered semantics of epoll. */
+	pthread_mutex_lock(&impl->ring_lock);
+	for (i = 0; i < n_ready; i++) {
+		struct uring_slot *slot = ready[i].slot;
+		if (ready[i].rearm && !slot->armed &&
+		    slot->gen == ready[i].gen && slot->source == ready[i].source)
+			uring_arm(impl, slot->source->fd, slot);
+	}
+	if (impl->ring_exported)
+		uring_enter(&impl->ring, uring_publish(&impl->ring), false, 0);
+	pthread_mutex_unlock(&impl->ring_lock);
+
+	process_destroy(impl);
+
+	return n_dispatched;
+}
+#endif
+
 static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
 {
 	struct impl *impl = SPA_CONTAINER_OF(ctrl, struct impl, control);
 	struct spa_loop *loop = &impl->loop;
 	struct epoll_event ep[32];
-	int i, nfds, save_errno = 0;
+	int i, nfds, n_dispatched = 0, save_errno = 0;
+
+#ifdef HAVE_IO_URING
+	if (impl->use_uring)
+		return uring_iterate(impl, timeout);
+#endif
 
 	spa_loop_control_hook_before(&impl->hooks_list);
 
@@ -343,7 +787,7 @@ static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
 	spa_loop_control_hook_after(&impl->hooks_list);
 
 	if (SPA_UNLIKELY(nfds < 0))
-		return save_errno;
+		return save_errno == EINTR ? 0 : -save_errno;
 
 	/* first we set all the rmasks, then call the callbacks. The reason is that
 	 * some callback might also want to look at other sources it manages and
@@ -354,12 +798,14 @@ static int loop_iterate(struct spa_loop_control *ctrl, int timeout)
 	}
 	for (i = 0; i < nfds; i++) {
 		struct spa_source *s = ep[i].data.ptr;
-		if (s->rmask && s->fd != -1 && s->loop == loop)
+		if (s->rmask && s->fd != -1 && s->loop == loop) {
 			s->func(s);
+			n_dispatched++;
+		}
 	}
 	process_destroy(impl);
 
-	return 0;
+	return n_dispatched;
 }
 
 static void source_io_func(struct spa_source *source)
@@ -456,12 +902,27 @@ static void loop_enable_idle(struct spa_source *source, bool enabled)
 	impl->enabled = enabled;
 }
 
+/* the ring reads event fds asynchronously and returns EAGAIN for
+ * non-blocking fds, they are only read directly after a poll said they
+ * are readable */
+static inline int fd_nonblock(struct impl *impl, int flag)
+{
+#ifdef HAVE_IO_URING
+	if (impl->use_uring)
+		return 0;
+#endif
+	return flag;
+}
+
 static void source_event_func(struct spa_source *source)
 {
 	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
 	uint64_t count;
 
-	if (read(source->fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
+	if (impl->have_count) {
+		count = impl->count;
+		impl->have_count = false;
+	} else if (read(source->fd, &count, sizeof(uint64_t)) != sizeof(uint64_t))
 		spa_log_warn(impl->impl->log, NAME " %p: failed to read event fd %d: %s",
 				source, source->fd, strerror(errno));
 
@@ -481,7 +942,7 @@ static struct spa_source *loop_add_event(struct spa_loop_utils *utils,
 	source->source.loop = &impl->loop;
 	source->source.func = source_event_func;
 	source->source.data = data;
-	source->source.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	source->source.fd = eventfd(0, EFD_CLOEXEC | fd_nonblock(impl, EFD_NONBLOCK));
 	source->source.mask = SPA_IO_IN;
 	source->impl = impl;
 	source->close = true;
@@ -504,16 +965,198 @@ static void loop_signal_event(struct spa_source *source)
 				source, source->fd, strerror(errno));
 }
 
-static void source_timer_func(struct spa_source *source)
+static inline uint64_t get_time_ns(void)
 {
-	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
-	uint64_t expirations;
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_TIME(&now);
+}
 
-	if (read(source->fd, &expirations, sizeof(uint64_t)) != sizeof(uint64_t))
-		spa_log_warn(impl->impl->log, NAME " %p: failed to read timer fd %d: %s",
-				source, source->fd, strerror(errno));
+static void wheel_init(struct timer_wheel *w, uint64_t slack)
+{
+	int i, j;
+
+	w->slack = slack;
+	w->now = get_time_ns() / slack;
+	for (i = 0; i < WHEEL_LEVELS; i++)
+		for (j = 0; j < WHEEL_SIZE; j++)
+			spa_list_init(&w->slots[i][j]);
+}
+
+static void wheel_insert(struct timer_wheel *w, struct source_impl *t)
+{
+	uint64_t tick = SPA_MAX(t->timer_tick, w->now);
+	int level, shift = 0, slot;
+
+	/* the lowest level where the tick is in the current round of the
+	 * level above, the slots of that level between now and the tick
+	 * are then processed before the timer expires */
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		shift = level * WHEEL_BITS;
+		if ((tick >> (shift + WHEEL_BITS)) == (w->now >> (shift + WHEEL_BITS)))
+			break;
+	}
+	if (level == WHEEL_LEVELS) {
+		level = WHEEL_LEVELS - 1;
+		/* too far away, put it in the last slot. It is inserted
+		 * again when that slot is reached */
+		if ((tick >> shift) - (w->now >> shift) >= WHEEL_SIZE)
+			tick = ((w->now >> shift) + WHEEL_MASK) << shift;
+	}
+	slot = (tick >> shift) & WHEEL_MASK;
+
+	spa_list_append(&w->slots[level][slot], &t->timer_link);
+	w->bitmap[level] |= 1ULL << slot;
+	t->timer_armed = true;
+}
+
+static void wheel_remove(struct timer_wheel *w, struct source_impl *t)
+{
+	struct spa_list *head = t->timer_link.next;
+
+	spa_list_remove(&t->timer_link);
+	t->timer_armed = false;
+
+	/* the slot is empty when the link was the only one in it, find the
+	 * slot from the list head and clear its bit. The head is not in the
+	 * wheel when the timer was being dispatched */
+	if (head == t->timer_link.prev && head->next == head) {
+		int level;
+		for (level = 0; level < WHEEL_LEVELS; level++) {
+			if (head >= &w->slots[level][0] && head <= &w->slots[level][WHEEL_MASK]) {
+				w->bitmap[level] &= ~(1ULL << (head - &w->slots[level][0]));
+				break;
+			}
+		}
+	}
+}
+
+/* the first tick where a slot needs to be processed, UINT64_MAX when
+ * there are no timers */
+static uint64_t wheel_next(struct timer_wheel *w)
+{
+	uint64_t next = UINT64_MAX;
+	int level;
+
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		int shift = level * WHEEL_BITS;
+		uint64_t bits = w->bitmap[level], tick;
+		uint32_t idx = (w->now >> shift) & WHEEL_MASK;
+
+		if (bits == 0)
+			continue;
+
+		bits = (bits >> idx) | (idx ? bits << (WHEEL_SIZE - idx) : 0);
+		tick = ((w->now >> shift) + __builtin_ctzll(bits)) << shift;
+		next = SPA_MIN(next, SPA_MAX(tick, w->now));
+	}
+	return next;
+}
+
+static void wheel_take_slot(struct timer_wheel *w, int level, int slot, struct spa_list *list)
+{
+	struct spa_list *head = &w->slots[level][slot];
+
+	if (spa_list_is_empty(head))
+		return;
+
+	spa_list_insert_list(list, head);
+	spa_list_init(head);
+	w->bitmap[level] &= ~(1ULL << slot);
+}
+
+static void wheel_arm(struct impl *impl)
+{
+	struct timer_wheel *w = &impl->wheel;
+	struct itimerspec its;
+	uint64_t next, time;
+
+	next = wheel_next(w);
+	if (next == w->armed || (next == UINT64_MAX && w->armed == 0))
+		return;
+
+	spa_zero(its);
+	if (next != UINT64_MAX) {
+		time = SPA_MAX(next * w->slack, 1ULL);
+		its.it_value.tv_sec = time / SPA_NSEC_PER_SEC;
+		its.it_value.tv_nsec = time % SPA_NSEC_PER_SEC;
+	}
+	if (timerfd_settime(impl->timer->fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+		spa_log_warn(impl->log, NAME " %p: failed to set timer fd %d: %s",
+				impl, impl->timer->fd, strerror(errno));
 
-	impl->func.timer(source->data, expirations);
+	w->armed = next == UINT64_MAX ? 0 : next;
+}
+
+static void wheel_io_func(void *data, int fd, enum spa_io mask)
+{
+	struct impl *impl = data;
+	struct timer_wheel *w = &impl->wheel;
+	uint64_t expirations, time, target, next;
+	struct source_impl *t;
+	struct spa_list list;
+	int level;
+
+	if (read(fd, &expirations, sizeof(uint64_t)) != sizeof(uint64_t) && errno != EAGAIN)
+		spa_log_warn(impl->log, NAME " %p: failed to read timer fd %d: %s",
+				impl, fd, strerror(errno));
+
+	w->armed = 0;
+	time = get_time_ns();
+	target = time / w->slack;
+
+	while ((next = wheel_next(w)) <= target) {
+		w->now = next;
+
+		/* move the timers of the higher levels down, starting from
+		 * the top so that they end up in level 0 when they expire
+		 * in this tick */
+		for (level = WHEEL_LEVELS - 1; level > 0; level--) {
+			int shift = level * WHEEL_BITS;
+			int slot = (w->now >> shift) & WHEEL_MASK;
+
+			spa_list_init(&list);
+			wheel_take_slot(w, level, slot, &list);
+			while (!spa_list_is_empty(&list)) {
+				t = spa_list_first(&list, struct source_impl, timer_link);
+				spa_list_remove(&t->timer_link);
+				wheel_insert(w, t);
+			}
+		}
+		spa_list_init(&list);
+		wheel_take_slot(w, 0, w->now & WHEEL_MASK, &list);
+		w->now++;
+
+		/* callbacks can update or destroy any timer in the list, they
+		 * are then removed from it with wheel_remove() */
+		while (!spa_list_is_empty(&list)) {
+			t = spa_list_first(&list, struct source_impl, timer_link);
+			spa_list_remove(&t->timer_link);
+			t->timer_armed = false;
+
+			if (t->timer_interval) {
+				expirations = 1 + (time - SPA_MIN(time, t->timer_expire)) /
+					t->timer_interval;
+				t->timer_expire += expirations * t->timer_interval;
+				t->timer_tick = (t->timer_expire + w->slack - 1) / w->slack;
+				wheel_insert(w, t);
+			} else
+				expirations = 1;
+
+			t->count = expirations;
+			t->source.func(&t->source);
+		}
+	}
+	if (w->now <= target)
+		w->now = target + 1;
+
+	wheel_arm(impl);
+}
+
+static void source_timer_func(struct spa_source *source)
+{
+	struct source_impl *impl = SPA_CONTAINER_OF(source, struct source_impl, source);
+	impl->func.timer(source->data, impl->count);
 }
 
 static struct spa_source *loop_add_timer(struct spa_loop_utils *utils,
@@ -522,47 +1165,75 @@ static struct spa_source *loop_add_timer(struct spa_loop_utils *utils,
 	struct impl *impl = SPA_CONTAINER_OF(utils, struct impl, utils);
 	struct source_impl *source;
 
+	if (impl->timer == NULL) {
+		int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+		if (fd == -1)
+			return NULL;
+		impl->timer = spa_loop_utils_add_io(utils, fd, SPA_IO_IN, true, wheel_io_func, impl);
+		if (impl->timer == NULL) {
+			close(fd);
+			return NULL;
+		}
+	}
+
 	source = calloc(1, sizeof(struct source_impl));
 	if (source == NULL)
 		return NULL;
 
+	/* timers have no fd, they are all in the wheel of the loop */
 	source->source.loop = &impl->loop;
 	source->source.func = source_timer_func;
 	source->source.data = data;
-	source->source.fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+	source->source.fd = -1;
 	source->source.mask = SPA_IO_IN;
 	source->impl = impl;
 	source->close = true;
 	source->func.timer = func;
 
-	spa_loop_add_source(&impl->loop, &source->source);
-
 	spa_list_insert(&impl->source_list, &source->link);
 
 	return &source->source;
 }
 
+/* this changes the wheel, which is only used from the loop thread, so it
+ * must not run concurrently with loop_iterate() */
 static int
 loop_update_timer(struct spa_source *source,
 		  struct timespec *value, struct timespec *interval, bool absolute)
 {
-	struct itimerspec its;
-	int flags = 0;
+	struct source_impl *s = SPA_CONTAINER_OF(source, struct source_impl, source);
+	struct impl *impl = s->impl;
+	struct timer_wheel *w = &impl->wheel;
+	uint64_t expire = 0;
 
-	spa_zero(its);
+	if (s->timer_armed)
+		wheel_remove(w, s);
+
+	/* same as timerfd_settime() */
 	if (value) {
-		its.it_value = *value;
+		expire = SPA_TIMESPEC_TO_TIME(value);
 	} else if (interval) {
-		its.it_value = *interval;
+		expire = SPA_TIMESPEC_TO_TIME(interval);
 		absolute = true;
 	}
-	if (interval)
-		its.it_interval = *interval;
-	if (absolute)
-		flags |= TFD_TIMER_ABSTIME;
-
-	if (timerfd_settime(source->fd, flags, &its, NULL) < 0)
-		return errno;
+	s->timer_interval = interval ? SPA_TIMESPEC_TO_TIME(interval) : 0;
+
+	if (expire != 0) {
+		uint64_t now = get_time_ns();
+
+		/* an empty wheel can skip the ticks that passed */
+		if (w->armed == 0 && wheel_next(w) == UINT64_MAX)
+			w->now = SPA_MAX(w->now, now / w->slack);
+		if (!absolute)
+			expire += now;
+		s->timer_expire = expire;
+		s->timer_tick = (expire + w->slack - 1) / w->slack;
+		wheel_insert(w, s);
+	}
+	/* only arm when the timer expires before the current wakeup, a
+	 * removed timer causes at most one wakeup without work */
+	if (s->timer_armed && (w->armed == 0 || wheel_next(w) < w->armed))
+		wheel_arm(impl);
 
 	return 0;
 }
@@ -621,6 +1292,9 @@ static void loop_destroy_source(struct spa_source *source)
 
 	spa_list_remove(&impl->link);
 
+	if (impl->timer_armed)
+		wheel_remove(&impl->impl->wheel, impl);
+
 	if (source->loop)
 		spa_loop_remove_source(source->loop, source);
 
@@ -637,6 +1311,8 @@ static const struct spa_loop impl_loop = {
 	loop_update_source,
 	loop_remove_source,
 	loop_invoke,
+	loop_invoke_queue,
+	loop_invoke_wait,
 };
 
 static const struct spa_loop_control impl_loop_control = {
@@ -687,6 +1363,9 @@ static int impl_clear(struct spa_handle *handle)
 {
 	struct impl *impl;
 	struct source_impl *source, *tmp;
+#ifdef HAVE_IO_URING
+	uint32_t i;
+#endif
 
 	spa_return_val_if_fail(handle != NULL, -EINVAL);
 
@@ -697,7 +1376,17 @@ static int impl_clear(struct spa_handle *handle)
 
 	process_destroy(impl);
 
-	close(impl->ack_fd);
+#ifdef HAVE_IO_URING
+	if (impl->use_uring) {
+		/* closing the ring cancels the outstanding requests */
+		uring_clear(&impl->ring);
+		for (i = 0; i < impl->n_slots; i++)
+			free(impl->slots[i]);
+		free(impl->slots);
+		pthread_mutex_destroy(&impl->ring_lock);
+		return 0;
+	}
+#endif
 	close(impl->epoll_fd);
 
 	return 0;
@@ -711,6 +1400,8 @@ impl_init(const struct spa_handle_factory *factory,
 	  uint32_t n_support)
 {
 	struct impl *impl;
+	const char *backend = NULL;
+	uint64_t slack = DEFAULT_TIMER_SLACK;
 	uint32_t i;
 
 	spa_return_val_if_fail(factory != NULL, -EINVAL);
@@ -736,20 +1427,53 @@ impl_init(const struct spa_handle_factory *factory,
 	}
 	init_type(&impl->type, impl->map);
 
-	impl->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
-	if (impl->epoll_fd == -1)
-		return errno;
+	for (i = 0; info && i < info->n_items; i++) {
+		if (strcmp(info->items[i].key, "loop.backend") == 0)
+			backend = info->items[i].value;
+		else if (strcmp(info->items[i].key, "loop.timer-slack") == 0)
+			slack = SPA_MAX(strtoull(info->items[i].value, NULL, 10), 1ULL);
+	}
+
+	impl->epoll_fd = -1;
+	if (backend && strcmp(backend, "io_uring") == 0) {
+#ifdef HAVE_IO_URING
+		int res;
+
+		if ((res = uring_init(&impl->ring, URING_ENTRIES)) < 0) {
+			spa_log_warn(impl->log, NAME " %p: can't use io_uring, using epoll: %s",
+					impl, strerror(-res));
+		} else {
+			pthread_mutex_init(&impl->ring_lock, NULL);
+			impl->use_uring = true;
+		}
+#else
+		spa_log_warn(impl->log, NAME " %p: io_uring not supported, using epoll", impl);
+#endif
+	} else if (backend && strcmp(backend, "epoll") != 0) {
+		spa_log_warn(impl->log, NAME " %p: unknown backend %s, using epoll",
+				impl, backend);
+	}
+
+#ifdef HAVE_IO_URING
+	if (!impl->use_uring)
+#endif
+	{
+		impl->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (impl->epoll_fd == -1)
+			return errno;
+	}
 
 	spa_list_init(&impl->source_list);
 	spa_list_init(&impl->destroy_list);
 	spa_hook_list_init(&impl->hooks_list);
 
-	spa_ringbuffer_init(&impl->buffer);
+	spa_mpsc_ringbuffer_init(&impl->buffer);
+	wheel_init(&impl->wheel, slack);
 
 	impl->wakeup = spa_loop_utils_add_event(&impl->utils, wakeup_func, impl);
-	impl->ack_fd = eventfd(0, EFD_SEMAPHORE | EFD_CLOEXEC);
 
-	spa_log_debug(impl->log, NAME " %p: initialized", impl);
+	spa_log_debug(impl->log, NAME " %p: initialized with %s", impl,
+			impl->epoll_fd == -1 ? "io_uring" : "epoll");
 
 	return 0;
 }
@@ -18,6 +18,7 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
@@ -52,8 +53,60 @@ struct impl {
 
 	struct array types;
 	struct array strings;
+
+	/* open addressing hash table with the id + 1 of the types,
+	 * 0 is an empty slot */
+	uint32_t *hash;
+	uint32_t hash_size;
 };
 
+#define HASH_MIN_SIZE	512
+
+static inline uint32_t hash_string(const char *str)
+{
+	/* FNV-1a */
+	uint32_t h = 2166136261u;
+	while (*str)
+		h = (h ^ (uint8_t) *str++) * 16777619u;
+	return h;
+}
+
+static inline const char *get_type(struct impl *impl, uint32_t id)
+{
+	off_t o = ((off_t *)impl->types.data)[id];
+	return SPA_MEMBER(impl->strings.data, o, char);
+}
+
+static inline void hash_insert(uint32_t *hash, uint32_t hash_size, uint32_t h, uint32_t id)
+{
+	uint32_t mask = hash_size - 1, i;
+
+	for (i = h & mask; hash[i] != 0; i = (i + 1) & mask);
+	hash[i] = id + 1;
+}
+
+/* make room for \a n_types, keep the table at most half full */
+static int hash_ensure_size(struct impl *impl, uint32_t n_types)
+{
+	uint32_t size, i, *hash;
+
+	if (n_types * 2 <= impl->hash_size)
+		return 0;
+
+	size = impl->hash_size ? impl->hash_size * 2 : HASH_MIN_SIZE;
+	if ((hash = calloc(size, sizeof(uint32_t))) == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < impl->types.size / sizeof(off_t); i++)
+		hash_insert(hash, size, hash_string(get_type(impl, i)), i);
+
+	free(impl->hash);
+	impl->hash = hash;
+	impl->hash_size = size;
+
+	return 0;
+}
+
 static inline void * alloc_size(struct array *array, size_t size, size_t extend)
 {
 	void *res;
@@ -70,18 +123,27 @@ static uint32_t
 impl_type_map_get_id(struct spa_type_map *map, const char *type)
 {
 	struct impl *impl = SPA_CONTAINER_OF(map, struct impl, map);
-	uint32_t i, len;
+	uint32_t i, len, h, mask;
 	void *p;
-	off_t o, *off;
+	off_t *off;
 
 	if (type == NULL)
 		return SPA_ID_INVALID;
 
-	for (i = 0; i < impl->types.size / sizeof(off_t); i++) {
-		o = ((off_t *)impl->types.data)[i];
-		if (strcmp(SPA_MEMBER(impl->strings.data, o, char), type) == 0)
-			return i;
+	h = hash_string(type);
+	mask = impl->hash_size - 1;
+
+	if (impl->hash_size > 0) {
+		for (i = h & mask; impl->hash[i] != 0; i = (i + 1) & mask) {
+			uint32_t id = impl->hash[i] - 1;
+			if (strcmp(get_type(impl, id), type) == 0)
+				return id;
+		}
 	}
+
+	if (hash_ensure_size(impl, impl->types.size / sizeof(off_t) + 1) < 0)
+		return SPA_ID_INVALID;
+
 	len = strlen(type);
 	p = alloc_size(&impl->strings, len+1, 1024);
 	memcpy(p, type, len + 1);
@@ -90,6 +152,8 @@ impl_type_map_get_id(struct spa_type_map *map, const char *type)
 	*off = SPA_PTRDIFF(p, impl->strings.data);
 	i = SPA_PTRDIFF(off, impl->types.data) / sizeof(off_t);
 
+	hash_insert(impl->hash, impl->hash_size, h, i);
+
 	return i;
 
 }
@@ -99,10 +163,8 @@ impl_type_map_get_type(const struct spa_type_map *map, uint32_t id)
 {
 	struct impl *impl = SPA_CONTAINER_OF(map, struct impl, map);
 
-	if (id < impl->types.size / sizeof(off_t)) {
-		off_t o = ((off_t *)impl->types.data)[id];
-		return SPA_MEMBER(impl->strings.data, o, char);
-	}
+	if (id < impl->types.size / sizeof(off_t))
+		return get_type(impl, id);
 	return NULL;
 }
 
@@ -150,6 +212,7 @@ static int impl_clear(struct spa_handle *handle)
 		free(impl->types.data);
 	if (impl->strings.data)
 		free(impl->strings.data);
+	free(impl->hash);
 
 	return 0;
 }
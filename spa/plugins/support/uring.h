@@ -0,0 +1,207 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __SPA_SUPPORT_URING_H__
+#define __SPA_SUPPORT_URING_H__
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/io_uring.h>
+
+/* a minimal io_uring wrapper on top of the raw syscalls. It is not thread
+ * safe, the caller must serialize access to the submission queue. */
+struct uring {
+	int fd;
+	uint32_t features;
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	uint32_t *sq_head;
+	uint32_t *sq_tail;
+	uint32_t sq_mask;
+	uint32_t *sq_array;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	uint32_t sqe_tail;		/* tail of the prepared but unpublished sqes */
+
+	void *cq_ring;
+	size_t cq_ring_size;
+	uint32_t *cq_head;
+	uint32_t *cq_tail;
+	uint32_t cq_mask;
+	struct io_uring_cqe *cqes;
+};
+
+static inline void uring_clear(struct uring *r)
+{
+	if (r->sqes)
+		munmap(r->sqes, r->sqes_size);
+	if (r->cq_ring && r->cq_ring != r->sq_ring)
+		munmap(r->cq_ring, r->cq_ring_size);
+	if (r->sq_ring)
+		munmap(r->sq_ring, r->sq_ring_size);
+	if (r->fd != -1)
+		close(r->fd);
+	memset(r, 0, sizeof(*r));
+	r->fd = -1;
+}
+
+/* make a ring, the kernel must complete without dropping events and
+ * must support a timeout when waiting for completions */
+static inline int uring_init(struct uring *r, uint32_t entries)
+{
+	struct io_uring_params p;
+	int res;
+
+	memset(r, 0, sizeof(*r));
+	memset(&p, 0, sizeof(p));
+
+	if ((r->fd = syscall(__NR_io_uring_setup, entries, &p)) < 0) {
+		r->fd = -1;
+		return -errno;
+	}
+	r->features = p.features;
+	if ((p.features & (IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG)) !=
+	    (IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG)) {
+		res = -ENOTSUP;
+		goto error;
+	}
+
+	r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	r->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		r->sq_ring_size = r->cq_ring_size = SPA_MAX(r->sq_ring_size, r->cq_ring_size);
+
+	r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	if (r->sq_ring == MAP_FAILED) {
+		r->sq_ring = NULL;
+		res = -errno;
+		goto error;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		r->cq_ring = r->sq_ring;
+	} else {
+		r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE,
+				  MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+		if (r->cq_ring == MAP_FAILED) {
+			r->cq_ring = NULL;
+			res = -errno;
+			goto error;
+		}
+	}
+	r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		r->sqes = NULL;
+		res = -errno;
+		goto error;
+	}
+
+	r->sq_head = SPA_MEMBER(r->sq_ring, p.sq_off.head, uint32_t);
+	r->sq_tail = SPA_MEMBER(r->sq_ring, p.sq_off.tail, uint32_t);
+	r->sq_mask = *SPA_MEMBER(r->sq_ring, p.sq_off.ring_mask, uint32_t);
+	r->sq_array = SPA_MEMBER(r->sq_ring, p.sq_off.array, uint32_t);
+	r->sqe_tail = *r->sq_tail;
+
+	r->cq_head = SPA_MEMBER(r->cq_ring, p.cq_off.head, uint32_t);
+	r->cq_tail = SPA_MEMBER(r->cq_ring, p.cq_off.tail, uint32_t);
+	r->cq_mask = *SPA_MEMBER(r->cq_ring, p.cq_off.ring_mask, uint32_t);
+	r->cqes = SPA_MEMBER(r->cq_ring, p.cq_off.cqes, struct io_uring_cqe);
+
+	return 0;
+
+      error:
+	uring_clear(r);
+	return res;
+}
+
+/* get a free sqe or NULL when the submission queue is full */
+static inline struct io_uring_sqe *uring_get_sqe(struct uring *r)
+{
+	uint32_t head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+	struct io_uring_sqe *sqe;
+
+	if (r->sqe_tail - head > r->sq_mask)
+		return NULL;
+
+	sqe = &r->sqes[r->sqe_tail & r->sq_mask];
+	r->sq_array[r->sqe_tail & r->sq_mask] = r->sqe_tail & r->sq_mask;
+	r->sqe_tail++;
+
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+/* make the prepared sqes visible to the kernel, returns the number of
+ * sqes that still need to be submitted */
+static inline uint32_t uring_publish(struct uring *r)
+{
+	__atomic_store_n(r->sq_tail, r->sqe_tail, __ATOMIC_RELEASE);
+	return r->sqe_tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+}
+
+/* submit sqes and optionally wait for a completion. A negative timeout
+ * waits forever. */
+static inline int uring_enter(struct uring *r, uint32_t to_submit, bool wait, int timeout)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	int res;
+
+	if (!wait) {
+		if (to_submit == 0)
+			return 0;
+		res = syscall(__NR_io_uring_enter, r->fd, to_submit, 0, 0, NULL, 0);
+	} else {
+		memset(&arg, 0, sizeof(arg));
+		if (timeout >= 0) {
+			ts.tv_sec = timeout / 1000;
+			ts.tv_nsec = (timeout % 1000) * 1000000LL;
+			arg.ts = (uint64_t)(uintptr_t) &ts;
+		}
+		res = syscall(__NR_io_uring_enter, r->fd, to_submit, 1,
+			      IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+			      &arg, sizeof(arg));
+	}
+	return res < 0 ? -errno : res;
+}
+
+/* get the next completion or NULL, release it with uring_cqe_seen() */
+static inline struct io_uring_cqe *uring_peek_cqe(struct uring *r)
+{
+	uint32_t head = *r->cq_head;
+
+	if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	return &r->cqes[head & r->cq_mask];
+}
+
+static inline void uring_cqe_seen(struct uring *r)
+{
+	__atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+#endif /* __SPA_SUPPORT_URING_H__ */
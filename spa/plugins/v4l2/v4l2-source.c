@@ -539,13 +539,31 @@ static int impl_node_port_enum_params(struct spa_node *node,
 		if (*index > 0)
 			return 0;
 
-		param = spa_pod_builder_object(&b,
-			id, t->param_buffers.Buffers,
-			":", t->param_buffers.size,    "i", port->fmt.fmt.pix.sizeimage,
-			":", t->param_buffers.stride,  "i", port->fmt.fmt.pix.bytesperline,
-			":", t->param_buffers.buffers, "iru", MAX_BUFFERS,
-				SPA_POD_PROP_MIN_MAX(2, MAX_BUFFERS),
-			":", t->param_buffers.align,   "i", 16);
+		/* exported dmabufs first, then importing memfd with userptr
+		 * and last the mmaped memory */
+		if (port->export_buf)
+			param = spa_pod_builder_object(&b,
+				id, t->param_buffers.Buffers,
+				":", t->param_buffers.size,     "i", port->fmt.fmt.pix.sizeimage,
+				":", t->param_buffers.stride,   "i", port->fmt.fmt.pix.bytesperline,
+				":", t->param_buffers.buffers,  "iru", MAX_BUFFERS,
+					SPA_POD_PROP_MIN_MAX(2, MAX_BUFFERS),
+				":", t->param_buffers.align,    "i", 16,
+				":", t->param_buffers.dataType, "Ieu", t->data.DmaBuf,
+					SPA_POD_PROP_ENUM(3, t->data.DmaBuf,
+							     t->data.MemFd,
+							     t->data.MemPtr));
+		else
+			param = spa_pod_builder_object(&b,
+				id, t->param_buffers.Buffers,
+				":", t->param_buffers.size,     "i", port->fmt.fmt.pix.sizeimage,
+				":", t->param_buffers.stride,   "i", port->fmt.fmt.pix.bytesperline,
+				":", t->param_buffers.buffers,  "iru", MAX_BUFFERS,
+					SPA_POD_PROP_MIN_MAX(2, MAX_BUFFERS),
+				":", t->param_buffers.align,    "i", 16,
+				":", t->param_buffers.dataType, "Ieu", t->data.MemFd,
+					SPA_POD_PROP_ENUM(2, t->data.MemFd,
+							     t->data.MemPtr));
 	}
 	else if (id == t->param.idMeta) {
 		switch (*index) {
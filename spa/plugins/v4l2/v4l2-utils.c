@@ -1310,9 +1310,23 @@ mmap_init(struct impl *this,
 	struct port *port = &this->out_ports[0];
 	struct v4l2_requestbuffers reqbuf;
 	int i;
+	uint32_t data_type = SPA_ID_INVALID;
+	bool export_buf;
 
 	port->memtype = V4L2_MEMORY_MMAP;
 
+	/* only export dmabufs when they were negotiated, without a
+	 * negotiated type we keep exporting */
+	for (i = 0; i < n_params; i++) {
+		if (spa_pod_is_object_type(params[i], this->type.param_buffers.Buffers)) {
+			spa_pod_object_parse(params[i],
+				":", this->type.param_buffers.dataType, "?I", &data_type, NULL);
+			break;
+		}
+	}
+	export_buf = port->export_buf &&
+		(data_type == SPA_ID_INVALID || data_type == this->type.data.DmaBuf);
+
 	spa_zero(reqbuf);
 	reqbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 	reqbuf.memory = port->memtype;
@@ -1330,7 +1344,7 @@ mmap_init(struct impl *this,
 		spa_log_error(port->log, "v4l2: can't allocate enough buffers");
 		return -ENOMEM;
 	}
-	if (port->export_buf)
+	if (export_buf)
 		spa_log_info(port->log, "v4l2: using EXPBUF");
 
 	for (i = 0; i < reqbuf.count; i++) {
@@ -1364,7 +1378,7 @@ mmap_init(struct impl *this,
 		d[0].chunk->size = 0;
 		d[0].chunk->stride = port->fmt.fmt.pix.bytesperline;
 
-		if (port->export_buf) {
+		if (export_buf) {
 			struct v4l2_exportbuffer expbuf;
 
 			spa_zero(expbuf);
@@ -0,0 +1,98 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "volume-ops.h"
+
+#include <emmintrin.h>
+
+/* 4 frames always contain a multiple of 4 samples, so the gains for each
+ * vector in a block of 4 frames can be loaded from the gains of the
+ * channels repeated 4 times */
+static inline void make_pattern(float *pattern, const float *gain, int n_channels)
+{
+	int i;
+	for (i = 0; i < 4 * n_channels; i++)
+		pattern[i] = gain[i % n_channels];
+}
+
+static void
+volume_apply_f32_sse2(void *dst, const void *src, const float *gain, int n_channels, int n_frames)
+{
+	const float *s = src;
+	float *d = dst;
+	float pattern[4 * VOLUME_MAX_CHANNELS];
+	int i, j, n_samples = 4 * n_channels;
+
+	make_pattern(pattern, gain, n_channels);
+
+	for (i = 0; i + 4 <= n_frames; i += 4) {
+		for (j = 0; j < n_samples; j += 4) {
+			__m128 in = _mm_loadu_ps(&s[j]);
+			_mm_storeu_ps(&d[j], _mm_mul_ps(in, _mm_loadu_ps(&pattern[j])));
+		}
+		s += n_samples;
+		d += n_samples;
+	}
+	if (i < n_frames)
+		volume_apply_f32_c(d, s, gain, n_channels, n_frames - i);
+}
+
+static inline __m128i scale_s16_sse2(__m128i in, __m128 g0, __m128 g1)
+{
+	__m128 lo, hi;
+
+	/* sign extend to 32 bits and convert to float */
+	lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+	hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+
+	/* truncate like the C version and saturate to 16 bits */
+	return _mm_packs_epi32(_mm_cvttps_epi32(_mm_mul_ps(lo, g0)),
+			       _mm_cvttps_epi32(_mm_mul_ps(hi, g1)));
+}
+
+static void
+volume_apply_s16_sse2(void *dst, const void *src, const float *gain, int n_channels, int n_frames)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	float pattern[8 * VOLUME_MAX_CHANNELS];
+	int i, j, n_samples = 8 * n_channels;
+
+	/* 8 frames always contain a multiple of 8 samples */
+	make_pattern(pattern, gain, n_channels);
+	make_pattern(&pattern[4 * n_channels], gain, n_channels);
+
+	for (i = 0; i + 8 <= n_frames; i += 8) {
+		for (j = 0; j < n_samples; j += 8) {
+			__m128i in = _mm_loadu_si128((const __m128i *) &s[j]);
+			_mm_storeu_si128((__m128i *) &d[j], scale_s16_sse2(in,
+					_mm_loadu_ps(&pattern[j]), _mm_loadu_ps(&pattern[j + 4])));
+		}
+		s += n_samples;
+		d += n_samples;
+	}
+	if (i < n_frames)
+		volume_apply_s16_c(d, s, gain, n_channels, n_frames - i);
+}
+
+void volume_init_ops_sse2(struct volume_ops *ops)
+{
+	ops->apply[VOLUME_FMT_S16] = volume_apply_s16_sse2;
+	ops->apply[VOLUME_FMT_F32] = volume_apply_f32_sse2;
+}
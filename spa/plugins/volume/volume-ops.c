@@ -0,0 +1,287 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <endian.h>
+
+#include "volume-ops.h"
+
+#define S24_MIN	-8388608
+#define S24_MAX	8388607
+
+static inline int32_t read_s24(const uint8_t *s)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	return (int32_t) (((uint32_t) s[0] << 8) | ((uint32_t) s[1] << 16) | ((uint32_t) s[2] << 24)) >> 8;
+#else
+	return (int32_t) (((uint32_t) s[2] << 8) | ((uint32_t) s[1] << 16) | ((uint32_t) s[0] << 24)) >> 8;
+#endif
+}
+
+static inline void write_s24(uint8_t *d, int32_t v)
+{
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	d[0] = v;
+	d[1] = v >> 8;
+	d[2] = v >> 16;
+#else
+	d[0] = v >> 16;
+	d[1] = v >> 8;
+	d[2] = v;
+#endif
+}
+
+static inline int16_t scale_s16(int16_t s, float g)
+{
+	int32_t t = s * g;
+	return SPA_CLAMP(t, INT16_MIN, INT16_MAX);
+}
+
+static inline int32_t scale_s24(int32_t s, float g)
+{
+	int32_t t = s * g;
+	return SPA_CLAMP(t, S24_MIN, S24_MAX);
+}
+
+static inline int32_t scale_s32(int32_t s, float g)
+{
+	double t = s * (double) g;
+	return t <= INT32_MIN ? INT32_MIN : t >= INT32_MAX ? INT32_MAX : (int32_t) t;
+}
+
+void
+volume_apply_s16_c(void *dst, const void *src, const float *gain, int n_channels, int n_frames)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = scale_s16(s[c], gain[c]);
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+volume_apply_s24_c(void *dst, const void *src, const float *gain, int n_channels, int n_frames)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++) {
+			write_s24(d, scale_s24(read_s24(s), gain[c]));
+			d += 3;
+			s += 3;
+		}
+	}
+}
+
+static void
+volume_apply_s32_c(void *dst, const void *src, const float *gain, int n_channels, int n_frames)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = scale_s32(s[c], gain[c]);
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+void
+volume_apply_f32_c(void *dst, const void *src, const float *gain, int n_channels, int n_frames)
+{
+	const float *s = src;
+	float *d = dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = s[c] * gain[c];
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+volume_apply_f64_c(void *dst, const void *src, const float *gain, int n_channels, int n_frames)
+{
+	const double *s = src;
+	double *d = dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = s[c] * (double) gain[c];
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+volume_ramp_s16_c(void *dst, const void *src, const float *start, const float *delta,
+		  const float *shape, int n_channels, int n_frames)
+{
+	const int16_t *s = src;
+	int16_t *d = dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = scale_s16(s[c], start[c] + delta[c] * shape[i]);
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+volume_ramp_s24_c(void *dst, const void *src, const float *start, const float *delta,
+		  const float *shape, int n_channels, int n_frames)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++) {
+			write_s24(d, scale_s24(read_s24(s), start[c] + delta[c] * shape[i]));
+			d += 3;
+			s += 3;
+		}
+	}
+}
+
+static void
+volume_ramp_s32_c(void *dst, const void *src, const float *start, const float *delta,
+		  const float *shape, int n_channels, int n_frames)
+{
+	const int32_t *s = src;
+	int32_t *d = dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = scale_s32(s[c], start[c] + delta[c] * shape[i]);
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+volume_ramp_f32_c(void *dst, const void *src, const float *start, const float *delta,
+		  const float *shape, int n_channels, int n_frames)
+{
+	const float *s = src;
+	float *d = dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = s[c] * (start[c] + delta[c] * shape[i]);
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+static void
+volume_ramp_f64_c(void *dst, const void *src, const float *start, const float *delta,
+		  const float *shape, int n_channels, int n_frames)
+{
+	const double *s = src;
+	double *d = dst;
+	int i, c;
+
+	for (i = 0; i < n_frames; i++) {
+		for (c = 0; c < n_channels; c++)
+			d[c] = s[c] * (double) (start[c] + delta[c] * shape[i]);
+		d += n_channels;
+		s += n_channels;
+	}
+}
+
+/** Make the shape of a ramp
+ * \param shape the result, n_frames values between 0.0 and 1.0
+ * \param curve VOLUME_RAMP_LINEAR or VOLUME_RAMP_CUBIC
+ * \param pos the position in the ramp of the first frame
+ * \param len the length of the ramp in frames
+ * \param n_frames the number of frames
+ *
+ * The last frame of the ramp has the value 1.0.
+ */
+void volume_ramp_shape(float *shape, int curve, uint32_t pos, uint32_t len, int n_frames)
+{
+	float x, step = 1.0f / len;
+	int i;
+
+	for (i = 0; i < n_frames; i++) {
+		x = SPA_MIN((pos + i + 1) * step, 1.0f);
+		if (curve == VOLUME_RAMP_CUBIC)
+			x = x * x * (3.0f - 2.0f * x);
+		shape[i] = x;
+	}
+}
+
+/** Get the optimizations supported by the CPU we are running on
+ * \return a mask of VOLUME_CPU_FLAG_* values
+ */
+uint32_t volume_get_cpu_flags(void)
+{
+	uint32_t flags = 0;
+
+#if defined(__i386__) || defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		flags |= VOLUME_CPU_FLAG_SSE2;
+#endif
+	return flags;
+}
+
+/** Get the volume functions
+ * \param ops the functions to fill
+ * \param cpu_flags the allowed optimizations, 0 for the generic C versions
+ */
+void volume_get_ops_cpu(struct volume_ops *ops, uint32_t cpu_flags)
+{
+	ops->apply[VOLUME_FMT_S16] = volume_apply_s16_c;
+	ops->apply[VOLUME_FMT_S24] = volume_apply_s24_c;
+	ops->apply[VOLUME_FMT_S32] = volume_apply_s32_c;
+	ops->apply[VOLUME_FMT_F32] = volume_apply_f32_c;
+	ops->apply[VOLUME_FMT_F64] = volume_apply_f64_c;
+	ops->ramp[VOLUME_FMT_S16] = volume_ramp_s16_c;
+	ops->ramp[VOLUME_FMT_S24] = volume_ramp_s24_c;
+	ops->ramp[VOLUME_FMT_S32] = volume_ramp_s32_c;
+	ops->ramp[VOLUME_FMT_F32] = volume_ramp_f32_c;
+	ops->ramp[VOLUME_FMT_F64] = volume_ramp_f64_c;
+
+#if defined(HAVE_SSE2)
+	if (cpu_flags & VOLUME_CPU_FLAG_SSE2)
+		volume_init_ops_sse2(ops);
+#endif
+}
+
+void volume_get_ops(struct volume_ops *ops)
+{
+	volume_get_ops_cpu(ops, volume_get_cpu_flags());
+}
@@ -0,0 +1,68 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+
+#include <spa/utils/defs.h>
+
+#define VOLUME_MAX_CHANNELS	64
+
+/* apply the gain of each channel to n_frames of n_channels interleaved samples */
+typedef void (*volume_func_t) (void *dst, const void *src, const float *gain,
+			       int n_channels, int n_frames);
+/* apply a ramp, the gain of channel c for frame f is start[c] + delta[c] * shape[f] */
+typedef void (*volume_ramp_func_t) (void *dst, const void *src,
+				    const float *start, const float *delta, const float *shape,
+				    int n_channels, int n_frames);
+
+enum {
+	VOLUME_FMT_S16,
+	VOLUME_FMT_S24,
+	VOLUME_FMT_S32,
+	VOLUME_FMT_F32,
+	VOLUME_FMT_F64,
+	VOLUME_FMT_MAX,
+};
+
+enum {
+	VOLUME_RAMP_LINEAR,
+	VOLUME_RAMP_CUBIC,
+};
+
+#define VOLUME_CPU_FLAG_SSE2	(1 << 0)
+
+struct volume_ops {
+	volume_func_t apply[VOLUME_FMT_MAX];
+	volume_ramp_func_t ramp[VOLUME_FMT_MAX];
+};
+
+uint32_t volume_get_cpu_flags(void);
+
+void volume_get_ops_cpu(struct volume_ops *ops, uint32_t cpu_flags);
+void volume_get_ops(struct volume_ops *ops);
+
+void volume_ramp_shape(float *shape, int curve, uint32_t pos, uint32_t len, int n_frames);
+
+/* generic C implementations, the optimized versions use these for the
+ * samples that don't fill a complete vector */
+void volume_apply_s16_c(void *dst, const void *src, const float *gain, int n_channels, int n_frames);
+void volume_apply_f32_c(void *dst, const void *src, const float *gain, int n_channels, int n_frames);
+
+void volume_init_ops_sse2(struct volume_ops *ops);
@@ -32,20 +32,38 @@
 #include <spa/param/io.h>
 #include <spa/pod/filter.h>
 
+#include "volume-ops.h"
+
 #define NAME "volume"
 
-#define DEFAULT_VOLUME 1.0
-#define DEFAULT_MUTE false
+#define DEFAULT_VOLUME		1.0
+#define DEFAULT_MUTE		false
+#define DEFAULT_RAMP_SAMPLES	0
+#define DEFAULT_RAMP_CURVE	VOLUME_RAMP_LINEAR
+
+/* the number of frames we make the shape of a ramp for at once */
+#define MAX_RAMP_FRAMES		256
 
 struct props {
 	double volume;
 	bool mute;
+	float channel_volumes[VOLUME_MAX_CHANNELS];
+	uint32_t n_channel_volumes;
+	int32_t ramp_samples;
+	int32_t ramp_curve;
 };
 
 static void reset_props(struct props *props)
 {
+	uint32_t i;
+
 	props->volume = DEFAULT_VOLUME;
 	props->mute = DEFAULT_MUTE;
+	for (i = 0; i < VOLUME_MAX_CHANNELS; i++)
+		props->channel_volumes[i] = 1.0f;
+	props->n_channel_volumes = 0;
+	props->ramp_samples = DEFAULT_RAMP_SAMPLES;
+	props->ramp_curve = DEFAULT_RAMP_CURVE;
 }
 
 #define MAX_BUFFERS     16
@@ -78,6 +96,9 @@ struct type {
 	uint32_t props;
 	uint32_t prop_volume;
 	uint32_t prop_mute;
+	uint32_t prop_channel_volumes;
+	uint32_t prop_ramp_samples;
+	uint32_t prop_ramp_curve;
 	struct spa_type_io io;
 	struct spa_type_param param;
 	struct spa_type_meta meta;
@@ -100,6 +121,9 @@ static inline void init_type(struct type *type, struct spa_type_map *map)
 	type->props = spa_type_map_get_id(map, SPA_TYPE__Props);
 	type->prop_volume = spa_type_map_get_id(map, SPA_TYPE_PROPS__volume);
 	type->prop_mute = spa_type_map_get_id(map, SPA_TYPE_PROPS__mute);
+	type->prop_channel_volumes = spa_type_map_get_id(map, SPA_TYPE_PROPS__channelVolumes);
+	type->prop_ramp_samples = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampSamples);
+	type->prop_ramp_curve = spa_type_map_get_id(map, SPA_TYPE_PROPS__rampCurve);
 	spa_type_io_map(map, &type->io);
 	spa_type_param_map(map, &type->param);
 	spa_type_meta_map(map, &type->meta);
@@ -131,6 +155,23 @@ struct impl {
 	struct spa_audio_info current_format;
 	int bpf;
 
+	struct volume_ops ops;
+	uint32_t fmt;
+	uint32_t sample_size;
+	uint32_t n_channels;
+	bool planar;
+
+	/* the gains we apply, when ramping we go from start to target */
+	bool gains_changed;
+	bool unity;
+	float gains[VOLUME_MAX_CHANNELS];
+	float start[VOLUME_MAX_CHANNELS];
+	float delta[VOLUME_MAX_CHANNELS];
+	float target[VOLUME_MAX_CHANNELS];
+	uint32_t ramp_pos;
+	uint32_t ramp_len;
+	int32_t ramp_curve;
+
 	struct port in_ports[1];
 	struct port out_ports[1];
 
@@ -195,6 +236,31 @@ static int impl_node_enum_params(struct spa_node *node,
 				":", t->param.propName, "s", "Mute",
 				":", t->param.propType, "b", p->mute);
 			break;
+		case 2:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId,   "I", t->prop_channel_volumes,
+				":", t->param.propName, "s", "The volume of each channel",
+				":", t->param.propType, "a", sizeof(float), SPA_POD_TYPE_FLOAT,
+					p->n_channel_volumes, p->channel_volumes);
+			break;
+		case 3:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId,   "I", t->prop_ramp_samples,
+				":", t->param.propName, "s", "Length of a volume change in samples",
+				":", t->param.propType, "ir", p->ramp_samples,
+					SPA_POD_PROP_MIN_MAX(0, INT32_MAX));
+			break;
+		case 4:
+			param = spa_pod_builder_object(&b,
+				id, t->param.PropInfo,
+				":", t->param.propId,   "I", t->prop_ramp_curve,
+				":", t->param.propName, "s", "Shape of a volume change, 0=linear, 1=cubic",
+				":", t->param.propType, "ie", p->ramp_curve,
+					SPA_POD_PROP_ENUM(2, VOLUME_RAMP_LINEAR,
+							     VOLUME_RAMP_CUBIC));
+			break;
 		default:
 			return 0;
 		}
@@ -204,8 +270,12 @@ static int impl_node_enum_params(struct spa_node *node,
 		case 0:
 			param = spa_pod_builder_object(&b,
 				id, t->props,
-				":", t->prop_volume, "d", p->volume,
-				":", t->prop_mute,   "b", p->mute);
+				":", t->prop_volume,          "d", p->volume,
+				":", t->prop_mute,            "b", p->mute,
+				":", t->prop_channel_volumes, "a", sizeof(float), SPA_POD_TYPE_FLOAT,
+					p->n_channel_volumes, p->channel_volumes,
+				":", t->prop_ramp_samples,    "i", p->ramp_samples,
+				":", t->prop_ramp_curve,      "i", p->ramp_curve);
 			break;
 		default:
 			return 0;
@@ -222,6 +292,30 @@ static int impl_node_enum_params(struct spa_node *node,
 	return 1;
 }
 
+static void parse_channel_volumes(struct impl *this, const struct spa_pod *pod)
+{
+	struct props *p = &this->props;
+	struct spa_pod_array *arr;
+	uint32_t i, n_values;
+	float *values;
+
+	if (SPA_POD_TYPE(pod) != SPA_POD_TYPE_ARRAY)
+		return;
+
+	arr = (struct spa_pod_array *) pod;
+	if (arr->body.child.type != SPA_POD_TYPE_FLOAT ||
+	    arr->body.child.size != sizeof(float))
+		return;
+
+	values = SPA_POD_CONTENTS(struct spa_pod_array, pod);
+	n_values = SPA_MIN((SPA_POD_BODY_SIZE(pod) - sizeof(struct spa_pod_array_body)) / sizeof(float),
+			   VOLUME_MAX_CHANNELS);
+
+	for (i = 0; i < VOLUME_MAX_CHANNELS; i++)
+		p->channel_volumes[i] = i < n_values ? values[i] : 1.0f;
+	p->n_channel_volumes = n_values;
+}
+
 static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flags,
 			       const struct spa_pod *param)
 {
@@ -235,14 +329,24 @@ static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flag
 
 	if (id == t->param.idProps) {
 		struct props *p = &this->props;
+		struct spa_pod *volumes = NULL;
 
 		if (param == NULL) {
 			reset_props(p);
+			this->gains_changed = true;
 			return 0;
 		}
 		spa_pod_object_parse(param,
-			":", t->prop_volume, "?d", &p->volume,
-			":", t->prop_mute,   "?b", &p->mute, NULL);
+			":", t->prop_volume,          "?d", &p->volume,
+			":", t->prop_mute,            "?b", &p->mute,
+			":", t->prop_channel_volumes, "?P", &volumes,
+			":", t->prop_ramp_samples,    "?i", &p->ramp_samples,
+			":", t->prop_ramp_curve,      "?i", &p->ramp_curve, NULL);
+
+		if (volumes)
+			parse_channel_volumes(this, volumes);
+
+		this->gains_changed = true;
 	}
 	else
 		return -ENOENT;
@@ -375,8 +479,14 @@ static int port_enum_formats(struct spa_node *node,
 			"I", t->media_type.audio,
 			"I", t->media_subtype.raw,
 			":", t->format_audio.format,  "Ieu", t->audio_format.S16,
-				SPA_POD_PROP_ENUM(2, t->audio_format.S16,
-						     t->audio_format.S32),
+				SPA_POD_PROP_ENUM(5, t->audio_format.S16,
+						     t->audio_format.S24,
+						     t->audio_format.S32,
+						     t->audio_format.F32,
+						     t->audio_format.F64),
+			":", t->format_audio.layout,  "ieu", SPA_AUDIO_LAYOUT_INTERLEAVED,
+				SPA_POD_PROP_ENUM(2, SPA_AUDIO_LAYOUT_INTERLEAVED,
+						     SPA_AUDIO_LAYOUT_NON_INTERLEAVED),
 			":", t->format_audio.rate,    "iru", 44100,
 				SPA_POD_PROP_MIN_MAX(1, INT32_MAX),
 			":", t->format_audio.channels,"iru", 2,
@@ -411,6 +521,7 @@ static int port_get_format(struct spa_node *node,
 	                "I", t->media_type.audio,
 			"I", t->media_subtype.raw,
 			":", t->format_audio.format,   "I", this->current_format.info.raw.format,
+			":", t->format_audio.layout,   "i", this->current_format.info.raw.layout,
 			":", t->format_audio.rate,     "i", this->current_format.info.raw.rate,
 			":", t->format_audio.channels, "i", this->current_format.info.raw.channels);
 
@@ -541,12 +652,43 @@ static int clear_buffers(struct impl *this, struct port *port)
 	return 0;
 }
 
+/* calculate the gains of the channels from the properties and start a ramp
+ * to them when needed */
+static void update_gains(struct impl *this, bool ramp)
+{
+	struct props *p = &this->props;
+	uint32_t i;
+
+	this->unity = !p->mute;
+	for (i = 0; i < this->n_channels; i++) {
+		this->target[i] = p->mute ? 0.0f : p->volume * p->channel_volumes[i];
+		if (this->target[i] != 1.0f)
+			this->unity = false;
+	}
+
+	if (ramp && p->ramp_samples > 0) {
+		for (i = 0; i < this->n_channels; i++) {
+			this->start[i] = this->gains[i];
+			this->delta[i] = this->target[i] - this->gains[i];
+		}
+		this->ramp_pos = 0;
+		this->ramp_len = p->ramp_samples;
+		this->ramp_curve = p->ramp_curve;
+		this->unity = false;
+	} else {
+		memcpy(this->gains, this->target, sizeof(this->gains));
+		this->ramp_len = 0;
+	}
+	spa_log_trace(this->log, NAME " %p: update gains, ramp %d", this, this->ramp_len);
+}
+
 static int port_set_format(struct spa_node *node,
 			   enum spa_direction direction, uint32_t port_id,
 			   uint32_t flags,
 			   const struct spa_pod *format)
 {
 	struct impl *this = SPA_CONTAINER_OF(node, struct impl, node);
+	struct type *t = &this->type;
 	struct port *port;
 
 	port = GET_PORT(this, direction, port_id);
@@ -556,6 +698,7 @@ static int port_set_format(struct spa_node *node,
 		clear_buffers(this, port);
 	} else {
 		struct spa_audio_info info = { 0 };
+		uint32_t fmt, size;
 
 		spa_pod_object_parse(format,
 			"I", &info.media_type,
@@ -568,9 +711,41 @@ static int port_set_format(struct spa_node *node,
 		if (spa_format_audio_raw_parse(format, &info.info.raw, &this->type.format_audio) < 0)
 			return -EINVAL;
 
-		this->bpf = 2 * info.info.raw.channels;
+		if (info.info.raw.format == t->audio_format.S16) {
+			fmt = VOLUME_FMT_S16;
+			size = sizeof(int16_t);
+		}
+		else if (info.info.raw.format == t->audio_format.S24) {
+			fmt = VOLUME_FMT_S24;
+			size = 3;
+		}
+		else if (info.info.raw.format == t->audio_format.S32) {
+			fmt = VOLUME_FMT_S32;
+			size = sizeof(int32_t);
+		}
+		else if (info.info.raw.format == t->audio_format.F32) {
+			fmt = VOLUME_FMT_F32;
+			size = sizeof(float);
+		}
+		else if (info.info.raw.format == t->audio_format.F64) {
+			fmt = VOLUME_FMT_F64;
+			size = sizeof(double);
+		}
+		else
+			return -EINVAL;
+
+		if (info.info.raw.channels == 0 || info.info.raw.channels > VOLUME_MAX_CHANNELS)
+			return -EINVAL;
+
+		this->fmt = fmt;
+		this->sample_size = size;
+		this->n_channels = info.info.raw.channels;
+		this->planar = info.info.raw.layout == SPA_AUDIO_LAYOUT_NON_INTERLEAVED;
+		this->bpf = this->planar ? size : size * this->n_channels;
 		this->current_format = info;
 		port->have_format = true;
+
+		update_gains(this, false);
 	}
 
 	return 0;
@@ -627,6 +802,12 @@ impl_node_port_use_buffers(struct spa_node *node,
 		struct buffer *b;
 		struct spa_data *d = buffers[i]->datas;
 
+		if (buffers[i]->n_datas < (this->planar ? this->n_channels : 1)) {
+			spa_log_error(this->log, NAME " %p: not enough planes on buffer %p", this,
+				      buffers[i]);
+			return -EINVAL;
+		}
+
 		b = &port->buffers[i];
 		b->outbuf = buffers[i];
 		b->outstanding = direction == SPA_DIRECTION_INPUT;
@@ -754,48 +935,78 @@ static struct spa_buffer *find_free_buffer(struct impl *this, struct port *port)
 
 static void do_volume(struct impl *this, struct spa_buffer *dbuf, struct spa_buffer *sbuf)
 {
-	uint32_t i, n_samples, n_bytes;
-	struct spa_data *sd, *dd;
-	int16_t *src, *dst;
-	double volume;
-	uint32_t written, towrite, savail, davail;
-	uint32_t sindex, dindex;
+	struct spa_data *sd = sbuf->datas, *dd = dbuf->datas;
+	uint32_t i, c, n_planes, n_channels, stride, n_frames, done, n, soffset;
+	float shape[MAX_RAMP_FRAMES];
 
-	volume = this->props.volume;
+	if (this->gains_changed) {
+		this->gains_changed = false;
+		update_gains(this, this->started);
+	}
 
-	sd = sbuf->datas;
-	dd = dbuf->datas;
+	/* planar audio has one channel in each plane */
+	n_planes = this->planar ? this->n_channels : 1;
+	n_channels = this->planar ? 1 : this->n_channels;
+	stride = this->sample_size * n_channels;
 
-	savail = SPA_MIN(sd[0].chunk->size, sd[0].maxsize);
-	sindex = sd[0].chunk->offset;
-	davail = 0;
-	dindex = 0;
-	davail = dd[0].maxsize - davail;
+	n_frames = n_planes > 0 ? UINT32_MAX : 0;
+	for (i = 0; i < n_planes; i++) {
+		n_frames = SPA_MIN(n_frames, SPA_MIN(sd[i].chunk->size, sd[i].maxsize) / stride);
+		n_frames = SPA_MIN(n_frames, dd[i].maxsize / stride);
+	}
 
-	towrite = SPA_MIN(savail, davail);
-	written = 0;
+	for (done = 0; done < n_frames; done += n) {
+		n = n_frames - done;
 
-	while (written < towrite) {
-		uint32_t soffset = sindex % sd[0].maxsize;
-		uint32_t doffset = dindex % dd[0].maxsize;
+		/* the source data can wrap around, process it up to the end of
+		 * the memory and then from the start */
+		for (i = 0; i < n_planes; i++) {
+			soffset = (sd[i].chunk->offset % sd[i].maxsize + done * stride) % sd[i].maxsize;
+			n = SPA_MIN(n, (sd[i].maxsize - soffset) / stride);
+		}
+		if (n == 0) {
+			/* a frame is split over the end of the memory */
+			n_frames = done;
+			break;
+		}
 
-		src = SPA_MEMBER(sd[0].data, soffset, int16_t);
-		dst = SPA_MEMBER(dd[0].data, doffset, int16_t);
+		if (this->ramp_len > 0) {
+			n = SPA_MIN(n, SPA_MIN(MAX_RAMP_FRAMES, this->ramp_len - this->ramp_pos));
+			volume_ramp_shape(shape, this->ramp_curve, this->ramp_pos, this->ramp_len, n);
+		}
 
-		n_bytes = SPA_MIN(towrite, sd[0].maxsize - soffset);
-		n_bytes = SPA_MIN(n_bytes, dd[0].maxsize - doffset);
+		for (i = 0; i < n_planes; i++) {
+			const void *s;
+			void *d = SPA_MEMBER(dd[i].data, done * stride, void);
+
+			soffset = (sd[i].chunk->offset % sd[i].maxsize + done * stride) % sd[i].maxsize;
+			s = SPA_MEMBER(sd[i].data, soffset, void);
+			c = this->planar ? i : 0;
+
+			if (this->ramp_len > 0)
+				this->ops.ramp[this->fmt](d, s, &this->start[c], &this->delta[c],
+						shape, n_channels, n);
+			else if (this->unity)
+				memcpy(d, s, n * stride);
+			else
+				this->ops.apply[this->fmt](d, s, &this->gains[c], n_channels, n);
+		}
 
-		n_samples = n_bytes / sizeof(int16_t);
-		for (i = 0; i < n_samples; i++)
-			dst[i] = src[i] * volume;
+		if (this->ramp_len > 0) {
+			for (c = 0; c < this->n_channels; c++)
+				this->gains[c] = this->start[c] + this->delta[c] * shape[n - 1];
+
+			this->ramp_pos += n;
+			if (this->ramp_pos >= this->ramp_len)
+				update_gains(this, false);
+		}
+	}
 
-		sindex += n_bytes;
-		dindex += n_bytes;
-		written += n_bytes;
+	for (i = 0; i < n_planes; i++) {
+		dd[i].chunk->offset = 0;
+		dd[i].chunk->size = n_frames * stride;
+		dd[i].chunk->stride = 0;
 	}
-	dd[0].chunk->offset = 0;
-	dd[0].chunk->size = written;
-	dd[0].chunk->stride = 0;
 }
 
 static int impl_node_process_input(struct spa_node *node)
@@ -954,6 +1165,7 @@ impl_init(const struct spa_handle_factory *factory,
 
 	this->node = impl_node;
 	reset_props(&this->props);
+	volume_get_ops(&this->ops);
 
 	this->in_ports[0].info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS |
 	    SPA_PORT_INFO_FLAG_IN_PLACE;
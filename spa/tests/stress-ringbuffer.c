@@ -1,113 +1,268 @@
 #define _GNU_SOURCE
 #include <unistd.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <sched.h>
+#include <time.h>
 
 #include <spa/utils/ringbuffer.h>
+#include <spa/utils/spsc-ringbuffer.h>
+#include <spa/utils/mpsc-ringbuffer.h>
 
 #define ARRAY_SIZE 64
-#define MAX_VALUE 0x10000
+#define MAX_PRODUCERS 16
 
-struct spa_ringbuffer rb;
-uint32_t size;
-uint8_t *data;
+enum mode {
+	MODE_RINGBUFFER,
+	MODE_SPSC,
+	MODE_MPSC,
+};
 
-static int fill_int_array(int *array, int start, int count)
+static const char *mode_names[] = { "ringbuffer", "spsc", "mpsc" };
+
+struct record {
+	uint32_t producer;
+	uint32_t seq;
+	uint64_t time;
+	int data[ARRAY_SIZE - 4];
+};
+
+struct bench {
+	enum mode mode;
+	uint32_t size;
+	uint8_t *data;
+	int n_producers;
+	int running;
+
+	struct spa_ringbuffer rb;
+	struct spa_spsc_ringbuffer spsc;
+	struct spa_mpsc_ringbuffer mpsc;
+
+	uint64_t count;
+	uint64_t failures;
+	uint64_t lat_total;
+	uint64_t lat_max;
+};
+
+static inline uint64_t get_time(void)
 {
-	int i, j = start;
-	for (i = 0; i < count; i++) {
-		array[i] = j;
-		j = (j + 1) % MAX_VALUE;
-	}
-	return j;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
 }
 
-static int cmp_array(int *array1, int *array2, int count)
+static void fill_record(struct record *r, uint32_t producer, uint32_t seq)
 {
 	int i;
-	for (i = 0; i < count; i++)
-		if (array1[i] != array2[i]) {
-			printf("%d != %d at offset %d\n", array1[i], array2[i], i);
-			return 0;
-		}
+	r->producer = producer;
+	r->seq = seq;
+	for (i = 0; i < SPA_N_ELEMENTS(r->data); i++)
+		r->data[i] = seq + i;
+}
 
+static int check_record(struct record *r, uint32_t seq)
+{
+	int i;
+	if (r->seq != seq)
+		return 0;
+	for (i = 0; i < SPA_N_ELEMENTS(r->data); i++)
+		if (r->data[i] != seq + i)
+			return 0;
 	return 1;
 }
 
-static void *reader_start(void *arg)
+static bool write_record(struct bench *b, struct record *r)
 {
-	int i = 0, a[ARRAY_SIZE], b[ARRAY_SIZE];
-	unsigned long j = 0, nfailures = 0;
+	uint32_t index;
+	int32_t filled;
+
+	switch (b->mode) {
+	case MODE_RINGBUFFER:
+		filled = spa_ringbuffer_get_write_index(&b->rb, &index);
+		if (b->size - filled < sizeof(struct record))
+			return false;
+		r->time = get_time();
+		spa_ringbuffer_write_data(&b->rb, b->data, b->size, index & (b->size - 1),
+					  r, sizeof(struct record));
+		spa_ringbuffer_write_update(&b->rb, index + sizeof(struct record));
+		break;
+	case MODE_SPSC:
+		if (spa_spsc_ringbuffer_write_reserve(&b->spsc, b->size,
+						      sizeof(struct record), &index) < 0)
+			return false;
+		r->time = get_time();
+		spa_spsc_ringbuffer_write_data(&b->spsc, b->data, b->size, index & (b->size - 1),
+					       r, sizeof(struct record));
+		spa_spsc_ringbuffer_write_commit(&b->spsc, index + sizeof(struct record));
+		break;
+	case MODE_MPSC:
+		do {
+			filled = spa_mpsc_ringbuffer_get_write_index(&b->mpsc, &index);
+			if (b->size - filled < sizeof(struct record))
+				return false;
+		} while (!spa_mpsc_ringbuffer_write_reserve(&b->mpsc, index, sizeof(struct record)));
+		r->time = get_time();
+		spa_ringbuffer_write_data(NULL, b->data, b->size, index & (b->size - 1),
+					  r, sizeof(struct record));
+		spa_mpsc_ringbuffer_write_commit(&b->mpsc, sizeof(struct record));
+		break;
+	}
+	return true;
+}
+
+static bool read_record(struct bench *b, struct record *r)
+{
+	uint32_t index;
+
+	switch (b->mode) {
+	case MODE_RINGBUFFER:
+		if (spa_ringbuffer_get_read_index(&b->rb, &index) < sizeof(struct record))
+			return false;
+		spa_ringbuffer_read_data(&b->rb, b->data, b->size, index & (b->size - 1),
+					 r, sizeof(struct record));
+		spa_ringbuffer_read_update(&b->rb, index + sizeof(struct record));
+		break;
+	case MODE_SPSC:
+		if (spa_spsc_ringbuffer_read_peek(&b->spsc, sizeof(struct record), &index) <
+		    sizeof(struct record))
+			return false;
+		spa_spsc_ringbuffer_read_data(&b->spsc, b->data, b->size, index & (b->size - 1),
+					      r, sizeof(struct record));
+		spa_spsc_ringbuffer_read_release(&b->spsc, index + sizeof(struct record));
+		break;
+	case MODE_MPSC:
+		if (spa_mpsc_ringbuffer_get_read_index(&b->mpsc, &index) < sizeof(struct record))
+			return false;
+		spa_ringbuffer_read_data(NULL, b->data, b->size, index & (b->size - 1),
+					 r, sizeof(struct record));
+		spa_mpsc_ringbuffer_read_update(&b->mpsc, index + sizeof(struct record));
+		break;
+	}
+	return true;
+}
 
-	printf("reader started on cpu: %d\n", sched_getcpu());
+struct producer {
+	struct bench *bench;
+	uint32_t id;
+	pthread_t thread;
+};
 
-	i = fill_int_array(a, i, ARRAY_SIZE);
+static void *reader_start(void *arg)
+{
+	struct bench *b = arg;
+	struct record r;
+	uint32_t seq[MAX_PRODUCERS] = { 0, };
 
-	while (1) {
-		uint32_t index;
+	while (__atomic_load_n(&b->running, __ATOMIC_RELAXED)) {
+		uint64_t lat;
 
-		if (spa_ringbuffer_get_read_index(&rb, &index) >= ARRAY_SIZE * sizeof(int)) {
-			spa_ringbuffer_read_data(&rb, data, size, index & (size - 1), b,
-						 ARRAY_SIZE * sizeof(int));
+		if (!read_record(b, &r))
+			continue;
 
-			if (!cmp_array(a, b, ARRAY_SIZE)) {
-				nfailures++;
-				printf
-				    ("failure in chunk %lu - probability: %lu/%lu = %.3f per million\n",
-				     j, nfailures, j, (float) nfailures / (j + 1) * 1000000);
-				i = (b[0] + ARRAY_SIZE) % MAX_VALUE;
-			}
-			i = fill_int_array(a, i, ARRAY_SIZE);
-			j++;
+		lat = get_time() - r.time;
+		b->lat_total += lat;
+		b->lat_max = SPA_MAX(b->lat_max, lat);
 
-			spa_ringbuffer_read_update(&rb, index + ARRAY_SIZE * sizeof(int));
+		if (r.producer >= MAX_PRODUCERS || !check_record(&r, seq[r.producer])) {
+			b->failures++;
+			printf("failure in record %lu from producer %u\n", b->count, r.producer);
+			if (r.producer < MAX_PRODUCERS)
+				seq[r.producer] = r.seq;
 		}
+		if (r.producer < MAX_PRODUCERS)
+			seq[r.producer]++;
+		b->count++;
 	}
-
 	return NULL;
 }
 
 static void *writer_start(void *arg)
 {
-	int i = 0, a[ARRAY_SIZE];
-	printf("writer started on cpu: %d\n", sched_getcpu());
+	struct producer *p = arg;
+	struct bench *b = p->bench;
+	struct record r;
+	uint32_t seq = 0;
 
-	i = fill_int_array(a, i, ARRAY_SIZE);
+	fill_record(&r, p->id, seq);
 
-	while (1) {
-		uint32_t index;
+	while (__atomic_load_n(&b->running, __ATOMIC_RELAXED)) {
+		if (write_record(b, &r))
+			fill_record(&r, p->id, ++seq);
+	}
+	return NULL;
+}
 
-		if (spa_ringbuffer_get_write_index(&rb, &index) >= ARRAY_SIZE * sizeof(int)) {
-			spa_ringbuffer_write_data(&rb, data, size, index & (size - 1), a,
-						  ARRAY_SIZE * sizeof(int));
-			spa_ringbuffer_write_update(&rb, index + ARRAY_SIZE * sizeof(int));
+static void run_bench(enum mode mode, uint32_t size, int n_producers, int seconds)
+{
+	struct bench b = { 0, };
+	struct producer producers[MAX_PRODUCERS];
+	pthread_t reader_thread;
+	uint64_t start, elapsed;
+	int i;
 
-			i = fill_int_array(a, i, ARRAY_SIZE);
-		}
+	b.mode = mode;
+	b.size = size;
+	b.data = malloc(size);
+	b.n_producers = n_producers;
+	b.running = 1;
+
+	spa_ringbuffer_init(&b.rb);
+	spa_spsc_ringbuffer_init(&b.spsc);
+	spa_mpsc_ringbuffer_init(&b.mpsc);
+
+	start = get_time();
+	pthread_create(&reader_thread, NULL, reader_start, &b);
+	for (i = 0; i < n_producers; i++) {
+		producers[i].bench = &b;
+		producers[i].id = i;
+		pthread_create(&producers[i].thread, NULL, writer_start, &producers[i]);
 	}
 
-	return NULL;
+	sleep(seconds);
+	__atomic_store_n(&b.running, 0, __ATOMIC_RELAXED);
+
+	for (i = 0; i < n_producers; i++)
+		pthread_join(producers[i].thread, NULL);
+	pthread_join(reader_thread, NULL);
+	elapsed = get_time() - start;
+
+	printf("%-10s producers %2d: %10.0f records/s %8.1f MB/s latency avg %8.0f ns max %10lu ns failures %lu\n",
+	       mode_names[mode], n_producers,
+	       (double) b.count * SPA_NSEC_PER_SEC / elapsed,
+	       (double) b.count * sizeof(struct record) * SPA_NSEC_PER_SEC / elapsed / (1024 * 1024),
+	       b.count ? (double) b.lat_total / b.count : 0.0,
+	       b.lat_max, b.failures);
+
+	free(b.data);
 }
 
 int main(int argc, char *argv[])
 {
-	printf("starting ringbuffer stress test\n");
+	uint32_t size = 1 << 16;
+	int seconds = 2, n_producers = 4, i;
 
-	sscanf(argv[1], "%d", &size);
+	if (argc > 1)
+		sscanf(argv[1], "%u", &size);
+	if (argc > 2)
+		sscanf(argv[2], "%d", &seconds);
+	if (argc > 3)
+		sscanf(argv[3], "%d", &n_producers);
 
-	printf("buffer size (bytes): %d\n", size);
-	printf("array size (bytes): %ld\n", sizeof(int) * ARRAY_SIZE);
-
-	spa_ringbuffer_init(&rb);
-	data = malloc(size);
+	if (size < sizeof(struct record) || (size & (size - 1)) != 0) {
+		printf("buffer size must be a power of 2 and at least %zd\n", sizeof(struct record));
+		return -1;
+	}
+	n_producers = SPA_CLAMP(n_producers, 1, MAX_PRODUCERS);
 
-	pthread_t reader_thread, writer_thread;
-	pthread_create(&reader_thread, NULL, reader_start, NULL);
-	pthread_create(&writer_thread, NULL, writer_start, NULL);
+	printf("ringbuffer benchmark on %ld cpus\n", sysconf(_SC_NPROCESSORS_ONLN));
+	printf("buffer size (bytes): %u\n", size);
+	printf("record size (bytes): %zd\n", sizeof(struct record));
 
-	while (1)
-		sleep(1);
+	run_bench(MODE_RINGBUFFER, size, 1, seconds);
+	run_bench(MODE_SPSC, size, 1, seconds);
+	for (i = 1; i <= n_producers; i *= 2)
+		run_bench(MODE_MPSC, size, i, seconds);
 
 	return 0;
 }
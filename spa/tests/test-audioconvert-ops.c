@@ -0,0 +1,218 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <spa/utils/defs.h>
+
+#include "fmt-ops.h"
+#include "channelmix.h"
+#include "resample.h"
+#include "test-ops.h"
+
+/* compares the optimized conversion functions against the generic C versions,
+ * the results must be bit exact, and checks the resampler */
+
+#define N_FRAMES	(1024 + 7)
+#define N_CHANNELS	4
+
+static const char *fmt_names[CONV_FMT_MAX] = {
+	"s16", "s16p", "s24", "s24p", "s32", "s32p", "f32", "f32p" };
+static const int fmt_sizes[CONV_FMT_MAX] = { 2, 2, 3, 3, 4, 4, 4, 4 };
+
+static float f32[N_CHANNELS][N_FRAMES], f32_ref[N_CHANNELS][N_FRAMES];
+static uint8_t data[N_CHANNELS][N_FRAMES * N_CHANNELS * 4];
+static uint8_t data_ref[N_CHANNELS][N_FRAMES * N_CHANNELS * 4];
+
+static int test_fmt(struct conv_ops *ref, struct conv_ops *ops, int fmt,
+		    int n_channels, int n_frames)
+{
+	void *f[N_CHANNELS], *f_ref[N_CHANNELS], *d[N_CHANNELS], *d_ref[N_CHANNELS];
+	int i, size, errors = 0;
+
+	for (i = 0; i < N_CHANNELS; i++) {
+		/* go a little out of range to test clipping */
+		fill_random_f32(f32[i], N_FRAMES, 1.1f);
+		f[i] = f32[i];
+		f_ref[i] = f32_ref[i];
+		d[i] = data[i];
+		d_ref[i] = data_ref[i];
+	}
+	size = n_frames * fmt_sizes[fmt] * (CONV_FMT_IS_PLANAR(fmt) ? 1 : n_channels);
+
+	memset(data, 0, sizeof(data));
+	memset(data_ref, 0, sizeof(data_ref));
+	ref->from_f32p[fmt](d_ref, (const void **) f, n_channels, n_frames);
+	ops->from_f32p[fmt](d, (const void **) f, n_channels, n_frames);
+	for (i = 0; i < (CONV_FMT_IS_PLANAR(fmt) ? n_channels : 1); i++) {
+		if (memcmp(data[i], data_ref[i], size) != 0) {
+			printf("from f32p to %s: mismatch, %d channels %d frames\n",
+					fmt_names[fmt], n_channels, n_frames);
+			errors++;
+		}
+	}
+
+	memset(f32, 0, sizeof(f32));
+	memset(f32_ref, 0, sizeof(f32_ref));
+	ref->to_f32p[fmt](f_ref, (const void **) d_ref, n_channels, n_frames);
+	ops->to_f32p[fmt](f, (const void **) d_ref, n_channels, n_frames);
+	if (memcmp(f32, f32_ref, sizeof(f32)) != 0) {
+		printf("from %s to f32p: mismatch, %d channels %d frames\n",
+				fmt_names[fmt], n_channels, n_frames);
+		errors++;
+	}
+	return errors;
+}
+
+static int test_ops(struct conv_ops *ref, struct conv_ops *ops, uint32_t cpu_flags)
+{
+	int fmt, n_channels, n_frames, errors = 0;
+
+	for (fmt = 0; fmt < CONV_FMT_MAX; fmt++) {
+		for (n_channels = 1; n_channels <= N_CHANNELS; n_channels++) {
+			for (n_frames = 0; n_frames < N_FRAMES; n_frames += 13)
+				errors += test_fmt(ref, ops, fmt, n_channels, n_frames);
+		}
+	}
+	printf("cpu flags %08x: %d errors\n", cpu_flags, errors);
+	return errors;
+}
+
+static int test_channelmix(void)
+{
+	static float in[2][16], out[1][16];
+	const float *src[2] = { in[0], in[1] };
+	float *dst[1] = { out[0] };
+	struct channelmix mix;
+	int i, errors = 0;
+
+	channelmix_init(&mix, 2, 1);
+	for (i = 0; i < 16; i++) {
+		in[0][i] = i;
+		in[1][i] = -i * 2;
+	}
+	channelmix_process(&mix, dst, src, 16);
+	for (i = 0; i < 16; i++) {
+		if (out[0][i] != i * -0.5f) {
+			printf("channelmix: wrong downmix %f\n", out[0][i]);
+			errors++;
+		}
+	}
+	return errors;
+}
+
+/* resample a sine wave and check that it is still a sine wave of the same
+ * frequency and amplitude */
+static int test_resample(uint32_t i_rate, uint32_t o_rate, double adjust, uint32_t cpu_flags)
+{
+	static float in[2][RESAMPLE_BLOCK], out[2][RESAMPLE_BLOCK * 8];
+	struct resample r;
+	uint32_t i, n_in = 0, n_out = 0, iter, in_len, out_len, errors = 0;
+	double freq = 1000.0, err = 0.0, phase;
+	const float *src[2];
+	float *dst[2];
+	uint64_t t1, t2;
+
+	if (resample_init(&r, 2, i_rate, o_rate, cpu_flags) < 0)
+		return 1;
+	resample_update_rate(&r, adjust);
+
+	t1 = get_time_ns();
+	for (iter = 0; iter < 100; iter++) {
+		for (i = 0; i < RESAMPLE_BLOCK; i++)
+			in[0][i] = in[1][i] = sin(2.0 * M_PI * freq * (n_in + i) / i_rate);
+
+		src[0] = in[0];
+		src[1] = in[1];
+		in_len = RESAMPLE_BLOCK;
+		while (in_len > 0) {
+			uint32_t len = in_len;
+
+			dst[0] = out[0];
+			dst[1] = out[1];
+			out_len = SPA_N_ELEMENTS(out[0]);
+			resample_process(&r, src, &len, dst, &out_len);
+
+			/* skip the first samples, the filter starts from silence */
+			for (i = 0; i < out_len; i++) {
+				phase = 2.0 * M_PI * freq * (n_out + i) * adjust / o_rate;
+				if (n_out + i > 128)
+					err = SPA_MAX(err, fabs(out[0][i] - sin(phase)));
+			}
+			n_out += out_len;
+			src[0] += len;
+			src[1] += len;
+			in_len -= len;
+		}
+		n_in += RESAMPLE_BLOCK;
+	}
+	t2 = get_time_ns();
+
+	if (err > 0.01) {
+		printf("resample %d -> %d (%f): max error %f\n", i_rate, o_rate, adjust, err);
+		errors++;
+	}
+	/* the last n_taps input samples are kept in the history */
+	if (fabs(n_out - (double) n_in * o_rate / i_rate / adjust) >
+	    r.n_taps * SPA_MAX(1.0, (double) o_rate / i_rate / adjust)) {
+		printf("resample %d -> %d (%f): %d frames in, %d frames out\n",
+				i_rate, o_rate, adjust, n_in, n_out);
+		errors++;
+	}
+	printf("cpu flags %08x: resample %d -> %d (%f): %d taps, max error %f, %f usec per block\n",
+			cpu_flags, i_rate, o_rate, adjust, r.n_taps, err,
+			(t2 - t1) / (iter * 1000.0));
+
+	resample_free(&r);
+
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	struct conv_ops ref, ops;
+	uint32_t i, flags, cpu_flags, errors = 0;
+
+	cpu_flags = conv_get_cpu_flags();
+	printf("cpu flags %08x\n", cpu_flags);
+
+	conv_get_ops_cpu(&ref, 0);
+
+	for (i = 0; i < 1; i++) {
+		flags = 1 << i;
+		if ((cpu_flags & flags) == 0)
+			continue;
+
+		conv_get_ops_cpu(&ops, flags);
+		errors += test_ops(&ref, &ops, flags);
+	}
+
+	errors += test_channelmix();
+
+	for (i = 0; i < 2; i++) {
+		flags = i == 0 ? 0 : cpu_flags;
+		errors += test_resample(44100, 48000, 1.0, flags);
+		errors += test_resample(48000, 44100, 1.0, flags);
+		errors += test_resample(48000, 48000, 1.001, flags);
+		errors += test_resample(8000, 48000, 0.999, flags);
+	}
+	return errors ? 1 : 0;
+}
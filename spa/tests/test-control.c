@@ -47,7 +47,7 @@ static SPA_LOG_IMPL(default_log);
 #define spa_debug(f,...) spa_log_trace(&default_log.log, f, __VA_ARGS__)
 
 #include <spa/graph/graph.h>
-#include <spa/graph/graph-scheduler6.h>
+#include <spa/graph/graph-scheduler7.h>
 
 #include <spa/debug/pod.h>
 
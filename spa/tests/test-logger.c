@@ -0,0 +1,245 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/type-map.h>
+#include <spa/support/log.h>
+
+#define SUPPORT_LIB	"build/spa/plugins/support/libspa-support.so"
+
+#define N_THREADS	8
+#define N_MESSAGES	20
+#define N_SHORT_THREADS	64	/* more than the spare rings of the logger */
+
+struct data {
+	struct spa_type_map *map;
+	struct spa_handle *handle;
+	struct spa_log *log;
+
+	FILE *out;		/* the captured stderr of the logger */
+	int saved_fd;
+};
+
+struct thread {
+	struct data *data;
+	pthread_t thread;
+	int id;
+	int n_messages;
+};
+
+static struct spa_handle *make_handle(const char *lib, const char *name,
+				      const struct spa_dict *info,
+				      const struct spa_support *support, uint32_t n_support)
+{
+	spa_handle_factory_enum_func_t enum_func;
+	struct spa_handle *handle;
+	uint32_t i;
+	void *hnd;
+	int res;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return NULL;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return NULL;
+	}
+
+	for (i = 0;;) {
+		const struct spa_handle_factory *factory;
+
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			if (res != 0)
+				printf("can't enumerate factories: %s\n", spa_strerror(res));
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		handle = calloc(1, factory->size);
+		if ((res = spa_handle_factory_init(factory, handle, info, support, n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return NULL;
+		}
+		return handle;
+	}
+	return NULL;
+}
+
+/* make a logger in binary trace mode and send its output to a file */
+static void start_logger(struct data *d)
+{
+	struct spa_dict_item items[] = {
+		{ "log.binary-trace", "true" },
+	};
+	struct spa_dict info = SPA_DICT_INIT(items, 1);
+	struct spa_support support[] = { { SPA_TYPE__TypeMap, d->map } };
+	void *iface;
+
+	fflush(stderr);
+	spa_assert_se((d->out = tmpfile()) != NULL);
+	spa_assert_se((d->saved_fd = dup(STDERR_FILENO)) >= 0);
+	spa_assert_se(dup2(fileno(d->out), STDERR_FILENO) >= 0);
+
+	spa_assert_se((d->handle = make_handle(SUPPORT_LIB, "logger", &info, support, 1)) != NULL);
+	spa_assert_se(spa_handle_get_interface(d->handle,
+				spa_type_map_get_id(d->map, SPA_TYPE__Log), &iface) >= 0);
+	d->log = iface;
+}
+
+/* clearing the logger writes the remaining messages */
+static void stop_logger(struct data *d)
+{
+	spa_handle_clear(d->handle);
+	free(d->handle);
+
+	fflush(stderr);
+	spa_assert_se(dup2(d->saved_fd, STDERR_FILENO) >= 0);
+	close(d->saved_fd);
+	rewind(d->out);
+}
+
+static void *log_thread(void *data)
+{
+	struct thread *t = data;
+	struct spa_log *log = t->data->log;
+	char *file, *func, *fmt, *str;
+	int i;
+
+	for (i = 0; i < t->n_messages; i++) {
+		/* the logger has to copy the strings, they are gone when the
+		 * trace thread formats the message */
+		file = strdup("/path/to/test-file.c");
+		func = strdup("log_func");
+		fmt = strdup("thread %d message %d %s %.2f");
+		str = strdup("copied");
+
+		log->log(log, SPA_LOG_LEVEL_TRACE, file, 100 + i, func, fmt, t->id, i, str, 1.5);
+
+		memset(file, 'X', strlen(file));
+		memset(func, 'X', strlen(func));
+		memset(fmt, 'X', strlen(fmt));
+		memset(str, 'X', strlen(str));
+		free(file);
+		free(func);
+		free(fmt);
+		free(str);
+	}
+	return NULL;
+}
+
+/* check the captured messages and count the messages of each thread */
+static void check_output(struct data *d, int *count, int n_threads)
+{
+	char line[1024], expected[256];
+	int id, seq, lineno;
+	const char *msg;
+
+	memset(count, 0, n_threads * sizeof(int));
+
+	while (fgets(line, sizeof(line), d->out)) {
+		/* no message of the threads is dropped */
+		spa_assert_se(strncmp(line, "[T][", 4) == 0);
+
+		spa_assert_se((msg = strstr(line, "][test-file.c:")) != NULL);
+		spa_assert_se(sscanf(msg, "][test-file.c:%d log_func()] thread %d message %d",
+					&lineno, &id, &seq) == 3);
+		spa_assert_se(id >= 0 && id < n_threads);
+
+		/* the messages of a thread are written in order */
+		spa_assert_se(seq == count[id]);
+		spa_assert_se(lineno == 100 + seq);
+
+		snprintf(expected, sizeof(expected),
+				"] thread %d message %d copied 1.50\n", id, seq);
+		spa_assert_se(strstr(line, expected) != NULL);
+
+		count[id]++;
+	}
+	fclose(d->out);
+}
+
+static void test_threads(struct data *d)
+{
+	struct thread threads[N_THREADS];
+	int i, count[N_THREADS];
+
+	start_logger(d);
+	for (i = 0; i < N_THREADS; i++) {
+		threads[i].data = d;
+		threads[i].id = i;
+		threads[i].n_messages = N_MESSAGES;
+		spa_assert_se(pthread_create(&threads[i].thread, NULL, log_thread, &threads[i]) == 0);
+	}
+	for (i = 0; i < N_THREADS; i++)
+		pthread_join(threads[i].thread, NULL);
+	stop_logger(d);
+
+	check_output(d, count, N_THREADS);
+	for (i = 0; i < N_THREADS; i++)
+		spa_assert_se(count[i] == N_MESSAGES);
+}
+
+/* threads that exit give their ring to the next new thread, so a stream
+ * of short lived threads never runs out of rings */
+static void test_reclaim(struct data *d)
+{
+	struct thread thread;
+	int i, count[N_SHORT_THREADS];
+
+	start_logger(d);
+	for (i = 0; i < N_SHORT_THREADS; i++) {
+		thread.data = d;
+		thread.id = i;
+		thread.n_messages = 1;
+		spa_assert_se(pthread_create(&thread.thread, NULL, log_thread, &thread) == 0);
+		pthread_join(thread.thread, NULL);
+	}
+	stop_logger(d);
+
+	check_output(d, count, N_SHORT_THREADS);
+	for (i = 0; i < N_SHORT_THREADS; i++)
+		spa_assert_se(count[i] == 1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0, };
+	struct spa_handle *handle;
+	void *iface;
+
+	spa_assert_se((handle = make_handle(SUPPORT_LIB, "mapper", NULL, NULL, 0)) != NULL);
+	/* the mapper registers its own interface as the first type */
+	spa_assert_se(spa_handle_get_interface(handle, 0, &iface) >= 0);
+	data.map = iface;
+
+	test_threads(&data);
+	test_reclaim(&data);
+
+	return 0;
+}
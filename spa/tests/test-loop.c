@@ -0,0 +1,575 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/type-map.h>
+#include <spa/support/loop.h>
+
+#define SUPPORT_LIB	"build/spa/plugins/support/libspa-support.so"
+
+#define N_INVOKE_THREADS	4
+#define N_INVOKES		100
+#define N_WHEEL_TIMERS		2000
+#define N_QUEUED		50
+
+struct data {
+	struct spa_type_map *map;
+	struct spa_handle *handle;
+	struct spa_loop *loop;
+	struct spa_loop_control *control;
+	struct spa_loop_utils *utils;
+
+	uint32_t n_events;
+	uint64_t event_count;
+	uint32_t n_timers;
+	uint32_t n_io;
+	uint32_t n_idle;
+	int32_t n_invokes;
+	struct spa_source *idle;
+
+	bool running;
+};
+
+static inline uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static struct spa_handle *make_handle(const char *lib, const char *name,
+				      const struct spa_dict *info,
+				      const struct spa_support *support, uint32_t n_support)
+{
+	spa_handle_factory_enum_func_t enum_func;
+	struct spa_handle *handle;
+	uint32_t i;
+	void *hnd;
+	int res;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return NULL;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return NULL;
+	}
+
+	for (i = 0;;) {
+		const struct spa_handle_factory *factory;
+
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			if (res != 0)
+				printf("can't enumerate factories: %s\n", spa_strerror(res));
+			break;
+		}
+		if (strcmp(factory->name, name))
+			continue;
+
+		handle = calloc(1, factory->size);
+		if ((res = spa_handle_factory_init(factory, handle, info, support, n_support)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return NULL;
+		}
+		return handle;
+	}
+	return NULL;
+}
+
+static void *get_interface(struct data *d, const char *type)
+{
+	void *iface;
+	spa_assert_se(spa_handle_get_interface(d->handle,
+				spa_type_map_get_id(d->map, type), &iface) >= 0);
+	return iface;
+}
+
+static void make_loop(struct data *d, const char *backend, const char *slack)
+{
+	struct spa_dict_item items[] = {
+		{ "loop.backend", backend },
+		{ "loop.timer-slack", slack },
+	};
+	struct spa_dict info = SPA_DICT_INIT(items, slack ? 2 : 1);
+	struct spa_support support[] = { { SPA_TYPE__TypeMap, d->map } };
+
+	spa_assert_se((d->handle = make_handle(SUPPORT_LIB, "loop", &info, support, 1)) != NULL);
+	d->loop = get_interface(d, SPA_TYPE__Loop);
+	d->control = get_interface(d, SPA_TYPE__LoopControl);
+	d->utils = get_interface(d, SPA_TYPE__LoopUtils);
+}
+
+static void on_event(void *data, uint64_t count)
+{
+	struct data *d = data;
+	d->n_events++;
+	d->event_count += count;
+}
+
+static void on_timer(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+	d->n_timers++;
+}
+
+static void on_io(void *data, int fd, enum spa_io mask)
+{
+	struct data *d = data;
+	char buf[16];
+
+	/* sources are level triggered, only read the data the third time */
+	if (++d->n_io == 3 && (mask & SPA_IO_IN))
+		spa_assert_se(read(fd, buf, sizeof(buf)) > 0);
+}
+
+static void on_idle(void *data)
+{
+	struct data *d = data;
+	if (++d->n_idle == 3)
+		spa_loop_utils_enable_idle(d->utils, d->idle, false);
+}
+
+static void iterate(struct data *d, int n, int timeout)
+{
+	while (n-- > 0)
+		spa_loop_control_iterate(d->control, timeout);
+}
+
+/* signals are counted and arrive in one dispatch, a new source on the
+ * fd of a destroyed one works */
+static void test_event(struct data *d)
+{
+	struct spa_source *source;
+	uint32_t n;
+
+	source = spa_loop_utils_add_event(d->utils, on_event, d);
+	spa_loop_utils_signal_event(d->utils, source);
+	spa_loop_utils_signal_event(d->utils, source);
+	iterate(d, 5, 10);
+	spa_assert_se(d->event_count == 2);
+
+	spa_loop_utils_signal_event(d->utils, source);
+	iterate(d, 1, 100);
+	spa_assert_se(d->event_count == 3);
+
+	spa_loop_utils_destroy_source(d->utils, source);
+	source = spa_loop_utils_add_event(d->utils, on_event, d);
+	n = d->n_events;
+	spa_loop_utils_signal_event(d->utils, source);
+	iterate(d, 1, 100);
+	spa_assert_se(d->n_events == n + 1);
+	spa_loop_utils_destroy_source(d->utils, source);
+}
+
+/* iterate waits for the timeout without sources, timers repeat until
+ * they are disarmed */
+static void test_timer(struct data *d)
+{
+	struct spa_source *source;
+	struct timespec value = { 0, 5 * SPA_NSEC_PER_MSEC };
+	uint64_t start, elapsed;
+
+	/* the cancelled requests of destroyed sources can wake up the loop */
+	iterate(d, 2, 0);
+
+	start = get_time();
+	iterate(d, 1, 50);
+	elapsed = (get_time() - start) / SPA_NSEC_PER_MSEC;
+	spa_assert_se(elapsed >= 45 && elapsed < 500);
+
+	source = spa_loop_utils_add_timer(d->utils, on_timer, d);
+	spa_loop_utils_update_timer(d->utils, source, &value, &value, false);
+	while (d->n_timers < 5)
+		iterate(d, 1, 100);
+
+	spa_loop_utils_update_timer(d->utils, source, NULL, NULL, false);
+	d->n_timers = 0;
+	iterate(d, 1, 20);
+	spa_assert_se(d->n_timers == 0);
+	spa_loop_utils_destroy_source(d->utils, source);
+}
+
+struct wheel_timer {
+	struct data *d;
+	struct spa_source *source;
+	uint64_t due;
+	uint64_t interval;
+	bool armed;
+};
+
+static struct wheel_timer wheel_timers[N_WHEEL_TIMERS];
+
+static void arm_wheel_timer(struct wheel_timer *t, uint64_t delay, uint64_t interval)
+{
+	struct timespec value, ival;
+
+	value.tv_sec = delay / SPA_NSEC_PER_SEC;
+	value.tv_nsec = delay % SPA_NSEC_PER_SEC;
+	ival.tv_sec = interval / SPA_NSEC_PER_SEC;
+	ival.tv_nsec = interval % SPA_NSEC_PER_SEC;
+
+	/* the loop takes its own time later, it can only expire after this */
+	t->due = get_time() + delay;
+	t->interval = interval;
+	t->armed = true;
+	spa_loop_utils_update_timer(t->d->utils, t->source, &value,
+				    interval ? &ival : NULL, false);
+}
+
+static void on_wheel_timer(void *data, uint64_t expirations)
+{
+	struct wheel_timer *t = data, *o;
+	uint64_t now = get_time();
+
+	/* never early and never after it was disarmed */
+	spa_assert_se(t->armed);
+	spa_assert_se(now >= t->due);
+	spa_assert_se(expirations > 0);
+	t->d->n_timers++;
+
+	if (t->interval)
+		t->due += expirations * t->interval;
+	else
+		t->armed = false;
+
+	/* change other timers and ourselves from the callback */
+	switch (rand() % 10) {
+	case 0:
+		o = &wheel_timers[rand() % N_WHEEL_TIMERS];
+		if (o->source)
+			spa_loop_utils_update_timer(t->d->utils, o->source, NULL, NULL, false);
+		o->armed = false;
+		break;
+	case 1:
+		if (!t->interval)
+			arm_wheel_timer(t, (rand() % 50 + 1) * SPA_NSEC_PER_MSEC, 0);
+		break;
+	}
+}
+
+/* many timers with random delays and intervals that are changed from the
+ * callbacks fire in time on the wheel with the given slack */
+static void test_wheel(struct data *d, uint64_t slack)
+{
+	uint64_t end, delay, interval;
+	uint32_t i;
+
+	srand(1);
+	d->n_timers = 0;
+
+	for (i = 0; i < N_WHEEL_TIMERS; i++) {
+		struct wheel_timer *t = &wheel_timers[i];
+
+		t->d = d;
+		t->source = spa_loop_utils_add_timer(d->utils, on_wheel_timer, t);
+		/* sub-tick delays on many levels of the wheel */
+		delay = (rand() % 1000) * SPA_NSEC_PER_MSEC + rand() % SPA_NSEC_PER_MSEC + 1;
+		interval = i % 5 == 0 ? (rand() % 100 + 10) * SPA_NSEC_PER_MSEC : 0;
+		arm_wheel_timer(t, delay, interval);
+	}
+	for (i = 1; i < N_WHEEL_TIMERS; i += 97) {
+		spa_loop_utils_destroy_source(d->utils, wheel_timers[i].source);
+		wheel_timers[i].source = NULL;
+		wheel_timers[i].armed = false;
+	}
+
+	end = get_time() + 1500 * SPA_NSEC_PER_MSEC;
+	while (get_time() < end)
+		iterate(d, 1, 100);
+	/* most one-shot timers expire in the first second */
+	spa_assert_se(d->n_timers > N_WHEEL_TIMERS / 2);
+
+	/* one-shot timers that are still armed were not due yet */
+	end = get_time() - 2 * slack - 5 * SPA_NSEC_PER_MSEC;
+	for (i = 0; i < N_WHEEL_TIMERS; i++) {
+		struct wheel_timer *t = &wheel_timers[i];
+
+		if (t->source == NULL)
+			continue;
+		spa_assert_se(!t->armed || t->interval || t->due >= end);
+		spa_loop_utils_destroy_source(d->utils, t->source);
+	}
+	memset(wheel_timers, 0, sizeof(wheel_timers));
+}
+
+/* io is level triggered and the mask can be changed */
+static void test_io(struct data *d)
+{
+	struct spa_source *in, *out;
+	int fds[2];
+	uint32_t n;
+
+	spa_assert_se(pipe(fds) == 0);
+
+	in = spa_loop_utils_add_io(d->utils, fds[0], SPA_IO_IN, false, on_io, d);
+	spa_assert_se(write(fds[1], "x", 1) == 1);
+	iterate(d, 5, 20);
+	spa_assert_se(d->n_io == 3);
+
+	out = spa_loop_utils_add_io(d->utils, fds[1], 0, false, on_io, d);
+	iterate(d, 1, 20);
+	spa_assert_se(d->n_io == 3);
+	spa_loop_utils_update_io(d->utils, out, SPA_IO_OUT);
+	n = d->n_io;
+	iterate(d, 1, 20);
+	spa_assert_se(d->n_io == n + 1);
+
+	spa_loop_utils_destroy_source(d->utils, out);
+	spa_loop_utils_destroy_source(d->utils, in);
+	close(fds[0]);
+	close(fds[1]);
+}
+
+static void test_idle(struct data *d)
+{
+	d->idle = spa_loop_utils_add_idle(d->utils, true, on_idle, d);
+	iterate(d, 6, 10);
+	spa_assert_se(d->n_idle == 3);
+	spa_loop_utils_destroy_source(d->utils, d->idle);
+}
+
+static int do_invoke(struct spa_loop *loop, bool async, uint32_t seq,
+		     const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	__atomic_add_fetch(&d->n_invokes, 1, __ATOMIC_SEQ_CST);
+	return 42;
+}
+
+static void *loop_thread(void *data)
+{
+	struct data *d = data;
+
+	spa_loop_control_enter(d->control);
+	while (__atomic_load_n(&d->running, __ATOMIC_SEQ_CST))
+		spa_loop_control_iterate(d->control, 10);
+	spa_loop_control_leave(d->control);
+
+	return NULL;
+}
+
+static void *invoke_thread(void *data)
+{
+	struct data *d = data;
+	int i;
+
+	for (i = 0; i < N_INVOKES; i++)
+		spa_assert_se(spa_loop_invoke(d->loop, do_invoke, 1, NULL, 0, true, d) == 42);
+
+	return NULL;
+}
+
+/* blocking invokes from other threads run in the loop thread */
+static void test_invoke(struct data *d)
+{
+	pthread_t loop, threads[N_INVOKE_THREADS];
+	int i;
+
+	d->running = true;
+	spa_assert_se(pthread_create(&loop, NULL, loop_thread, d) == 0);
+
+	for (i = 0; i < N_INVOKE_THREADS; i++)
+		spa_assert_se(pthread_create(&threads[i], NULL, invoke_thread, d) == 0);
+	for (i = 0; i < N_INVOKE_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	spa_assert_se(d->n_invokes == N_INVOKE_THREADS * N_INVOKES);
+
+	__atomic_store_n(&d->running, false, __ATOMIC_SEQ_CST);
+	pthread_join(loop, NULL);
+}
+
+static int do_queued(struct spa_loop *loop, bool async, uint32_t seq,
+		     const void *data, size_t size, void *user_data)
+{
+	struct data *d = user_data;
+	__atomic_add_fetch(&d->n_invokes, 1, __ATOMIC_SEQ_CST);
+	return seq == SPA_ID_INVALID ? 0 : seq;
+}
+
+static void start_loop(struct data *d, pthread_t *thread)
+{
+	d->running = true;
+	spa_assert_se(pthread_create(thread, NULL, loop_thread, d) == 0);
+}
+
+static void stop_loop(struct data *d, pthread_t thread)
+{
+	__atomic_store_n(&d->running, false, __ATOMIC_SEQ_CST);
+	pthread_join(thread, NULL);
+}
+
+static void *queue_thread(void *data)
+{
+	struct data **d = data;
+	struct spa_loop_completion completion;
+	int i, j;
+
+	for (i = 0; i < N_INVOKES; i++) {
+		completion = SPA_LOOP_COMPLETION_INIT;
+		for (j = 0; j < 2; j++)
+			spa_assert_se(spa_loop_invoke_queue(d[j]->loop, do_queued, SPA_ID_INVALID,
+						    NULL, 0, d[j], &completion) == 0);
+		spa_assert_se(spa_loop_invoke_wait(d[0]->loop, &completion) == 0);
+		spa_assert_se(completion.pending == 0);
+	}
+	return NULL;
+}
+
+/* one completion waits for functions queued on two loops, from other
+ * threads, from the thread of the loop and on a full queue */
+static void test_invoke_queue(struct data *d, struct data *d2)
+{
+	struct data *loops[2] = { d, d2 };
+	struct spa_loop_completion completion = SPA_LOOP_COMPLETION_INIT;
+	pthread_t t1, t2, threads[N_INVOKE_THREADS];
+	uint8_t buffer[1024] = { 0 };
+	int i, res, n_queued;
+
+	d->n_invokes = d2->n_invokes = 0;
+
+	/* the functions are called when the loops run, the result is the
+	 * one of the function that did not return 0 */
+	for (i = 0; i < N_QUEUED; i++) {
+		spa_assert_se(spa_loop_invoke_queue(d->loop, do_queued, SPA_ID_INVALID,
+					    NULL, 0, d, &completion) == 0);
+		spa_assert_se(spa_loop_invoke_queue(d2->loop, do_queued, i == 10 ? 7 : SPA_ID_INVALID,
+					    NULL, 0, d2, &completion) >= 0);
+	}
+	spa_assert_se(completion.pending == 2 * N_QUEUED);
+	spa_assert_se(d->n_invokes == 0 && d2->n_invokes == 0);
+
+	start_loop(d, &t1);
+	start_loop(d2, &t2);
+	spa_assert_se(spa_loop_invoke_wait(d->loop, &completion) == 7);
+	spa_assert_se(completion.pending == 0);
+	spa_assert_se(d->n_invokes == N_QUEUED && d2->n_invokes == N_QUEUED);
+
+	/* many threads queue on both loops at the same time */
+	for (i = 0; i < N_INVOKE_THREADS; i++)
+		spa_assert_se(pthread_create(&threads[i], NULL, queue_thread, loops) == 0);
+	for (i = 0; i < N_INVOKE_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	spa_assert_se(d->n_invokes == N_QUEUED + N_INVOKE_THREADS * N_INVOKES);
+	spa_assert_se(d2->n_invokes == N_QUEUED + N_INVOKE_THREADS * N_INVOKES);
+
+	stop_loop(d, t1);
+	stop_loop(d2, t2);
+
+	/* in the thread of the loop, the function is called right away */
+	completion = SPA_LOOP_COMPLETION_INIT;
+	spa_loop_control_enter(d->control);
+	spa_assert_se(spa_loop_invoke_queue(d->loop, do_queued, 3, NULL, 0, d, &completion) == 3);
+	spa_assert_se(completion.pending == 0);
+	spa_assert_se(spa_loop_invoke_wait(d->loop, &completion) == 3);
+	spa_loop_control_leave(d->control);
+
+	/* a full queue fails without changing the completion */
+	completion = SPA_LOOP_COMPLETION_INIT;
+	for (n_queued = 0;; n_queued++) {
+		res = spa_loop_invoke_queue(d->loop, do_queued, SPA_ID_INVALID,
+					    buffer, sizeof(buffer), d, &completion);
+		if (res < 0)
+			break;
+	}
+	spa_assert_se(res == -EPIPE && n_queued > 0);
+	spa_assert_se(completion.pending == n_queued);
+
+	d->n_invokes = 0;
+	spa_loop_control_enter(d->control);
+	for (i = 0; i < 10 && d->n_invokes < n_queued; i++)
+		iterate(d, 1, 10);
+	spa_loop_control_leave(d->control);
+	spa_assert_se(d->n_invokes == n_queued);
+	spa_assert_se(spa_loop_invoke_wait(d->loop, &completion) == 0);
+
+	/* and there is room again */
+	start_loop(d, &t1);
+	spa_assert_se(spa_loop_invoke(d->loop, do_queued, 5, buffer, sizeof(buffer), true, d) == 5);
+	stop_loop(d, t1);
+}
+
+static void test_backend(struct spa_type_map *map, const char *backend)
+{
+	struct data d = { map, }, d2 = { map, };
+
+	make_loop(&d, backend, NULL);
+
+	spa_loop_control_enter(d.control);
+	test_event(&d);
+	test_timer(&d);
+	test_io(&d);
+	test_idle(&d);
+	test_wheel(&d, SPA_NSEC_PER_MSEC);
+	spa_loop_control_leave(d.control);
+
+	test_invoke(&d);
+
+	make_loop(&d2, backend, NULL);
+	test_invoke_queue(&d, &d2);
+	spa_handle_clear(d2.handle);
+	free(d2.handle);
+
+	spa_handle_clear(d.handle);
+	free(d.handle);
+
+	/* a short tick puts the same timers on more levels */
+	make_loop(&d, backend, "50000");
+	spa_loop_control_enter(d.control);
+	test_wheel(&d, 50 * SPA_NSEC_PER_USEC);
+	spa_loop_control_leave(d.control);
+
+	spa_handle_clear(d.handle);
+	free(d.handle);
+
+	printf("%s: ok\n", backend);
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_handle *handle;
+	struct spa_type_map *map;
+	void *iface;
+	int i;
+
+	spa_assert_se((handle = make_handle(SUPPORT_LIB, "mapper", NULL, NULL, 0)) != NULL);
+	/* the mapper registers its own interface as the first type */
+	spa_assert_se(spa_handle_get_interface(handle, 0, &iface) >= 0);
+	map = iface;
+
+	/* io_uring falls back to epoll when the kernel can't do it */
+	if (argc > 1) {
+		for (i = 1; i < argc; i++)
+			test_backend(map, argv[i]);
+	} else {
+		test_backend(map, "epoll");
+		test_backend(map, "io_uring");
+	}
+	return 0;
+}
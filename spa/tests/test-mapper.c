@@ -0,0 +1,126 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <time.h>
+
+#include <spa/support/plugin.h>
+#include <spa/support/type-map.h>
+
+#define MAX_TYPES	2048
+
+static inline uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+static struct spa_type_map *make_mapper(const char *lib)
+{
+	spa_handle_factory_enum_func_t enum_func;
+	struct spa_handle *handle;
+	uint32_t i;
+	void *hnd, *iface;
+	int res;
+
+	if ((hnd = dlopen(lib, RTLD_NOW)) == NULL) {
+		printf("can't load %s: %s\n", lib, dlerror());
+		return NULL;
+	}
+	if ((enum_func = dlsym(hnd, SPA_HANDLE_FACTORY_ENUM_FUNC_NAME)) == NULL) {
+		printf("can't find enum function\n");
+		return NULL;
+	}
+
+	for (i = 0;;) {
+		const struct spa_handle_factory *factory;
+
+		if ((res = enum_func(&factory, &i)) <= 0) {
+			if (res != 0)
+				printf("can't enumerate factories: %s\n", spa_strerror(res));
+			break;
+		}
+		if (strcmp(factory->name, "mapper"))
+			continue;
+
+		handle = calloc(1, factory->size);
+		if ((res = spa_handle_factory_init(factory, handle, NULL, NULL, 0)) < 0) {
+			printf("can't make factory instance: %d\n", res);
+			return NULL;
+		}
+		/* the mapper registers its own interface as the first type */
+		if ((res = spa_handle_get_interface(handle, 0, &iface)) < 0) {
+			printf("can't get interface %d\n", res);
+			return NULL;
+		}
+		return iface;
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_type_map *map;
+	static char names[MAX_TYPES][64];
+	uint32_t ids[MAX_TYPES], i, j, n_types = MAX_TYPES, loops = 100;
+	uint64_t start, elapsed;
+
+	if (argc > 1)
+		n_types = SPA_CLAMP(atoi(argv[1]), 1, MAX_TYPES);
+
+	if ((map = make_mapper("build/spa/plugins/support/libspa-support.so")) == NULL)
+		return -1;
+
+	for (i = 0; i < n_types; i++)
+		snprintf(names[i], sizeof(names[i]), SPA_TYPE_BASE "Test:Type:%u:name", i);
+
+	start = get_time();
+	for (i = 0; i < n_types; i++)
+		ids[i] = spa_type_map_get_id(map, names[i]);
+	elapsed = get_time() - start;
+	printf("register %u types: %8.1f ns/type\n", n_types, (double) elapsed / n_types);
+
+	for (i = 0; i < n_types; i++) {
+		const char *type = spa_type_map_get_type(map, ids[i]);
+		if (type == NULL || strcmp(type, names[i]) != 0) {
+			printf("type %u: wrong name for id %u\n", i, ids[i]);
+			return -1;
+		}
+	}
+
+	start = get_time();
+	for (j = 0; j < loops; j++) {
+		for (i = 0; i < n_types; i++) {
+			if (spa_type_map_get_id(map, names[i]) != ids[i]) {
+				printf("type %u: wrong id\n", i);
+				return -1;
+			}
+		}
+	}
+	elapsed = get_time() - start;
+	printf("lookup %u types:   %8.1f ns/lookup\n", n_types,
+	       (double) elapsed / (n_types * loops));
+
+	return 0;
+}
@@ -0,0 +1,147 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <spa/utils/defs.h>
+
+#include "mix-ops.h"
+#include "test-ops.h"
+
+/* compares the optimized mixer functions against the generic C versions,
+ * the results must be bit exact */
+
+#define N_BYTES		(4096 + 3 * 8)
+#define N_PORTS		128
+#define N_SAMPLES	1024
+
+static const char *fmt_names[FMT_MAX] = { "s16", "f32", "s32", "f64" };
+static const int fmt_sizes[FMT_MAX] = { sizeof(int16_t), sizeof(float), sizeof(int32_t), sizeof(double) };
+
+static const double scales[] = { 1.0, 0.5, 0.3333, 1.7, -0.75, 15.99, 17.5, 0.0 };
+
+static uint8_t src[N_BYTES + 64], dst_ref[N_BYTES + 64], dst[N_BYTES + 64], init[N_BYTES + 64];
+
+static void fill_random(int fmt, void *data, int n_bytes)
+{
+	switch (fmt) {
+	case FMT_F32:
+		fill_random_f32(data, n_bytes / sizeof(float), 1.0f);
+		break;
+	case FMT_F64:
+		fill_random_f64(data, n_bytes / sizeof(double), 1.0);
+		break;
+	default:
+		fill_random_bytes(data, n_bytes);
+		break;
+	}
+}
+
+static int check(const char *name, int fmt, int offset, int n_bytes, double scale)
+{
+	if (memcmp(dst_ref, dst, sizeof(dst)) != 0) {
+		printf("%s %s: mismatch, offset %d, %d bytes, scale %f\n",
+				name, fmt_names[fmt], offset, n_bytes, scale);
+		return 1;
+	}
+	return 0;
+}
+
+static int test_ops(struct spa_audiomixer_ops *ref, struct spa_audiomixer_ops *ops, uint32_t cpu_flags)
+{
+	int fmt, offset, size, i, errors = 0;
+
+	for (fmt = 0; fmt < FMT_MAX; fmt++) {
+		for (offset = 0; offset < 8 * fmt_sizes[fmt]; offset += fmt_sizes[fmt]) {
+			for (size = 0; size < N_BYTES - offset; size += fmt_sizes[fmt] * 7) {
+				fill_random(fmt, src, sizeof(src));
+				fill_random(fmt, init, sizeof(init));
+
+				memcpy(dst_ref, init, sizeof(init));
+				memcpy(dst, init, sizeof(init));
+				ref->add[fmt](dst_ref + offset, src + offset, size);
+				ops->add[fmt](dst + offset, src + offset, size);
+				errors += check("add", fmt, offset, size, 1.0);
+
+				for (i = 0; i < SPA_N_ELEMENTS(scales); i++) {
+					memcpy(dst_ref, init, sizeof(init));
+					memcpy(dst, init, sizeof(init));
+					ref->copy_scale[fmt](dst_ref + offset, src + offset, scales[i], size);
+					ops->copy_scale[fmt](dst + offset, src + offset, scales[i], size);
+					errors += check("copy_scale", fmt, offset, size, scales[i]);
+
+					memcpy(dst_ref, init, sizeof(init));
+					memcpy(dst, init, sizeof(init));
+					ref->add_scale[fmt](dst_ref + offset, src + offset, scales[i], size);
+					ops->add_scale[fmt](dst + offset, src + offset, scales[i], size);
+					errors += check("add_scale", fmt, offset, size, scales[i]);
+				}
+			}
+		}
+	}
+	printf("cpu flags %08x: %d errors\n", cpu_flags, errors);
+	return errors;
+}
+
+/* mix N_PORTS ports of N_SAMPLES stereo samples, like the audiomixer does */
+static void bench_ops(struct spa_audiomixer_ops *ops, uint32_t cpu_flags)
+{
+	static float in[N_PORTS][N_SAMPLES * 2], out[N_SAMPLES * 2];
+	int fmt = FMT_F32, i, j, n_iter = 100;
+	uint64_t t1, t2;
+
+	for (i = 0; i < N_PORTS; i++)
+		fill_random(fmt, in[i], sizeof(in[i]));
+
+	t1 = get_time_ns();
+	for (j = 0; j < n_iter; j++) {
+		ops->copy[fmt](out, in[0], sizeof(out));
+		for (i = 1; i < N_PORTS; i++)
+			ops->add_scale[fmt](out, in[i], 0.5, sizeof(out));
+	}
+	t2 = get_time_ns();
+
+	printf("cpu flags %08x: mixing %d ports: %f usec per cycle\n", cpu_flags, N_PORTS,
+			(t2 - t1) / (n_iter * 1000.0));
+}
+
+int main(int argc, char *argv[])
+{
+	struct spa_audiomixer_ops ref, ops;
+	uint32_t i, flags, cpu_flags, errors = 0;
+
+	cpu_flags = spa_audiomixer_get_cpu_flags();
+	printf("cpu flags %08x\n", cpu_flags);
+
+	spa_audiomixer_get_ops_cpu(&ref, 0);
+	bench_ops(&ref, 0);
+
+	for (i = 0; i < 3; i++) {
+		flags = 1 << i;
+		if ((cpu_flags & flags) == 0)
+			continue;
+
+		spa_audiomixer_get_ops_cpu(&ops, flags);
+		errors += test_ops(&ref, &ops, flags);
+		bench_ops(&ops, flags);
+	}
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* helpers for the tests that compare the optimized functions of a plugin
+ * against the generic C versions */
+
+#include <stdlib.h>
+#include <time.h>
+
+#include <spa/utils/defs.h>
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * SPA_NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* random integer samples of any size */
+static inline void fill_random_bytes(void *data, int n_bytes)
+{
+	uint8_t *d = data;
+	int i;
+
+	for (i = 0; i < n_bytes; i++)
+		d[i] = rand();
+}
+
+/* random samples between -range and range */
+static inline void fill_random_f32(float *d, int n_samples, float range)
+{
+	int i;
+
+	for (i = 0; i < n_samples; i++)
+		d[i] = (rand() / (float) RAND_MAX) * 2.0f * range - range;
+}
+
+static inline void fill_random_f64(double *d, int n_samples, double range)
+{
+	int i;
+
+	for (i = 0; i < n_samples; i++)
+		d[i] = (rand() / (double) RAND_MAX) * 2.0 * range - range;
+}
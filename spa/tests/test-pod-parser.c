@@ -0,0 +1,239 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <spa/pod/pod.h>
+#include <spa/pod/builder.h>
+#include <spa/pod/parser.h>
+
+struct message {
+	uint8_t buffer[1024];
+	struct spa_pod_builder b;
+};
+
+static void message_init(struct message *m)
+{
+	memset(m->buffer, 0xaa, sizeof(m->buffer));
+	m->b = SPA_POD_BUILDER_INIT(m->buffer, sizeof(m->buffer));
+}
+
+static struct spa_pod *make_object(struct message *m)
+{
+	m->b = SPA_POD_BUILDER_INIT(m->buffer, sizeof(m->buffer));
+	spa_pod_builder_push_object(&m->b, 0, 1);
+	spa_pod_builder_push_prop(&m->b, 2, 0);
+	spa_pod_builder_int(&m->b, 42);
+	spa_pod_builder_pop(&m->b);
+	spa_pod_builder_pop(&m->b);
+	return (struct spa_pod *) m->buffer;
+}
+
+/* the fields of a client-node port_update and port_use_buffers message */
+static void build_varargs(struct spa_pod_builder *b, const struct spa_pod *param)
+{
+	spa_pod_builder_add(b,
+			    "[",
+			    "i", 1,
+			    "i", 7,
+			    "I", 3,
+			    "i", 2, NULL);
+	spa_pod_builder_add(b, "P", param, NULL);
+	spa_pod_builder_add(b, "P", NULL, NULL);
+	spa_pod_builder_add(b,
+			    "[",
+			    "i", 0x10,
+			    "i", 48000,
+			    "i", 2, NULL);
+	spa_pod_builder_add(b,
+			    "s", "key",
+			    "s", "value", NULL);
+	spa_pod_builder_add(b,
+			    "s", "unset",
+			    "s", NULL, NULL);
+	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_add(b,
+			    "b", true,
+			    "l", (int64_t) 1 << 40,
+			    "i", -1, NULL);
+	spa_pod_builder_add(b, "]", NULL);
+}
+
+static void build_typed(struct spa_pod_builder *b, const struct spa_pod *param)
+{
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, 1);
+	spa_pod_builder_int(b, 7);
+	spa_pod_builder_id(b, 3);
+	spa_pod_builder_int(b, 2);
+	spa_pod_builder_pod(b, param);
+	spa_pod_builder_pod(b, NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, 0x10);
+	spa_pod_builder_int(b, 48000);
+	spa_pod_builder_int(b, 2);
+	spa_pod_builder_string(b, "key");
+	spa_pod_builder_string(b, "value");
+	spa_pod_builder_string(b, "unset");
+	spa_pod_builder_none(b);
+	spa_pod_builder_pop(b);
+	spa_pod_builder_bool(b, true);
+	spa_pod_builder_long(b, (int64_t) 1 << 40);
+	spa_pod_builder_int(b, -1);
+	spa_pod_builder_pop(b);
+}
+
+/* a message built with the typed calls is byte-identical to the varargs one */
+static void test_wire(void)
+{
+	struct message obj, m1, m2;
+	struct spa_pod *param = make_object(&obj);
+
+	message_init(&m1);
+	message_init(&m2);
+
+	build_varargs(&m1.b, param);
+	build_typed(&m2.b, param);
+
+	spa_assert_se(m1.b.state.offset == m2.b.state.offset);
+	spa_assert_se(m1.b.state.offset == SPA_POD_SIZE((struct spa_pod *) m1.buffer));
+	spa_assert_se(memcmp(m1.buffer, m2.buffer, sizeof(m1.buffer)) == 0);
+
+	printf("wire: ok\n");
+}
+
+static void test_typed(void)
+{
+	struct message obj, m;
+	struct spa_pod *param = make_object(&obj), *pod, *info;
+	struct spa_pod_parser prs, p2;
+	int32_t i1, i2, n_params, n_items, flags, rate, last;
+	uint32_t id;
+	int64_t l;
+	bool active;
+	const char *key, *value;
+
+	message_init(&m);
+	build_typed(&m.b, param);
+
+	spa_pod_parser_init(&prs, m.buffer, m.b.state.offset, 0);
+
+	/* fields can only be read inside the struct */
+	spa_assert_se(spa_pod_parser_get_int(&prs, &i1) == -ESRCH);
+	spa_assert_se(spa_pod_parser_pop(&prs) == -EINVAL);
+	spa_assert_se(spa_pod_parser_push_struct(&prs) == 0);
+
+	spa_assert_se(spa_pod_parser_get_int(&prs, &i1) == 0 && i1 == 1);
+	spa_assert_se(spa_pod_parser_get_int(&prs, &i2) == 0 && i2 == 7);
+
+	/* a wrong type fails and doesn't advance */
+	spa_assert_se(spa_pod_parser_get_int(&prs, &i1) == -ESRCH);
+	spa_assert_se(spa_pod_parser_get_string(&prs, &key) == -ESRCH);
+	spa_assert_se(spa_pod_parser_get_object(&prs, &pod) == -ESRCH);
+	spa_assert_se(spa_pod_parser_get_id(&prs, &id) == 0 && id == 3);
+
+	spa_assert_se(spa_pod_parser_get_int(&prs, &n_params) == 0 && n_params == 2);
+	spa_assert_se(spa_pod_parser_get_object(&prs, &pod) == 0);
+	spa_assert_se(pod != NULL && SPA_POD_SIZE(pod) == SPA_POD_SIZE(param));
+	spa_assert_se(memcmp(pod, param, SPA_POD_SIZE(param)) == 0);
+	/* NONE is parsed as a NULL object */
+	spa_assert_se(spa_pod_parser_get_object(&prs, &pod) == 0 && pod == NULL);
+
+	/* a struct can be taken as a pod and parsed on its own */
+	spa_assert_se(spa_pod_parser_get_object(&prs, &info) == -ESRCH);
+	spa_assert_se(spa_pod_parser_get_struct(&prs, &info) == 0 && info != NULL);
+	spa_assert_se(SPA_POD_TYPE(info) == SPA_POD_TYPE_STRUCT);
+
+	spa_pod_parser_pod(&p2, info);
+	spa_assert_se(spa_pod_parser_push_struct(&p2) == 0);
+	spa_assert_se(spa_pod_parser_get_int(&p2, &flags) == 0 && flags == 0x10);
+	spa_assert_se(spa_pod_parser_get_int(&p2, &rate) == 0 && rate == 48000);
+	spa_assert_se(spa_pod_parser_get_int(&p2, &n_items) == 0 && n_items == 2);
+	spa_assert_se(spa_pod_parser_get_string(&p2, &key) == 0 && strcmp(key, "key") == 0);
+	spa_assert_se(spa_pod_parser_get_string(&p2, &value) == 0 && strcmp(value, "value") == 0);
+	spa_assert_se(spa_pod_parser_get_string(&p2, &key) == 0 && strcmp(key, "unset") == 0);
+
+	/* the struct can't be left before all fields are read */
+	spa_assert_se(spa_pod_parser_pop(&p2) == -EINVAL);
+	spa_assert_se(spa_pod_parser_get_string(&p2, &value) == 0 && value == NULL);
+	spa_assert_se(spa_pod_parser_get_string(&p2, &value) == -ESRCH);
+	spa_assert_se(spa_pod_parser_pop(&p2) == 0);
+
+	spa_assert_se(spa_pod_parser_get_bool(&prs, &active) == 0 && active);
+	spa_assert_se(spa_pod_parser_get_long(&prs, &l) == 0 && l == (int64_t) 1 << 40);
+	spa_assert_se(spa_pod_parser_pop(&prs) == -EINVAL);
+	spa_assert_se(spa_pod_parser_get_int(&prs, &last) == 0 && last == -1);
+	spa_assert_se(spa_pod_parser_pop(&prs) == 0);
+
+	/* the message is done */
+	spa_assert_se(spa_pod_parser_current(&prs) == NULL);
+	spa_assert_se(spa_pod_parser_get_pod(&prs, &pod) == -ESRCH);
+
+	printf("typed: ok\n");
+}
+
+/* the typed calls read what the varargs parser reads */
+static void test_compat(void)
+{
+	struct message obj, m;
+	struct spa_pod *param = make_object(&obj), *p1, *p2, *info;
+	struct spa_pod_parser prs;
+	int32_t i1, i2, n_params, last;
+	uint32_t id;
+	int64_t l;
+	int active;
+
+	message_init(&m);
+	build_typed(&m.b, param);
+
+	spa_pod_parser_init(&prs, m.buffer, m.b.state.offset, 0);
+	spa_assert_se(spa_pod_parser_get(&prs,
+			"["
+			"i", &i1,
+			"i", &i2,
+			"I", &id,
+			"i", &n_params,
+			"O", &p1,
+			"O", &p2,
+			"T", &info,
+			"b", &active,
+			"l", &l,
+			"i", &last,
+			"]", NULL) == 0);
+
+	spa_assert_se(i1 == 1 && i2 == 7 && id == 3 && n_params == 2);
+	spa_assert_se(p1 != NULL && memcmp(p1, param, SPA_POD_SIZE(param)) == 0);
+	spa_assert_se(p2 == NULL);
+	spa_assert_se(info != NULL && SPA_POD_TYPE(info) == SPA_POD_TYPE_STRUCT);
+	spa_assert_se(active && l == (int64_t) 1 << 40 && last == -1);
+
+	printf("compat: ok\n");
+}
+
+int main(int argc, char *argv[])
+{
+	test_wire();
+	test_typed();
+	test_compat();
+
+	return 0;
+}
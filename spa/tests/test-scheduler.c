@@ -0,0 +1,553 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include <spa/node/node.h>
+#include <spa/graph/graph.h>
+#include <spa/graph/graph-scheduler7.h>
+
+#define MAX_PORTS	16
+#define DEEP_NODES	20000
+#define WIDE_NODES	8
+#define WIDE_CYCLES	2000
+#define OVERFLOW_PAIRS	(SPA_GRAPH_MAX_DEFERRED + 32)
+
+/* a node that produces a buffer on all its outputs when all its inputs
+ * have a buffer, sources always produce, sinks end the cycle */
+struct test_node {
+	struct spa_node node;
+	struct spa_graph_node gnode;
+	struct spa_graph_port in[MAX_PORTS];
+	struct spa_graph_port out[MAX_PORTS];
+	uint32_t n_in;
+	uint32_t n_out;
+
+	uint32_t position;		/* in the sorted order */
+	uint32_t processed;		/* in the cycle */
+	uint32_t n_process_input;
+
+	bool callbacks;			/* call back into the graph when processed */
+	uint32_t n_reuse;		/* buffers given back by the peers */
+};
+
+struct data {
+	struct spa_graph graph;
+	struct spa_graph_data graph_data;
+	uint32_t processed;
+};
+
+static struct data data;
+
+static int node_process_input(struct spa_node *node)
+{
+	struct test_node *n = SPA_CONTAINER_OF(node, struct test_node, node);
+	uint32_t i;
+
+	n->processed = __atomic_add_fetch(&data.processed, 1, __ATOMIC_SEQ_CST);
+	n->n_process_input++;
+
+	for (i = 0; i < n->n_in; i++) {
+		spa_assert_se(n->in[i].io->status == SPA_STATUS_HAVE_BUFFER);
+		n->in[i].io->status = SPA_STATUS_NEED_BUFFER;
+		if (n->callbacks)
+			spa_graph_reuse_buffer(&data.graph, &n->gnode, n->in[i].port_id, 0);
+	}
+	if (n->n_out == 0)
+		return SPA_STATUS_OK;
+
+	for (i = 0; i < n->n_out; i++)
+		n->out[i].io->status = SPA_STATUS_HAVE_BUFFER;
+
+	/* like a node that produced its output, the scheduler must
+	 * handle this from the thread that runs the graph */
+	if (n->callbacks)
+		spa_graph_have_output(&data.graph, &n->gnode);
+
+	return SPA_STATUS_HAVE_BUFFER;
+}
+
+static int node_process_output(struct spa_node *node)
+{
+	struct test_node *n = SPA_CONTAINER_OF(node, struct test_node, node);
+	uint32_t i;
+
+	if (n->n_in == 0) {
+		n->processed = ++data.processed;
+		for (i = 0; i < n->n_out; i++)
+			n->out[i].io->status = SPA_STATUS_HAVE_BUFFER;
+		return SPA_STATUS_HAVE_BUFFER;
+	}
+	for (i = 0; i < n->n_in; i++)
+		n->in[i].io->status = SPA_STATUS_NEED_BUFFER;
+	return SPA_STATUS_NEED_BUFFER;
+}
+
+/* not thread safe, the scheduler serializes the calls */
+static int node_port_reuse_buffer(struct spa_node *node, uint32_t port_id, uint32_t buffer_id)
+{
+	struct test_node *n = SPA_CONTAINER_OF(node, struct test_node, node);
+	uint32_t reuse = n->n_reuse;
+
+	sched_yield();
+	n->n_reuse = reuse + 1;
+	return 0;
+}
+
+static const struct spa_node test_node_impl = {
+	SPA_VERSION_NODE,
+	.port_reuse_buffer = node_port_reuse_buffer,
+	.process_input = node_process_input,
+	.process_output = node_process_output,
+};
+
+static void node_init(struct test_node *n)
+{
+	memset(n, 0, sizeof(*n));
+	n->node = test_node_impl;
+	spa_graph_node_init(&n->gnode);
+	spa_graph_node_set_implementation(&n->gnode, &n->node);
+	spa_graph_node_add(&data.graph, &n->gnode);
+}
+
+static void link_nodes(struct test_node *out, struct test_node *in)
+{
+	struct spa_graph_port *op, *ip;
+	struct spa_io_buffers *io;
+
+	spa_assert_se(out->n_out < MAX_PORTS && in->n_in < MAX_PORTS);
+
+	io = calloc(1, sizeof(struct spa_io_buffers));
+	io->status = SPA_STATUS_NEED_BUFFER;
+	io->buffer_id = SPA_ID_INVALID;
+
+	op = &out->out[out->n_out];
+	spa_graph_port_init(op, SPA_DIRECTION_OUTPUT, out->n_out++, 0, io);
+	spa_graph_port_add(&out->gnode, op);
+
+	ip = &in->in[in->n_in];
+	spa_graph_port_init(ip, SPA_DIRECTION_INPUT, in->n_in++, 0, io);
+	spa_graph_port_add(&in->gnode, ip);
+
+	spa_graph_port_link(op, ip);
+}
+
+/* unlink the last output port of a node, the peer must be the last input
+ * port of its node */
+static void unlink_output(struct test_node *n)
+{
+	struct spa_graph_port *p = &n->out[n->n_out - 1], *peer = p->peer;
+	struct test_node *pn = SPA_CONTAINER_OF(peer->node, struct test_node, gnode);
+
+	spa_assert_se(peer == &pn->in[pn->n_in - 1]);
+
+	spa_graph_port_unlink(p);
+	spa_graph_port_remove(p);
+	spa_graph_port_remove(peer);
+	n->n_out--;
+	pn->n_in--;
+	free(p->io);
+}
+
+static void reset_graph(void)
+{
+	spa_graph_init(&data.graph);
+	spa_graph_data_init(&data.graph_data, &data.graph);
+	spa_graph_set_callbacks(&data.graph, &spa_graph_impl_default, &data.graph_data);
+	data.processed = 0;
+}
+
+/* sort when needed and check that all nodes are in the order after
+ * their upstream peers */
+static void check_order(void)
+{
+	struct spa_graph_node *n;
+	struct spa_graph_port *p;
+	uint32_t position = 0, count = 0;
+
+	if (data.graph_data.version != data.graph.version)
+		spa_graph_data_sort(&data.graph_data);
+
+	spa_list_for_each(n, &data.graph_data.order, ready_link) {
+		struct test_node *tn = SPA_CONTAINER_OF(n, struct test_node, gnode);
+		tn->position = position++;
+	}
+
+	spa_list_for_each(n, &data.graph.nodes, link) {
+		struct test_node *tn = SPA_CONTAINER_OF(n, struct test_node, gnode);
+
+		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
+			struct test_node *peer = SPA_CONTAINER_OF(p->peer->node,
+							struct test_node, gnode);
+			spa_assert_se(peer->position < tn->position);
+		}
+		count++;
+	}
+	spa_assert_se(count == position);
+	spa_assert_se(data.graph_data.n_nodes == count);
+}
+
+static void run_cycle(struct test_node *sink)
+{
+	spa_graph_need_input(&data.graph, &sink->gnode);
+	spa_assert_se(data.graph_data.n_pending == 0);
+	spa_assert_se(!data.graph_data.running);
+}
+
+/* nodes are added downstream first so that the sort has to reorder them */
+static void test_order(void)
+{
+	struct test_node n[6];
+	struct test_node *sink = &n[0], *mix = &n[1], *a = &n[2], *b = &n[3],
+			 *tee = &n[4], *src = &n[5];
+	int i;
+
+	reset_graph();
+	for (i = 0; i < 6; i++)
+		node_init(&n[i]);
+
+	/* src -> tee -> a -> mix -> sink
+	 *           \-> b ->/          */
+	link_nodes(src, tee);
+	link_nodes(tee, a);
+	link_nodes(tee, b);
+	link_nodes(a, mix);
+	link_nodes(b, mix);
+	link_nodes(mix, sink);
+
+	check_order();
+
+	for (i = 0; i < 3; i++) {
+		data.processed = 0;
+		run_cycle(sink);
+
+		spa_assert_se(src->processed < tee->processed);
+		spa_assert_se(tee->processed < a->processed && tee->processed < b->processed);
+		spa_assert_se(a->processed < mix->processed && b->processed < mix->processed);
+		spa_assert_se(mix->processed < sink->processed);
+	}
+	/* every node gets its input once per cycle */
+	spa_assert_se(mix->n_process_input == 3);
+	spa_assert_se(sink->n_process_input == 3);
+
+	unlink_output(mix);
+	unlink_output(b);
+	unlink_output(a);
+	unlink_output(tee);
+	unlink_output(tee);
+	unlink_output(src);
+
+	printf("order: ok\n");
+}
+
+/* a long chain would overflow the stack of a recursive scheduler */
+static void test_deep(void)
+{
+	struct test_node *n;
+	int i;
+
+	reset_graph();
+	n = calloc(DEEP_NODES, sizeof(struct test_node));
+
+	for (i = DEEP_NODES - 1; i >= 0; i--)
+		node_init(&n[i]);
+	for (i = 0; i < DEEP_NODES - 1; i++)
+		link_nodes(&n[i], &n[i + 1]);
+
+	check_order();
+
+	run_cycle(&n[DEEP_NODES - 1]);
+
+	for (i = 1; i < DEEP_NODES; i++) {
+		spa_assert_se(n[i].n_process_input == 1);
+		spa_assert_se(n[i - 1].processed < n[i].processed);
+	}
+
+	for (i = 0; i < DEEP_NODES - 1; i++)
+		unlink_output(&n[i]);
+	free(n);
+
+	printf("deep chain of %d nodes: ok\n", DEEP_NODES);
+}
+
+/* the order is rebuilt when nodes are inserted and removed */
+static void test_rebuild(void)
+{
+	struct test_node src, filter, sink;
+	uint32_t version;
+
+	reset_graph();
+	node_init(&sink);
+	node_init(&src);
+	link_nodes(&src, &sink);
+
+	run_cycle(&sink);
+	spa_assert_se(data.graph_data.version == data.graph.version);
+	spa_assert_se(data.graph_data.n_nodes == 2);
+	spa_assert_se(src.processed < sink.processed);
+
+	/* no topology change, no new sort */
+	version = data.graph.version;
+	run_cycle(&sink);
+	spa_assert_se(data.graph.version == version);
+
+	/* insert a filter between the source and the sink */
+	unlink_output(&src);
+	node_init(&filter);
+	link_nodes(&filter, &sink);
+	link_nodes(&src, &filter);
+	spa_assert_se(data.graph.version != version);
+
+	data.processed = 0;
+	run_cycle(&sink);
+	spa_assert_se(data.graph_data.version == data.graph.version);
+	spa_assert_se(data.graph_data.n_nodes == 3);
+	spa_assert_se(filter.n_process_input == 1);
+	spa_assert_se(src.processed < filter.processed && filter.processed < sink.processed);
+	check_order();
+
+	/* and remove it again */
+	unlink_output(&src);
+	unlink_output(&filter);
+	spa_graph_node_remove(&filter.gnode);
+	link_nodes(&src, &sink);
+
+	data.processed = 0;
+	run_cycle(&sink);
+	spa_assert_se(data.graph_data.n_nodes == 2);
+	spa_assert_se(filter.n_process_input == 1);
+	spa_assert_se(src.processed < sink.processed);
+	check_order();
+
+	unlink_output(&src);
+
+	printf("rebuild: ok\n");
+}
+
+struct executor {
+	uint32_t n_batches;
+	uint32_t max_batch;
+};
+
+struct work {
+	struct spa_graph_node *node;
+	enum spa_direction direction;
+};
+
+static void *do_process(void *user_data)
+{
+	struct work *w = user_data;
+	spa_graph_node_process(w->node, w->direction);
+	return NULL;
+}
+
+/* process every node of the batch in its own thread */
+static void executor_process(void *user_data, enum spa_direction direction,
+			     struct spa_graph_node **nodes, uint32_t n_nodes)
+{
+	struct executor *e = user_data;
+	pthread_t threads[SPA_GRAPH_MAX_BATCH];
+	struct work work[SPA_GRAPH_MAX_BATCH];
+	uint32_t i, j;
+
+	/* the nodes in a batch are never linked to each other */
+	for (i = 0; i < n_nodes; i++) {
+		struct spa_graph_port *p;
+		int d;
+
+		for (d = 0; d < 2; d++) {
+			spa_list_for_each(p, &nodes[i]->ports[d], link) {
+				for (j = 0; j < n_nodes; j++)
+					spa_assert_se(p->peer == NULL || p->peer->node != nodes[j]);
+			}
+		}
+	}
+	for (i = 0; i < n_nodes; i++) {
+		work[i].node = nodes[i];
+		work[i].direction = direction;
+		spa_assert_se(pthread_create(&threads[i], NULL, do_process, &work[i]) == 0);
+	}
+	for (i = 0; i < n_nodes; i++)
+		pthread_join(threads[i], NULL);
+
+	e->n_batches++;
+	e->max_batch = SPA_MAX(e->max_batch, n_nodes);
+}
+
+static const struct spa_graph_executor test_executor = {
+	SPA_VERSION_GRAPH_EXECUTOR,
+	.process = executor_process,
+};
+
+/* the filters between a source and a mixer are processed in parallel and
+ * call back into the graph from the executor threads */
+static void test_batch(void)
+{
+	struct test_node src, filter[WIDE_NODES], mix, sink;
+	struct executor executor = { 0, };
+	uint32_t i, cycle;
+
+	reset_graph();
+	spa_graph_data_set_executor(&data.graph_data, &test_executor, &executor);
+
+	node_init(&sink);
+	node_init(&mix);
+	for (i = 0; i < WIDE_NODES; i++) {
+		node_init(&filter[i]);
+		filter[i].callbacks = true;
+	}
+	node_init(&src);
+
+	for (i = 0; i < WIDE_NODES; i++) {
+		link_nodes(&src, &filter[i]);
+		link_nodes(&filter[i], &mix);
+	}
+	link_nodes(&mix, &sink);
+
+	check_order();
+
+	for (cycle = 1; cycle <= WIDE_CYCLES; cycle++) {
+		data.processed = 0;
+		run_cycle(&sink);
+
+		spa_assert_se(mix.n_process_input == cycle);
+		spa_assert_se(sink.n_process_input == cycle);
+		for (i = 0; i < WIDE_NODES; i++) {
+			spa_assert_se(filter[i].n_process_input == cycle);
+			spa_assert_se(src.processed < filter[i].processed);
+			spa_assert_se(filter[i].processed < mix.processed);
+			spa_assert_se((filter[i].gnode.pending & SPA_GRAPH_PENDING_DEFER) == 0);
+		}
+		spa_assert_se(src.n_reuse == cycle * WIDE_NODES);
+		spa_assert_se(data.graph_data.n_reuse == 0);
+		spa_assert_se(data.graph_data.n_deferred == 0);
+		spa_assert_se(!data.graph_data.executing);
+	}
+	spa_assert_se(executor.max_batch == WIDE_NODES);
+	spa_assert_se(data.graph_data.n_reuse_dropped == 0);
+
+	for (i = 0; i < WIDE_NODES; i++)
+		unlink_output(&filter[WIDE_NODES - 1 - i]);
+	for (i = 0; i < WIDE_NODES; i++)
+		unlink_output(&src);
+	unlink_output(&mix);
+
+	printf("batch of %d nodes, %d batches: ok\n", WIDE_NODES, executor.n_batches);
+}
+
+/* more deferred triggers than fit in the array are replayed from the
+ * whole cycle, also for a node outside of the graph */
+static void test_overflow(void)
+{
+	static struct test_node src[OVERFLOW_PAIRS], sink[OVERFLOW_PAIRS];
+	uint32_t i;
+
+	reset_graph();
+
+	for (i = 0; i < OVERFLOW_PAIRS; i++) {
+		node_init(&sink[i]);
+		node_init(&src[i]);
+		link_nodes(&src[i], &sink[i]);
+	}
+	spa_graph_node_remove(&src[OVERFLOW_PAIRS - 1].gnode);
+	check_order();
+
+	/* like triggers from the executor threads while a batch runs */
+	data.graph_data.executing = true;
+	for (i = 0; i < OVERFLOW_PAIRS; i++) {
+		src[i].out[0].io->status = SPA_STATUS_HAVE_BUFFER;
+		spa_graph_have_output(&data.graph, &src[i].gnode);
+	}
+	data.graph_data.executing = false;
+	spa_assert_se(data.graph_data.n_deferred == OVERFLOW_PAIRS);
+
+	spa_graph_data_replay(&data.graph_data);
+
+	spa_assert_se(data.graph_data.n_deferred == 0);
+	spa_assert_se(data.graph_data.n_pending == 0);
+	for (i = 0; i < OVERFLOW_PAIRS; i++) {
+		spa_assert_se(sink[i].n_process_input == 1);
+		spa_assert_se((src[i].gnode.pending & SPA_GRAPH_PENDING_DEFER) == 0);
+	}
+
+	for (i = 0; i < OVERFLOW_PAIRS; i++)
+		unlink_output(&src[i]);
+
+	printf("overflow of %d deferred triggers: ok\n", OVERFLOW_PAIRS);
+}
+
+static uint32_t n_old_reuse;
+
+static int old_reuse_buffer(void *data, struct spa_graph_node *node,
+			    uint32_t port_id, uint32_t buffer_id)
+{
+	n_old_reuse++;
+	return 0;
+}
+
+/* schedulers without a reuse_buffer callback give the buffer straight
+ * back to the peer */
+static void test_reuse_fallback(void)
+{
+	struct spa_graph_callbacks callbacks;
+	struct test_node src, sink;
+
+	reset_graph();
+
+	node_init(&sink);
+	node_init(&src);
+	link_nodes(&src, &sink);
+
+	callbacks = spa_graph_impl_default;
+	callbacks.reuse_buffer = NULL;
+	spa_graph_set_callbacks(&data.graph, &callbacks, &data.graph_data);
+	spa_graph_reuse_buffer(&data.graph, &sink.gnode, sink.in[0].port_id, 0);
+	spa_assert_se(src.n_reuse == 1);
+
+	/* the member did not exist before version 1 */
+	callbacks.version = 0;
+	callbacks.reuse_buffer = old_reuse_buffer;
+	spa_graph_reuse_buffer(&data.graph, &sink.gnode, sink.in[0].port_id, 0);
+	spa_assert_se(src.n_reuse == 2);
+	spa_assert_se(n_old_reuse == 0);
+
+	spa_graph_set_callbacks(&data.graph, &spa_graph_impl_default, &data.graph_data);
+	spa_graph_reuse_buffer(&data.graph, &sink.gnode, sink.in[0].port_id, 0);
+	spa_assert_se(src.n_reuse == 3);
+
+	unlink_output(&src);
+
+	printf("reuse fallback: ok\n");
+}
+
+int main(int argc, char *argv[])
+{
+	test_order();
+	test_deep();
+	test_rebuild();
+	test_batch();
+	test_overflow();
+	test_reuse_fallback();
+
+	return 0;
+}
@@ -0,0 +1,126 @@
+/* Spa
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <spa/utils/defs.h>
+
+#include "volume-ops.h"
+#include "test-ops.h"
+
+/* compares the optimized volume functions against the generic C versions,
+ * the results must be bit exact */
+
+#define N_FRAMES	1027
+
+static const char *fmt_names[VOLUME_FMT_MAX] = { "s16", "s24", "s32", "f32", "f64" };
+static const int fmt_sizes[VOLUME_FMT_MAX] = { 2, 3, 4, 4, 8 };
+
+static uint8_t src[N_FRAMES * 8 * 8], dst_ref[N_FRAMES * 8 * 8], dst[N_FRAMES * 8 * 8];
+
+static void fill_random(int fmt, void *data, int n_samples)
+{
+	switch (fmt) {
+	case VOLUME_FMT_F32:
+		fill_random_f32(data, n_samples, 1.0f);
+		break;
+	case VOLUME_FMT_F64:
+		fill_random_f64(data, n_samples, 1.0);
+		break;
+	default:
+		fill_random_bytes(data, n_samples * fmt_sizes[fmt]);
+		break;
+	}
+}
+
+static int test_ops(struct volume_ops *ref, struct volume_ops *ops, uint32_t cpu_flags)
+{
+	float gain[8];
+	int fmt, n_channels, n_frames, i, errors = 0;
+
+	for (fmt = 0; fmt < VOLUME_FMT_MAX; fmt++) {
+		for (n_channels = 1; n_channels <= 8; n_channels++) {
+			for (i = 0; i < n_channels; i++)
+				gain[i] = (rand() / (float) RAND_MAX) * 3.0f;
+
+			for (n_frames = 0; n_frames < N_FRAMES; n_frames += 13) {
+				fill_random(fmt, src, n_frames * n_channels);
+				memset(dst_ref, 0, sizeof(dst_ref));
+				memset(dst, 0, sizeof(dst));
+
+				ref->apply[fmt](dst_ref, src, gain, n_channels, n_frames);
+				ops->apply[fmt](dst, src, gain, n_channels, n_frames);
+
+				if (memcmp(dst_ref, dst, sizeof(dst)) != 0) {
+					printf("apply %s: mismatch, %d channels, %d frames\n",
+							fmt_names[fmt], n_channels, n_frames);
+					errors++;
+				}
+			}
+		}
+	}
+	printf("cpu flags %08x: %d errors\n", cpu_flags, errors);
+	return errors;
+}
+
+/* a ramp must end exactly on the target gain */
+static int test_ramp(struct volume_ops *ops, int curve)
+{
+	float shape[64], start = 0.0f, delta = 0.5f, in[64], out[64];
+	int i, errors = 0;
+
+	for (i = 0; i < 64; i++)
+		in[i] = 1.0f;
+
+	volume_ramp_shape(shape, curve, 0, 64, 64);
+	ops->ramp[VOLUME_FMT_F32](out, in, &start, &delta, shape, 1, 64);
+
+	for (i = 1; i < 64; i++) {
+		if (out[i] < out[i - 1]) {
+			printf("ramp %d: not monotonic at %d\n", curve, i);
+			errors++;
+		}
+	}
+	if (out[63] != 0.5f) {
+		printf("ramp %d: ends at %f\n", curve, out[63]);
+		errors++;
+	}
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	struct volume_ops ref, ops;
+	uint32_t cpu_flags, errors = 0;
+
+	cpu_flags = volume_get_cpu_flags();
+	printf("cpu flags %08x\n", cpu_flags);
+
+	volume_get_ops_cpu(&ref, 0);
+	errors += test_ramp(&ref, VOLUME_RAMP_LINEAR);
+	errors += test_ramp(&ref, VOLUME_RAMP_CUBIC);
+
+	if (cpu_flags & VOLUME_CPU_FLAG_SSE2) {
+		volume_get_ops_cpu(&ops, VOLUME_CPU_FLAG_SSE2);
+		errors += test_ops(&ref, &ops, VOLUME_CPU_FLAG_SSE2);
+	}
+	return errors ? 1 : 0;
+}
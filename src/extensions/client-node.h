@@ -24,7 +24,10 @@
 extern "C" {
 #endif
 
+#include <time.h>
+
 #include <spa/utils/defs.h>
+#include <spa/utils/spsc-ringbuffer.h>
 #include <spa/param/param.h>
 #include <spa/node/node.h>
 
@@ -34,7 +37,10 @@ struct pw_client_node_proxy;
 
 #define PW_TYPE_INTERFACE__ClientNode		PW_TYPE_INTERFACE_BASE "ClientNode"
 
-#define PW_VERSION_CLIENT_NODE			0
+/* version 2 shares the port io and the activation record in the transport
+ * area and only keeps the reuse buffer message, older versions can't talk
+ * to it */
+#define PW_VERSION_CLIENT_NODE			2
 
 struct pw_client_node_message;
 
@@ -44,6 +50,80 @@ struct pw_client_node_area {
 	uint32_t n_input_ports;		/**< number of input ports of the node */
 	uint32_t max_output_ports;	/**< max output ports of the node */
 	uint32_t n_output_ports;	/**< number of output ports of the node */
+	uint32_t pending[2];		/**< pending process events for the client and
+					  *  the server, see \ref pw_client_node_transport */
+};
+
+/** Activation record of a node \memberof pw_client_node
+ *
+ * The record lives in the transport area of the node. The clients of the
+ * nodes that feed the node directly decrement the pending counter when
+ * they finished and the last one wakes up the node.
+ */
+struct pw_client_node_activation {
+#define PW_CLIENT_NODE_ACTIVATION_NOT_TRIGGERED	0	/*< waiting for the peers */
+#define PW_CLIENT_NODE_ACTIVATION_TRIGGERED	1	/*< all peers finished, node is woken up */
+#define PW_CLIENT_NODE_ACTIVATION_AWAKE		2	/*< node is processing */
+#define PW_CLIENT_NODE_ACTIVATION_FINISHED	3	/*< node finished processing */
+	uint32_t status;		/**< one of the activation states */
+	int32_t required;		/**< number of peers that activate the node */
+	int32_t pending;		/**< number of peers that did not finish yet */
+	uint32_t triggered;		/**< number of activations by peers */
+	uint64_t signal_time;		/**< time the node was woken up */
+	uint64_t awake_time;		/**< time the node started processing */
+	uint64_t finish_time;		/**< time the node finished processing */
+};
+
+static inline uint64_t pw_client_node_activation_get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+/** Signal that a peer finished, returns true when the node should be woken up */
+static inline bool
+pw_client_node_activation_trigger(struct pw_client_node_activation *a, uint64_t now)
+{
+	if (__atomic_sub_fetch(&a->pending, 1, __ATOMIC_ACQ_REL) > 0)
+		return false;
+
+	a->signal_time = now;
+	__atomic_store_n(&a->status, PW_CLIENT_NODE_ACTIVATION_TRIGGERED, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&a->triggered, 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+/** Check if the node was woken up by its peers and rearm the pending counter */
+static inline bool
+pw_client_node_activation_awake(struct pw_client_node_activation *a, uint64_t now)
+{
+	uint32_t status = PW_CLIENT_NODE_ACTIVATION_TRIGGERED;
+
+	if (!__atomic_compare_exchange_n(&a->status, &status, PW_CLIENT_NODE_ACTIVATION_AWAKE,
+					 false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return false;
+
+	a->awake_time = now;
+	__atomic_store_n(&a->pending, a->required, __ATOMIC_RELEASE);
+	return true;
+}
+
+/** Mark the node as finished after it was woken up by its peers */
+static inline void
+pw_client_node_activation_finish(struct pw_client_node_activation *a, uint64_t now)
+{
+	if (__atomic_load_n(&a->status, __ATOMIC_RELAXED) != PW_CLIENT_NODE_ACTIVATION_AWAKE)
+		return;
+
+	a->finish_time = now;
+	__atomic_store_n(&a->status, PW_CLIENT_NODE_ACTIVATION_FINISHED, __ATOMIC_RELEASE);
+}
+
+/** A link from an output port of a node to an input port of a peer */
+struct pw_client_node_link {
+	uint32_t output_port_id;	/**< the output port of the node */
+	uint32_t input_port_id;		/**< the input port of the peer */
 };
 
 /** \class pw_client_node_transport
@@ -56,12 +136,15 @@ struct pw_client_node_area {
  */
 struct pw_client_node_transport {
 	struct pw_client_node_area *area;	/**< the transport area */
+	struct pw_client_node_activation *activation;	/**< the activation record */
 	struct spa_io_buffers *inputs;		/**< array of buffer input io */
 	struct spa_io_buffers *outputs;		/**< array of buffer output io */
+	uint32_t *input_pending;		/**< pending events from the other side */
+	uint32_t *output_pending;		/**< pending events for the other side */
 	void *input_data;			/**< input memory for ringbuffer */
-	struct spa_ringbuffer *input_buffer;	/**< ringbuffer for input memory */
+	struct spa_spsc_ringbuffer *input_buffer;	/**< ringbuffer for input memory */
 	void *output_data;			/**< output memory for ringbuffer */
-	struct spa_ringbuffer *output_buffer;	/**< ringbuffer for output memory */
+	struct spa_spsc_ringbuffer *output_buffer;	/**< ringbuffer for output memory */
 
 	/** Destroy a transport
 	 * \param trans a transport to destroy
@@ -107,11 +190,28 @@ struct pw_client_node_transport {
 #define pw_client_node_transport_next_message(t,m)	((t)->next_message((t), (m)))
 #define pw_client_node_transport_parse_message(t,m)	((t)->parse_message((t), (m)))
 
+/** Process events, the io of the ports is shared in the transport area so
+ * these events carry no data and are merged until the other side handles them */
+#define PW_CLIENT_NODE_PENDING_HAVE_OUTPUT	(1 << 0)	/*< signal that the node has output */
+#define PW_CLIENT_NODE_PENDING_NEED_INPUT	(1 << 1)	/*< signal that the node needs input */
+#define PW_CLIENT_NODE_PENDING_PROCESS_INPUT	(1 << 2)	/*< instruct the node to process input */
+#define PW_CLIENT_NODE_PENDING_PROCESS_OUTPUT	(1 << 3)	/*< instruct the node output is processed */
+
+/** Post process events for the other side, the caller wakes up the other side */
+static inline void
+pw_client_node_transport_signal(struct pw_client_node_transport *trans, uint32_t events)
+{
+	__atomic_fetch_or(trans->output_pending, events, __ATOMIC_RELEASE);
+}
+
+/** Take the pending process events posted by the other side */
+static inline uint32_t
+pw_client_node_transport_take_pending(struct pw_client_node_transport *trans)
+{
+	return __atomic_exchange_n(trans->input_pending, 0, __ATOMIC_ACQUIRE);
+}
+
 enum pw_client_node_message_type {
-	PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT,		/*< signal that the node has output */
-	PW_CLIENT_NODE_MESSAGE_NEED_INPUT,		/*< signal that the node needs input */
-	PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT,		/*< instruct the node to process input */
-	PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT,		/*< instruct the node output is processed */
 	PW_CLIENT_NODE_MESSAGE_PORT_REUSE_BUFFER,	/*< reuse a buffer */
 };
 
@@ -299,11 +399,12 @@ pw_client_node_proxy_destroy(struct pw_client_node_proxy *p)
 #define PW_CLIENT_NODE_PROXY_EVENT_PORT_USE_BUFFERS	8
 #define PW_CLIENT_NODE_PROXY_EVENT_PORT_COMMAND		9
 #define PW_CLIENT_NODE_PROXY_EVENT_PORT_SET_IO		10
-#define PW_CLIENT_NODE_PROXY_EVENT_NUM			11
+#define PW_CLIENT_NODE_PROXY_EVENT_SET_ACTIVATION	11
+#define PW_CLIENT_NODE_PROXY_EVENT_NUM			12
 
 /** \ref pw_client_node events */
 struct pw_client_node_proxy_events {
-#define PW_VERSION_CLIENT_NODE_PROXY_EVENTS		0
+#define PW_VERSION_CLIENT_NODE_PROXY_EVENTS		1
 	uint32_t version;
 	/**
 	 * Memory was added to a node
@@ -446,6 +547,30 @@ struct pw_client_node_proxy_events {
 			     uint32_t mem_id,
 			     uint32_t offset,
 			     uint32_t size);
+
+	/**
+	 * Activate a peer node directly
+	 *
+	 * When the node has output, it copies the io of the linked output
+	 * ports to the input ports of the peer and activates the peer
+	 * itself. The server is only signaled when the node has no peers
+	 * to activate, it handles the messages of the node when one of
+	 * the peers signals.
+	 *
+	 * \param node_id the node id of the peer
+	 * \param signalfd fd to wake up the peer, -1 to stop activating the peer
+	 * \param transport the transport area of the peer or NULL
+	 * \param n_links the number of links to the peer
+	 * \param links the links to the peer
+	 *
+	 * Since version 1, only sent to nodes created with version 1 or later.
+	 */
+	void (*set_activation) (void *object,
+				uint32_t node_id,
+				int signalfd,
+				struct pw_client_node_transport *transport,
+				uint32_t n_links,
+				const struct pw_client_node_link *links);
 };
 
 static inline void
@@ -479,6 +604,8 @@ pw_client_node_proxy_add_listener(struct pw_client_node_proxy *p,
 	pw_resource_notify(r,struct pw_client_node_proxy_events,port_command,__VA_ARGS__)
 #define pw_client_node_resource_port_set_io(r,...)	\
 	pw_resource_notify(r,struct pw_client_node_proxy_events,port_set_io,__VA_ARGS__)
+#define pw_client_node_resource_set_activation(r,...)	\
+	pw_resource_notify(r,struct pw_client_node_proxy_events,set_activation,__VA_ARGS__)
 
 #ifdef __cplusplus
 }  /* extern "C" */
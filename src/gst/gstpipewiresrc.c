@@ -53,6 +53,7 @@ GST_DEBUG_CATEGORY_STATIC (pipewire_src_debug);
 #define GST_CAT_DEFAULT pipewire_src_debug
 
 #define DEFAULT_ALWAYS_COPY     false
+#define DEFAULT_MIN_FREE_BUFFERS 0
 
 enum
 {
@@ -62,6 +63,7 @@ enum
   PROP_STREAM_PROPERTIES,
   PROP_ALWAYS_COPY,
   PROP_FD,
+  PROP_MIN_FREE_BUFFERS,
 };
 
 
@@ -121,6 +123,10 @@ gst_pipewire_src_set_property (GObject * object, guint prop_id,
       pwsrc->fd = g_value_get_int (value);
       break;
 
+    case PROP_MIN_FREE_BUFFERS:
+      pwsrc->min_free_buffers = g_value_get_int (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -154,6 +160,10 @@ gst_pipewire_src_get_property (GObject * object, guint prop_id,
       g_value_set_int (value, pwsrc->fd);
       break;
 
+    case PROP_MIN_FREE_BUFFERS:
+      g_value_set_int (value, pwsrc->min_free_buffers);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -282,6 +292,16 @@ gst_pipewire_src_class_init (GstPipeWireSrcClass * klass)
                                                       G_PARAM_READWRITE |
                                                       G_PARAM_STATIC_STRINGS));
 
+   g_object_class_install_property (gobject_class,
+                                    PROP_MIN_FREE_BUFFERS,
+                                    g_param_spec_int ("min-free-buffers",
+                                                      "Min free buffers",
+                                                      "Copy the buffer when fewer buffers are "
+                                                      "left for the stream (0 = never copy)",
+                                                      0, G_MAXINT, DEFAULT_MIN_FREE_BUFFERS,
+                                                      G_PARAM_READWRITE |
+                                                      G_PARAM_STATIC_STRINGS));
+
   gstelement_class->provide_clock = gst_pipewire_src_provide_clock;
   gstelement_class->change_state = gst_pipewire_src_change_state;
 
@@ -316,6 +336,7 @@ gst_pipewire_src_init (GstPipeWireSrc * src)
   GST_OBJECT_FLAG_SET (src, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
 
   src->always_copy = DEFAULT_ALWAYS_COPY;
+  src->min_free_buffers = DEFAULT_MIN_FREE_BUFFERS;
   src->fd = -1;
 
   g_queue_init (&src->queue);
@@ -346,6 +367,8 @@ buffer_recycle (GstMiniObject *obj)
 
   GST_LOG_OBJECT (obj, "recycle buffer");
   pw_thread_loop_lock (src->main_loop);
+  if (src->n_outstanding > 0)
+    src->n_outstanding--;
   pw_stream_queue_buffer (src->stream, data->b);
   pw_thread_loop_unlock (src->main_loop);
 
@@ -363,6 +386,7 @@ on_add_buffer (void *_data, struct pw_buffer *b)
   data = b->user_data;
   data->owner = pwsrc;
   GST_MINI_OBJECT_CAST (data->buf)->dispose = buffer_recycle;
+  pwsrc->n_buffers++;
 }
 
 static void
@@ -377,6 +401,12 @@ on_remove_buffer (void *_data, struct pw_buffer *b)
 
   GST_MINI_OBJECT_CAST (buf)->dispose = NULL;
 
+  if (pwsrc->n_buffers > 0)
+    pwsrc->n_buffers--;
+  /* all buffers are gone, the ones downstream are not recycled */
+  if (pwsrc->n_buffers == 0)
+    pwsrc->n_outstanding = 0;
+
   walk = pwsrc->queue.head;
   while (walk) {
     GList *next = walk->next;
@@ -406,6 +436,7 @@ on_process (void *_data)
 
   data = b->user_data;
   buf = data->buf;
+  pwsrc->n_outstanding++;
 
   GST_LOG_OBJECT (pwsrc, "got new buffer %p", buf);
 
@@ -712,7 +743,9 @@ on_format_changed (void *data,
 	":", t->param_buffers.size,    "ir", 0,  SPA_PROP_RANGE(0, INT32_MAX),
 	":", t->param_buffers.stride,  "ir", 0,  SPA_PROP_RANGE(0, INT32_MAX),
 	":", t->param_buffers.buffers, "ir", 16, SPA_PROP_RANGE(1, INT32_MAX),
-	":", t->param_buffers.align,   "i", 16);
+	":", t->param_buffers.align,   "i", 16,
+	":", t->param_buffers.dataType, "Ieu", t->data.DmaBuf,
+		SPA_POD_PROP_ENUM(3, t->data.DmaBuf, t->data.MemFd, t->data.MemPtr));
 
     params[1] = spa_pod_builder_object (&b,
 	t->param.idMeta, t->param_meta.Meta,
@@ -831,6 +864,7 @@ gst_pipewire_src_create (GstPushSrc * psrc, GstBuffer ** buffer)
   GstClockTime pts, dts, base_time;
   const char *error = NULL;
   GstBuffer *buf;
+  gboolean copy;
 
   pwsrc = GST_PIPEWIRE_SRC (psrc);
 
@@ -861,11 +895,17 @@ gst_pipewire_src_create (GstPushSrc * psrc, GstBuffer ** buffer)
 
     pw_thread_loop_wait (pwsrc->main_loop);
   }
+  /* when downstream holds on to too many buffers, the stream would run out
+   * of buffers, copy and give this one back to the stream right away */
+  copy = pwsrc->always_copy ||
+      pwsrc->n_buffers < pwsrc->n_outstanding + pwsrc->min_free_buffers;
   pw_thread_loop_unlock (pwsrc->main_loop);
 
   gst_buffer_unref (buf);
 
-  if (pwsrc->always_copy) {
+  if (copy) {
+    GST_LOG_OBJECT (pwsrc, "copy buffer %p, %u of %u buffers outstanding", buf,
+        pwsrc->n_outstanding, pwsrc->n_buffers);
     *buffer = gst_buffer_copy_deep (buf);
     gst_buffer_unref (buf);
   }
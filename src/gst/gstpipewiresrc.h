@@ -57,6 +57,7 @@ struct _GstPipeWireSrc {
   gchar *client_name;
   gboolean always_copy;
   int fd;
+  gint min_free_buffers;
 
   gboolean negotiated;
   gboolean flushing;
@@ -81,6 +82,8 @@ struct _GstPipeWireSrc {
 
   GstPipeWirePool *pool;
   GQueue queue;
+  guint n_buffers;
+  guint n_outstanding;
   GstClock *clock;
   GstClockTime last_time;
 };
@@ -28,6 +28,8 @@
 #include <spa/utils/hook.h>
 #include <spa/param/audio/format-utils.h>
 #include <spa/pod/filter.h>
+#include <spa/pod/parser.h>
+#include <spa/param/props.h>
 
 #include "pipewire/core.h"
 #include "pipewire/link.h"
@@ -118,6 +120,7 @@ struct node {
 	int channels;
 	int sample_rate;
 	int buffer_size;
+	uint32_t prop_quantum;
 
 	struct spa_node node_impl;
 
@@ -144,7 +147,23 @@ static int node_set_param(struct spa_node *node,
 			  uint32_t id, uint32_t flags,
 			  const struct spa_pod *param)
 {
-	return -ENOTSUP;
+	struct node *n = SPA_CONTAINER_OF(node, struct node, node_impl);
+	struct pw_type *t = n->impl->t;
+	uint32_t quantum = 0;
+
+	if (id != t->param.idProps)
+		return -ENOENT;
+
+	if (param == NULL)
+		return 0;
+
+	spa_pod_object_parse(param,
+		":", n->prop_quantum, "?i", &quantum, NULL);
+
+	if (quantum != 0)
+		n->buffer_size = SPA_MIN(quantum, PW_QUANTUM_MAX);
+
+	return 0;
 }
 
 static int node_send_command(struct spa_node *node,
@@ -260,14 +279,6 @@ static void fill_s16(int16_t *out, int n_samples, int stride)
 		out += stride;
 	}
 }
-#if 0
-static void add_f32(float *out, float *in, int n_samples)
-{
-	int i;
-	for (i = 0; i < n_samples; i++)
-		out[i] += in[i];
-}
-#endif
 
 static int node_process_input(struct spa_node *node)
 {
@@ -277,7 +288,7 @@ static int node_process_input(struct spa_node *node)
 	struct spa_io_buffers *outio = outp->io;
 	struct buffer *out;
 	int16_t *op;
-	int i;
+	int i, n_samples;
 
 	pw_log_trace(NAME " %p: process input", this);
 
@@ -294,6 +305,8 @@ static int node_process_input(struct spa_node *node)
 	outio->status = SPA_STATUS_HAVE_BUFFER;
 
 	op = out->ptr;
+	n_samples = SPA_MIN(n->buffer_size,
+			out->outbuf->datas[0].maxsize / (sizeof(int16_t) * 2));
 
 	for (i = 0; i < n->n_in_ports; i++) {
 		struct port *inp = GET_IN_PORT(n, i);
@@ -303,17 +316,17 @@ static int node_process_input(struct spa_node *node)
 
 		if (inio->buffer_id < inp->n_buffers && inio->status == SPA_STATUS_HAVE_BUFFER) {
 			in = &inp->buffers[inio->buffer_id];
-			conv_f32_s16(op, in->ptr, n->buffer_size, stride);
+			conv_f32_s16(op, in->ptr, n_samples, stride);
 		}
 		else {
-			fill_s16(op, n->buffer_size, stride);
+			fill_s16(op, n_samples, stride);
 		}
 		op++;
 		inio->status = SPA_STATUS_NEED_BUFFER;
 	}
 
 	out->outbuf->datas[0].chunk->offset = 0;
-	out->outbuf->datas[0].chunk->size = n->buffer_size * sizeof(int16_t) * 2;
+	out->outbuf->datas[0].chunk->size = n_samples * sizeof(int16_t) * 2;
 	out->outbuf->datas[0].chunk->stride = 0;
 
 	return outio->status;
@@ -463,7 +476,7 @@ static int port_enum_params(struct spa_node *node,
 
 		param = spa_pod_builder_object(&b,
 			id, t->param_buffers.Buffers,
-			":", t->param_buffers.size,    "i", n->buffer_size * sizeof(float),
+			":", t->param_buffers.size,    "i", PW_QUANTUM_MAX * sizeof(float),
 			":", t->param_buffers.stride,  "i", 0,
 			":", t->param_buffers.buffers, "ir", 2,
 				SPA_POD_PROP_MIN_MAX(1, MAX_BUFFERS),
@@ -626,64 +639,6 @@ static const struct spa_node node_impl = {
 	.process_output = node_process_output,
 };
 
-#if 0
-static int schedule_mix_input(struct spa_node *_node)
-{
-	struct port *p = SPA_CONTAINER_OF(_node, struct port, mix_node);
-	struct pw_port *port = p->port;
-	struct spa_graph_node *node = &port->rt.mix_node;
-	struct spa_graph_port *gp;
-	struct spa_io_buffers *io = port->rt.mix_port.io;
-	size_t buffer_size = p->node->buffer_size;
-	int layer = 0;
-
-	spa_list_for_each(gp, &node->ports[SPA_DIRECTION_INPUT], link) {
-		struct pw_link *link = gp->scheduler_data;
-		struct spa_buffer *inbuf;
-
-		pw_log_trace("mix %p: input %d %d", node, gp->io->buffer_id, link->output->n_buffers);
-
-		if (!(gp->io->buffer_id < link->output->n_buffers && gp->io->status == SPA_STATUS_HAVE_BUFFER))
-			continue;
-
-		inbuf = link->output->buffers[gp->io->buffer_id];
-
-		if (layer++ == 0)
-			memcpy(p->buffers[0].ptr, inbuf->datas[0].data, buffer_size * sizeof(float));
-		else
-			add_f32(p->buffers[0].ptr, inbuf->datas[0].data, buffer_size);
-
-		pw_log_trace("mix %p: input %p %p->%p %d %d", node,
-				gp, gp->io, io, gp->io->status, gp->io->buffer_id);
-		*io = *gp->io;
-		io->buffer_id = 0;
-		gp->io->status = SPA_STATUS_OK;
-		gp->io->buffer_id = SPA_ID_INVALID;
-	}
-	return SPA_STATUS_HAVE_BUFFER;
-}
-
-static int schedule_mix_output(struct spa_node *_node)
-{
-	struct port *p = SPA_CONTAINER_OF(_node, struct port, mix_node);
-	struct pw_port *port = p->port;
-	struct spa_graph_node *node = &port->rt.mix_node;
-	struct spa_graph_port *gp;
-	struct spa_io_buffers *io = port->rt.mix_port.io;
-
-	spa_list_for_each(gp, &node->ports[SPA_DIRECTION_INPUT], link)
-		*gp->io = *io;
-	return io->status;
-}
-
-static const struct spa_node schedule_mix_node = {
-	SPA_VERSION_NODE,
-	NULL,
-	.process_input = schedule_mix_input,
-	.process_output = schedule_mix_output,
-};
-#endif
-
 static void port_free(void *data)
 {
 	struct port *p = data;
@@ -764,7 +719,8 @@ static struct pw_node *make_node(struct impl *impl, const struct pw_properties *
 	n->node_impl = node_impl;
 	n->channels = 2;
 	n->sample_rate = 44100;
-	n->buffer_size = 1024 / sizeof(float);
+	n->buffer_size = pw_core_get_quantum(impl->core);
+	n->prop_quantum = spa_type_map_get_id(impl->t->map, SPA_TYPE_PROPS__quantum);
 	pw_node_set_implementation(node, &n->node_impl);
 
 	p = make_port(n, direction, 0, 0, NULL);
@@ -23,13 +23,19 @@
 
 #include "config.h"
 
+#include <spa/param/format-utils.h>
+
 #include "pipewire/core.h"
 #include "pipewire/interfaces.h"
 #include "pipewire/link.h"
 #include "pipewire/log.h"
 #include "pipewire/module.h"
 #include "pipewire/control.h"
+#include "pipewire/work-queue.h"
 #include "pipewire/private.h"
+#include "modules/spa/spa-node.h"
+
+#define AUDIOCONVERT_LIB "audioconvert/libspa-audioconvert"
 
 struct impl {
 	struct pw_core *core;
@@ -41,6 +47,13 @@ struct impl {
 	struct spa_hook module_listener;
 
 	struct spa_list node_list;
+
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+
+	bool convert_failed;		/**< the audioconvert plugin can't be loaded */
+	struct pw_work_queue *work;
+	struct spa_list convert_list;
 };
 
 struct node_info {
@@ -61,6 +74,18 @@ struct link_data {
 	struct spa_hook link_listener;
 };
 
+/* an audioconvert node between 2 ports with incompatible formats, it is
+ * destroyed when one of its links goes away */
+struct convert_data {
+	struct spa_list l;
+
+	struct impl *impl;
+	struct pw_node *node;
+	struct spa_hook node_listener;
+	struct pw_link *links[2];
+	struct spa_hook link_listeners[2];
+};
+
 static struct node_info *find_node_info(struct impl *impl, struct pw_node *node)
 {
 	struct node_info *info;
@@ -184,6 +209,180 @@ static const struct pw_link_events link_events = {
 	.state_changed = link_state_changed,
 };
 
+static bool port_is_audio_raw(struct impl *impl, struct pw_port *port)
+{
+	uint8_t buffer[4096];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod *format;
+	uint32_t index = 0, media_type, media_subtype;
+
+	if (spa_node_port_enum_params(port->node->node, port->direction, port->port_id,
+				      impl->t->param.idEnumFormat, &index,
+				      NULL, &format, &b) <= 0)
+		return false;
+
+	if (spa_pod_object_parse(format,
+			"I", &media_type,
+			"I", &media_subtype) < 0)
+		return false;
+
+	return media_type == impl->media_type.audio &&
+	    media_subtype == impl->media_subtype.raw;
+}
+
+/* audio ports without a common format can be linked with an audioconvert
+ * node in between */
+static bool need_convert(struct impl *impl, struct pw_port *output, struct pw_port *input)
+{
+	uint8_t buffer[4096];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod *format;
+	char *error = NULL;
+	int res;
+
+	if (!port_is_audio_raw(impl, output) || !port_is_audio_raw(impl, input))
+		return false;
+
+	res = pw_core_find_format(impl->core, output, input, NULL, 0, NULL, &format, &b, &error);
+	if (res >= 0)
+		return false;
+
+	pw_log_debug("module %p: no common format: %s", impl, error);
+	free(error);
+
+	return !impl->convert_failed;
+}
+
+static void convert_unlink(struct convert_data *cd)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (cd->links[i]) {
+			spa_hook_remove(&cd->link_listeners[i]);
+			cd->links[i] = NULL;
+		}
+	}
+}
+
+static void do_destroy_convert(void *obj, void *data, int res, uint32_t id)
+{
+	struct convert_data *cd = data;
+	pw_node_destroy(cd->node);
+}
+
+static void convert_link_destroy(void *data)
+{
+	struct convert_data *cd = data;
+	struct impl *impl = cd->impl;
+
+	pw_log_debug("module %p: convert node %p unlinked", impl, cd->node);
+
+	/* we can't destroy the node from the link destroy event */
+	convert_unlink(cd);
+	pw_work_queue_add(impl->work, cd, 0, do_destroy_convert, cd);
+}
+
+static const struct pw_link_events convert_link_events = {
+	PW_VERSION_LINK_EVENTS,
+	.destroy = convert_link_destroy,
+};
+
+static void convert_node_destroy(void *data)
+{
+	struct convert_data *cd = data;
+
+	convert_unlink(cd);
+	spa_hook_remove(&cd->node_listener);
+	spa_list_remove(&cd->l);
+	pw_work_queue_cancel(cd->impl->work, cd, SPA_ID_INVALID);
+}
+
+static const struct pw_node_events convert_node_events = {
+	PW_VERSION_NODE_EVENTS,
+	.destroy = convert_node_destroy,
+};
+
+static struct pw_node *make_convert_node(struct impl *impl)
+{
+	struct pw_node *node;
+	struct convert_data *cd;
+
+	node = pw_spa_node_load(impl->core, NULL, pw_module_get_global(impl->module),
+				AUDIOCONVERT_LIB, "audioconvert", "audioconvert",
+				PW_SPA_NODE_FLAG_ACTIVATE, NULL,
+				sizeof(struct convert_data));
+	if (node == NULL) {
+		/* don't try to load the plugin again for every link */
+		impl->convert_failed = true;
+		return NULL;
+	}
+
+	cd = pw_spa_node_get_user_data(node);
+	cd->impl = impl;
+	cd->node = node;
+	spa_list_append(&impl->convert_list, &cd->l);
+	pw_node_add_listener(node, &cd->node_listener, &convert_node_events, cd);
+
+	return node;
+}
+
+/* link output to input through a new audioconvert node, returns the link
+ * with the port of the node we are linking, the caller registers it like
+ * a normal link */
+static struct pw_link *link_convert(struct impl *impl, struct pw_port *output,
+				    struct pw_port *input, struct node_info *info, char **error)
+{
+	struct pw_node *node;
+	struct pw_port *ports[2];
+	struct pw_link *links[2] = { NULL, NULL };
+	struct convert_data *cd;
+	int i;
+
+	if ((node = make_convert_node(impl)) == NULL) {
+		asprintf(error, "can't make audioconvert node");
+		return NULL;
+	}
+	cd = pw_spa_node_get_user_data(node);
+
+	ports[0] = pw_node_get_free_port(node, PW_DIRECTION_INPUT);
+	ports[1] = pw_node_get_free_port(node, PW_DIRECTION_OUTPUT);
+	if (ports[0] == NULL || ports[1] == NULL) {
+		asprintf(error, "audioconvert node has no free ports");
+		goto error;
+	}
+
+	links[0] = pw_link_new(impl->core, output, ports[0], NULL, NULL, error,
+			       sizeof(struct link_data));
+	if (links[0] == NULL)
+		goto error;
+	links[1] = pw_link_new(impl->core, ports[1], input, NULL, NULL, error,
+			       sizeof(struct link_data));
+	if (links[1] == NULL)
+		goto error;
+
+	pw_log_debug("module %p: link %p and %p through convert node %p", impl,
+			links[0], links[1], node);
+
+	for (i = 0; i < 2; i++) {
+		cd->links[i] = links[i];
+		pw_link_add_listener(links[i], &cd->link_listeners[i], &convert_link_events, cd);
+	}
+	if (pw_port_get_node(output) == info->node) {
+		pw_link_register(links[1], NULL, pw_module_get_global(impl->module), NULL);
+		return links[0];
+	} else {
+		pw_link_register(links[0], NULL, pw_module_get_global(impl->module), NULL);
+		return links[1];
+	}
+
+      error:
+	if (links[0])
+		pw_link_destroy(links[0]);
+	pw_node_destroy(node);
+	return NULL;
+}
+
 static void try_link_port(struct pw_node *node, struct pw_port *port, struct node_info *info)
 {
 	struct impl *impl = info->impl;
@@ -223,11 +422,14 @@ static void try_link_port(struct pw_node *node, struct pw_port *port, struct nod
 		port = tmp;
 	}
 
-	link = pw_link_new(impl->core,
-			   port, target,
-			   NULL, NULL,
-			   &error,
-			   sizeof(struct link_data));
+	if (need_convert(impl, port, target))
+		link = link_convert(impl, port, target, info, &error);
+	else
+		link = pw_link_new(impl->core,
+				   port, target,
+				   NULL, NULL,
+				   &error,
+				   sizeof(struct link_data));
 	if (link == NULL)
 		goto error;
 
@@ -333,6 +535,7 @@ static void module_destroy(void *data)
 {
 	struct impl *impl = data;
 	struct node_info *info, *t;
+	struct convert_data *cd, *tcd;
 
 	spa_list_for_each_safe(info, t, &impl->node_list, l)
 		node_info_free(info);
@@ -340,6 +543,11 @@ static void module_destroy(void *data)
 	spa_hook_remove(&impl->core_listener);
 	spa_hook_remove(&impl->module_listener);
 
+	spa_list_for_each_safe(cd, tcd, &impl->convert_list, l)
+		pw_node_destroy(cd->node);
+
+	pw_work_queue_destroy(impl->work);
+
 	if (impl->properties)
 		pw_properties_free(impl->properties);
 
@@ -383,6 +591,12 @@ static int module_init(struct pw_module *module, struct pw_properties *propertie
 	impl->properties = properties;
 
 	spa_list_init(&impl->node_list);
+	spa_list_init(&impl->convert_list);
+
+	spa_type_media_type_map(impl->t->map, &impl->media_type);
+	spa_type_media_subtype_map(impl->t->map, &impl->media_subtype);
+
+	impl->work = pw_work_queue_new(pw_core_get_main_loop(core));
 
 	pw_core_add_listener(core, &impl->core_listener, &core_events, impl);
 	pw_module_add_listener(module, &impl->module_listener, &module_events, impl);
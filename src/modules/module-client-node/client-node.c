@@ -21,6 +21,7 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <dlfcn.h>
@@ -92,6 +93,9 @@ struct port {
 
 	uint32_t n_buffers;
 	struct buffer buffers[MAX_BUFFERS];
+
+	struct pw_port *port;
+	struct spa_hook port_listener;
 };
 
 struct node {
@@ -111,6 +115,11 @@ struct node {
 	struct spa_source data_source;
 	int writefd;
 
+	bool batching;		/**< collect the wakeups of the client */
+	bool need_flush;
+	uint64_t n_events;	/**< number of events for the client */
+	uint64_t n_wakeups;	/**< number of wakeups of the client */
+
 	uint32_t max_inputs;
 	uint32_t n_inputs;
 	uint32_t max_outputs;
@@ -145,7 +154,28 @@ struct impl {
 	int other_fds[2];
 
 	uint32_t input_ready;
-	bool out_pending;
+
+	struct spa_list target_list;	/**< nodes activated by this node, main thread */
+	struct spa_list source_list;	/**< nodes activating this node, data thread */
+	uint32_t n_sources;
+	bool direct;
+	bool destroyed;
+
+	bool draining;
+	uint32_t triggered;
+};
+
+/** a peer node that is activated directly by the client of a node */
+struct target {
+	struct spa_list link;		/**< link in impl target_list */
+	struct spa_list rt_link;	/**< link in peer source_list */
+	struct impl *impl;
+	struct impl *peer;
+	bool seen;
+	uint32_t n_links;
+	struct pw_client_node_link links[MAX_OUTPUTS];
+	uint32_t n_new_links;
+	struct pw_client_node_link new_links[MAX_OUTPUTS];
 };
 
 /** \endcond */
@@ -264,12 +294,23 @@ static int impl_node_set_param(struct spa_node *node, uint32_t id, uint32_t flag
 	return SPA_RESULT_RETURN_ASYNC(this->seq++);
 }
 
-static inline void do_flush(struct node *this)
+static inline void do_wakeup(struct node *this)
 {
 	uint64_t cmd = 1;
+
+	this->n_wakeups++;
 	if (write(this->writefd, &cmd, 8) != 8)
 		spa_log_warn(this->log, "node %p: error flushing : %s", this, strerror(errno));
+}
 
+static inline void do_flush(struct node *this)
+{
+	this->n_events++;
+	/* we are handling the events of the client, wake it up when done */
+	if (this->batching)
+		this->need_flush = true;
+	else
+		do_wakeup(this);
 }
 
 static int impl_node_send_command(struct spa_node *node, const struct spa_command *command)
@@ -613,6 +654,11 @@ impl_node_port_set_io(struct spa_node *node,
 	if (!CHECK_PORT(this, direction, port_id))
 		return -EINVAL;
 
+	/* the buffers io of the ports lives in the transport area and is
+	 * shared with the client when the port is added */
+	if (id == t->io.Buffers)
+		return 0;
+
 	if (data) {
 		if ((mem = pw_memblock_find(data)) == NULL)
 			return -EINVAL;
@@ -841,8 +887,25 @@ static int impl_node_process_input(struct spa_node *node)
 	struct spa_graph_node *n = &impl->this.node->rt.node;
 	bool client_reuse = impl->client_reuse;
 	struct spa_graph_port *p, *pp;
+	uint32_t triggered;
 	int res;
 
+	triggered = __atomic_load_n(&impl->transport->activation->triggered, __ATOMIC_ACQUIRE);
+	if (triggered != impl->triggered) {
+		/* the peers copied the io and woke up the client already */
+		pw_log_trace("node %p: activated by peers", impl);
+		impl->triggered = triggered;
+
+		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
+			if (!client_reuse && (pp = p->peer))
+		                spa_node_port_reuse_buffer(pp->node->implementation,
+						pp->port_id, p->io->buffer_id);
+		}
+		if (impl->input_ready > 0)
+			impl->input_ready--;
+		return SPA_STATUS_OK;
+	}
+
 	if (impl->input_ready == 0) {
 		/* the client is not ready to receive our buffers, recycle them */
 		pw_log_trace("node not ready, recycle buffers");
@@ -851,19 +914,20 @@ static int impl_node_process_input(struct spa_node *node)
 		res = SPA_STATUS_NEED_BUFFER;
 	}
 	else {
+		/* the io of the ports is in the transport, the client sees the new
+		 * status and buffer_id directly */
 		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
 			struct spa_io_buffers *io = p->io;
 
 			pw_log_trace("set io status to %d %d", io->status, io->buffer_id);
-			impl->transport->inputs[p->port_id] = *io;
 
 			/* explicitly recycle buffers when the client is not going to do it */
 			if (!client_reuse && (pp = p->peer))
 		                spa_node_port_reuse_buffer(pp->node->implementation,
 						pp->port_id, io->buffer_id);
 		}
-		pw_client_node_transport_add_message(impl->transport,
-			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT));
+		pw_client_node_transport_signal(impl->transport,
+						PW_CLIENT_NODE_PENDING_PROCESS_INPUT);
 		do_flush(this);
 
 		impl->input_ready--;
@@ -874,65 +938,36 @@ static int impl_node_process_input(struct spa_node *node)
 
 static int impl_node_process_output(struct spa_node *node)
 {
-	struct node *this;
-	struct impl *impl;
-	struct spa_graph_node *n;
-	struct spa_graph_port *p;
-
-	this = SPA_CONTAINER_OF(node, struct node, node);
-	impl = this->impl;
-	n = &impl->this.node->rt.node;
-
-	if (impl->out_pending)
-		goto done;
-
-	impl->out_pending = true;
-
-	spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
-		struct spa_io_buffers *io = p->io;
-
-		impl->transport->outputs[p->port_id] = *io;
-
-		pw_log_trace("%d %d -> %d %d", io->status, io->buffer_id,
-				impl->transport->outputs[p->port_id].status,
-				impl->transport->outputs[p->port_id].buffer_id);
-	}
+	struct node *this = SPA_CONTAINER_OF(node, struct node, node);
+	struct impl *impl = this->impl;
 
-      done:
-	pw_client_node_transport_add_message(impl->transport,
-			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT));
+	pw_client_node_transport_signal(impl->transport,
+					PW_CLIENT_NODE_PENDING_PROCESS_OUTPUT);
 	do_flush(this);
 
 	return SPA_STATUS_OK;
 }
 
-static int handle_node_message(struct node *this, struct pw_client_node_message *message)
+static void handle_node_pending(struct node *this, uint32_t pending)
 {
-	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, node);
-	struct spa_graph_node *n;
-	struct spa_graph_port *p;
-
-	n = &impl->this.node->rt.node;
+	struct impl *impl = this->impl;
 
-	switch (PW_CLIENT_NODE_MESSAGE_TYPE(message)) {
-	case PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT:
-		spa_list_for_each(p, &n->ports[SPA_DIRECTION_OUTPUT], link) {
-			*p->io = impl->transport->outputs[p->port_id];
-			pw_log_trace("have output %d %d", p->io->status, p->io->buffer_id);
-		}
-		impl->out_pending = false;
+	if (pending & PW_CLIENT_NODE_PENDING_HAVE_OUTPUT) {
+		pw_log_trace("node %p: have output", this);
 		this->callbacks->have_output(this->callbacks_data);
-		break;
-
-	case PW_CLIENT_NODE_MESSAGE_NEED_INPUT:
-		spa_list_for_each(p, &n->ports[SPA_DIRECTION_INPUT], link) {
-			*p->io = impl->transport->inputs[p->port_id];
-			pw_log_trace("need input %d %d", p->io->status, p->io->buffer_id);
-		}
+	}
+	if (pending & PW_CLIENT_NODE_PENDING_NEED_INPUT) {
+		pw_log_trace("node %p: need input", this);
 		impl->input_ready++;
 		this->callbacks->need_input(this->callbacks_data);
-		break;
+	}
+}
+
+static int handle_node_message(struct node *this, struct pw_client_node_message *message)
+{
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, node);
 
+	switch (PW_CLIENT_NODE_MESSAGE_TYPE(message)) {
 	case PW_CLIENT_NODE_MESSAGE_PORT_REUSE_BUFFER:
 		if (impl->client_reuse) {
 			struct pw_client_node_message_port_reuse_buffer *p =
@@ -955,7 +990,9 @@ static void setup_transport(struct impl *impl)
 
 	spa_node_get_n_ports(&impl->node.node, &n_inputs, &max_inputs, &n_outputs, &max_outputs);
 
-	impl->transport = pw_client_node_transport_new(max_inputs, max_outputs);
+	if (impl->transport == NULL)
+		impl->transport = pw_client_node_transport_new(max_inputs, max_outputs);
+
 	impl->transport->area->n_input_ports = n_inputs;
 	impl->transport->area->n_output_ports = n_outputs;
 }
@@ -966,7 +1003,7 @@ client_node_done(void *data, int seq, int res)
 	struct impl *impl = data;
 	struct node *this = &impl->node;
 
-	if (seq == 0 && res == 0 && impl->transport == NULL)
+	if (seq == 0 && res == 0)
 		setup_transport(impl);
 
 	this->callbacks->done(this->callbacks_data, seq, res);
@@ -1032,6 +1069,9 @@ client_node_port_update(void *data,
 			       n_params, params, info);
 	}
 	pw_node_update_ports(impl->this.node);
+
+	if (impl->transport)
+		setup_transport(impl);
 }
 
 static void client_node_set_active(void *data, bool active)
@@ -1063,6 +1103,37 @@ static struct pw_client_node_proxy_methods client_node_methods = {
 	.destroy = client_node_destroy,
 };
 
+static void process_messages(struct impl *impl)
+{
+	struct node *this = &impl->node;
+	struct pw_client_node_message message;
+	struct target *t;
+
+	if (impl->draining)
+		return;
+	impl->draining = true;
+	this->batching = true;
+
+	/* the nodes that activated us directly did not wake us up, handle
+	 * their messages first */
+	spa_list_for_each(t, &impl->source_list, rt_link)
+		process_messages(t->impl);
+
+	while (pw_client_node_transport_next_message(impl->transport, &message) == 1) {
+		struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
+		pw_client_node_transport_parse_message(impl->transport, msg);
+		handle_node_message(this, msg);
+	}
+	handle_node_pending(this, pw_client_node_transport_take_pending(impl->transport));
+
+	this->batching = false;
+	if (this->need_flush) {
+		this->need_flush = false;
+		do_wakeup(this);
+	}
+	impl->draining = false;
+}
+
 static void node_on_data_fd_events(struct spa_source *source)
 {
 	struct node *this = source->data;
@@ -1074,18 +1145,13 @@ static void node_on_data_fd_events(struct spa_source *source)
 	}
 
 	if (source->rmask & SPA_IO_IN) {
-		struct pw_client_node_message message;
 		uint64_t cmd;
 
 		if (read(this->data_source.fd, &cmd, sizeof(uint64_t)) != sizeof(uint64_t))
 			spa_log_warn(this->log, "node %p: error reading message: %s",
 					this, strerror(errno));
 
-		while (pw_client_node_transport_next_message(impl->transport, &message) == 1) {
-			struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
-			pw_client_node_transport_parse_message(impl->transport, msg);
-			handle_node_message(this, msg);
-		}
+		process_messages(impl);
 	}
 }
 
@@ -1178,6 +1244,318 @@ static int do_remove_source(struct spa_loop *loop,
 	return 0;
 }
 
+static struct impl *node_get_impl(struct pw_node *node)
+{
+	struct impl *impl;
+
+	if (node == NULL || node->node == NULL ||
+	    node->node->process_input != impl_node_process_input)
+		return NULL;
+
+	impl = SPA_CONTAINER_OF(node->node, struct impl, node.node);
+	if (impl->destroyed || impl->this.resource == NULL ||
+	    impl->transport == NULL || impl->fds[1] == -1)
+		return NULL;
+
+	return impl;
+}
+
+/* a link between two client nodes where the output node can copy the io
+ * and activate the input node itself. The output node gets the eventfd and
+ * the transport of the input node, so both nodes must belong to the same
+ * client. */
+static struct impl *link_get_peer(struct pw_link *link, struct pw_link *removed)
+{
+	struct pw_port *input = link->input;
+	struct impl *source, *peer;
+
+	if (link == removed || input == NULL || link->output == NULL)
+		return NULL;
+	if (link->state < PW_LINK_STATE_PAUSED)
+		return NULL;
+	/* mixing is done in the server */
+	if (input->links.next->next != &input->links)
+		return NULL;
+	if (input->port_id >= MAX_INPUTS || link->output->port_id >= MAX_OUTPUTS)
+		return NULL;
+
+	if ((source = node_get_impl(link->output->node)) == NULL ||
+	    (peer = node_get_impl(input->node)) == NULL)
+		return NULL;
+	if (pw_resource_get_client(source->this.resource) !=
+	    pw_resource_get_client(peer->this.resource))
+		return NULL;
+
+	return peer;
+}
+
+/* set_activation is only sent to clients that created the node with
+ * version 1 or later */
+static inline bool client_can_activate(struct impl *impl)
+{
+	return impl->this.resource != NULL && impl->this.resource->version >= 1;
+}
+
+static bool node_outputs_direct(struct impl *impl, struct pw_link *removed)
+{
+	struct pw_node *node = impl->this.node;
+	struct pw_port *port;
+	struct pw_link *link;
+	bool linked = false;
+
+	if (!client_can_activate(impl))
+		return false;
+
+	spa_list_for_each(port, &node->output_ports, link) {
+		spa_list_for_each(link, &port->links, output_link) {
+			struct impl *peer = link_get_peer(link, removed);
+			if (peer == NULL || peer == impl)
+				return false;
+			linked = true;
+		}
+	}
+	return linked;
+}
+
+static bool node_inputs_direct(struct impl *impl, struct pw_link *removed)
+{
+	struct pw_node *node = impl->this.node;
+	struct pw_port *port;
+	struct pw_link *link;
+
+	spa_list_for_each(port, &node->input_ports, link) {
+		spa_list_for_each(link, &port->links, input_link) {
+			struct impl *source;
+
+			if (link_get_peer(link, removed) == NULL)
+				return false;
+			if ((source = node_get_impl(link->output->node)) == NULL || !source->direct)
+				return false;
+		}
+	}
+	return true;
+}
+
+static struct target *find_target(struct impl *impl, struct impl *peer)
+{
+	struct target *t;
+
+	spa_list_for_each(t, &impl->target_list, link) {
+		if (t->peer == peer)
+			return t;
+	}
+	return NULL;
+}
+
+static int
+do_add_target(struct spa_loop *loop,
+	      bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct target *t = user_data;
+	spa_list_append(&t->peer->source_list, &t->rt_link);
+	return 0;
+}
+
+static int
+do_remove_target(struct spa_loop *loop,
+		 bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct target *t = user_data;
+	spa_list_remove(&t->rt_link);
+	return 0;
+}
+
+static void target_free(struct target *t)
+{
+	struct impl *impl = t->impl;
+
+	pw_log_debug("client-node %p: stop activating %p", impl, t->peer);
+
+	if (client_can_activate(impl))
+		pw_client_node_resource_set_activation(impl->this.resource,
+				pw_global_get_id(pw_node_get_global(t->peer->this.node)),
+				-1, NULL, 0, NULL);
+
+	pw_loop_invoke(impl->this.node->data_loop,
+		       do_remove_target, SPA_ID_INVALID, NULL, 0, true, t);
+
+	spa_list_remove(&t->link);
+	free(t);
+}
+
+static void update_targets(struct impl *impl, struct pw_link *removed)
+{
+	struct pw_node *node = impl->this.node;
+	struct pw_port *port;
+	struct pw_link *link;
+	struct target *t, *tmp;
+
+	spa_list_for_each(t, &impl->target_list, link)
+		t->seen = false;
+
+	if (impl->direct) {
+		spa_list_for_each(port, &node->output_ports, link) {
+			spa_list_for_each(link, &port->links, output_link) {
+				struct impl *peer = link_get_peer(link, removed);
+				struct pw_client_node_link *l;
+
+				if ((t = find_target(impl, peer)) == NULL) {
+					if ((t = calloc(1, sizeof(struct target))) == NULL)
+						continue;
+					t->impl = impl;
+					t->peer = peer;
+					spa_list_init(&t->rt_link);
+					spa_list_append(&impl->target_list, &t->link);
+				}
+				if (!t->seen) {
+					t->seen = true;
+					t->n_new_links = 0;
+				}
+				if (t->n_new_links == MAX_OUTPUTS)
+					continue;
+				l = &t->new_links[t->n_new_links++];
+				l->output_port_id = link->output->port_id;
+				l->input_port_id = link->input->port_id;
+			}
+		}
+	}
+
+	spa_list_for_each_safe(t, tmp, &impl->target_list, link) {
+		if (!t->seen) {
+			target_free(t);
+			continue;
+		}
+		if (!spa_list_is_empty(&t->rt_link) &&
+		    t->n_links == t->n_new_links &&
+		    memcmp(t->links, t->new_links, t->n_links * sizeof(t->links[0])) == 0)
+			continue;
+
+		t->n_links = t->n_new_links;
+		memcpy(t->links, t->new_links, t->n_links * sizeof(t->links[0]));
+
+		pw_log_debug("client-node %p: activate %p with %d links", impl, t->peer, t->n_links);
+
+		pw_client_node_resource_set_activation(impl->this.resource,
+				pw_global_get_id(pw_node_get_global(t->peer->this.node)),
+				t->peer->node.writefd,
+				t->peer->transport,
+				t->n_links, t->links);
+
+		if (spa_list_is_empty(&t->rt_link))
+			pw_loop_invoke(impl->this.node->data_loop,
+				       do_add_target, SPA_ID_INVALID, NULL, 0, true, t);
+	}
+}
+
+/* Find the client nodes that can activate their peers directly. A node
+ * activates its peers when all its output links go to client nodes that
+ * are only activated by such nodes. */
+static void update_activations(struct pw_core *core, struct pw_link *removed)
+{
+	struct pw_node *node;
+	struct impl *impl;
+	struct target *t;
+	bool changed;
+
+	spa_list_for_each(node, &core->node_list, link) {
+		if ((impl = node_get_impl(node)) == NULL)
+			continue;
+		impl->direct = node_outputs_direct(impl, removed);
+		impl->n_sources = 0;
+	}
+
+	do {
+		changed = false;
+		spa_list_for_each(node, &core->node_list, link) {
+			struct pw_port *port;
+			struct pw_link *link;
+
+			if ((impl = node_get_impl(node)) == NULL || !impl->direct)
+				continue;
+
+			spa_list_for_each(port, &node->output_ports, link) {
+				spa_list_for_each(link, &port->links, output_link) {
+					struct impl *peer = link_get_peer(link, removed);
+					if (peer && !node_inputs_direct(peer, removed)) {
+						impl->direct = false;
+						changed = true;
+						break;
+					}
+				}
+				if (!impl->direct)
+					break;
+			}
+		}
+	} while (changed);
+
+	spa_list_for_each(node, &core->node_list, link) {
+		if ((impl = node_get_impl(node)) == NULL)
+			continue;
+		update_targets(impl, removed);
+		spa_list_for_each(t, &impl->target_list, link)
+			t->peer->n_sources++;
+	}
+
+	spa_list_for_each(node, &core->node_list, link) {
+		struct pw_client_node_activation *a;
+
+		if ((impl = node_get_impl(node)) == NULL)
+			continue;
+
+		a = impl->transport->activation;
+		if (a->required != impl->n_sources) {
+			pw_log_debug("client-node %p: activated by %d peers", impl, impl->n_sources);
+			a->required = impl->n_sources;
+			__atomic_store_n(&a->pending, a->required, __ATOMIC_RELEASE);
+		}
+	}
+}
+
+/* stop activating and being activated by other nodes */
+static void clear_activations(struct impl *impl)
+{
+	struct pw_node *node;
+	struct impl *other;
+	struct target *t, *tmp;
+
+	spa_list_for_each_safe(t, tmp, &impl->target_list, link)
+		target_free(t);
+
+	spa_list_for_each(node, &impl->core->node_list, link) {
+		if ((other = node_get_impl(node)) == NULL)
+			continue;
+		spa_list_for_each_safe(t, tmp, &other->target_list, link) {
+			if (t->peer == impl)
+				target_free(t);
+		}
+	}
+}
+
+static void port_link_added(void *data, struct pw_link *link)
+{
+	struct impl *impl = data;
+	update_activations(impl->core, NULL);
+}
+
+static void port_link_removed(void *data, struct pw_link *link)
+{
+	struct impl *impl = data;
+	update_activations(impl->core, link);
+}
+
+static void port_state_changed(void *data, enum pw_port_state state)
+{
+	struct impl *impl = data;
+	update_activations(impl->core, NULL);
+}
+
+static const struct pw_port_events port_events = {
+	PW_VERSION_PORT_EVENTS,
+	.link_added = port_link_added,
+	.link_removed = port_link_removed,
+	.state_changed = port_state_changed,
+};
+
 static void client_node_resource_destroy(void *data)
 {
 	struct impl *impl = data;
@@ -1227,11 +1605,98 @@ static void node_initialized(void *data)
 					  impl->transport);
 }
 
+static void node_destroy(void *data)
+{
+	struct impl *impl = data;
+
+	pw_log_debug("client-node %p: destroy", &impl->this);
+	impl->destroyed = true;
+	clear_activations(impl);
+}
+
+static int
+do_port_set_io(struct spa_loop *loop,
+	       bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_port *port = user_data;
+	struct spa_io_buffers *io = *(struct spa_io_buffers **) data;
+
+	port->rt.port.io = io;
+	port->rt.mix_port.io = io;
+	return 0;
+}
+
+/* make the graph use the io area in the transport so that the server and
+ * the client read and write the same io without copies */
+static void port_use_transport_io(struct impl *impl, struct pw_port *port)
+{
+	struct pw_client_node_transport *trans = impl->transport;
+	struct spa_io_buffers *io;
+
+	if (port->direction == PW_DIRECTION_INPUT) {
+		if (port->port_id >= trans->area->max_input_ports)
+			return;
+		io = &trans->inputs[port->port_id];
+	} else {
+		if (port->port_id >= trans->area->max_output_ports)
+			return;
+		io = &trans->outputs[port->port_id];
+	}
+	*io = *port->rt.port.io;
+
+	pw_loop_invoke(port->node->data_loop,
+		       do_port_set_io, SPA_ID_INVALID, &io, sizeof(io), true, port);
+}
+
+static void node_port_added(void *data, struct pw_port *port)
+{
+	struct impl *impl = data;
+	struct node *this = &impl->node;
+	enum spa_direction direction = (enum spa_direction) port->direction;
+	struct port *p;
+
+	if (!CHECK_PORT_ID(this, direction, port->port_id))
+		return;
+
+	p = GET_PORT(this, direction, port->port_id);
+	p->port = port;
+	pw_port_add_listener(port, &p->port_listener, &port_events, impl);
+
+	setup_transport(impl);
+	port_use_transport_io(impl, port);
+}
+
+static void node_port_removed(void *data, struct pw_port *port)
+{
+	struct impl *impl = data;
+	struct node *this = &impl->node;
+	enum spa_direction direction = (enum spa_direction) port->direction;
+	struct port *p;
+
+	if (!CHECK_PORT_ID(this, direction, port->port_id))
+		return;
+
+	p = GET_PORT(this, direction, port->port_id);
+	if (p->port != port)
+		return;
+
+	spa_hook_remove(&p->port_listener);
+	p->port = NULL;
+}
+
+static void node_state_changed(void *data, enum pw_node_state old,
+			       enum pw_node_state state, const char *error)
+{
+	struct impl *impl = data;
+	update_activations(impl->core, NULL);
+}
+
 static void node_free(void *data)
 {
 	struct impl *impl = data;
 
-	pw_log_debug("client-node %p: free", &impl->this);
+	pw_log_debug("client-node %p: free, %" PRIu64 " events in %" PRIu64 " wakeups",
+		     &impl->this, impl->node.n_events, impl->node.n_wakeups);
 	node_clear(&impl->node);
 
 	if (impl->transport)
@@ -1250,8 +1715,12 @@ static void node_free(void *data)
 
 static const struct pw_node_events node_events = {
 	PW_VERSION_NODE_EVENTS,
+	.destroy = node_destroy,
 	.free = node_free,
 	.initialized = node_initialized,
+	.port_added = node_port_added,
+	.port_removed = node_port_removed,
+	.state_changed = node_state_changed,
 };
 
 static const struct pw_resource_events resource_events = {
@@ -1291,6 +1760,8 @@ struct pw_client_node *pw_client_node_new(struct pw_resource *resource,
 	impl->core = core;
 	impl->t = pw_core_get_type(core);
 	impl->fds[0] = impl->fds[1] = -1;
+	spa_list_init(&impl->target_list);
+	spa_list_init(&impl->source_list);
 	pw_log_debug("client-node %p: new", impl);
 
 	support = pw_core_get_support(impl->core, &n_support);
@@ -1315,6 +1786,9 @@ struct pw_client_node *pw_client_node_new(struct pw_resource *resource,
 	if (this->node == NULL)
 		goto error_no_node;
 
+	/* the client completes the processing and calls back into the graph */
+	this->node->rt.node.flags |= SPA_GRAPH_NODE_FLAG_ASYNC;
+
 	str = pw_properties_get(properties, "pipewire.client.reuse");
 	impl->client_reuse = str && pw_properties_parse_bool(str);
 
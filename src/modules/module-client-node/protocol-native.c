@@ -31,6 +31,15 @@
 
 #include "transport.h"
 
+/* a NULL string is sent as NONE so that it is demarshalled as NULL again */
+static void marshal_string(struct spa_pod_builder *b, const char *str)
+{
+	if (str)
+		spa_pod_builder_string(b, str);
+	else
+		spa_pod_builder_none(b);
+}
+
 static void
 client_node_marshal_done(void *object, int seq, int res)
 {
@@ -39,9 +48,10 @@ client_node_marshal_done(void *object, int seq, int res)
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CLIENT_NODE_PROXY_METHOD_DONE);
 
-	spa_pod_builder_struct(b,
-			       "i", seq,
-			       "i", res);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, seq);
+	spa_pod_builder_int(b, res);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -61,17 +71,14 @@ client_node_marshal_update(void *object,
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CLIENT_NODE_PROXY_METHOD_UPDATE);
 
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", change_mask,
-			    "i", max_input_ports,
-			    "i", max_output_ports,
-			    "i", n_params, NULL);
-
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, change_mask);
+	spa_pod_builder_int(b, max_input_ports);
+	spa_pod_builder_int(b, max_output_ports);
+	spa_pod_builder_int(b, n_params);
 	for (i = 0; i < n_params; i++)
-		spa_pod_builder_add(b, "P", params[i], NULL);
-
-	spa_pod_builder_add(b, "]", NULL);
+		spa_pod_builder_pod(b, params[i]);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -91,34 +98,30 @@ client_node_marshal_port_update(void *object,
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CLIENT_NODE_PROXY_METHOD_PORT_UPDATE);
 
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", direction,
-			    "i", port_id,
-			    "i", change_mask,
-			    "i", n_params, NULL);
-
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, direction);
+	spa_pod_builder_int(b, port_id);
+	spa_pod_builder_int(b, change_mask);
+	spa_pod_builder_int(b, n_params);
 	for (i = 0; i < n_params; i++)
-		spa_pod_builder_add(b, "P", params[i], NULL);
+		spa_pod_builder_pod(b, params[i]);
 
 	if (info) {
 		n_items = info->props ? info->props->n_items : 0;
 
-		spa_pod_builder_add(b,
-				    "[",
-				    "i", info->flags,
-				    "i", info->rate,
-				    "i", n_items, NULL);
+		spa_pod_builder_push_struct(b);
+		spa_pod_builder_int(b, info->flags);
+		spa_pod_builder_int(b, info->rate);
+		spa_pod_builder_int(b, n_items);
 		for (i = 0; i < n_items; i++) {
-			spa_pod_builder_add(b,
-					    "s", info->props->items[i].key,
-					    "s", info->props->items[i].value, NULL);
+			marshal_string(b, info->props->items[i].key);
+			marshal_string(b, info->props->items[i].value);
 		}
-		spa_pod_builder_add(b, "]", NULL);
+		spa_pod_builder_pop(b);
 	} else {
-		spa_pod_builder_add(b, "P", NULL, NULL);
+		spa_pod_builder_none(b);
 	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -130,7 +133,9 @@ static void client_node_marshal_set_active(void *object, bool active)
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CLIENT_NODE_PROXY_METHOD_SET_ACTIVE);
 
-	spa_pod_builder_struct(b, "b", active);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_bool(b, active);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -142,7 +147,9 @@ static void client_node_marshal_event_method(void *object, struct spa_event *eve
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CLIENT_NODE_PROXY_METHOD_EVENT);
 
-	spa_pod_builder_struct(b, "P", event);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_pod(b, (const struct spa_pod *) event);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -154,7 +161,8 @@ static void client_node_marshal_destroy(void *object)
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CLIENT_NODE_PROXY_METHOD_DESTROY);
 
-	spa_pod_builder_struct(b);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -167,12 +175,11 @@ static int client_node_demarshal_add_mem(void *object, void *data, size_t size)
 	int memfd;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &mem_id,
-			"I", &type,
-			"i", &memfd_idx,
-			"i", &flags, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &mem_id) < 0 ||
+	    spa_pod_parser_get_id(&prs, &type) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &memfd_idx) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &flags) < 0)
 		return -EINVAL;
 
 	memfd = pw_protocol_native_get_proxy_fd(proxy, memfd_idx);
@@ -194,14 +201,13 @@ static int client_node_demarshal_transport(void *object, void *data, size_t size
 	struct pw_client_node_transport *transport;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &node_id,
-			"i", &ridx,
-			"i", &widx,
-			"i", &memfd_idx,
-			"i", &info.offset,
-			"i", &info.size, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &node_id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &ridx) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &widx) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &memfd_idx) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.offset) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.size) < 0)
 		return -EINVAL;
 
 	readfd = pw_protocol_native_get_proxy_fd(proxy, ridx);
@@ -226,12 +232,11 @@ static int client_node_demarshal_set_param(void *object, void *data, size_t size
 	const struct spa_pod *param = NULL;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &seq,
-			"I", &id,
-			"i", &flags,
-			"O", &param, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &seq) < 0 ||
+	    spa_pod_parser_get_id(&prs, &id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &flags) < 0 ||
+	    spa_pod_parser_get_object(&prs, (struct spa_pod **) &param) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, set_param, 0, seq, id, flags, param);
@@ -245,7 +250,8 @@ static int client_node_demarshal_event_event(void *object, void *data, size_t si
 	const struct spa_event *event;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[ O", &event, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_object(&prs, (struct spa_pod **) &event) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, event, 0, event);
@@ -260,10 +266,9 @@ static int client_node_demarshal_command(void *object, void *data, size_t size)
 	uint32_t seq;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &seq,
-			"O", &command, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &seq) < 0 ||
+	    spa_pod_parser_get_object(&prs, (struct spa_pod **) &command) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, command, 0, seq, command);
@@ -277,11 +282,10 @@ static int client_node_demarshal_add_port(void *object, void *data, size_t size)
 	int32_t seq, direction, port_id;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &seq,
-			"i", &direction,
-			"i", &port_id, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, &seq) < 0 ||
+	    spa_pod_parser_get_int(&prs, &direction) < 0 ||
+	    spa_pod_parser_get_int(&prs, &port_id) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, add_port, 0, seq, direction, port_id);
@@ -295,11 +299,10 @@ static int client_node_demarshal_remove_port(void *object, void *data, size_t si
 	int32_t seq, direction, port_id;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &seq,
-			"i", &direction,
-			"i", &port_id, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, &seq) < 0 ||
+	    spa_pod_parser_get_int(&prs, &direction) < 0 ||
+	    spa_pod_parser_get_int(&prs, &port_id) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, remove_port, 0, seq, direction, port_id);
@@ -314,14 +317,13 @@ static int client_node_demarshal_port_set_param(void *object, void *data, size_t
 	const struct spa_pod *param = NULL;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &seq,
-			"i", &direction,
-			"i", &port_id,
-			"I", &id,
-			"i", &flags,
-			"O", &param, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &seq) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &direction) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &port_id) < 0 ||
+	    spa_pod_parser_get_id(&prs, &id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &flags) < 0 ||
+	    spa_pod_parser_get_object(&prs, (struct spa_pod **) &param) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, port_set_param, 0,
@@ -338,48 +340,44 @@ static int client_node_demarshal_port_use_buffers(void *object, void *data, size
 	int i, j;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &seq,
-			"i", &direction,
-			"i", &port_id,
-			"i", &n_buffers, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &seq) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &direction) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &port_id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &n_buffers) < 0)
 		return -EINVAL;
 
 	buffers = alloca(sizeof(struct pw_client_node_buffer) * n_buffers);
 	for (i = 0; i < n_buffers; i++) {
 		struct spa_buffer *buf = buffers[i].buffer = alloca(sizeof(struct spa_buffer));
 
-		if (spa_pod_parser_get(&prs,
-				      "i", &buffers[i].mem_id,
-				      "i", &buffers[i].offset,
-				      "i", &buffers[i].size,
-				      "i", &buf->id,
-				      "i", &buf->n_metas, NULL) < 0)
+		if (spa_pod_parser_get_int(&prs, (int32_t *) &buffers[i].mem_id) < 0 ||
+		    spa_pod_parser_get_int(&prs, (int32_t *) &buffers[i].offset) < 0 ||
+		    spa_pod_parser_get_int(&prs, (int32_t *) &buffers[i].size) < 0 ||
+		    spa_pod_parser_get_int(&prs, (int32_t *) &buf->id) < 0 ||
+		    spa_pod_parser_get_int(&prs, (int32_t *) &buf->n_metas) < 0)
 			return -EINVAL;
 
 		buf->metas = alloca(sizeof(struct spa_meta) * buf->n_metas);
 		for (j = 0; j < buf->n_metas; j++) {
 			struct spa_meta *m = &buf->metas[j];
 
-			if (spa_pod_parser_get(&prs,
-					      "I", &m->type,
-					      "i", &m->size, NULL) < 0)
+			if (spa_pod_parser_get_id(&prs, &m->type) < 0 ||
+			    spa_pod_parser_get_int(&prs, (int32_t *) &m->size) < 0)
 				return -EINVAL;
 		}
-		if (spa_pod_parser_get(&prs, "i", &buf->n_datas, NULL) < 0)
+		if (spa_pod_parser_get_int(&prs, (int32_t *) &buf->n_datas) < 0)
 			return -EINVAL;
 
 		buf->datas = alloca(sizeof(struct spa_data) * buf->n_datas);
 		for (j = 0; j < buf->n_datas; j++) {
 			struct spa_data *d = &buf->datas[j];
 
-			if (spa_pod_parser_get(&prs,
-					      "I", &d->type,
-					      "i", &data_id,
-					      "i", &d->flags,
-					      "i", &d->mapoffset,
-					      "i", &d->maxsize, NULL) < 0)
+			if (spa_pod_parser_get_id(&prs, &d->type) < 0 ||
+			    spa_pod_parser_get_int(&prs, (int32_t *) &data_id) < 0 ||
+			    spa_pod_parser_get_int(&prs, (int32_t *) &d->flags) < 0 ||
+			    spa_pod_parser_get_int(&prs, (int32_t *) &d->mapoffset) < 0 ||
+			    spa_pod_parser_get_int(&prs, (int32_t *) &d->maxsize) < 0)
 				return -EINVAL;
 
 			d->data = SPA_UINT32_TO_PTR(data_id);
@@ -400,11 +398,10 @@ static int client_node_demarshal_port_command(void *object, void *data, size_t s
 	uint32_t direction, port_id;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &direction,
-			"i", &port_id,
-			"O", &command, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &direction) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &port_id) < 0 ||
+	    spa_pod_parser_get_object(&prs, (struct spa_pod **) &command) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, port_command, 0, direction,
@@ -420,15 +417,14 @@ static int client_node_demarshal_port_set_io(void *object, void *data, size_t si
 	uint32_t seq, direction, port_id, id, memid, off, sz;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &seq,
-			"i", &direction,
-			"i", &port_id,
-			"I", &id,
-			"i", &memid,
-			"i", &off,
-			"i", &sz, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &seq) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &direction) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &port_id) < 0 ||
+	    spa_pod_parser_get_id(&prs, &id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &memid) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &off) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &sz) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, port_set_io, 0,
@@ -439,6 +435,47 @@ static int client_node_demarshal_port_set_io(void *object, void *data, size_t si
 	return 0;
 }
 
+static int client_node_demarshal_set_activation(void *object, void *data, size_t size)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_parser prs;
+	uint32_t node_id, sigidx, memfd_idx, n_links;
+	int signalfd;
+	struct pw_client_node_transport_info info;
+	struct pw_client_node_transport *transport = NULL;
+	struct pw_client_node_link *links;
+	int i;
+
+	spa_pod_parser_init(&prs, data, size, 0);
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &node_id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &sigidx) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &memfd_idx) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.offset) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.size) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &n_links) < 0)
+		return -EINVAL;
+
+	links = alloca(sizeof(struct pw_client_node_link) * n_links);
+	for (i = 0; i < n_links; i++) {
+		if (spa_pod_parser_get_int(&prs, (int32_t *) &links[i].output_port_id) < 0 ||
+		    spa_pod_parser_get_int(&prs, (int32_t *) &links[i].input_port_id) < 0)
+			return -EINVAL;
+	}
+
+	signalfd = pw_protocol_native_get_proxy_fd(proxy, sigidx);
+	info.memfd = pw_protocol_native_get_proxy_fd(proxy, memfd_idx);
+
+	if (signalfd != -1 && info.memfd != -1)
+		transport = pw_client_node_transport_new_from_info(&info);
+
+	pw_proxy_notify(proxy, struct pw_client_node_proxy_events, set_activation, 1, node_id,
+									     signalfd,
+									     transport,
+									     n_links, links);
+	return 0;
+}
+
 static void
 client_node_marshal_add_mem(void *object,
 			    uint32_t mem_id,
@@ -450,11 +487,12 @@ client_node_marshal_add_mem(void *object,
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_ADD_MEM);
 
-	spa_pod_builder_struct(b,
-			       "i", mem_id,
-			       "I", type,
-			       "i", pw_protocol_native_add_resource_fd(resource, memfd),
-			       "i", flags);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, mem_id);
+	spa_pod_builder_id(b, type);
+	spa_pod_builder_int(b, pw_protocol_native_add_resource_fd(resource, memfd));
+	spa_pod_builder_int(b, flags);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -470,13 +508,14 @@ static void client_node_marshal_transport(void *object, uint32_t node_id, int re
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_TRANSPORT);
 
-	spa_pod_builder_struct(b,
-			       "i", node_id,
-			       "i", pw_protocol_native_add_resource_fd(resource, readfd),
-			       "i", pw_protocol_native_add_resource_fd(resource, writefd),
-			       "i", pw_protocol_native_add_resource_fd(resource, info.memfd),
-			       "i", info.offset,
-			       "i", info.size);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, node_id);
+	spa_pod_builder_int(b, pw_protocol_native_add_resource_fd(resource, readfd));
+	spa_pod_builder_int(b, pw_protocol_native_add_resource_fd(resource, writefd));
+	spa_pod_builder_int(b, pw_protocol_native_add_resource_fd(resource, info.memfd));
+	spa_pod_builder_int(b, info.offset);
+	spa_pod_builder_int(b, info.size);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -490,11 +529,12 @@ client_node_marshal_set_param(void *object, uint32_t seq, uint32_t id, uint32_t
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_SET_PARAM);
 
-	spa_pod_builder_struct(b,
-			       "i", seq,
-			       "I", id,
-			       "i", flags,
-			       "P", param);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, seq);
+	spa_pod_builder_id(b, id);
+	spa_pod_builder_int(b, flags);
+	spa_pod_builder_pod(b, param);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -506,7 +546,9 @@ static void client_node_marshal_event_event(void *object, const struct spa_event
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_EVENT);
 
-	spa_pod_builder_struct(b, "P", event);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_pod(b, (const struct spa_pod *) event);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -519,7 +561,10 @@ client_node_marshal_command(void *object, uint32_t seq, const struct spa_command
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_COMMAND);
 
-	spa_pod_builder_struct(b, "i", seq, "P", command);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, seq);
+	spa_pod_builder_pod(b, (const struct spa_pod *) command);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -533,10 +578,11 @@ client_node_marshal_add_port(void *object,
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_ADD_PORT);
 
-	spa_pod_builder_struct(b,
-			       "i", seq,
-			       "i", direction,
-			       "i", port_id);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, seq);
+	spa_pod_builder_int(b, direction);
+	spa_pod_builder_int(b, port_id);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -550,10 +596,11 @@ client_node_marshal_remove_port(void *object,
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_REMOVE_PORT);
 
-	spa_pod_builder_struct(b,
-			       "i", seq,
-			       "i", direction,
-			       "i", port_id);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, seq);
+	spa_pod_builder_int(b, direction);
+	spa_pod_builder_int(b, port_id);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -572,13 +619,14 @@ client_node_marshal_port_set_param(void *object,
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_PORT_SET_PARAM);
 
-	spa_pod_builder_struct(b,
-			       "i", seq,
-			       "i", direction,
-			       "i", port_id,
-			       "I", id,
-			       "i", flags,
-			       "P", param);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, seq);
+	spa_pod_builder_int(b, direction);
+	spa_pod_builder_int(b, port_id);
+	spa_pod_builder_id(b, id);
+	spa_pod_builder_int(b, flags);
+	spa_pod_builder_pod(b, param);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -596,41 +644,37 @@ client_node_marshal_port_use_buffers(void *object,
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_PORT_USE_BUFFERS);
 
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", seq,
-			    "i", direction,
-			    "i", port_id,
-			    "i", n_buffers, NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, seq);
+	spa_pod_builder_int(b, direction);
+	spa_pod_builder_int(b, port_id);
+	spa_pod_builder_int(b, n_buffers);
 
 	for (i = 0; i < n_buffers; i++) {
 		struct spa_buffer *buf = buffers[i].buffer;
 
-		spa_pod_builder_add(b,
-				    "i", buffers[i].mem_id,
-				    "i", buffers[i].offset,
-				    "i", buffers[i].size,
-				    "i", buf->id,
-				    "i", buf->n_metas, NULL);
+		spa_pod_builder_int(b, buffers[i].mem_id);
+		spa_pod_builder_int(b, buffers[i].offset);
+		spa_pod_builder_int(b, buffers[i].size);
+		spa_pod_builder_int(b, buf->id);
+		spa_pod_builder_int(b, buf->n_metas);
 
 		for (j = 0; j < buf->n_metas; j++) {
 			struct spa_meta *m = &buf->metas[j];
-			spa_pod_builder_add(b,
-					    "I", m->type,
-					    "i", m->size, NULL);
+			spa_pod_builder_id(b, m->type);
+			spa_pod_builder_int(b, m->size);
 		}
-		spa_pod_builder_add(b, "i", buf->n_datas, NULL);
+		spa_pod_builder_int(b, buf->n_datas);
 		for (j = 0; j < buf->n_datas; j++) {
 			struct spa_data *d = &buf->datas[j];
-			spa_pod_builder_add(b,
-					    "I", d->type,
-					    "i", SPA_PTR_TO_UINT32(d->data),
-					    "i", d->flags,
-					    "i", d->mapoffset,
-					    "i", d->maxsize, NULL);
+			spa_pod_builder_id(b, d->type);
+			spa_pod_builder_int(b, SPA_PTR_TO_UINT32(d->data));
+			spa_pod_builder_int(b, d->flags);
+			spa_pod_builder_int(b, d->mapoffset);
+			spa_pod_builder_int(b, d->maxsize);
 		}
 	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -646,10 +690,11 @@ client_node_marshal_port_command(void *object,
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_PORT_COMMAND);
 
-	spa_pod_builder_struct(b,
-			       "i", direction,
-			       "i", port_id,
-			       "P", command);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, direction);
+	spa_pod_builder_int(b, port_id);
+	spa_pod_builder_pod(b, (const struct spa_pod *) command);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -669,14 +714,51 @@ client_node_marshal_port_set_io(void *object,
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_PORT_SET_IO);
 
-	spa_pod_builder_struct(b,
-			       "i", seq,
-			       "i", direction,
-			       "i", port_id,
-			       "I", id,
-			       "i", memid,
-			       "i", offset,
-			       "i", size);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, seq);
+	spa_pod_builder_int(b, direction);
+	spa_pod_builder_int(b, port_id);
+	spa_pod_builder_id(b, id);
+	spa_pod_builder_int(b, memid);
+	spa_pod_builder_int(b, offset);
+	spa_pod_builder_int(b, size);
+	spa_pod_builder_pop(b);
+
+	pw_protocol_native_end_resource(resource, b);
+}
+
+static void
+client_node_marshal_set_activation(void *object,
+				   uint32_t node_id,
+				   int signalfd,
+				   struct pw_client_node_transport *transport,
+				   uint32_t n_links,
+				   const struct pw_client_node_link *links)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_builder *b;
+	struct pw_client_node_transport_info info = { -1, 0, 0 };
+	uint32_t i;
+
+	if (transport)
+		pw_client_node_transport_get_info(transport, &info);
+
+	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_NODE_PROXY_EVENT_SET_ACTIVATION);
+
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, node_id);
+	spa_pod_builder_int(b, signalfd == -1 ? -1 :
+			    pw_protocol_native_add_resource_fd(resource, signalfd));
+	spa_pod_builder_int(b, info.memfd == -1 ? -1 :
+			    pw_protocol_native_add_resource_fd(resource, info.memfd));
+	spa_pod_builder_int(b, info.offset);
+	spa_pod_builder_int(b, info.size);
+	spa_pod_builder_int(b, n_links);
+	for (i = 0; i < n_links; i++) {
+		spa_pod_builder_int(b, links[i].output_port_id);
+		spa_pod_builder_int(b, links[i].input_port_id);
+	}
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -689,10 +771,9 @@ static int client_node_demarshal_done(void *object, void *data, size_t size)
 	uint32_t seq, res;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &seq,
-			"i", &res, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &seq) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &res) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_client_node_proxy_methods, done, 0, seq, res);
@@ -708,17 +789,16 @@ static int client_node_demarshal_update(void *object, void *data, size_t size)
 	int i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &change_mask,
-			"i", &max_input_ports,
-			"i", &max_output_ports,
-			"i", &n_params, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &change_mask) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &max_input_ports) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &max_output_ports) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &n_params) < 0)
 		return -EINVAL;
 
 	params = alloca(n_params * sizeof(struct spa_pod *));
 	for (i = 0; i < n_params; i++)
-		if (spa_pod_parser_get(&prs, "O", &params[i], NULL) < 0)
+		if (spa_pod_parser_get_object(&prs, (struct spa_pod **) &params[i]) < 0)
 			return -EINVAL;
 
 	pw_resource_do(resource, struct pw_client_node_proxy_methods, update, 0, change_mask,
@@ -740,20 +820,19 @@ static int client_node_demarshal_port_update(void *object, void *data, size_t si
 	struct spa_dict props;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &direction,
-			"i", &port_id,
-			"i", &change_mask,
-			"i", &n_params, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &direction) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &port_id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &change_mask) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &n_params) < 0)
 		return -EINVAL;
 
 	params = alloca(n_params * sizeof(struct spa_pod *));
 	for (i = 0; i < n_params; i++)
-		if (spa_pod_parser_get(&prs, "O", &params[i], NULL) < 0)
+		if (spa_pod_parser_get_object(&prs, (struct spa_pod **) &params[i]) < 0)
 			return -EINVAL;
 
-	if (spa_pod_parser_get(&prs, "T", &ipod, NULL) < 0)
+	if (spa_pod_parser_get_struct(&prs, &ipod) < 0)
 		return -EINVAL;
 
 	if (ipod) {
@@ -761,11 +840,10 @@ static int client_node_demarshal_port_update(void *object, void *data, size_t si
 		infop = &info;
 
 		spa_pod_parser_pod(&p2, ipod);
-		if (spa_pod_parser_get(&p2,
-				"["
-				"i", &info.flags,
-				"i", &info.rate,
-				"i", &props.n_items, NULL) < 0)
+		if (spa_pod_parser_push_struct(&p2) < 0 ||
+		    spa_pod_parser_get_int(&p2, (int32_t *) &info.flags) < 0 ||
+		    spa_pod_parser_get_int(&p2, (int32_t *) &info.rate) < 0 ||
+		    spa_pod_parser_get_int(&p2, (int32_t *) &props.n_items) < 0)
 			return -EINVAL;
 
 		if (props.n_items > 0) {
@@ -773,10 +851,10 @@ static int client_node_demarshal_port_update(void *object, void *data, size_t si
 
 			props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
 			for (i = 0; i < props.n_items; i++) {
-				if (spa_pod_parser_get(&p2,
-						"s", &props.items[i].key,
-						"s", &props.items[i].value,
-						NULL) < 0)
+				struct spa_dict_item *item = (struct spa_dict_item *) &props.items[i];
+
+				if (spa_pod_parser_get_string(&p2, &item->key) < 0 ||
+				    spa_pod_parser_get_string(&p2, &item->value) < 0)
 					return -EINVAL;
 			}
 		}
@@ -794,12 +872,11 @@ static int client_node_demarshal_set_active(void *object, void *data, size_t siz
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_parser prs;
-	int active;
+	bool active;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"b", &active, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_bool(&prs, &active) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_client_node_proxy_methods, set_active, 0, active);
@@ -813,9 +890,8 @@ static int client_node_demarshal_event_method(void *object, void *data, size_t s
 	struct spa_event *event;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"O", &event, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_object(&prs, (struct spa_pod **) &event) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_client_node_proxy_methods, event, 0, event);
@@ -828,7 +904,7 @@ static int client_node_demarshal_destroy(void *object, void *data, size_t size)
 	struct spa_pod_parser prs;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[", NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_client_node_proxy_methods, destroy, 0);
@@ -867,6 +943,7 @@ static const struct pw_client_node_proxy_events pw_protocol_native_client_node_e
 	&client_node_marshal_port_use_buffers,
 	&client_node_marshal_port_command,
 	&client_node_marshal_port_set_io,
+	&client_node_marshal_set_activation,
 };
 
 static const struct pw_protocol_native_demarshal pw_protocol_native_client_node_event_demarshal[] = {
@@ -881,6 +958,7 @@ static const struct pw_protocol_native_demarshal pw_protocol_native_client_node_
 	{ &client_node_demarshal_port_use_buffers, PW_PROTOCOL_NATIVE_REMAP },
 	{ &client_node_demarshal_port_command, PW_PROTOCOL_NATIVE_REMAP },
 	{ &client_node_demarshal_port_set_io, PW_PROTOCOL_NATIVE_REMAP },
+	{ &client_node_demarshal_set_activation, 0 },
 };
 
 static const struct pw_protocol_marshal pw_protocol_native_client_node_marshal = {
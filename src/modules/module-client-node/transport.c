@@ -21,7 +21,7 @@
 #include <errno.h>
 #include <sys/mman.h>
 
-#include <spa/utils/ringbuffer.h>
+#include <spa/utils/spsc-ringbuffer.h>
 #include <spa/node/io.h>
 #include <pipewire/log.h>
 #include <extensions/client-node.h>
@@ -50,9 +50,11 @@ static size_t area_get_size(struct pw_client_node_area *area)
 	size = sizeof(struct pw_client_node_area);
 	size += area->max_input_ports * sizeof(struct spa_io_buffers);
 	size += area->max_output_ports * sizeof(struct spa_io_buffers);
-	size += sizeof(struct spa_ringbuffer);
+	size = SPA_ROUND_UP_N(size, SPA_CACHE_LINE_SIZE);
+	size += SPA_ROUND_UP_N(sizeof(struct pw_client_node_activation), SPA_CACHE_LINE_SIZE);
+	size += sizeof(struct spa_spsc_ringbuffer);
 	size += INPUT_BUFFER_SIZE;
-	size += sizeof(struct spa_ringbuffer);
+	size += sizeof(struct spa_spsc_ringbuffer);
 	size += OUTPUT_BUFFER_SIZE;
 	return size;
 }
@@ -60,8 +62,11 @@ static size_t area_get_size(struct pw_client_node_area *area)
 static void transport_setup_area(void *p, struct pw_client_node_transport *trans)
 {
 	struct pw_client_node_area *a;
+	void *base = p;
 
 	trans->area = a = p;
+	trans->input_pending = &a->pending[0];
+	trans->output_pending = &a->pending[1];
 	p = SPA_MEMBER(p, sizeof(struct pw_client_node_area), struct spa_io_buffers);
 
 	trans->inputs = p;
@@ -70,14 +75,21 @@ static void transport_setup_area(void *p, struct pw_client_node_transport *trans
 	trans->outputs = p;
 	p = SPA_MEMBER(p, a->max_output_ports * sizeof(struct spa_io_buffers), void);
 
+	/* keep the activation and the ringbuffers in their own cache lines */
+	p = SPA_MEMBER(base, SPA_ROUND_UP_N(SPA_PTRDIFF(p, base), SPA_CACHE_LINE_SIZE), void);
+
+	trans->activation = p;
+	p = SPA_MEMBER(p, SPA_ROUND_UP_N(sizeof(struct pw_client_node_activation),
+					 SPA_CACHE_LINE_SIZE), void);
+
 	trans->input_buffer = p;
-	p = SPA_MEMBER(p, sizeof(struct spa_ringbuffer), void);
+	p = SPA_MEMBER(p, sizeof(struct spa_spsc_ringbuffer), void);
 
 	trans->input_data = p;
 	p = SPA_MEMBER(p, INPUT_BUFFER_SIZE, void);
 
 	trans->output_buffer = p;
-	p = SPA_MEMBER(p, sizeof(struct spa_ringbuffer), void);
+	p = SPA_MEMBER(p, sizeof(struct spa_spsc_ringbuffer), void);
 
 	trans->output_data = p;
 	p = SPA_MEMBER(p, OUTPUT_BUFFER_SIZE, void);
@@ -96,8 +108,10 @@ static void transport_reset_area(struct pw_client_node_transport *trans)
 		trans->outputs[i].status = SPA_STATUS_OK;
 		trans->outputs[i].buffer_id = SPA_ID_INVALID;
 	}
-	spa_ringbuffer_init(trans->input_buffer);
-	spa_ringbuffer_init(trans->output_buffer);
+	a->pending[0] = a->pending[1] = 0;
+	memset(trans->activation, 0, sizeof(struct pw_client_node_activation));
+	spa_spsc_ringbuffer_init(trans->input_buffer);
+	spa_spsc_ringbuffer_init(trans->output_buffer);
 }
 
 static void destroy(struct pw_client_node_transport *trans)
@@ -113,22 +127,22 @@ static void destroy(struct pw_client_node_transport *trans)
 static int add_message(struct pw_client_node_transport *trans, struct pw_client_node_message *message)
 {
 	struct transport *impl = (struct transport *) trans;
-	int32_t filled, avail;
+	int32_t avail;
 	uint32_t size, index;
 
 	if (impl == NULL || message == NULL)
 		return -EINVAL;
 
-	filled = spa_ringbuffer_get_write_index(trans->output_buffer, &index);
-	avail = OUTPUT_BUFFER_SIZE - filled;
 	size = SPA_POD_SIZE(message);
-	if (avail < size)
-		return -ENOSPC;
+	avail = spa_spsc_ringbuffer_write_reserve(trans->output_buffer,
+						  OUTPUT_BUFFER_SIZE, size, &index);
+	if (avail < 0)
+		return avail;
 
-	spa_ringbuffer_write_data(trans->output_buffer,
-				  trans->output_data, OUTPUT_BUFFER_SIZE,
-				  index & (OUTPUT_BUFFER_SIZE - 1), message, size);
-	spa_ringbuffer_write_update(trans->output_buffer, index + size);
+	spa_spsc_ringbuffer_write_data(trans->output_buffer,
+				       trans->output_data, OUTPUT_BUFFER_SIZE,
+				       index & (OUTPUT_BUFFER_SIZE - 1), message, size);
+	spa_spsc_ringbuffer_write_commit(trans->output_buffer, index + size);
 
 	return 0;
 }
@@ -141,14 +155,16 @@ static int next_message(struct pw_client_node_transport *trans, struct pw_client
 	if (impl == NULL || message == NULL)
 		return -EINVAL;
 
-	avail = spa_ringbuffer_get_read_index(trans->input_buffer, &impl->current_index);
+	avail = spa_spsc_ringbuffer_read_peek(trans->input_buffer,
+					      sizeof(struct pw_client_node_message),
+					      &impl->current_index);
 	if (avail < sizeof(struct pw_client_node_message))
 		return 0;
 
-	spa_ringbuffer_read_data(trans->input_buffer,
-				 trans->input_data, INPUT_BUFFER_SIZE,
-				 impl->current_index & (INPUT_BUFFER_SIZE - 1),
-				 &impl->current, sizeof(struct pw_client_node_message));
+	spa_spsc_ringbuffer_read_data(trans->input_buffer,
+				      trans->input_data, INPUT_BUFFER_SIZE,
+				      impl->current_index & (INPUT_BUFFER_SIZE - 1),
+				      &impl->current, sizeof(struct pw_client_node_message));
 
 	if (avail < SPA_POD_SIZE(&impl->current))
 		return 0;
@@ -168,10 +184,10 @@ static int parse_message(struct pw_client_node_transport *trans, void *message)
 
 	size = SPA_POD_SIZE(&impl->current);
 
-	spa_ringbuffer_read_data(trans->input_buffer,
-				 trans->input_data, INPUT_BUFFER_SIZE,
-				 impl->current_index & (INPUT_BUFFER_SIZE - 1), message, size);
-	spa_ringbuffer_read_update(trans->input_buffer, impl->current_index + size);
+	spa_spsc_ringbuffer_read_data(trans->input_buffer,
+				      trans->input_data, INPUT_BUFFER_SIZE,
+				      impl->current_index & (INPUT_BUFFER_SIZE - 1), message, size);
+	spa_spsc_ringbuffer_read_release(trans->input_buffer, impl->current_index + size);
 
 	return 0;
 }
@@ -259,6 +275,10 @@ pw_client_node_transport_new_from_info(struct pw_client_node_transport_info *inf
 	trans->output_data = trans->input_data;
 	trans->input_data = tmp;
 
+	tmp = trans->output_pending;
+	trans->output_pending = trans->input_pending;
+	trans->input_pending = tmp;
+
 	trans->destroy = destroy;
 	trans->add_message = add_message;
 	trans->next_message = next_message;
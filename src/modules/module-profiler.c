@@ -0,0 +1,401 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "config.h"
+
+#include "pipewire/core.h"
+#include "pipewire/interfaces.h"
+#include "pipewire/log.h"
+#include "pipewire/type.h"
+#include "pipewire/module.h"
+#include "pipewire/private.h"
+
+#define NAME "profiler"
+
+/** \cond */
+struct impl {
+	struct pw_core *core;
+	struct pw_type *t;
+	struct pw_properties *properties;
+
+	struct spa_hook module_listener;
+	struct spa_hook core_listener;
+
+	struct pw_global *global;
+	struct spa_hook global_listener;
+	struct spa_list resource_list;
+
+	struct pw_memblock *mem;
+	struct pw_profiler_area *area;
+
+	struct spa_list node_list;
+};
+
+struct node_info {
+	struct spa_list link;
+	struct impl *impl;
+	struct pw_node *node;
+	struct pw_profiler_node_stats *stats;
+	struct spa_graph_timing timing;
+};
+
+struct resource_data {
+	struct spa_hook resource_listener;
+};
+/** \endcond */
+
+static inline void stats_begin(struct pw_profiler_node_stats *s)
+{
+	__atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void stats_end(struct pw_profiler_node_stats *s)
+{
+	__atomic_store_n(&s->seq, s->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* called from the data thread or a worker when a cycle of the node completed */
+static void timing_complete(void *data, struct spa_graph_timing *t)
+{
+	struct node_info *info = data;
+	struct pw_profiler_node_stats *s = info->stats;
+	uint64_t awake, wait, busy;
+
+	stats_begin(s);
+
+	if (s->signal != 0 && t->signal > s->signal)
+		s->period = t->signal - s->signal;
+
+	if (t->finish == 0) {
+		s->xruns++;
+	}
+	else {
+		awake = t->awake ? t->awake : t->signal;
+		wait = awake - t->signal;
+		busy = t->finish - awake;
+
+		if (s->period != 0 && t->finish - t->signal > s->period)
+			s->xruns++;
+
+		s->wait_min = SPA_MIN(s->wait_min, wait);
+		s->wait_max = SPA_MAX(s->wait_max, wait);
+		s->wait_total += wait;
+		s->busy_min = SPA_MIN(s->busy_min, busy);
+		s->busy_max = SPA_MAX(s->busy_max, busy);
+		s->busy_total += busy;
+		s->histogram[pw_profiler_bucket(busy)]++;
+		s->cycles++;
+	}
+	s->signal = t->signal;
+	s->awake = t->awake;
+	s->finish = t->finish;
+
+	stats_end(s);
+}
+
+static struct pw_profiler_node_stats *alloc_stats(struct impl *impl, uint32_t id)
+{
+	struct pw_profiler_area *area = impl->area;
+	struct pw_profiler_node_stats *s = NULL;
+	uint32_t i;
+
+	for (i = 0; i < area->n_nodes; i++) {
+		if (area->nodes[i].id == SPA_ID_INVALID) {
+			s = &area->nodes[i];
+			break;
+		}
+	}
+	if (s == NULL) {
+		if (area->n_nodes == PW_PROFILER_MAX_NODES)
+			return NULL;
+		s = &area->nodes[area->n_nodes];
+	}
+
+	stats_begin(s);
+	memset(SPA_MEMBER(s, sizeof(uint32_t), void), 0, sizeof(*s) - sizeof(uint32_t));
+	s->id = id;
+	s->wait_min = s->busy_min = UINT64_MAX;
+	stats_end(s);
+
+	if (s == &area->nodes[area->n_nodes])
+		__atomic_store_n(&area->n_nodes, area->n_nodes + 1, __ATOMIC_RELEASE);
+
+	return s;
+}
+
+static void free_stats(struct impl *impl, struct pw_profiler_node_stats *s)
+{
+	stats_begin(s);
+	s->id = SPA_ID_INVALID;
+	stats_end(s);
+}
+
+static int
+do_set_timing(struct spa_loop *loop,
+	      bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct node_info *info = user_data;
+	struct spa_graph_timing *timing = *(struct spa_graph_timing **) data;
+
+	info->node->rt.node.timing = timing;
+	return 0;
+}
+
+static void set_timing(struct node_info *info, struct spa_graph_timing *timing)
+{
+	pw_loop_invoke(info->node->data_loop, do_set_timing, 1,
+		       &timing, sizeof(timing), true, info);
+}
+
+static struct node_info *find_node_info(struct impl *impl, struct pw_node *node)
+{
+	struct node_info *info;
+
+	spa_list_for_each(info, &impl->node_list, link) {
+		if (info->node == node)
+			return info;
+	}
+	return NULL;
+}
+
+static void add_node(struct impl *impl, struct pw_node *node)
+{
+	struct node_info *info;
+	struct pw_profiler_node_stats *stats;
+
+	if ((stats = alloc_stats(impl, node->global->id)) == NULL) {
+		pw_log_warn(NAME " %p: no space to profile node %p", impl, node);
+		return;
+	}
+
+	info = calloc(1, sizeof(struct node_info));
+	if (info == NULL) {
+		free_stats(impl, stats);
+		return;
+	}
+	info->impl = impl;
+	info->node = node;
+	info->stats = stats;
+	info->timing.complete = timing_complete;
+	info->timing.data = info;
+	spa_list_append(&impl->node_list, &info->link);
+
+	set_timing(info, &info->timing);
+
+	pw_log_debug(NAME " %p: node %p added", impl, node);
+}
+
+static void node_info_free(struct node_info *info)
+{
+	set_timing(info, NULL);
+	free_stats(info->impl, info->stats);
+	spa_list_remove(&info->link);
+	free(info);
+}
+
+static void
+core_global_added(void *data, struct pw_global *global)
+{
+	struct impl *impl = data;
+
+	if (pw_global_get_type(global) == impl->t->node)
+		add_node(impl, pw_global_get_object(global));
+}
+
+static void
+core_global_removed(void *data, struct pw_global *global)
+{
+	struct impl *impl = data;
+
+	if (pw_global_get_type(global) == impl->t->node) {
+		struct pw_node *node = pw_global_get_object(global);
+		struct node_info *info;
+
+		if ((info = find_node_info(impl, node)))
+			node_info_free(info);
+
+		pw_log_debug(NAME " %p: node %p removed", impl, node);
+	}
+}
+
+static const struct pw_core_events core_events = {
+	PW_VERSION_CORE_EVENTS,
+	.global_added = core_global_added,
+	.global_removed = core_global_removed,
+};
+
+static void profiler_unbind_func(void *data)
+{
+	struct pw_resource *resource = data;
+	spa_list_remove(&resource->link);
+}
+
+static const struct pw_resource_events resource_events = {
+	PW_VERSION_RESOURCE_EVENTS,
+	.destroy = profiler_unbind_func,
+};
+
+static void
+global_bind(void *_data, struct pw_client *client, uint32_t permissions,
+	    uint32_t version, uint32_t id)
+{
+	struct impl *impl = _data;
+	struct pw_global *global = impl->global;
+	struct pw_resource *resource;
+	struct resource_data *data;
+
+	resource = pw_resource_new(client, id, permissions, global->type, version, sizeof(*data));
+	if (resource == NULL)
+		goto no_mem;
+
+	data = pw_resource_get_user_data(resource);
+	pw_resource_add_listener(resource, &data->resource_listener, &resource_events, resource);
+
+	pw_log_debug(NAME " %p: bound to %d", impl, resource->id);
+
+	spa_list_append(&impl->resource_list, &resource->link);
+
+	pw_profiler_resource_area(resource, impl->mem->fd,
+				  impl->mem->offset, impl->mem->size);
+	return;
+
+      no_mem:
+	pw_log_error("can't create profiler resource");
+	pw_core_resource_error(client->core_resource,
+			       client->core_resource->id, -ENOMEM, "no memory");
+	return;
+}
+
+static void global_destroy(void *data)
+{
+	struct impl *impl = data;
+	spa_hook_remove(&impl->global_listener);
+	impl->global = NULL;
+}
+
+static const struct pw_global_events global_events = {
+	PW_VERSION_GLOBAL_EVENTS,
+	.destroy = global_destroy,
+	.bind = global_bind,
+};
+
+static void module_destroy(void *data)
+{
+	struct impl *impl = data;
+	struct node_info *info, *t;
+	struct pw_resource *resource, *tmp;
+
+	spa_hook_remove(&impl->core_listener);
+	spa_hook_remove(&impl->module_listener);
+
+	spa_list_for_each_safe(resource, tmp, &impl->resource_list, link)
+		pw_resource_destroy(resource);
+
+	if (impl->global)
+		pw_global_destroy(impl->global);
+
+	spa_list_for_each_safe(info, t, &impl->node_list, link)
+		node_info_free(info);
+
+	if (impl->mem)
+		pw_memblock_free(impl->mem);
+
+	if (impl->properties)
+		pw_properties_free(impl->properties);
+
+	free(impl);
+}
+
+static const struct pw_module_events module_events = {
+	PW_VERSION_MODULE_EVENTS,
+	.destroy = module_destroy,
+};
+
+static int module_init(struct pw_module *module, struct pw_properties *properties)
+{
+	struct pw_core *core = pw_module_get_core(module);
+	struct impl *impl;
+	struct pw_node *node;
+	uint32_t i;
+	int res;
+
+	impl = calloc(1, sizeof(struct impl));
+	if (impl == NULL)
+		return -ENOMEM;
+
+	pw_log_debug(NAME " %p: new", impl);
+
+	impl->core = core;
+	impl->t = pw_core_get_type(core);
+	impl->properties = properties;
+
+	spa_list_init(&impl->node_list);
+	spa_list_init(&impl->resource_list);
+
+	if ((res = pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
+				     PW_MEMBLOCK_FLAG_MAP_READWRITE |
+				     PW_MEMBLOCK_FLAG_SEAL,
+				     sizeof(struct pw_profiler_area),
+				     &impl->mem)) < 0)
+		goto error_free;
+
+	impl->area = impl->mem->ptr;
+	impl->area->version = PW_VERSION_PROFILER;
+	impl->area->n_nodes = 0;
+	for (i = 0; i < PW_PROFILER_MAX_NODES; i++)
+		impl->area->nodes[i].id = SPA_ID_INVALID;
+
+	impl->global = pw_global_new(core,
+				     impl->t->profiler, PW_VERSION_PROFILER,
+				     NULL,
+				     impl);
+	if (impl->global == NULL) {
+		res = -ENOMEM;
+		goto error_free_mem;
+	}
+
+	spa_list_for_each(node, &core->node_list, link) {
+		if (node->global)
+			add_node(impl, node);
+	}
+
+	pw_module_add_listener(module, &impl->module_listener, &module_events, impl);
+	pw_core_add_listener(core, &impl->core_listener, &core_events, impl);
+
+	pw_global_add_listener(impl->global, &impl->global_listener, &global_events, impl);
+	pw_global_register(impl->global, NULL, pw_module_get_global(module));
+
+	return 0;
+
+      error_free_mem:
+	pw_memblock_free(impl->mem);
+      error_free:
+	free(impl);
+	return res;
+}
+
+int pipewire__module_init(struct pw_module *module, const char *args)
+{
+	return module_init(module, NULL);
+}
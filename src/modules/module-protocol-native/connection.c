@@ -107,6 +107,9 @@ uint32_t pw_protocol_native_connection_add_fd(struct pw_protocol_native_connecti
 		return -1;
 	}
 
+	/* the receiver can map the memory, don't recycle it */
+	pw_memblock_export_fd(fd);
+
 	impl->out.fds[index] = fd;
 	impl->out.n_fds++;
 
@@ -30,6 +30,42 @@
 
 #include "connection.h"
 
+/* a NULL string is sent as NONE so that it is demarshalled as NULL again */
+static void marshal_string(struct spa_pod_builder *b, const char *str)
+{
+	if (str)
+		spa_pod_builder_string(b, str);
+	else
+		spa_pod_builder_none(b);
+}
+
+static void marshal_dict(struct spa_pod_builder *b, const struct spa_dict *dict)
+{
+	uint32_t i, n_items;
+
+	n_items = dict ? dict->n_items : 0;
+
+	spa_pod_builder_int(b, n_items);
+	for (i = 0; i < n_items; i++) {
+		marshal_string(b, dict->items[i].key);
+		marshal_string(b, dict->items[i].value);
+	}
+}
+
+/* parse the key/value pairs of a dict, the caller allocated dict->n_items */
+static int demarshal_dict_items(struct spa_pod_parser *prs, struct spa_dict *dict)
+{
+	struct spa_dict_item *items = (struct spa_dict_item *) dict->items;
+	uint32_t i;
+
+	for (i = 0; i < dict->n_items; i++) {
+		if (spa_pod_parser_get_string(prs, &items[i].key) < 0 ||
+		    spa_pod_parser_get_string(prs, &items[i].value) < 0)
+			return -EINVAL;
+	}
+	return 0;
+}
+
 static void core_marshal_hello(void *object)
 {
 	struct pw_proxy *proxy = object;
@@ -37,7 +73,9 @@ static void core_marshal_hello(void *object)
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CORE_PROXY_METHOD_HELLO);
 
-	spa_pod_builder_struct(b, "P", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_pod(b, NULL);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -46,20 +84,12 @@ static void core_marshal_client_update(void *object, const struct spa_dict *prop
 {
 	struct pw_proxy *proxy = object;
 	struct spa_pod_builder *b;
-	int i, n_items;
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CORE_PROXY_METHOD_CLIENT_UPDATE);
 
-	n_items = props ? props->n_items : 0;
-
-	spa_pod_builder_add(b, "[ i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", props->items[i].key,
-				    "s", props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	marshal_dict(b, props);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -68,20 +98,12 @@ static void core_marshal_permissions(void *object, const struct spa_dict *props)
 {
 	struct pw_proxy *proxy = object;
 	struct spa_pod_builder *b;
-	int i, n_items;
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CORE_PROXY_METHOD_PERMISSIONS);
 
-	n_items = props ? props->n_items : 0;
-
-	spa_pod_builder_add(b, "[ i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", props->items[i].key,
-				    "s", props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	marshal_dict(b, props);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -93,7 +115,9 @@ static void core_marshal_sync(void *object, uint32_t seq)
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CORE_PROXY_METHOD_SYNC);
 
-	spa_pod_builder_struct(b, "i", seq);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, seq);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -105,9 +129,10 @@ static void core_marshal_get_registry(void *object, uint32_t version, uint32_t n
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CORE_PROXY_METHOD_GET_REGISTRY);
 
-	spa_pod_builder_struct(b,
-			       "i", version,
-			       "i", new_id);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, version);
+	spa_pod_builder_int(b, new_id);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -120,27 +145,16 @@ core_marshal_create_object(void *object,
 {
 	struct pw_proxy *proxy = object;
 	struct spa_pod_builder *b;
-	uint32_t i, n_items;
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CORE_PROXY_METHOD_CREATE_OBJECT);
 
-	n_items = props ? props->n_items : 0;
-
-	spa_pod_builder_add(b,
-			    "["
-			    "s", factory_name,
-			    "I", type,
-			    "i", version,
-			    "i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", props->items[i].key,
-				    "s", props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b,
-			    "i", new_id,
-			    "]", NULL);
+	spa_pod_builder_push_struct(b);
+	marshal_string(b, factory_name);
+	spa_pod_builder_id(b, type);
+	spa_pod_builder_int(b, version);
+	marshal_dict(b, props);
+	spa_pod_builder_int(b, new_id);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -153,7 +167,9 @@ core_marshal_destroy(void *object, uint32_t id)
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CORE_PROXY_METHOD_DESTROY);
 
-	spa_pod_builder_struct(b, "i", id);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, id);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -167,15 +183,12 @@ core_marshal_update_types_client(void *object, uint32_t first_id, const char **t
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_CORE_PROXY_METHOD_UPDATE_TYPES);
 
-	spa_pod_builder_add(b,
-			    "["
-			    " i", first_id,
-			    " i", n_types, NULL);
-
-	for (i = 0; i < n_types; i++) {
-		spa_pod_builder_add(b, "s", types[i], NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, first_id);
+	spa_pod_builder_int(b, n_types);
+	for (i = 0; i < n_types; i++)
+		marshal_string(b, types[i]);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -186,30 +199,24 @@ static int core_demarshal_info(void *object, void *data, size_t size)
 	struct spa_dict props;
 	struct pw_core_info info;
 	struct spa_pod_parser prs;
-	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			 "i", &info.id,
-			 "l", &info.change_mask,
-			 "s", &info.user_name,
-			 "s", &info.host_name,
-			 "s", &info.version,
-			 "s", &info.name,
-			 "i", &info.cookie,
-			 "i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.id) < 0 ||
+	    spa_pod_parser_get_long(&prs, (int64_t *) &info.change_mask) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.user_name) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.host_name) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.version) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.name) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.cookie) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	info.props = &props;
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs,
-				       "s", &props.items[i].key,
-				       "s", &props.items[i].value,
-				       NULL) < 0)
-			return -EINVAL;
-	}
+	if (demarshal_dict_items(&prs, &props) < 0)
+		return -EINVAL;
+
 	pw_proxy_notify(proxy, struct pw_core_proxy_events, info, 0, &info);
 	return 0;
 }
@@ -221,7 +228,8 @@ static int core_demarshal_done(void *object, void *data, size_t size)
 	uint32_t seq;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[ i", &seq, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &seq) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_core_proxy_events, done, 0, seq);
@@ -236,10 +244,10 @@ static int core_demarshal_error(void *object, void *data, size_t size)
 	const char *error;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"[ i", &id,
-			  "i", &res,
-			  "s", &error, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &res) < 0 ||
+	    spa_pod_parser_get_string(&prs, &error) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_core_proxy_events, error, 0, id, res, error);
@@ -253,7 +261,8 @@ static int core_demarshal_remove_id(void *object, void *data, size_t size)
 	uint32_t id;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[ i", &id, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &id) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_core_proxy_events, remove_id, 0, id);
@@ -269,15 +278,14 @@ static int core_demarshal_update_types_client(void *object, void *data, size_t s
 	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-				"["
-				" i", &first_id,
-				" i", &n_types, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &first_id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &n_types) < 0)
 		return -EINVAL;
 
 	types = alloca(n_types * sizeof(char *));
 	for (i = 0; i < n_types; i++) {
-		if (spa_pod_parser_get(&prs, "s", &types[i], NULL) < 0)
+		if (spa_pod_parser_get_string(&prs, &types[i]) < 0)
 			return -EINVAL;
 	}
 	pw_proxy_notify(proxy, struct pw_core_proxy_events, update_types, 0, first_id, types, n_types);
@@ -288,29 +296,19 @@ static void core_marshal_info(void *object, struct pw_core_info *info)
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_builder *b;
-	uint32_t i, n_items;
 
 	b = pw_protocol_native_begin_resource(resource, PW_CORE_PROXY_EVENT_INFO);
 
-	n_items = info->props ? info->props->n_items : 0;
-
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", info->id,
-			    "l", info->change_mask,
-			    "s", info->user_name,
-			    "s", info->host_name,
-			    "s", info->version,
-			    "s", info->name,
-			    "i", info->cookie,
-			    "i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", info->props->items[i].key,
-				    "s", info->props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, info->id);
+	spa_pod_builder_long(b, info->change_mask);
+	marshal_string(b, info->user_name);
+	marshal_string(b, info->host_name);
+	marshal_string(b, info->version);
+	marshal_string(b, info->name);
+	spa_pod_builder_int(b, info->cookie);
+	marshal_dict(b, info->props);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -322,7 +320,9 @@ static void core_marshal_done(void *object, uint32_t seq)
 
 	b = pw_protocol_native_begin_resource(resource, PW_CORE_PROXY_EVENT_DONE);
 
-	spa_pod_builder_struct(b, "i", seq);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, seq);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -340,10 +340,11 @@ static void core_marshal_error(void *object, uint32_t id, int res, const char *e
 	vsnprintf(buffer, sizeof(buffer), error, ap);
 	va_end(ap);
 
-	spa_pod_builder_struct(b,
-			       "i", id,
-			       "i", res,
-			       "s", buffer);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, id);
+	spa_pod_builder_int(b, res);
+	marshal_string(b, buffer);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -355,7 +356,9 @@ static void core_marshal_remove_id(void *object, uint32_t id)
 
 	b = pw_protocol_native_begin_resource(resource, PW_CORE_PROXY_EVENT_REMOVE_ID);
 
-	spa_pod_builder_struct(b, "i", id);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, id);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -369,15 +372,12 @@ core_marshal_update_types_server(void *object, uint32_t first_id, const char **t
 
 	b = pw_protocol_native_begin_resource(resource, PW_CORE_PROXY_EVENT_UPDATE_TYPES);
 
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", first_id,
-			    "i", n_types, NULL);
-
-	for (i = 0; i < n_types; i++) {
-		spa_pod_builder_add(b, "s", types[i], NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, first_id);
+	spa_pod_builder_int(b, n_types);
+	for (i = 0; i < n_types; i++)
+		marshal_string(b, types[i]);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -387,20 +387,16 @@ static int core_demarshal_client_update(void *object, void *data, size_t size)
 	struct pw_resource *resource = object;
 	struct spa_dict props;
 	struct spa_pod_parser prs;
-	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[ i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs,
-				"s", &props.items[i].key,
-				"s", &props.items[i].value,
-				NULL) < 0)
-			return -EINVAL;
-	}
+	if (demarshal_dict_items(&prs, &props) < 0)
+		return -EINVAL;
+
 	pw_resource_do(resource, struct pw_core_proxy_methods, client_update, 0, &props);
 	return 0;
 }
@@ -410,20 +406,16 @@ static int core_demarshal_permissions(void *object, void *data, size_t size)
 	struct pw_resource *resource = object;
 	struct spa_dict props;
 	struct spa_pod_parser prs;
-	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[ i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs,
-				"s", &props.items[i].key,
-				"s", &props.items[i].value,
-				NULL) < 0)
-			return -EINVAL;
-	}
+	if (demarshal_dict_items(&prs, &props) < 0)
+		return -EINVAL;
+
 	pw_resource_do(resource, struct pw_core_proxy_methods, permissions, 0, &props);
 	return 0;
 }
@@ -432,10 +424,11 @@ static int core_demarshal_hello(void *object, void *data, size_t size)
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_parser prs;
-	void *ptr;
+	struct spa_pod *ptr;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[P]", &ptr, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_pod(&prs, &ptr) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_core_proxy_methods, hello, 0);
@@ -449,7 +442,8 @@ static int core_demarshal_sync(void *object, void *data, size_t size)
 	uint32_t seq;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[i]", &seq, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &seq) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_core_proxy_methods, sync, 0, seq);
@@ -463,7 +457,9 @@ static int core_demarshal_get_registry(void *object, void *data, size_t size)
 	int32_t version, new_id;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[ii]", &version, &new_id, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, &version) < 0 ||
+	    spa_pod_parser_get_int(&prs, &new_id) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_core_proxy_methods, get_registry, 0, version, new_id);
@@ -474,26 +470,21 @@ static int core_demarshal_create_object(void *object, void *data, size_t size)
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_parser prs;
-	uint32_t version, type, new_id, i;
+	uint32_t version, type, new_id;
 	const char *factory_name;
 	struct spa_dict props;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"s", &factory_name,
-			"I", &type,
-			"i", &version,
-			"i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_string(&prs, &factory_name) < 0 ||
+	    spa_pod_parser_get_id(&prs, &type) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &version) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs, "ss",
-					&props.items[i].key, &props.items[i].value, NULL) < 0)
-			return -EINVAL;
-	}
-	if (spa_pod_parser_get(&prs, "i", &new_id, NULL) < 0)
+	if (demarshal_dict_items(&prs, &props) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &new_id) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_core_proxy_methods, create_object, 0, factory_name,
@@ -509,7 +500,8 @@ static int core_demarshal_destroy(void *object, void *data, size_t size)
 	uint32_t id;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[i]", &id, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &id) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_core_proxy_methods, destroy, 0, id);
@@ -525,15 +517,14 @@ static int core_demarshal_update_types_server(void *object, void *data, size_t s
 	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &first_id,
-			"i", &n_types, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &first_id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &n_types) < 0)
 		return -EINVAL;
 
 	types = alloca(n_types * sizeof(char *));
 	for (i = 0; i < n_types; i++) {
-		if (spa_pod_parser_get(&prs, "s", &types[i], NULL) < 0)
+		if (spa_pod_parser_get_string(&prs, &types[i]) < 0)
 			return -EINVAL;
 	}
 	pw_resource_do(resource, struct pw_core_proxy_methods, update_types, 0, first_id, types, n_types);
@@ -545,27 +536,17 @@ static void registry_marshal_global(void *object, uint32_t id, uint32_t parent_i
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_builder *b;
-	uint32_t i, n_items;
 
 	b = pw_protocol_native_begin_resource(resource, PW_REGISTRY_PROXY_EVENT_GLOBAL);
 
-	n_items = props ? props->n_items : 0;
-
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", id,
-			    "i", parent_id,
-			    "i", permissions,
-			    "I", type,
-			    "i", version,
-			    "i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", props->items[i].key,
-				    "s", props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, id);
+	spa_pod_builder_int(b, parent_id);
+	spa_pod_builder_int(b, permissions);
+	spa_pod_builder_id(b, type);
+	spa_pod_builder_int(b, version);
+	marshal_dict(b, props);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -577,7 +558,9 @@ static void registry_marshal_global_remove(void *object, uint32_t id)
 
 	b = pw_protocol_native_begin_resource(resource, PW_REGISTRY_PROXY_EVENT_GLOBAL_REMOVE);
 
-	spa_pod_builder_struct(b, "i", id);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, id);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -589,12 +572,11 @@ static int registry_demarshal_bind(void *object, void *data, size_t size)
 	uint32_t id, version, type, new_id;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &id,
-			"I", &type,
-			"i", &version,
-			"i", &new_id, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &id) < 0 ||
+	    spa_pod_parser_get_id(&prs, &type) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &version) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &new_id) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_registry_proxy_methods, bind, 0, id, type, version, new_id);
@@ -605,27 +587,17 @@ static void module_marshal_info(void *object, struct pw_module_info *info)
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_builder *b;
-	uint32_t i, n_items;
 
 	b = pw_protocol_native_begin_resource(resource, PW_MODULE_PROXY_EVENT_INFO);
 
-	n_items = info->props ? info->props->n_items : 0;
-
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", info->id,
-			    "l", info->change_mask,
-			    "s", info->name,
-			    "s", info->filename,
-			    "s", info->args,
-			    "i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", info->props->items[i].key,
-				    "s", info->props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, info->id);
+	spa_pod_builder_long(b, info->change_mask);
+	marshal_string(b, info->name);
+	marshal_string(b, info->filename);
+	marshal_string(b, info->args);
+	marshal_dict(b, info->props);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -636,26 +608,22 @@ static int module_demarshal_info(void *object, void *data, size_t size)
 	struct spa_pod_parser prs;
 	struct spa_dict props;
 	struct pw_module_info info;
-	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &info.id,
-			"l", &info.change_mask,
-			"s", &info.name,
-			"s", &info.filename,
-			"s", &info.args,
-			"i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.id) < 0 ||
+	    spa_pod_parser_get_long(&prs, (int64_t *) &info.change_mask) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.name) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.filename) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.args) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	info.props = &props;
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs, "ss",
-					&props.items[i].key, &props.items[i].value, NULL) < 0)
-			return -EINVAL;
-	}
+	if (demarshal_dict_items(&prs, &props) < 0)
+		return -EINVAL;
+
 	pw_proxy_notify(proxy, struct pw_module_proxy_events, info, 0, &info);
 	return 0;
 }
@@ -664,27 +632,17 @@ static void factory_marshal_info(void *object, struct pw_factory_info *info)
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_builder *b;
-	uint32_t i, n_items;
 
 	b = pw_protocol_native_begin_resource(resource, PW_FACTORY_PROXY_EVENT_INFO);
 
-	n_items = info->props ? info->props->n_items : 0;
-
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", info->id,
-			    "l", info->change_mask,
-			    "s", info->name,
-			    "I", info->type,
-			    "i", info->version,
-			    "i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", info->props->items[i].key,
-				    "s", info->props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, info->id);
+	spa_pod_builder_long(b, info->change_mask);
+	marshal_string(b, info->name);
+	spa_pod_builder_id(b, info->type);
+	spa_pod_builder_int(b, info->version);
+	marshal_dict(b, info->props);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -695,27 +653,22 @@ static int factory_demarshal_info(void *object, void *data, size_t size)
 	struct spa_pod_parser prs;
 	struct spa_dict props;
 	struct pw_factory_info info;
-	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			 "["
-			"i", &info.id,
-			"l", &info.change_mask,
-			"s", &info.name,
-			"I", &info.type,
-			"i", &info.version,
-			"i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.id) < 0 ||
+	    spa_pod_parser_get_long(&prs, (int64_t *) &info.change_mask) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.name) < 0 ||
+	    spa_pod_parser_get_id(&prs, &info.type) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.version) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	info.props = &props;
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs,
-				       "s", &props.items[i].key,
-				       "s", &props.items[i].value, NULL) < 0)
-			return -EINVAL;
-	}
+	if (demarshal_dict_items(&prs, &props) < 0)
+		return -EINVAL;
+
 	pw_proxy_notify(proxy, struct pw_factory_proxy_events, info, 0, &info);
 	return 0;
 }
@@ -724,31 +677,21 @@ static void node_marshal_info(void *object, struct pw_node_info *info)
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_builder *b;
-	uint32_t i, n_items;
 
 	b = pw_protocol_native_begin_resource(resource, PW_NODE_PROXY_EVENT_INFO);
 
-	n_items = info->props ? info->props->n_items : 0;
-
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", info->id,
-			    "l", info->change_mask,
-			    "s", info->name,
-			    "i", info->max_input_ports,
-			    "i", info->n_input_ports,
-			    "i", info->max_output_ports,
-			    "i", info->n_output_ports,
-			    "i", info->state,
-			    "s", info->error,
-			    "i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", info->props->items[i].key,
-				    "s", info->props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, info->id);
+	spa_pod_builder_long(b, info->change_mask);
+	marshal_string(b, info->name);
+	spa_pod_builder_int(b, info->max_input_ports);
+	spa_pod_builder_int(b, info->n_input_ports);
+	spa_pod_builder_int(b, info->max_output_ports);
+	spa_pod_builder_int(b, info->n_output_ports);
+	spa_pod_builder_int(b, info->state);
+	marshal_string(b, info->error);
+	marshal_dict(b, info->props);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -759,31 +702,26 @@ static int node_demarshal_info(void *object, void *data, size_t size)
 	struct spa_pod_parser prs;
 	struct spa_dict props;
 	struct pw_node_info info;
-	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &info.id,
-			"l", &info.change_mask,
-			"s", &info.name,
-			"i", &info.max_input_ports,
-			"i", &info.n_input_ports,
-			"i", &info.max_output_ports,
-			"i", &info.n_output_ports,
-			"i", &info.state,
-			"s", &info.error,
-			"i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.id) < 0 ||
+	    spa_pod_parser_get_long(&prs, (int64_t *) &info.change_mask) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.name) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.max_input_ports) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.n_input_ports) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.max_output_ports) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.n_output_ports) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.state) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.error) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	info.props = &props;
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs,
-				       "s", &props.items[i].key,
-				       "s", &props.items[i].value, NULL) < 0)
-			return -EINVAL;
-	}
+	if (demarshal_dict_items(&prs, &props) < 0)
+		return -EINVAL;
+
 	pw_proxy_notify(proxy, struct pw_node_proxy_events, info, 0, &info);
 	return 0;
 }
@@ -796,7 +734,12 @@ static void node_marshal_param(void *object, uint32_t id, uint32_t index, uint32
 
 	b = pw_protocol_native_begin_resource(resource, PW_NODE_PROXY_EVENT_PARAM);
 
-	spa_pod_builder_struct(b, "I", id, "i", index, "i", next, "P", param);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_id(b, id);
+	spa_pod_builder_int(b, index);
+	spa_pod_builder_int(b, next);
+	spa_pod_builder_pod(b, param);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -809,11 +752,11 @@ static int node_demarshal_param(void *object, void *data, size_t size)
 	struct spa_pod *param;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-				"[ I", &id,
-				"i", &index,
-				"i", &next,
-				"P", &param, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_id(&prs, &id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &index) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &next) < 0 ||
+	    spa_pod_parser_get_pod(&prs, &param) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_node_proxy_events, param, 0, id, index, next, param);
@@ -828,11 +771,12 @@ static void node_marshal_enum_params(void *object, uint32_t id, uint32_t index,
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_NODE_PROXY_METHOD_ENUM_PARAMS);
 
-	spa_pod_builder_struct(b,
-			"I", id,
-			"i", index,
-			"i", num,
-			"P", filter);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_id(b, id);
+	spa_pod_builder_int(b, index);
+	spa_pod_builder_int(b, num);
+	spa_pod_builder_pod(b, filter);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -845,11 +789,11 @@ static int node_demarshal_enum_params(void *object, void *data, size_t size)
 	struct spa_pod *filter;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-				"[ I", &id,
-				"i", &index,
-				"i", &num,
-				"P", &filter, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_id(&prs, &id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &index) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &num) < 0 ||
+	    spa_pod_parser_get_pod(&prs, &filter) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_node_proxy_methods, enum_params, 0, id, index, num, filter);
@@ -860,25 +804,15 @@ static void port_marshal_info(void *object, struct pw_port_info *info)
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_builder *b;
-	uint32_t i, n_items;
 
 	b = pw_protocol_native_begin_resource(resource, PW_PORT_PROXY_EVENT_INFO);
 
-	n_items = info->props ? info->props->n_items : 0;
-
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", info->id,
-			    "l", info->change_mask,
-			    "s", info->name,
-			    "i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", info->props->items[i].key,
-				    "s", info->props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, info->id);
+	spa_pod_builder_long(b, info->change_mask);
+	marshal_string(b, info->name);
+	marshal_dict(b, info->props);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -889,25 +823,20 @@ static int port_demarshal_info(void *object, void *data, size_t size)
 	struct spa_pod_parser prs;
 	struct spa_dict props;
 	struct pw_port_info info;
-	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &info.id,
-			"l", &info.change_mask,
-			"s", &info.name,
-			"i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.id) < 0 ||
+	    spa_pod_parser_get_long(&prs, (int64_t *) &info.change_mask) < 0 ||
+	    spa_pod_parser_get_string(&prs, &info.name) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	info.props = &props;
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs,
-				       "s", &props.items[i].key,
-				       "s", &props.items[i].value, NULL) < 0)
-			return -EINVAL;
-	}
+	if (demarshal_dict_items(&prs, &props) < 0)
+		return -EINVAL;
+
 	pw_proxy_notify(proxy, struct pw_port_proxy_events, info, 0, &info);
 	return 0;
 }
@@ -920,7 +849,12 @@ static void port_marshal_param(void *object, uint32_t id, uint32_t index, uint32
 
 	b = pw_protocol_native_begin_resource(resource, PW_PORT_PROXY_EVENT_PARAM);
 
-	spa_pod_builder_struct(b, "I", id, "i", index, "i", next, "P", param);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_id(b, id);
+	spa_pod_builder_int(b, index);
+	spa_pod_builder_int(b, next);
+	spa_pod_builder_pod(b, param);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -933,11 +867,11 @@ static int port_demarshal_param(void *object, void *data, size_t size)
 	struct spa_pod *param;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-				"[ I", &id,
-				"i", &index,
-				"i", &next,
-				"P", &param, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_id(&prs, &id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &index) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &next) < 0 ||
+	    spa_pod_parser_get_pod(&prs, &param) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_port_proxy_events, param, 0, id, index, next, param);
@@ -952,11 +886,12 @@ static void port_marshal_enum_params(void *object, uint32_t id, uint32_t index,
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_PORT_PROXY_METHOD_ENUM_PARAMS);
 
-	spa_pod_builder_struct(b,
-			"I", id,
-			"i", index,
-			"i", num,
-			"P", filter);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_id(b, id);
+	spa_pod_builder_int(b, index);
+	spa_pod_builder_int(b, num);
+	spa_pod_builder_pod(b, filter);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -969,11 +904,11 @@ static int port_demarshal_enum_params(void *object, void *data, size_t size)
 	struct spa_pod *filter;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-				"[ I", &id,
-				"i", &index,
-				"i", &num,
-				"P", &filter, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_id(&prs, &id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &index) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &num) < 0 ||
+	    spa_pod_parser_get_pod(&prs, &filter) < 0)
 		return -EINVAL;
 
 	pw_resource_do(resource, struct pw_port_proxy_methods, enum_params, 0, id, index, num, filter);
@@ -984,24 +919,14 @@ static void client_marshal_info(void *object, struct pw_client_info *info)
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_builder *b;
-	uint32_t i, n_items;
 
 	b = pw_protocol_native_begin_resource(resource, PW_CLIENT_PROXY_EVENT_INFO);
 
-	n_items = info->props ? info->props->n_items : 0;
-
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", info->id,
-			    "l", info->change_mask,
-			    "i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", info->props->items[i].key,
-				    "s", info->props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, info->id);
+	spa_pod_builder_long(b, info->change_mask);
+	marshal_dict(b, info->props);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -1012,24 +937,19 @@ static int client_demarshal_info(void *object, void *data, size_t size)
 	struct spa_pod_parser prs;
 	struct spa_dict props;
 	struct pw_client_info info;
-	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &info.id,
-			"l", &info.change_mask,
-			"i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.id) < 0 ||
+	    spa_pod_parser_get_long(&prs, (int64_t *) &info.change_mask) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	info.props = &props;
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs,
-				       "s", &props.items[i].key,
-				       "s", &props.items[i].value, NULL) < 0)
-			return -EINVAL;
-	}
+	if (demarshal_dict_items(&prs, &props) < 0)
+		return -EINVAL;
+
 	pw_proxy_notify(proxy, struct pw_client_proxy_events, info, 0, &info);
 	return 0;
 }
@@ -1038,29 +958,19 @@ static void link_marshal_info(void *object, struct pw_link_info *info)
 {
 	struct pw_resource *resource = object;
 	struct spa_pod_builder *b;
-	uint32_t i, n_items;
 
 	b = pw_protocol_native_begin_resource(resource, PW_LINK_PROXY_EVENT_INFO);
 
-	n_items = info->props ? info->props->n_items : 0;
-
-	spa_pod_builder_add(b,
-			    "[",
-			    "i", info->id,
-			    "l", info->change_mask,
-			    "i", info->output_node_id,
-			    "i", info->output_port_id,
-			    "i", info->input_node_id,
-			    "i", info->input_port_id,
-			    "P", info->format,
-			    "i", n_items, NULL);
-
-	for (i = 0; i < n_items; i++) {
-		spa_pod_builder_add(b,
-				    "s", info->props->items[i].key,
-				    "s", info->props->items[i].value, NULL);
-	}
-	spa_pod_builder_add(b, "]", NULL);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, info->id);
+	spa_pod_builder_long(b, info->change_mask);
+	spa_pod_builder_int(b, info->output_node_id);
+	spa_pod_builder_int(b, info->output_port_id);
+	spa_pod_builder_int(b, info->input_node_id);
+	spa_pod_builder_int(b, info->input_port_id);
+	spa_pod_builder_pod(b, info->format);
+	marshal_dict(b, info->props);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_resource(resource, b);
 }
@@ -1071,29 +981,24 @@ static int link_demarshal_info(void *object, void *data, size_t size)
 	struct spa_pod_parser prs;
 	struct spa_dict props;
 	struct pw_link_info info = { 0, };
-	uint32_t i;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &info.id,
-			"l", &info.change_mask,
-			"i", &info.output_node_id,
-			"i", &info.output_port_id,
-			"i", &info.input_node_id,
-			"i", &info.input_port_id,
-			"P", &info.format,
-			"i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.id) < 0 ||
+	    spa_pod_parser_get_long(&prs, (int64_t *) &info.change_mask) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.output_node_id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.output_port_id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.input_node_id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &info.input_port_id) < 0 ||
+	    spa_pod_parser_get_pod(&prs, &info.format) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	info.props = &props;
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs,
-				       "s", &props.items[i].key,
-				       "s", &props.items[i].value, NULL) < 0)
-			return -EINVAL;
-	}
+	if (demarshal_dict_items(&prs, &props) < 0)
+		return -EINVAL;
+
 	pw_proxy_notify(proxy, struct pw_link_proxy_events, info, 0, &info);
 	return 0;
 }
@@ -1102,27 +1007,22 @@ static int registry_demarshal_global(void *object, void *data, size_t size)
 {
 	struct pw_proxy *proxy = object;
 	struct spa_pod_parser prs;
-	uint32_t id, parent_id, permissions, type, version, i;
+	uint32_t id, parent_id, permissions, type, version;
 	struct spa_dict props;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs,
-			"["
-			"i", &id,
-			"i", &parent_id,
-			"i", &permissions,
-			"I", &type,
-			"i", &version,
-			"i", &props.n_items, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &parent_id) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &permissions) < 0 ||
+	    spa_pod_parser_get_id(&prs, &type) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &version) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &props.n_items) < 0)
 		return -EINVAL;
 
 	props.items = alloca(props.n_items * sizeof(struct spa_dict_item));
-	for (i = 0; i < props.n_items; i++) {
-		if (spa_pod_parser_get(&prs,
-				       "s", &props.items[i].key,
-				       "s", &props.items[i].value, NULL) < 0)
-			return -EINVAL;
-	}
+	if (demarshal_dict_items(&prs, &props) < 0)
+		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_registry_proxy_events,
 			global, 0, id, parent_id, permissions, type, version,
@@ -1137,7 +1037,8 @@ static int registry_demarshal_global_remove(void *object, void *data, size_t siz
 	uint32_t id;
 
 	spa_pod_parser_init(&prs, data, size, 0);
-	if (spa_pod_parser_get(&prs, "[ i", &id, NULL) < 0)
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &id) < 0)
 		return -EINVAL;
 
 	pw_proxy_notify(proxy, struct pw_registry_proxy_events, global_remove, 0, id);
@@ -1152,11 +1053,12 @@ static void registry_marshal_bind(void *object, uint32_t id,
 
 	b = pw_protocol_native_begin_proxy(proxy, PW_REGISTRY_PROXY_METHOD_BIND);
 
-	spa_pod_builder_struct(b,
-			       "i", id,
-			       "I", type,
-			       "i", version,
-			       "i", new_id);
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, id);
+	spa_pod_builder_id(b, type);
+	spa_pod_builder_int(b, version);
+	spa_pod_builder_int(b, new_id);
+	spa_pod_builder_pop(b);
 
 	pw_protocol_native_end_proxy(proxy, b);
 }
@@ -1378,6 +1280,60 @@ static const struct pw_protocol_marshal pw_protocol_native_link_marshal = {
 	PW_LINK_PROXY_EVENT_NUM,
 };
 
+static void profiler_marshal_area(void *object, int memfd, uint32_t offset, uint32_t size)
+{
+	struct pw_resource *resource = object;
+	struct spa_pod_builder *b;
+
+	b = pw_protocol_native_begin_resource(resource, PW_PROFILER_PROXY_EVENT_AREA);
+
+	spa_pod_builder_push_struct(b);
+	spa_pod_builder_int(b, pw_protocol_native_add_resource_fd(resource, memfd));
+	spa_pod_builder_int(b, offset);
+	spa_pod_builder_int(b, size);
+	spa_pod_builder_pop(b);
+
+	pw_protocol_native_end_resource(resource, b);
+}
+
+static int profiler_demarshal_area(void *object, void *data, size_t size)
+{
+	struct pw_proxy *proxy = object;
+	struct spa_pod_parser prs;
+	uint32_t memfd_idx, offset, sz;
+	int memfd;
+
+	spa_pod_parser_init(&prs, data, size, 0);
+	if (spa_pod_parser_push_struct(&prs) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &memfd_idx) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &offset) < 0 ||
+	    spa_pod_parser_get_int(&prs, (int32_t *) &sz) < 0)
+		return -EINVAL;
+
+	memfd = pw_protocol_native_get_proxy_fd(proxy, memfd_idx);
+
+	pw_proxy_notify(proxy, struct pw_profiler_proxy_events, area, 0, memfd, offset, sz);
+	return 0;
+}
+
+static const struct pw_profiler_proxy_events pw_protocol_native_profiler_event_marshal = {
+	PW_VERSION_PROFILER_PROXY_EVENTS,
+	&profiler_marshal_area,
+};
+
+static const struct pw_protocol_native_demarshal pw_protocol_native_profiler_event_demarshal[] = {
+	{ &profiler_demarshal_area, 0, }
+};
+
+static const struct pw_protocol_marshal pw_protocol_native_profiler_marshal = {
+	PW_TYPE_INTERFACE__Profiler,
+	PW_VERSION_PROFILER,
+	NULL, NULL, 0,
+	&pw_protocol_native_profiler_event_marshal,
+	pw_protocol_native_profiler_event_demarshal,
+	PW_PROFILER_PROXY_EVENT_NUM,
+};
+
 void pw_protocol_native_init(struct pw_protocol *protocol)
 {
 	pw_protocol_add_marshal(protocol, &pw_protocol_native_core_marshal);
@@ -1388,4 +1344,5 @@ void pw_protocol_native_init(struct pw_protocol *protocol)
 	pw_protocol_add_marshal(protocol, &pw_protocol_native_factory_marshal);
 	pw_protocol_add_marshal(protocol, &pw_protocol_native_client_marshal);
 	pw_protocol_add_marshal(protocol, &pw_protocol_native_link_marshal);
+	pw_protocol_add_marshal(protocol, &pw_protocol_native_profiler_marshal);
 }
@@ -280,7 +280,9 @@ struct pw_node *pw_spa_node_load(struct pw_core *core,
 
 	support = pw_core_get_support(core, &n_support);
 
-	handle = calloc(1, factory->size);
+	if ((handle = calloc(1, factory->size)) == NULL)
+		goto enum_failed;
+
 	if ((res = spa_handle_factory_init(factory,
 					   handle,
 					   properties ? &properties->dict : NULL,
@@ -306,6 +308,10 @@ struct pw_node *pw_spa_node_load(struct pw_core *core,
 
 	this = pw_spa_node_new(core, owner, parent, name, flags,
 			       spa_node, handle, properties, user_data_size);
+	if (this == NULL) {
+		pw_log_error("can't make node");
+		goto interface_failed;
+	}
 
 	impl = this->user_data;
 	impl->hnd = hnd;
@@ -0,0 +1,183 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "pipewire/log.h"
+#include "pipewire/loop.h"
+#include "pipewire/private.h"
+#include "extensions/client-node.h"
+
+/** \cond */
+/** a peer node that we activate directly */
+struct peer {
+	struct spa_list link;
+	struct spa_list rt_link;
+	struct pw_client_node_peers *peers;
+	uint32_t node_id;
+	int signalfd;
+	struct pw_client_node_transport *trans;
+	uint32_t max_inputs;
+	uint32_t n_links;
+	struct pw_client_node_link *links;
+};
+/** \endcond */
+
+static int
+do_add_peer(struct spa_loop *loop,
+	    bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct peer *p = user_data;
+	spa_list_append(&p->peers->rt_list, &p->rt_link);
+	return 0;
+}
+
+static int
+do_remove_peer(struct spa_loop *loop,
+	       bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct peer *p = user_data;
+	spa_list_remove(&p->rt_link);
+	return 0;
+}
+
+static void peer_free(struct peer *p)
+{
+	pw_loop_invoke(p->peers->data_loop,
+		       do_remove_peer, 1, NULL, 0, true, p);
+	spa_list_remove(&p->link);
+	close(p->signalfd);
+	pw_client_node_transport_destroy(p->trans);
+	free(p);
+}
+
+/** Initialize the peers of a node
+ * \param peers the peers to initialize
+ * \param data_loop the loop that activates the peers
+ */
+void pw_client_node_peers_init(struct pw_client_node_peers *peers, struct pw_loop *data_loop)
+{
+	peers->data_loop = data_loop;
+	spa_list_init(&peers->list);
+	spa_list_init(&peers->rt_list);
+}
+
+/** Stop activating all peers */
+void pw_client_node_peers_clear(struct pw_client_node_peers *peers)
+{
+	struct peer *p, *t;
+	spa_list_for_each_safe(p, t, &peers->list, link)
+		peer_free(p);
+}
+
+/** Update a peer from a set_activation event
+ * \param peers the peers of the node
+ * \param node_id the id of the peer node
+ * \param signalfd the fd to wake up the peer, -1 to stop activating it
+ * \param transport the transport of the peer or NULL
+ * \param n_links the number of links to the peer
+ * \param links the links to the peer
+ *
+ * This takes ownership of \a signalfd and \a transport.
+ */
+void pw_client_node_peers_set(struct pw_client_node_peers *peers,
+			      uint32_t node_id,
+			      int signalfd,
+			      struct pw_client_node_transport *transport,
+			      uint32_t n_links,
+			      const struct pw_client_node_link *links)
+{
+	struct peer *p;
+
+	spa_list_for_each(p, &peers->list, link) {
+		if (p->node_id == node_id) {
+			peer_free(p);
+			break;
+		}
+	}
+
+	if (signalfd == -1 || transport == NULL)
+		goto done;
+
+	p = calloc(1, sizeof(struct peer) + n_links * sizeof(struct pw_client_node_link));
+	if (p == NULL)
+		goto done;
+
+	pw_log_debug("peers %p: activate node %u with %d links", peers, node_id, n_links);
+
+	p->peers = peers;
+	p->node_id = node_id;
+	p->signalfd = signalfd;
+	p->trans = transport;
+	p->max_inputs = transport->area->max_input_ports;
+	p->n_links = n_links;
+	p->links = SPA_MEMBER(p, sizeof(struct peer), struct pw_client_node_link);
+	memcpy(p->links, links, n_links * sizeof(struct pw_client_node_link));
+
+	spa_list_append(&peers->list, &p->link);
+	pw_loop_invoke(peers->data_loop,
+		       do_add_peer, 1, NULL, 0, true, p);
+	return;
+
+      done:
+	if (signalfd != -1)
+		close(signalfd);
+	if (transport)
+		pw_client_node_transport_destroy(transport);
+}
+
+/** Activate the peers, called from the data loop
+ * \param peers the peers of the node
+ * \param trans the transport of the node
+ * \return false when there are no peers
+ *
+ * Copy the output io of the node to the peers and wake up the peers that
+ * have all their input.
+ */
+bool pw_client_node_peers_activate(struct pw_client_node_peers *peers,
+				   struct pw_client_node_transport *trans)
+{
+	struct peer *p;
+	uint64_t cmd = 1, now;
+	uint32_t i;
+
+	if (spa_list_is_empty(&peers->rt_list))
+		return false;
+
+	now = pw_client_node_activation_get_time();
+
+	spa_list_for_each(p, &peers->rt_list, rt_link) {
+		for (i = 0; i < p->n_links; i++) {
+			struct pw_client_node_link *l = &p->links[i];
+
+			if (l->output_port_id >= trans->area->max_output_ports ||
+			    l->input_port_id >= p->max_inputs)
+				continue;
+
+			p->trans->inputs[l->input_port_id] = trans->outputs[l->output_port_id];
+		}
+		if (pw_client_node_activation_trigger(p->trans->activation, now) &&
+		    write(p->signalfd, &cmd, 8) != 8)
+			pw_log_warn("peers %p: failed to wake up node %u: %m",
+				    peers, p->node_id);
+	}
+	return true;
+}
@@ -17,6 +17,7 @@
  * Boston, MA 02110-1301, USA.
  */
 #include <errno.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <time.h>
 #include <stdio.h>
@@ -35,15 +36,34 @@
 
 #undef spa_debug
 #define spa_debug pw_log_trace
-#include <spa/graph/graph-scheduler6.h>
+#include <spa/graph/graph-scheduler7.h>
 
 /** \cond */
+struct impl {
+	struct pw_core this;
+
+	struct spa_graph_data graph_data;
+	struct pw_worker_pool *worker_pool;
+};
+
 struct resource_data {
 	struct spa_hook resource_listener;
 };
 
 /** \endcond */
 
+static void worker_pool_process(void *data, enum spa_direction direction,
+				struct spa_graph_node **nodes, uint32_t n_nodes)
+{
+	struct impl *impl = data;
+	pw_worker_pool_process(impl->worker_pool, direction, nodes, n_nodes);
+}
+
+static const struct spa_graph_executor worker_pool_executor = {
+	SPA_VERSION_GRAPH_EXECUTOR,
+	.process = worker_pool_process,
+};
+
 static void registry_bind(void *object, uint32_t id,
 			  uint32_t type, uint32_t version, uint32_t new_id)
 {
@@ -362,13 +382,16 @@ static const struct pw_global_events global_events = {
  */
 struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *properties)
 {
+	struct impl *impl;
 	struct pw_core *this;
-	const char *name;
+	const char *name, *str;
 
-	this = calloc(1, sizeof(struct pw_core));
-	if (this == NULL)
+	impl = calloc(1, sizeof(struct impl));
+	if (impl == NULL)
 		return NULL;
 
+	this = &impl->this;
+
 	pw_log_debug("core %p: new", this);
 
 	if (properties == NULL)
@@ -389,7 +412,22 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 	pw_map_init(&this->globals, 128, 32);
 
 	spa_graph_init(&this->rt.graph);
-	spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, NULL);
+	spa_graph_data_init(&impl->graph_data, &this->rt.graph);
+	spa_graph_set_callbacks(&this->rt.graph, &spa_graph_impl_default, &impl->graph_data);
+
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_QUANTUM)) == NULL)
+		str = getenv("PIPEWIRE_QUANTUM");
+	this->default_quantum = str != NULL && atoi(str) > 0 ? atoi(str) : PW_QUANTUM_DEFAULT;
+	this->quantum = SPA_CLAMP(this->default_quantum, PW_QUANTUM_MIN, PW_QUANTUM_MAX);
+
+	if ((str = pw_properties_get(properties, PW_CORE_PROP_DATA_WORKERS)) == NULL)
+		str = getenv("PIPEWIRE_DATA_WORKERS");
+	if (str != NULL && atoi(str) > 0) {
+		impl->worker_pool = pw_worker_pool_new(atoi(str));
+		if (impl->worker_pool != NULL)
+			spa_graph_data_set_executor(&impl->graph_data,
+						    &worker_pool_executor, impl);
+	}
 
 	this->dbus_iface = pw_get_spa_dbus(this->main_loop);
 
@@ -458,7 +496,7 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
 
       no_mem:
       no_data_loop:
-	free(this);
+	free(impl);
 	return NULL;
 }
 
@@ -470,6 +508,7 @@ struct pw_core *pw_core_new(struct pw_loop *main_loop, struct pw_properties *pro
  */
 void pw_core_destroy(struct pw_core *core)
 {
+	struct impl *impl = SPA_CONTAINER_OF(core, struct impl, this);
 	struct pw_global *global, *t;
 	struct pw_module *module, *tm;
 	struct pw_remote *remote, *tr;
@@ -496,6 +535,9 @@ void pw_core_destroy(struct pw_core *core)
 
 	pw_data_loop_destroy(core->data_loop_impl);
 
+	if (impl->worker_pool)
+		pw_worker_pool_destroy(impl->worker_pool);
+
 	pw_release_spa_dbus(core->dbus_iface);
 
 	pw_properties_free(core->properties);
@@ -503,7 +545,7 @@ void pw_core_destroy(struct pw_core *core)
 	pw_map_clear(&core->globals);
 
 	pw_log_debug("core %p: free", core);
-	free(core);
+	free(impl);
 }
 
 const struct pw_core_info *pw_core_get_info(struct pw_core *core)
@@ -558,6 +600,7 @@ int pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict)
 {
 	struct pw_resource *resource;
 	uint32_t i, changed = 0;
+	const char *str;
 
 	for (i = 0; i < dict->n_items; i++)
 		changed += pw_properties_set(core->properties, dict->items[i].key, dict->items[i].value);
@@ -577,9 +620,51 @@ int pw_core_update_properties(struct pw_core *core, const struct spa_dict *dict)
 
 	core->info.change_mask = 0;
 
+	if ((str = pw_properties_get(core->properties, PW_CORE_PROP_QUANTUM)) != NULL &&
+	    atoi(str) > 0 && (uint32_t) atoi(str) != core->default_quantum) {
+		core->default_quantum = atoi(str);
+		pw_core_update_quantum(core);
+	}
+
 	return changed;
 }
 
+/** Recalculate the quantum of the graph
+ * \param core a core
+ *
+ * The smallest latency requested by the nodes is used as the quantum, when
+ * no node requests a latency, the default quantum is used. All nodes are
+ * informed of the new quantum, links stay in place.
+ */
+void pw_core_update_quantum(struct pw_core *core)
+{
+	struct pw_node *n;
+	uint32_t latency = 0, quantum;
+
+	spa_list_for_each(n, &core->node_list, link) {
+		if (n->latency != 0 && (latency == 0 || n->latency < latency))
+			latency = n->latency;
+	}
+	quantum = latency != 0 ? latency : core->default_quantum;
+	quantum = SPA_CLAMP(quantum, PW_QUANTUM_MIN, PW_QUANTUM_MAX);
+
+	if (quantum == core->quantum)
+		return;
+
+	pw_log_info("core %p: quantum %u -> %u", core, core->quantum, quantum);
+	core->quantum = quantum;
+
+	spa_list_for_each(n, &core->node_list, link)
+		pw_node_set_quantum(n, quantum);
+
+	pw_core_events_quantum_changed(core, quantum);
+}
+
+uint32_t pw_core_get_quantum(struct pw_core *core)
+{
+	return core->quantum;
+}
+
 int pw_core_for_each_global(struct pw_core *core,
 			    int (*callback) (void *data, struct pw_global *global),
 			    void *data)
@@ -779,10 +864,9 @@ int pw_core_find_format(struct pw_core *core,
 		/* both ports need a format */
 		pw_log_debug("core %p: do enum input %d", core, iidx);
 		spa_pod_builder_init(&fb, fbuf, sizeof(fbuf));
-		if ((res = spa_node_port_enum_params(input->node->node,
-						     input->direction, input->port_id,
-						     t->param.idEnumFormat, &iidx,
-						     NULL, &filter, &fb)) <= 0) {
+		if ((res = pw_port_enum_params_cached(input,
+						      t->param.idEnumFormat, &iidx,
+						      NULL, &filter, &fb)) <= 0) {
 			if (res == 0 && iidx == 0) {
 				asprintf(error, "error input enum formats: %s", spa_strerror(res));
 				goto error;
@@ -794,10 +878,9 @@ int pw_core_find_format(struct pw_core *core,
 		if (pw_log_level_enabled(SPA_LOG_LEVEL_DEBUG))
 			spa_debug_format(2, core->type.map, filter);
 
-		if ((res = spa_node_port_enum_params(output->node->node,
-						     output->direction, output->port_id,
-						     t->param.idEnumFormat, &oidx,
-						     filter, format, builder)) <= 0) {
+		if ((res = pw_port_enum_params_cached(output,
+						      t->param.idEnumFormat, &oidx,
+						      filter, format, builder)) <= 0) {
 			if (res == 0) {
 				oidx = 0;
 				goto again;
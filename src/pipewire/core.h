@@ -98,6 +98,8 @@ struct pw_core_events {
 	void (*global_added) (void *data, struct pw_global *global);
 	/** a global object was removed */
 	void (*global_removed) (void *data, struct pw_global *global);
+	/** the quantum of the graph changed */
+	void (*quantum_changed) (void *data, uint32_t quantum);
 };
 
 /** The user name that started the core */
@@ -110,6 +112,18 @@ struct pw_core_events {
 #define PW_CORE_PROP_VERSION	"pipewire.core.version"
 /** If the core should listen for connections, boolean default false */
 #define PW_CORE_PROP_DAEMON	"pipewire.daemon"
+/** Number of extra realtime threads that process independent nodes of the
+ * graph in parallel, default 0. Can also be set with the
+ * PIPEWIRE_DATA_WORKERS environment variable */
+#define PW_CORE_PROP_DATA_WORKERS	"pipewire.data-workers"
+/** The number of frames processed in one cycle of the graph when no node
+ * requests a latency, default 1024. Can also be set with the
+ * PIPEWIRE_QUANTUM environment variable */
+#define PW_CORE_PROP_QUANTUM		"pipewire.quantum"
+
+#define PW_QUANTUM_MIN		32	/**< smallest quantum of the graph */
+#define PW_QUANTUM_MAX		8192	/**< largest quantum of the graph */
+#define PW_QUANTUM_DEFAULT	1024	/**< default quantum of the graph */
 
 /** Make a new core object for a given main_loop. Ownership of the properties is taken */
 struct pw_core * pw_core_new(struct pw_loop *main_loop, struct pw_properties *props);
@@ -144,6 +158,9 @@ const struct spa_support *pw_core_get_support(struct pw_core *core, uint32_t *n_
 /** get the core main loop */
 struct pw_loop *pw_core_get_main_loop(struct pw_core *core);
 
+/** Get the number of frames processed in one cycle of the graph */
+uint32_t pw_core_get_quantum(struct pw_core *core);
+
 /** Iterate the globals of the core. The callback should return
  * 0 to fetch the next item, any other value stops the iteration and returns
  * the value. When all callbacks return 0, this function returns 0 when all
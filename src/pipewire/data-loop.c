@@ -20,22 +20,95 @@
 #include <pthread.h>
 #include <errno.h>
 #include <sys/resource.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "pipewire/log.h"
 #include "pipewire/data-loop.h"
 #include "pipewire/private.h"
+#include "extensions/client-node.h"
+
+static inline uint64_t get_time_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return SPA_TIMESPEC_TO_TIME(&now);
+}
+
+/* the latest time one of the watched nodes was activated since the last
+ * check, 0 when none was */
+static uint64_t check_activations(struct pw_data_loop *this)
+{
+	struct pw_data_loop_activation *a;
+	uint64_t cycle = 0;
+	uint32_t triggered;
+
+	spa_list_for_each(a, &this->activation_list, link) {
+		triggered = __atomic_load_n(&a->activation->triggered, __ATOMIC_ACQUIRE);
+		if (triggered == a->triggered)
+			continue;
+		a->triggered = triggered;
+		cycle = SPA_MAX(cycle, a->activation->signal_time);
+	}
+	return cycle;
+}
+
+/* spin on the activation records until one is triggered or \a end */
+static void spin_activations(struct pw_data_loop *this, uint64_t end)
+{
+	struct pw_data_loop_activation *a;
+
+	do {
+		spa_list_for_each(a, &this->activation_list, link) {
+			if (__atomic_load_n(&a->activation->triggered,
+					    __ATOMIC_ACQUIRE) != a->triggered)
+				return;
+		}
+	} while (get_time_ns() < end);
+}
 
 static void *do_loop(void *user_data)
 {
 	struct pw_data_loop *this = user_data;
-	int res;
+	uint64_t now, cycle, last = 0, period = 0;
+	int res, timeout;
 
 	pw_log_debug("data-loop %p: enter thread", this);
 	pw_loop_enter(this->loop);
 
 	while (this->running) {
-		if ((res = pw_loop_iterate(this->loop, -1)) < 0)
+		timeout = -1;
+
+		/* with busy polling, the period of the cycles is measured from
+		 * the activations of the nodes by their peers. The thread
+		 * waits for events until the next cycle is expected within
+		 * the busy poll time, then spins on the activation records
+		 * until one is triggered or the cycle is a quarter period
+		 * late, and then waits for the events again. */
+		if (this->busy_poll > 0 && period > 0) {
+			uint64_t expected = last + period, late = expected + period / 4;
+
+			now = get_time_ns();
+			if (expected > now + this->busy_poll + SPA_NSEC_PER_MSEC)
+				/* the loop waits in milliseconds, start spinning early */
+				timeout = (expected - this->busy_poll - now) / SPA_NSEC_PER_MSEC;
+			else if (now < late)
+				spin_activations(this, SPA_MIN(late, now + this->busy_poll));
+		}
+
+		if ((res = pw_loop_iterate(this->loop, timeout)) < 0)
 			pw_log_warn("data-loop %p: iterate error %d", this, res);
+
+		if (this->busy_poll > 0 && (cycle = check_activations(this)) > last) {
+			if (last > 0 && cycle - last < SPA_NSEC_PER_SEC)
+				period = period ? (7 * period + cycle - last) / 8 : cycle - last;
+			else
+				period = 0;
+			last = cycle;
+		}
 	}
 	pw_log_debug("data-loop %p: leave thread", this);
 	pw_loop_leave(this->loop);
@@ -43,7 +116,6 @@ static void *do_loop(void *user_data)
 	return NULL;
 }
 
-
 static void do_stop(void *data, uint64_t count)
 {
 	struct pw_data_loop *this = data;
@@ -59,6 +131,7 @@ static void do_stop(void *data, uint64_t count)
 struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 {
 	struct pw_data_loop *this;
+	const char *str;
 
 	this = calloc(1, sizeof(struct pw_data_loop));
 	if (this == NULL)
@@ -66,11 +139,18 @@ struct pw_data_loop *pw_data_loop_new(struct pw_properties *properties)
 
 	pw_log_debug("data-loop %p: new", this);
 
+	if (properties == NULL ||
+	    (str = pw_properties_get(properties, PW_DATA_LOOP_PROP_BUSY_POLL)) == NULL)
+		str = getenv("PIPEWIRE_DATA_LOOP_BUSY_POLL");
+	if (str != NULL)
+		this->busy_poll = strtoull(str, NULL, 10) * SPA_NSEC_PER_USEC;
+
 	this->loop = pw_loop_new(properties);
 	if (this->loop == NULL)
 		goto no_loop;
 
 	spa_hook_list_init(&this->listener_list);
+	spa_list_init(&this->activation_list);
 
 	this->event = pw_loop_add_event(this->loop, do_stop, this);
 
@@ -163,3 +243,100 @@ bool pw_data_loop_in_thread(struct pw_data_loop * loop)
 {
 	return pthread_equal(loop->thread, pthread_self());
 }
+
+static int
+do_add_activation(struct spa_loop *loop,
+		  bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_data_loop *this = *(struct pw_data_loop **) data;
+	struct pw_data_loop_activation *a = user_data;
+
+	a->triggered = __atomic_load_n(&a->activation->triggered, __ATOMIC_ACQUIRE);
+	spa_list_append(&this->activation_list, &a->link);
+	return 0;
+}
+
+static int
+do_remove_activation(struct spa_loop *loop,
+		     bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct pw_data_loop_activation *a = user_data;
+	spa_list_remove(&a->link);
+	return 0;
+}
+
+/** Spin on the activation record of a node when busy polling
+ * \param loop the data loop
+ * \param activation the activation record to watch, with the activation set
+ *
+ * The data loop measures the period of the cycles from the activations and
+ * spins on the record before the next cycle is expected, see
+ * \ref PW_DATA_LOOP_PROP_BUSY_POLL. The record must stay valid until it is
+ * removed with \ref pw_data_loop_remove_activation.
+ */
+void pw_data_loop_add_activation(struct pw_data_loop *loop,
+				 struct pw_data_loop_activation *activation)
+{
+	pw_loop_invoke(loop->loop, do_add_activation, 1,
+		       &loop, sizeof(loop), true, activation);
+}
+
+/** Stop watching an activation record, can be called from the data loop */
+void pw_data_loop_remove_activation(struct pw_data_loop *loop,
+				    struct pw_data_loop_activation *activation)
+{
+	pw_loop_invoke(loop->loop, do_remove_activation, 1,
+		       NULL, 0, true, activation);
+}
+
+/* the NUMA node of \a cpu or -1 */
+static int get_cpu_node(int cpu)
+{
+	char path[64];
+	struct dirent *entry;
+	DIR *dir;
+	int node = -1;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	if ((dir = opendir(path)) == NULL)
+		return -1;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (strncmp(entry->d_name, "node", 4) == 0 &&
+		    sscanf(entry->d_name + 4, "%d", &node) == 1)
+			break;
+	}
+	closedir(dir);
+
+	return node;
+}
+
+/** Get the NUMA node of the data loop thread
+ * \param loop the data loop
+ * \return the NUMA node or < 0 when the thread is not running or when
+ *	it can run on CPUs of more than one node
+ *
+ * \memberof pw_data_loop
+ */
+int pw_data_loop_get_numa_node(struct pw_data_loop *loop)
+{
+	cpu_set_t cpuset;
+	int i, cpu_node, node = -1;
+
+	if (!loop->running)
+		return -EIO;
+
+	if (pthread_getaffinity_np(loop->thread, sizeof(cpuset), &cpuset) != 0)
+		return -EIO;
+
+	for (i = 0; i < CPU_SETSIZE; i++) {
+		if (!CPU_ISSET(i, &cpuset))
+			continue;
+		if ((cpu_node = get_cpu_node(i)) < 0)
+			return -ENOENT;
+		if (node != -1 && node != cpu_node)
+			return -EINVAL;
+		node = cpu_node;
+	}
+	return node;
+}
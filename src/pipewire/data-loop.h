@@ -44,6 +44,14 @@ struct pw_data_loop_events {
 	void (*destroy) (void *data);
 };
 
+/** The longest time in microseconds that the processing thread spins on the
+ * activation records of its nodes when the next cycle of the graph is
+ * expected, default 0 (off). This removes the wakeup latency of the thread
+ * at the cost of CPU time. Only nodes that are activated by their peers
+ * are watched. Can also be set with the PIPEWIRE_DATA_LOOP_BUSY_POLL
+ * environment variable */
+#define PW_DATA_LOOP_PROP_BUSY_POLL	"pipewire.data-loop.busy-poll"
+
 /** Make a new loop */
 struct pw_data_loop *
 pw_data_loop_new(struct pw_properties *properties);
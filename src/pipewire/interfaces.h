@@ -39,6 +39,7 @@ struct pw_port_proxy;
 struct pw_factory_proxy;
 struct pw_client_proxy;
 struct pw_link_proxy;
+struct pw_profiler_proxy;
 
 /**
  * \page page_pipewire_protocol The PipeWire protocol
@@ -65,6 +66,7 @@ struct pw_link_proxy;
 #define PW_TYPE_INTERFACE__Port		PW_TYPE_INTERFACE_BASE "Port"
 #define PW_TYPE_INTERFACE__Client	PW_TYPE_INTERFACE_BASE "Client"
 #define PW_TYPE_INTERFACE__Link		PW_TYPE_INTERFACE_BASE "Link"
+#define PW_TYPE_INTERFACE__Profiler	PW_TYPE_INTERFACE_BASE "Profiler"
 
 #define PW_VERSION_CORE				0
 
@@ -717,6 +719,116 @@ pw_link_proxy_add_listener(struct pw_link_proxy *link,
 
 #define pw_link_resource_info(r,...)      pw_resource_notify(r,struct pw_link_proxy_events,info,__VA_ARGS__)
 
+
+#define PW_VERSION_PROFILER		0
+
+#define PW_PROFILER_MAX_NODES		256	/**< max nodes in the stats area */
+#define PW_PROFILER_HISTOGRAM		64	/**< buckets in the busy histogram */
+
+/** Statistics of a node, all times are in nanoseconds.
+ *
+ * The wait time is the time between the node being scheduled and the
+ * node starting to process. The busy time is the time the node takes
+ * to complete. For nodes of clients the busy time includes the wakeup
+ * of the client.
+ *
+ * A node has an xrun when it is scheduled again before it completed or
+ * when it takes longer than the time between its last two cycles. */
+struct pw_profiler_node_stats {
+	uint32_t seq;			/**< odd while the stats are updated */
+	uint32_t id;			/**< global id of the node or SPA_ID_INVALID */
+	uint64_t cycles;		/**< number of completed cycles */
+	uint64_t xruns;			/**< number of xruns */
+	uint64_t signal;		/**< last time the node was scheduled */
+	uint64_t awake;			/**< last time the node started */
+	uint64_t finish;		/**< last time the node completed */
+	uint64_t period;		/**< time between the last two cycles */
+	uint64_t wait_min;
+	uint64_t wait_max;
+	uint64_t wait_total;
+	uint64_t busy_min;
+	uint64_t busy_max;
+	uint64_t busy_total;
+	uint32_t histogram[PW_PROFILER_HISTOGRAM];	/**< busy times, see
+							  *  pw_profiler_bucket() */
+};
+
+/** The stats area, shared with the clients of the profiler */
+struct pw_profiler_area {
+	uint32_t version;		/**< PW_VERSION_PROFILER */
+	uint32_t n_nodes;		/**< number of slots in use, slots with
+					  *  an id of SPA_ID_INVALID are free */
+	struct pw_profiler_node_stats nodes[PW_PROFILER_MAX_NODES];
+};
+
+/** Get the histogram bucket of \a time. Buckets have 4 steps per power of 2
+ * of microseconds */
+static inline uint32_t pw_profiler_bucket(uint64_t time)
+{
+	uint64_t us = time / 1000;
+	uint32_t msb;
+
+	if (us < 4)
+		return us;
+	msb = 63 - __builtin_clzll(us);
+	return SPA_MIN(4 * (msb - 1) + ((us >> (msb - 2)) & 3), PW_PROFILER_HISTOGRAM - 1);
+}
+
+/** Get the lowest time in nanoseconds of histogram bucket \a bucket */
+static inline uint64_t pw_profiler_bucket_time(uint32_t bucket)
+{
+	if (bucket < 4)
+		return bucket * 1000;
+	return ((4ULL | (bucket & 3)) << (bucket / 4 - 1)) * 1000;
+}
+
+/** Get a consistent copy of the stats in \a slot of \a area */
+static inline void
+pw_profiler_area_read(const struct pw_profiler_area *area, uint32_t slot,
+		      struct pw_profiler_node_stats *stats)
+{
+	const struct pw_profiler_node_stats *s = &area->nodes[slot];
+	uint32_t seq;
+
+	do {
+		while ((seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE)) & 1);
+		*stats = *s;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (seq != __atomic_load_n(&s->seq, __ATOMIC_RELAXED));
+}
+
+#define PW_PROFILER_PROXY_EVENT_AREA	0
+#define PW_PROFILER_PROXY_EVENT_NUM	1
+
+/** Profiler events */
+struct pw_profiler_proxy_events {
+#define PW_VERSION_PROFILER_PROXY_EVENTS	0
+	uint32_t version;
+	/**
+	 * Notify the stats area
+	 *
+	 * The stats area is updated by the data thread, map the memory
+	 * and read the stats with pw_profiler_area_read().
+	 *
+	 * \param memfd the memfd of the \ref pw_profiler_area
+	 * \param offset the offset in \a memfd
+	 * \param size the size of the area
+	 */
+	void (*area) (void *object, int memfd, uint32_t offset, uint32_t size);
+};
+
+/** Profiler */
+static inline void
+pw_profiler_proxy_add_listener(struct pw_profiler_proxy *profiler,
+			       struct spa_hook *listener,
+			       const struct pw_profiler_proxy_events *events,
+			       void *data)
+{
+	pw_proxy_add_proxy_listener((struct pw_proxy*)profiler, listener, events, data);
+}
+
+#define pw_profiler_resource_area(r,...)	pw_resource_notify(r,struct pw_profiler_proxy_events,area,__VA_ARGS__)
+
 #ifdef __cplusplus
 }  /* extern "C" */
 #endif
@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include <spa/pod/parser.h>
 #include <spa/pod/compare.h>
@@ -251,6 +252,46 @@ static struct spa_pod *find_param(struct spa_pod **params, uint32_t n_params, ui
 	return NULL;
 }
 
+static const char *get_property(struct pw_link *this, const char *key)
+{
+	const char *str = NULL;
+
+	if (this->properties)
+		str = pw_properties_get(this->properties, key);
+	if (str == NULL)
+		str = pw_properties_get(this->core->properties, key);
+	return str;
+}
+
+/* the NUMA node for the buffer memory or -1 */
+static int get_numa_node(struct pw_link *this)
+{
+	const char *str;
+	int node;
+
+	if ((str = get_property(this, PW_LINK_PROP_NUMA_NODE)) == NULL)
+		return -1;
+
+	if (strcmp(str, "auto") == 0)
+		node = pw_data_loop_get_numa_node(this->core->data_loop_impl);
+	else
+		node = atoi(str);
+
+	return node < 0 ? -1 : node;
+}
+
+/* data planes of at least this size are page aligned, smaller planes
+ * are aligned to a cache line */
+#define PAGE_ALIGN_MIN_SIZE	(64 * 1024)
+#define CACHE_LINE_SIZE		64
+
+static size_t get_data_align(size_t size, bool hugepages)
+{
+	if (hugepages || size >= PAGE_ALIGN_MIN_SIZE)
+		return sysconf(_SC_PAGESIZE);
+	return CACHE_LINE_SIZE;
+}
+
 /* Allocate an array of buffers that can be shared.
  *
  * All information will be allocated in \a mem. A pointer to a
@@ -313,6 +354,9 @@ static struct spa_pod *find_param(struct spa_pod **params, uint32_t n_params, ui
  *
  * The shared memory block should not contain any types or structure,
  * just the actual metadata contents.
+ *
+ * The data of each plane starts on a cache line, or on a page for large
+ * planes and with huge pages, so that every buffer starts aligned as well.
  */
 static int alloc_buffers(struct pw_link *this,
 			 uint32_t n_buffers,
@@ -323,22 +367,28 @@ static int alloc_buffers(struct pw_link *this,
 			 ssize_t *data_strides,
 			 struct allocation *allocation)
 {
-	int res;
+	int res, node;
 	struct spa_buffer **buffers, *bp;
 	uint32_t i;
-	size_t skel_size, data_size, meta_size;
+	size_t skel_size, data_size, meta_size, chunk_offset, *data_offsets, max_align;
 	struct spa_chunk *cdp;
-	void *ddp;
 	uint32_t n_metas;
 	struct spa_meta *metas;
 	struct pw_memblock *m;
 	struct pw_type *t = &this->core->type;
+	enum pw_memblock_flags flags;
+	const char *str;
+	bool hugepages;
 
 	n_metas = data_size = meta_size = 0;
 
 	skel_size = sizeof(struct spa_buffer);
 
 	metas = alloca(sizeof(struct spa_meta) * n_params);
+	data_offsets = alloca(sizeof(size_t) * n_datas);
+
+	str = get_property(this, PW_LINK_PROP_HUGEPAGES);
+	hugepages = str && pw_properties_parse_bool(str);
 
 	/* collect metadata */
 	for (i = 0; i < n_params; i++) {
@@ -359,23 +409,48 @@ static int alloc_buffers(struct pw_link *this,
 			skel_size += sizeof(struct spa_meta);
 		}
 	}
-	data_size += meta_size;
 
-	/* data */
+	/* clients expect the chunks right after the metadata, the data
+	 * planes are referenced with their offset and can be aligned */
+	chunk_offset = meta_size;
+	data_size = chunk_offset + n_datas * sizeof(struct spa_chunk);
+	max_align = sizeof(uint64_t);
+
 	for (i = 0; i < n_datas; i++) {
-		data_size += sizeof(struct spa_chunk);
+		size_t align = get_data_align(data_sizes[i], hugepages);
+
+		if (data_sizes[i] > 0)
+			data_size = SPA_ROUND_UP_N(data_size, align);
+		data_offsets[i] = data_size;
 		data_size += data_sizes[i];
+		max_align = SPA_MAX(max_align, align);
 		skel_size += sizeof(struct spa_data);
 	}
+	/* keep the next buffer aligned as well */
+	data_size = SPA_ROUND_UP_N(data_size, max_align);
 
 	buffers = calloc(n_buffers, skel_size + sizeof(struct spa_buffer *));
+	if (buffers == NULL)
+		return -ENOMEM;
 	/* pointer to buffer structures */
 	bp = SPA_MEMBER(buffers, n_buffers * sizeof(struct spa_buffer *), struct spa_buffer);
 
-	if ((res = pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
-				     PW_MEMBLOCK_FLAG_MAP_READWRITE |
-				     PW_MEMBLOCK_FLAG_SEAL, n_buffers * data_size, &m)) < 0)
+	flags = PW_MEMBLOCK_FLAG_WITH_FD |
+		PW_MEMBLOCK_FLAG_MAP_READWRITE |
+		PW_MEMBLOCK_FLAG_SEAL;
+	if (hugepages)
+		flags |= PW_MEMBLOCK_FLAG_HUGEPAGES;
+
+	if ((res = pw_memblock_alloc(flags, n_buffers * data_size, &m)) < 0) {
+		free(buffers);
 		return res;
+	}
+
+	/* before we touch the memory */
+	if ((node = get_numa_node(this)) >= 0 &&
+	    (res = pw_memblock_bind(m, node)) < 0)
+		pw_log_warn("link %p: can't bind buffers to node %d: %s", this, node,
+			    spa_strerror(res));
 
 	for (i = 0; i < n_buffers; i++) {
 		int j;
@@ -401,8 +476,8 @@ static int alloc_buffers(struct pw_link *this,
 		b->n_datas = n_datas;
 		b->datas = SPA_MEMBER(b->metas, n_metas * sizeof(struct spa_meta), struct spa_data);
 
-		cdp = p;
-		ddp = SPA_MEMBER(cdp, sizeof(struct spa_chunk) * n_datas, void);
+		p = SPA_MEMBER(m->ptr, data_size * i, void);
+		cdp = SPA_MEMBER(p, chunk_offset, struct spa_chunk);
 
 		for (j = 0; j < n_datas; j++) {
 			struct spa_data *d = &b->datas[j];
@@ -412,13 +487,12 @@ static int alloc_buffers(struct pw_link *this,
 				d->type = t->data.MemFd;
 				d->flags = 0;
 				d->fd = m->fd;
-				d->mapoffset = SPA_PTRDIFF(ddp, m->ptr);
+				d->mapoffset = SPA_PTRDIFF(SPA_MEMBER(p, data_offsets[j], void), m->ptr);
 				d->maxsize = data_sizes[j];
 				d->data = SPA_MEMBER(m->ptr, d->mapoffset, void);
 				d->chunk->offset = 0;
 				d->chunk->size = 0;
 				d->chunk->stride = data_strides[j];
-				ddp += data_sizes[j];
 			} else {
 				/* needs to be allocated by a node */
 				d->type = SPA_ID_INVALID;
@@ -449,9 +523,8 @@ param_filter(struct pw_link *this,
 	for (iidx = 0;;) {
 	        spa_pod_builder_init(&ib, ibuf, sizeof(ibuf));
 		pw_log_debug("iparam %d", iidx);
-		if ((res = spa_node_port_enum_params(in_port->node->node,
-						     in_port->direction, in_port->port_id,
-						     id, &iidx, NULL, &iparam, &ib)) < 0)
+		if ((res = pw_port_enum_params_cached(in_port,
+						      id, &iidx, NULL, &iparam, &ib)) < 0)
 			break;
 
 		if (res == 0) {
@@ -465,9 +538,8 @@ param_filter(struct pw_link *this,
 
 		for (oidx = 0;;) {
 			pw_log_debug("oparam %d", oidx);
-			if (spa_node_port_enum_params(out_port->node->node, out_port->direction,
-						      out_port->port_id, id, &oidx,
-						      iparam, &oparam, result) <= 0) {
+			if (pw_port_enum_params_cached(out_port, id, &oidx,
+						       iparam, &oparam, result) <= 0) {
 				break;
 			}
 
@@ -585,6 +657,7 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 		size_t minsize = 1024, stride = 0;
 		size_t data_sizes[1];
 		ssize_t data_strides[1];
+		uint32_t data_type = SPA_ID_INVALID;
 
 		n_params = param_filter(this, input, output, t->param.idBuffers, &b);
 		n_params += param_filter(this, input, output, t->param.idMeta, &b);
@@ -609,7 +682,8 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 			spa_pod_object_parse(param,
 				":", t->param_buffers.size, "i", &qminsize,
 				":", t->param_buffers.stride, "i", &qstride,
-				":", t->param_buffers.buffers, "i", &qmax_buffers, NULL);
+				":", t->param_buffers.buffers, "i", &qmax_buffers,
+				":", t->param_buffers.dataType, "?I", &data_type, NULL);
 
 			max_buffers =
 			    qmax_buffers == 0 ? max_buffers : SPA_MIN(qmax_buffers,
@@ -621,9 +695,24 @@ static int do_allocation(struct pw_link *this, uint32_t in_state, uint32_t out_s
 				     minsize, stride, max_buffers);
 		} else {
 			pw_log_warn("no buffers param");
-			minsize = 1024;
+			/* leave room for the largest quantum so that the quantum can
+			 * change without reallocating the buffers */
+			minsize = PW_QUANTUM_MAX * sizeof(float);
 		}
 
+		/* we can only allocate memfd, let the ports use our memory when that
+		 * is what they agreed on, even when one of them can allocate */
+		if (data_type == t->data.MemFd &&
+		    in_state == PW_PORT_STATE_READY && out_state == PW_PORT_STATE_READY &&
+		    (oinfo->flags & SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS) &&
+		    (iinfo->flags & SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS)) {
+			out_flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+			in_flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+		}
+		pw_log_debug("link %p: data type %s", this,
+			     data_type == SPA_ID_INVALID ? "any" :
+			     spa_type_map_get_type(t->map, data_type));
+
 		/* when one of the ports can allocate buffer memory, set the minsize to
 		 * 0 to make sure we don't allocate memory in the shared memory */
 		if ((in_flags & SPA_PORT_INFO_FLAG_CAN_ALLOC_BUFFERS) ||
@@ -872,9 +961,6 @@ static void input_remove(struct pw_link *this, struct pw_port *port)
 	spa_hook_remove(&impl->input_port_listener);
 	spa_hook_remove(&impl->input_node_listener);
 
-	pw_loop_invoke(port->node->data_loop,
-		       do_remove_input, 1, NULL, 0, true, this);
-
 	pw_map_remove(&port->mix_port_map, this->rt.in_port.port_id);
 
 	spa_list_remove(&this->input_link);
@@ -901,9 +987,6 @@ static void output_remove(struct pw_link *this, struct pw_port *port)
 	spa_hook_remove(&impl->output_port_listener);
 	spa_hook_remove(&impl->output_node_listener);
 
-	pw_loop_invoke(port->node->data_loop,
-		       do_remove_output, 1, NULL, 0, true, this);
-
 	pw_map_remove(&port->mix_port_map, this->rt.out_port.port_id);
 
 	spa_list_remove(&this->output_link);
@@ -1129,12 +1212,16 @@ struct pw_link *pw_link_new(struct pw_core *core,
 	input_node = input->node;
 	output_node = output->node;
 
+	this->gain = 1.0f;
+
 	if (properties) {
 		const char *str = pw_properties_get(properties, PW_LINK_PROP_PASSIVE);
 		if (str && pw_properties_parse_bool(str)) {
 			input_node->idle_used_input_links++;
 			output_node->idle_used_output_links++;
 		}
+		if ((str = pw_properties_get(properties, PW_LINK_PROP_GAIN)) != NULL)
+			this->gain = pw_properties_parse_float(str);
 	}
 	spa_list_init(&this->resource_list);
 	spa_hook_list_init(&this->listener_list);
@@ -1279,6 +1366,8 @@ void pw_link_destroy(struct pw_link *link)
 {
 	struct impl *impl = SPA_CONTAINER_OF(link, struct impl, this);
 	struct pw_resource *resource, *tmp;
+	struct spa_loop_completion completion = SPA_LOOP_COMPLETION_INIT;
+	int res_in, res_out;
 
 	pw_log_debug("link %p: destroy", impl);
 	pw_link_events_destroy(link);
@@ -1291,6 +1380,27 @@ void pw_link_destroy(struct pw_link *link)
 	if (link->output->node->clock == link->input->node->clock)
 		link->input->node->clock = NULL;
 
+	/* remove the ports from the graphs of both data loops and wait
+	 * for them together. When the queue of a loop is full, the removal
+	 * is retried with a blocking invoke after the other loop is done */
+	res_in = pw_loop_invoke_queue(link->input->node->data_loop,
+				      do_remove_input, 1, NULL, 0, link, &completion);
+	res_out = pw_loop_invoke_queue(link->output->node->data_loop,
+				       do_remove_output, 1, NULL, 0, link, &completion);
+	pw_loop_invoke_wait(link->output->node->data_loop, &completion);
+
+	if (res_in == -EPIPE)
+		res_in = pw_loop_invoke(link->input->node->data_loop,
+					do_remove_input, 1, NULL, 0, true, link);
+	if (res_in < 0)
+		pw_log_error("link %p: can't remove input: %s", link, spa_strerror(res_in));
+
+	if (res_out == -EPIPE)
+		res_out = pw_loop_invoke(link->output->node->data_loop,
+					 do_remove_output, 1, NULL, 0, true, link);
+	if (res_out < 0)
+		pw_log_error("link %p: can't remove output: %s", link, spa_strerror(res_out));
+
 	input_remove(link, link->input);
 
 	output_remove(link, link->output);
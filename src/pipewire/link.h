@@ -75,6 +75,19 @@ struct pw_link_events {
   * set to "1" or "0" */
 #define PW_LINK_PROP_PASSIVE	"pipewire.link.passive"
 
+/** The gain applied to the data of the link when it is mixed with other
+  * links on the input port, as a float, default 1.0 */
+#define PW_LINK_PROP_GAIN	"pipewire.link.gain"
+
+/** Allocate the buffers of the link in huge pages, set to "1" or "0". Can
+  * also be set on the core for all links, default "0" */
+#define PW_LINK_PROP_HUGEPAGES	"pipewire.link.hugepages"
+
+/** The NUMA node for the buffer memory of the link or "auto" to use the node
+  * that the data thread is bound to. Can also be set on the core for all
+  * links, default unset */
+#define PW_LINK_PROP_NUMA_NODE	"pipewire.link.numa-node"
+
 /** Make a new link between two ports \memberof pw_link
  * \return a newly allocated link */
 struct pw_link *
@@ -33,6 +33,11 @@ extern "C" {
  * Logging is performed to stdout and stderr. Trace logging is performed
  * in a lockfree ringbuffer and written out from the main thread as to not
  * block the realtime threads.
+ *
+ * With the PIPEWIRE_LOG_BINARY_TRACE environment variable, trace messages
+ * are stored unformatted in a ringbuffer per thread and are formatted and
+ * written by a separate thread. This makes trace logging cheap enough for
+ * the realtime threads.
  */
 
 /** The global log level */
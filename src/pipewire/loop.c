@@ -18,6 +18,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <spa/support/loop.h>
 #include <spa/support/type-map.h>
@@ -51,6 +52,18 @@ struct pw_loop *pw_loop_new(struct pw_properties *properties)
 	void *iface;
 	const struct spa_support *support;
 	uint32_t n_support;
+	struct spa_dict_item items[2];
+	struct spa_dict info = SPA_DICT_INIT(items, 0);
+	const char *str;
+
+	if (properties == NULL ||
+	    (str = pw_properties_get(properties, PW_LOOP_PROP_BACKEND)) == NULL)
+		str = getenv("PIPEWIRE_LOOP_BACKEND");
+	if (str != NULL)
+		items[info.n_items++] = SPA_DICT_ITEM_INIT(PW_LOOP_PROP_BACKEND, str);
+	if (properties &&
+	    (str = pw_properties_get(properties, PW_LOOP_PROP_TIMER_SLACK)) != NULL)
+		items[info.n_items++] = SPA_DICT_ITEM_INIT(PW_LOOP_PROP_TIMER_SLACK, str);
 
 	support = pw_get_support(&n_support);
 	if (support == NULL)
@@ -74,7 +87,7 @@ struct pw_loop *pw_loop_new(struct pw_properties *properties)
 
 	if ((res = spa_handle_factory_init(factory,
 					   impl->handle,
-					   NULL,
+					   &info,
 					   support,
 					   n_support)) < 0) {
 		fprintf(stderr, "can't make factory instance: %d\n", res);
@@ -40,6 +40,13 @@ struct pw_loop {
 	struct spa_loop_utils *utils;		/**< loop utils */
 };
 
+/** The implementation of the loop, "epoll" (default) or "io_uring". Can also
+ * be set with the PIPEWIRE_LOOP_BACKEND environment variable */
+#define PW_LOOP_PROP_BACKEND	"loop.backend"
+/** Timers that expire within this many nanoseconds of each other are
+ * dispatched together, default 1000000 */
+#define PW_LOOP_PROP_TIMER_SLACK	"loop.timer-slack"
+
 struct pw_loop *
 pw_loop_new(struct pw_properties *properties);
 
@@ -50,6 +57,8 @@ pw_loop_destroy(struct pw_loop *loop);
 #define pw_loop_update_source(l,...)	spa_loop_update_source(__VA_ARGS__)
 #define pw_loop_remove_source(l,...)	spa_loop_remove_source(__VA_ARGS__)
 #define pw_loop_invoke(l,...)		spa_loop_invoke((l)->loop,__VA_ARGS__)
+#define pw_loop_invoke_queue(l,...)	spa_loop_invoke_queue((l)->loop,__VA_ARGS__)
+#define pw_loop_invoke_wait(l,...)	spa_loop_invoke_wait((l)->loop,__VA_ARGS__)
 
 #define pw_loop_get_fd(l)		spa_loop_control_get_fd((l)->control)
 #define pw_loop_add_hook(l,...)		spa_loop_control_add_hook((l)->control,__VA_ARGS__)
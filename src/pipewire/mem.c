@@ -32,6 +32,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/syscall.h>
+#include <pthread.h>
 
 #include <spa/utils/list.h>
 
@@ -63,6 +64,15 @@ static inline int memfd_create(const char *name, unsigned int flags)
 #define MFD_ALLOW_SEALING 0x0002U
 #endif
 
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE     14
+#endif
+
+/* mbind(2) policy, we don't want to depend on libnuma for this */
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED    1
+#endif
+
 /* fcntl() seals-related flags */
 
 #ifndef F_LINUX_SPECIFIC_BASE
@@ -81,13 +91,163 @@ static inline int memfd_create(const char *name, unsigned int flags)
 
 struct memblock {
 	struct pw_memblock mem;
-	struct spa_list link;
+	struct spa_list link;	/**< link in the pool */
+	size_t map_size;	/**< size of the memfd and the mapping */
+	bool imported;		/**< fd and memory are not ours */
+	bool indexed;		/**< in the ptr index */
+	bool exported;		/**< fd was sent to another process */
 };
 
-static struct spa_list _memblocks = SPA_LIST_INIT(&_memblocks);
+/** Recycled memfds, the most recently freed block is first */
+#define MAX_POOL_BLOCKS	64
+#define MAX_POOL_SIZE	(64 * 1024 * 1024)
+
+static pthread_mutex_t _lock = PTHREAD_MUTEX_INITIALIZER;
+static struct spa_list _pool = SPA_LIST_INIT(&_pool);
+static uint32_t _n_pool;
+static size_t _pool_size;
+
+/** Mapped blocks, sorted on ptr */
+static struct memblock **_index;
+static uint32_t _n_index;
+static uint32_t _max_index;
 
 #define USE_MEMFD
 
+/* first index with a ptr larger than \a ptr, call with the lock */
+static uint32_t index_upper_bound(const void *ptr)
+{
+	uint32_t lo = 0, hi = _n_index;
+
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		if ((const uint8_t *) _index[mid]->mem.ptr <= (const uint8_t *) ptr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int index_add(struct memblock *m)
+{
+	uint32_t pos;
+
+	if (m->indexed || m->mem.ptr == NULL)
+		return 0;
+
+	pthread_mutex_lock(&_lock);
+	if (_n_index == _max_index) {
+		uint32_t max = _max_index ? _max_index * 2 : 64;
+		struct memblock **idx = realloc(_index, max * sizeof(struct memblock *));
+		if (idx == NULL) {
+			pthread_mutex_unlock(&_lock);
+			return -ENOMEM;
+		}
+		_index = idx;
+		_max_index = max;
+	}
+	pos = index_upper_bound(m->mem.ptr);
+	memmove(&_index[pos + 1], &_index[pos], (_n_index - pos) * sizeof(struct memblock *));
+	_index[pos] = m;
+	_n_index++;
+	m->indexed = true;
+	pthread_mutex_unlock(&_lock);
+
+	return 0;
+}
+
+static void index_remove(struct memblock *m)
+{
+	uint32_t pos;
+
+	if (!m->indexed)
+		return;
+
+	pthread_mutex_lock(&_lock);
+	pos = index_upper_bound(m->mem.ptr);
+	while (pos > 0 && _index[pos - 1] != m)
+		pos--;
+	if (pos > 0) {
+		pos--;
+		memmove(&_index[pos], &_index[pos + 1], (_n_index - pos - 1) * sizeof(struct memblock *));
+		_n_index--;
+	}
+	m->indexed = false;
+	pthread_mutex_unlock(&_lock);
+}
+
+/* the size of the memfd that is allocated for \a size bytes. Sizes are
+ * rounded up to a page and then to a quarter of their power of 2 so that
+ * memfds can be reused for similar sizes without wasting much memory. */
+static size_t pool_size_class(size_t size, size_t page_size)
+{
+	size_t step;
+
+	size = SPA_ROUND_UP_N(SPA_MAX(size, (size_t) 1), page_size);
+	if (size <= 4 * page_size)
+		return size;
+
+	step = (size_t) 1 << ((sizeof(unsigned long) * 8 - 1 - __builtin_clzl(size)) - 2);
+	return SPA_ROUND_UP_N(size, SPA_MAX(step, page_size));
+}
+
+static bool pool_can_recycle(struct memblock *m)
+{
+	enum pw_memblock_flags flags = m->mem.flags;
+
+	return !m->imported &&
+	    !m->exported &&
+	    m->mem.fd != -1 &&
+	    m->mem.ptr != NULL &&
+	    (flags & PW_MEMBLOCK_FLAG_WITH_FD) &&
+	    (flags & PW_MEMBLOCK_FLAG_SEAL) &&
+	    !(flags & PW_MEMBLOCK_FLAG_MAP_TWICE);
+}
+
+/* take a block from the pool with a memfd of \a map_size and the same
+ * flags, the memory is cleared */
+static struct memblock *pool_take(enum pw_memblock_flags flags, size_t map_size)
+{
+	struct memblock *m, *res = NULL;
+
+	pthread_mutex_lock(&_lock);
+	spa_list_for_each(m, &_pool, link) {
+		if (m->map_size == map_size && m->mem.flags == flags) {
+			spa_list_remove(&m->link);
+			_n_pool--;
+			_pool_size -= m->map_size;
+			res = m;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return res;
+}
+
+/* give the block to the pool, returns false when the pool is full */
+static bool pool_give(struct memblock *m)
+{
+	bool res = false;
+
+	/* drop the pages, the next user will see zeroes */
+	if (fallocate(m->mem.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+		      0, m->map_size) < 0)
+		memset(m->mem.ptr, 0, m->map_size);
+
+	pthread_mutex_lock(&_lock);
+	if (_n_pool < MAX_POOL_BLOCKS && _pool_size + m->map_size <= MAX_POOL_SIZE) {
+		spa_list_prepend(&_pool, &m->link);
+		_n_pool++;
+		_pool_size += m->map_size;
+		res = true;
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return res;
+}
+
 /** Map a memblock
  * \param mem a memblock
  * \return 0 on success, < 0 on error
@@ -95,6 +255,8 @@ static struct spa_list _memblocks = SPA_LIST_INIT(&_memblocks);
  */
 int pw_memblock_map(struct pw_memblock *mem)
 {
+	struct memblock *m = SPA_CONTAINER_OF(mem, struct memblock, mem);
+
 	if (mem->ptr != NULL)
 		return 0;
 
@@ -130,11 +292,24 @@ int pw_memblock_map(struct pw_memblock *mem)
 				munmap(mem->ptr, mem->size << 1);
 				return -ENOMEM;
 			}
+			m->map_size = mem->size << 1;
 		} else {
-			mem->ptr = mmap(NULL, mem->size, prot, MAP_SHARED, mem->fd, 0);
-			if (mem->ptr == MAP_FAILED)
+			size_t size = m->map_size ? m->map_size : mem->size;
+
+			mem->ptr = mmap(NULL, size, prot, MAP_SHARED, mem->fd, 0);
+			if (mem->ptr == MAP_FAILED) {
+				mem->ptr = NULL;
 				return -ENOMEM;
+			}
+			m->map_size = size;
+
+			/* transparent huge pages, when enabled for shmem. Clients
+			 * map the memfd with normal page alignment so it can't
+			 * live on hugetlbfs */
+			if (mem->flags & PW_MEMBLOCK_FLAG_HUGEPAGES)
+				madvise(mem->ptr, size, MADV_HUGEPAGE);
 		}
+		index_add(m);
 	} else {
 		mem->ptr = NULL;
 	}
@@ -142,86 +317,147 @@ int pw_memblock_map(struct pw_memblock *mem)
 	return 0;
 }
 
+static int alloc_fd(struct memblock *p, size_t size)
+{
+	struct pw_memblock *m = &p->mem;
+
+#ifdef USE_MEMFD
+	m->fd = memfd_create("pipewire-memfd", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (m->fd == -1) {
+		pw_log_error("Failed to create memfd: %s\n", strerror(errno));
+		return -errno;
+	}
+#else
+	char filename[] = "/dev/shm/pipewire-tmpfile.XXXXXX";
+	m->fd = mkostemp(filename, O_CLOEXEC);
+	if (m->fd == -1) {
+		pw_log_error("Failed to create temporary file: %s\n", strerror(errno));
+		return -errno;
+	}
+	unlink(filename);
+#endif
+
+	if (ftruncate(m->fd, size) < 0) {
+		pw_log_warn("Failed to truncate temporary file: %s", strerror(errno));
+		close(m->fd);
+		m->fd = -1;
+		return -errno;
+	}
+#ifdef USE_MEMFD
+	if (m->flags & PW_MEMBLOCK_FLAG_SEAL) {
+		unsigned int seals = F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL;
+		if (fcntl(m->fd, F_ADD_SEALS, seals) == -1) {
+			pw_log_warn("Failed to add seals: %s", strerror(errno));
+		}
+	}
+#endif
+	return 0;
+}
+
+/* make the memfd of \a p and map it */
+static int alloc_fd_mapped(struct memblock *p)
+{
+	struct pw_memblock *m = &p->mem;
+	int res;
+
+	if ((res = alloc_fd(p, p->map_size ? p->map_size : m->size)) < 0)
+		return res;
+
+	if (pw_memblock_map(m) != 0) {
+		close(m->fd);
+		m->fd = -1;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
 /** Create a new memblock
  * \param flags memblock flags
  * \param size size to allocate
  * \param[out] mem memblock structure to fill
  * \return 0 on success, < 0 on error
+ *
+ * Sealed blocks with a memfd are taken from a pool of previously freed
+ * blocks of the same size class when possible.
+ *
+ * With PW_MEMBLOCK_FLAG_HUGEPAGES, transparent huge pages are requested
+ * for the mapping.
+ *
  * \memberof pw_memblock
  */
 int pw_memblock_alloc(enum pw_memblock_flags flags, size_t size, struct pw_memblock **mem)
 {
-	struct memblock tmp, *p;
+	struct memblock *p;
 	struct pw_memblock *m;
-	bool use_fd;
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	bool use_fd, pooled;
+	int res;
 
 	if (mem == NULL)
 		return -EINVAL;
 
-	m = &tmp.mem;
+	use_fd = ! !(flags & (PW_MEMBLOCK_FLAG_MAP_TWICE | PW_MEMBLOCK_FLAG_WITH_FD));
+	pooled = use_fd && (flags & PW_MEMBLOCK_FLAG_SEAL) &&
+	    (flags & PW_MEMBLOCK_FLAG_WITH_FD) && !(flags & PW_MEMBLOCK_FLAG_MAP_TWICE) &&
+	    (flags & PW_MEMBLOCK_FLAG_MAP_READWRITE);
+
+	if (pooled) {
+		if ((p = pool_take(flags, pool_size_class(size, page_size))) != NULL) {
+			p->mem.size = size;
+			if ((res = index_add(p)) < 0) {
+				pw_memblock_free(&p->mem);
+				return res;
+			}
+			*mem = &p->mem;
+			pw_log_debug("mem %p: alloc from pool", *mem);
+			return 0;
+		}
+	}
+
+	p = calloc(1, sizeof(struct memblock));
+	if (p == NULL)
+		return -ENOMEM;
+
+	m = &p->mem;
 	m->offset = 0;
 	m->flags = flags;
 	m->size = size;
 	m->ptr = NULL;
-
-	use_fd = ! !(flags & (PW_MEMBLOCK_FLAG_MAP_TWICE | PW_MEMBLOCK_FLAG_WITH_FD));
+	m->fd = -1;
 
 	if (use_fd) {
-#ifdef USE_MEMFD
-		m->fd = memfd_create("pipewire-memfd", MFD_CLOEXEC | MFD_ALLOW_SEALING);
-		if (m->fd == -1) {
-			pw_log_error("Failed to create memfd: %s\n", strerror(errno));
-			return -errno;
-		}
-#else
-		char filename[] = "/dev/shm/pipewire-tmpfile.XXXXXX";
-		m->fd = mkostemp(filename, O_CLOEXEC);
-		if (m->fd == -1) {
-			pw_log_error("Failed to create temporary file: %s\n", strerror(errno));
-			return -errno;
-		}
-		unlink(filename);
-#endif
-
-		if (ftruncate(m->fd, size) < 0) {
-			pw_log_warn("Failed to truncate temporary file: %s", strerror(errno));
-			close(m->fd);
-			return -errno;
-		}
-#ifdef USE_MEMFD
-		if (flags & PW_MEMBLOCK_FLAG_SEAL) {
-			unsigned int seals = F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL;
-			if (fcntl(m->fd, F_ADD_SEALS, seals) == -1) {
-				pw_log_warn("Failed to add seals: %s", strerror(errno));
-			}
-		}
-#endif
-		if (pw_memblock_map(m) != 0)
-			goto mmap_failed;
+		if (pooled)
+			p->map_size = pool_size_class(size, page_size);
+		else
+			p->map_size = (flags & PW_MEMBLOCK_FLAG_MAP_TWICE) ? 0 : size;
+		if ((res = alloc_fd_mapped(p)) < 0)
+			goto error_free;
 	} else {
 		if (size > 0) {
 			m->ptr = malloc(size);
-			if (m->ptr == NULL)
-				return -ENOMEM;
+			if (m->ptr == NULL) {
+				res = -ENOMEM;
+				goto error_free;
+			}
+			if ((res = index_add(p)) < 0)
+				goto index_failed;
 		}
-		m->fd = -1;
 	}
 	if (!(flags & PW_MEMBLOCK_FLAG_WITH_FD) && m->fd != -1) {
 		close(m->fd);
 		m->fd = -1;
 	}
 
-	p = calloc(1, sizeof(struct memblock));
-	*p = tmp;
-	spa_list_append(&_memblocks, &p->link);
-	*mem = &p->mem;
+	*mem = m;
 	pw_log_debug("mem %p: alloc", *mem);
 
 	return 0;
 
-      mmap_failed:
-	close(m->fd);
-	return -ENOMEM;
+      index_failed:
+	free(m->ptr);
+      error_free:
+	free(p);
+	return res;
 }
 
 int
@@ -229,23 +465,38 @@ pw_memblock_import(enum pw_memblock_flags flags,
 		   int fd, off_t offset, size_t size,
 		   struct pw_memblock **mem)
 {
+	struct memblock *p;
 	int res;
 
-	if ((res = pw_memblock_alloc(0, 0, mem)) < 0)
-		return res;
+	if (mem == NULL)
+		return -EINVAL;
 
-	(*mem)->flags = flags;
-	(*mem)->fd = fd;
-	(*mem)->offset = offset;
-	(*mem)->size = size;
+	p = calloc(1, sizeof(struct memblock));
+	if (p == NULL)
+		return -ENOMEM;
+
+	p->imported = true;
+	p->mem.flags = flags;
+	p->mem.fd = fd;
+	p->mem.offset = offset;
+	p->mem.size = size;
+	*mem = &p->mem;
 
 	pw_log_debug("mem %p: import", *mem);
 
-	return pw_memblock_map(*mem);
+	if ((res = pw_memblock_map(*mem)) < 0) {
+		free(p);
+		*mem = NULL;
+	}
+	return res;
 }
 
 /** Free a memblock
  * \param mem a memblock
+ *
+ * Sealed blocks with a memfd are kept in a pool for reuse unless their
+ * fd was exported, other processes might still have it mapped.
+ *
  * \memberof pw_memblock
  */
 void pw_memblock_free(struct pw_memblock *mem)
@@ -256,25 +507,103 @@ void pw_memblock_free(struct pw_memblock *mem)
 		return;
 
 	pw_log_debug("mem %p: free", mem);
-	if (mem->flags & PW_MEMBLOCK_FLAG_WITH_FD) {
+	index_remove(m);
+
+	if (pool_can_recycle(m) && pool_give(m))
+		return;
+
+	if (m->map_size) {
 		if (mem->ptr)
-			munmap(mem->ptr, mem->size);
-		if (mem->fd != -1)
-			close(mem->fd);
+			munmap(mem->ptr, m->map_size);
 	} else {
 		free(mem->ptr);
 	}
-	spa_list_remove(&m->link);
+	if ((mem->flags & PW_MEMBLOCK_FLAG_WITH_FD) && mem->fd != -1)
+		close(mem->fd);
 	free(mem);
 }
 
+/** Prefer memory from a NUMA node
+ * \param mem a mapped memblock
+ * \param node the NUMA node
+ * \return 0 on success, < 0 on error
+ *
+ * The pages of \a mem that are allocated after this call will preferably
+ * come from \a node. Call this before the memory is touched.
+ *
+ * \memberof pw_memblock
+ */
+int pw_memblock_bind(struct pw_memblock *mem, int node)
+{
+	struct memblock *m = (struct memblock *)mem;
+	unsigned long mask[4] = { 0, };
+	const unsigned long bits = sizeof(unsigned long) * 8;
+
+	if (mem->ptr == NULL || m->map_size == 0 || node < 0)
+		return -EINVAL;
+	if ((unsigned long) node >= SPA_N_ELEMENTS(mask) * bits)
+		return -ERANGE;
+
+	mask[node / bits] = 1UL << (node % bits);
+
+#ifdef SYS_mbind
+	if (syscall(SYS_mbind, mem->ptr, m->map_size, MPOL_PREFERRED,
+		    mask, SPA_N_ELEMENTS(mask) * bits + 1, 0) < 0)
+		return -errno;
+	pw_log_debug("mem %p: bound to node %d", mem, node);
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/** Find memblock for given \a ptr
+ * \param ptr a pointer into a memblock
+ * \return the memblock that contains \a ptr or NULL
+ *
+ * This is a binary search in the blocks sorted on their mapped address.
+ *
+ * \memberof pw_memblock
+ */
 struct pw_memblock * pw_memblock_find(const void *ptr)
 {
-	struct memblock *m;
+	struct pw_memblock *res = NULL;
+	uint32_t pos;
+
+	pthread_mutex_lock(&_lock);
+	pos = index_upper_bound(ptr);
+	if (pos > 0) {
+		struct memblock *m = _index[pos - 1];
+		if ((const uint8_t *) ptr < (const uint8_t *) m->mem.ptr + m->mem.size)
+			res = &m->mem;
+	}
+	pthread_mutex_unlock(&_lock);
+
+	return res;
+}
 
-	spa_list_for_each(m, &_memblocks, link) {
-		if (ptr >= m->mem.ptr && ptr < m->mem.ptr + m->mem.size)
-			return &m->mem;
+/** Mark the memblock with \a fd as exported
+ * \param fd the fd that is sent to another process
+ *
+ * The memblock that owns \a fd, if any, will not be recycled when it
+ * is freed. Call this for every fd that leaves the process.
+ *
+ * \memberof pw_memblock
+ */
+void pw_memblock_export_fd(int fd)
+{
+	uint32_t i;
+
+	if (fd == -1)
+		return;
+
+	pthread_mutex_lock(&_lock);
+	for (i = 0; i < _n_index; i++) {
+		struct memblock *m = _index[i];
+		if (m->mem.fd == fd) {
+			m->exported = true;
+			break;
+		}
 	}
-	return NULL;
+	pthread_mutex_unlock(&_lock);
 }
@@ -34,6 +34,7 @@ enum pw_memblock_flags {
 	PW_MEMBLOCK_FLAG_MAP_READ = (1 << 2),
 	PW_MEMBLOCK_FLAG_MAP_WRITE = (1 << 3),
 	PW_MEMBLOCK_FLAG_MAP_TWICE = (1 << 4),
+	PW_MEMBLOCK_FLAG_HUGEPAGES = (1 << 5),	/**< try to use huge pages for the memory */
 };
 
 #define PW_MEMBLOCK_FLAG_MAP_READWRITE (PW_MEMBLOCK_FLAG_MAP_READ | PW_MEMBLOCK_FLAG_MAP_WRITE)
@@ -62,9 +63,16 @@ pw_memblock_map(struct pw_memblock *mem);
 void
 pw_memblock_free(struct pw_memblock *mem);
 
+/** Prefer memory from NUMA \a node for \a mem */
+int
+pw_memblock_bind(struct pw_memblock *mem, int node);
+
 /** Find memblock for given \a ptr */
 struct pw_memblock * pw_memblock_find(const void *ptr);
 
+/** Mark the memblock with \a fd as shared with another process */
+void pw_memblock_export_fd(int fd);
+
 /** parameters to map a memory range */
 struct pw_map_range {
 	uint32_t start;		/** offset in first page with start of data */
@@ -24,6 +24,8 @@
 
 #include <spa/clock/clock.h>
 #include <spa/pod/parser.h>
+#include <spa/pod/builder.h>
+#include <spa/param/props.h>
 
 #include "pipewire/pipewire.h"
 #include "pipewire/interfaces.h"
@@ -188,6 +190,25 @@ static void update_port_map(struct pw_node *node, enum pw_direction direction,
 	}
 }
 
+/** Forget the cached params of all ports of the node
+ *
+ * \param node a node
+ *
+ * The params of one port can depend on the configuration of the other
+ * ports of the node, so they are all forgotten together.
+ *
+ * \memberof pw_node
+ */
+void pw_node_clear_param_cache(struct pw_node *node)
+{
+	struct pw_port *port;
+
+	spa_list_for_each(port, &node->input_ports, link)
+		pw_port_clear_param_cache(port);
+	spa_list_for_each(port, &node->output_ports, link)
+		pw_port_clear_param_cache(port);
+}
+
 int pw_node_update_ports(struct pw_node *node)
 {
 	uint32_t *input_port_ids, *output_port_ids;
@@ -228,6 +249,9 @@ int pw_node_update_ports(struct pw_node *node)
 	update_port_map(node, PW_DIRECTION_INPUT, &node->input_port_map, input_port_ids, n_input_ports);
 	update_port_map(node, PW_DIRECTION_OUTPUT, &node->output_port_map, output_port_ids, n_output_ports);
 
+	/* the params of the ports might have changed */
+	pw_node_clear_param_cache(node);
+
 	return 0;
 }
 
@@ -355,6 +379,10 @@ int pw_node_register(struct pw_node *this,
 	spa_list_append(&core->node_list, &this->link);
 	this->registered = true;
 
+	pw_node_set_quantum(this, core->quantum);
+	if (this->latency != 0)
+		pw_core_update_quantum(core);
+
 	this->global = pw_global_new(core,
 				     core->type.node, PW_VERSION_NODE,
 				     properties,
@@ -390,6 +418,11 @@ static void check_properties(struct pw_node *node)
 		impl->pause_on_idle = pw_properties_parse_bool(str);
 	else
 		impl->pause_on_idle = true;
+
+	if ((str = pw_properties_get(node->properties, PW_NODE_PROP_LATENCY)))
+		node->latency = SPA_MAX(atoi(str), 0);
+	else
+		node->latency = 0;
 }
 
 struct pw_node *pw_node_new(struct pw_core *core,
@@ -477,7 +510,7 @@ const struct pw_properties *pw_node_get_properties(struct pw_node *node)
 int pw_node_update_properties(struct pw_node *node, const struct spa_dict *dict)
 {
 	struct pw_resource *resource;
-	uint32_t i, changed = 0;
+	uint32_t i, changed = 0, latency = node->latency;
 
 	for (i = 0; i < dict->n_items; i++)
 		changed += pw_properties_set(node->properties, dict->items[i].key, dict->items[i].value);
@@ -489,6 +522,9 @@ int pw_node_update_properties(struct pw_node *node, const struct spa_dict *dict)
 
 	check_properties(node);
 
+	if (node->registered && node->latency != latency)
+		pw_core_update_quantum(node->core);
+
 	node->info.props = &node->properties->dict;
 	node->info.change_mask |= PW_NODE_CHANGE_MASK_PROPS;
 	pw_node_events_info_changed(node, &node->info);
@@ -541,16 +577,8 @@ static void node_have_output(void *data)
 static void node_reuse_buffer(void *data, uint32_t port_id, uint32_t buffer_id)
 {
 	struct pw_node *node = data;
-        struct spa_graph_port *p, *pp;
-
-	spa_list_for_each(p, &node->rt.node.ports[SPA_DIRECTION_INPUT], link) {
-		if (p->port_id != port_id)
-			continue;
-
-		if ((pp = p->peer) != NULL)
-			spa_node_port_reuse_buffer(pp->node->implementation, pp->port_id, buffer_id);
-		break;
-	}
+	pw_log_trace("node %p: reuse buffer %d %d", node, port_id, buffer_id);
+	spa_graph_reuse_buffer(node->rt.graph, &node->rt.node, port_id, buffer_id);
 }
 
 
@@ -621,6 +649,8 @@ void pw_node_destroy(struct pw_node *node)
 	if (node->registered) {
 		pw_loop_invoke(node->data_loop, do_node_remove, 1, NULL, 0, true, node);
 		spa_list_remove(&node->link);
+		if (node->latency != 0)
+			pw_core_update_quantum(node->core);
 	}
 
 	pw_log_debug("node %p: unlink ports", node);
@@ -992,3 +1022,43 @@ bool pw_node_is_enabled(struct pw_node *node)
 {
 	return node->enabled;
 }
+
+/** Configure the quantum of the graph on the node
+ * \param node a node
+ * \param quantum the new quantum in samples
+ * \return 0 on success, < 0 on error
+ *
+ * The quantum is configured with the quantum property of the node. Nodes
+ * that don't know about the quantum ignore it.
+ */
+int pw_node_set_quantum(struct pw_node *node, uint32_t quantum)
+{
+	struct pw_type *t = &node->core->type;
+	struct spa_pod_builder b = { 0 };
+	uint8_t buf[128];
+	struct spa_pod *props;
+	int res;
+
+	if (node->node == NULL)
+		return 0;
+
+	spa_pod_builder_init(&b, buf, sizeof(buf));
+	props = spa_pod_builder_object(&b,
+		t->param.idProps, t->spa_props,
+		":", spa_type_map_get_id(t->map, SPA_TYPE_PROPS__quantum), "i", quantum);
+
+	res = spa_node_set_param(node->node, t->param.idProps, 0, props);
+	if (res == -ENOENT || res == -ENOTSUP) {
+		pw_log_debug("node %p: quantum not supported: %s", node, spa_strerror(res));
+		return 0;
+	}
+	else if (res < 0)
+		pw_log_warn("node %p: can't set quantum %u: %s", node, quantum, spa_strerror(res));
+	else {
+		pw_log_debug("node %p: quantum %u", node, quantum);
+		/* the buffer params of the ports depend on the quantum */
+		pw_node_clear_param_cache(node);
+	}
+
+	return res;
+}
@@ -104,6 +104,9 @@ struct pw_node_events {
 #define PW_NODE_PROP_AUTOCONNECT	"pipewire.autoconnect"
 /** Try to connect the node to this node id */
 #define PW_NODE_PROP_TARGET_NODE	"pipewire.target.node"
+/** The latency in frames the node wants, the smallest latency of all nodes
+ * is used as the quantum of the graph */
+#define PW_NODE_PROP_LATENCY		"pipewire.latency"
 
 /** Create a new node \memberof pw_node */
 struct pw_node *
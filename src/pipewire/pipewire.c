@@ -108,7 +108,8 @@ static const struct spa_handle_factory *get_factory(struct support_info *info, c
 static struct interface *
 load_interface(struct support_info *info,
 	       const char *factory_name,
-	       const char *type)
+	       const char *type,
+	       const struct spa_dict *props)
 {
         int res;
         struct spa_handle *handle;
@@ -124,7 +125,7 @@ load_interface(struct support_info *info,
 
         handle = calloc(1, factory->size);
         if ((res = spa_handle_factory_init(factory,
-                                           handle, NULL, info->support, info->n_support)) < 0) {
+                                           handle, props, info->support, info->n_support)) < 0) {
                 fprintf(stderr, "can't make factory instance: %d\n", res);
                 goto init_failed;
         }
@@ -212,7 +213,7 @@ void *pw_get_spa_dbus(struct pw_loop *loop)
 		str = PLUGINDIR;
 
 	if (open_support(str, "support/libspa-dbus", &dbus_support_info)) {
-		iface = load_interface(&dbus_support_info, "dbus", SPA_TYPE__DBus);
+		iface = load_interface(&dbus_support_info, "dbus", SPA_TYPE__DBus, NULL);
 		if (iface != NULL)
 			return iface->iface;
 	}
@@ -252,6 +253,9 @@ int pw_release_spa_dbus(void *dbus)
  *
  * The environment variable \a PIPEWIRE_DEBUG
  *
+ * When the environment variable \a PIPEWIRE_LOG_BINARY_TRACE is 1, trace
+ * messages are stored in binary form and formatted in a separate thread.
+ *
  * \memberof pw_pipewire
  */
 void pw_init(int *argc, char **argv[])
@@ -259,6 +263,8 @@ void pw_init(int *argc, char **argv[])
 	const char *str;
 	struct interface *iface;
 	struct support_info *info = &support_info;
+	struct spa_dict_item items[1];
+	struct spa_dict props = SPA_DICT_INIT(items, 0);
 
 	if ((str = getenv("PIPEWIRE_DEBUG")))
 		configure_debug(str);
@@ -272,11 +278,14 @@ void pw_init(int *argc, char **argv[])
 	spa_list_init(&global_registry.interfaces);
 
 	if (open_support(str, "support/libspa-support", info)) {
-		iface = load_interface(info, "mapper", SPA_TYPE__TypeMap);
+		iface = load_interface(info, "mapper", SPA_TYPE__TypeMap, NULL);
 		if (iface != NULL)
 			info->support[info->n_support++] = SPA_SUPPORT_INIT(SPA_TYPE__TypeMap, iface->iface);
 
-		iface = load_interface(info, "logger", SPA_TYPE__Log);
+		if ((str = getenv("PIPEWIRE_LOG_BINARY_TRACE")))
+			items[props.n_items++] = SPA_DICT_ITEM_INIT("log.binary-trace", str);
+
+		iface = load_interface(info, "logger", SPA_TYPE__Log, &props);
 		if (iface != NULL) {
 			info->support[info->n_support++] = SPA_SUPPORT_INIT(SPA_TYPE__Log, iface->iface);
 			pw_log_set(iface->iface);
@@ -22,14 +22,69 @@
 #include <errno.h>
 
 #include <spa/pod/parser.h>
+#include <spa/pod/filter.h>
+#include <spa/param/audio/format-utils.h>
 
 #include "pipewire/pipewire.h"
 #include "pipewire/private.h"
 #include "pipewire/port.h"
 
+#include "mix-ops.h"
+
 /** \cond */
+struct type {
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+};
+
+static inline void init_type(struct type *type, struct spa_type_map *map)
+{
+	spa_type_media_type_map(map, &type->media_type);
+	spa_type_media_subtype_map(map, &type->media_subtype);
+	spa_type_format_audio_map(map, &type->format_audio);
+	spa_type_audio_format_map(map, &type->audio_format);
+}
+
+/* the buffers of the input mixer, only used from the data thread */
+struct mixer {
+	struct spa_buffer **buffers;	/**< buffers of the node */
+	uint32_t n_buffers;		/**< number of buffers of the node */
+	uint32_t base;			/**< id of the first mix buffer, the buffers
+					  *  before it are the buffers of the link */
+	struct spa_buffer **link_buffers;	/**< buffers of the link the node
+						  *  can use without a copy */
+	uint64_t free;			/**< bitmask of free mix buffers */
+	bool refused;			/**< links were dropped because they can't
+					  *  be mixed */
+};
+
 struct impl {
 	struct pw_port this;
+
+	struct type type;
+
+	struct spa_audiomixer_ops ops;
+	uint32_t mix_format;		/**< one of the FMT_ values or FMT_MAX when
+					  *  the format can't be mixed */
+	struct allocation mix;		/**< memory of the mix buffers */
+	struct mixer mixer;		/**< the mixer of the data thread */
+
+	struct pw_array param_cache;	/**< enumerated params, struct param_cache */
+};
+
+struct param_cache_item {
+	struct spa_pod *param;		/**< the enumerated param */
+	struct spa_pod *filter;		/**< the last filter applied to param */
+	struct spa_pod *result;		/**< result of the last filter, NULL when
+					  *  the filter did not match */
+};
+
+struct param_cache {
+	uint32_t id;
+	uint32_t n_items;
+	struct param_cache_item *items;
 };
 
 struct resource_data {
@@ -101,19 +156,233 @@ static const struct spa_node schedule_tee_node = {
 	.port_reuse_buffer = schedule_tee_reuse_buffer,
 };
 
+static inline bool link_is_ready(struct spa_graph_port *p)
+{
+	return !SPA_FLAG_CHECK(p->flags, SPA_GRAPH_PORT_FLAG_DISABLED) &&
+		p->io->status == SPA_STATUS_HAVE_BUFFER &&
+		p->io->buffer_id != SPA_ID_INVALID;
+}
+
+static struct spa_buffer *link_get_buffer(struct pw_link *link)
+{
+	struct pw_port *output = link->output;
+	uint32_t id = link->io.buffer_id;
+
+	if (output == NULL || id >= output->n_buffers)
+		return NULL;
+	return output->buffers[id];
+}
+
+static inline bool is_mix_buffer(struct mixer *m, uint32_t id)
+{
+	return id >= m->base && id < m->n_buffers;
+}
+
+static inline struct spa_buffer *dequeue_mix_buffer(struct mixer *m)
+{
+	uint64_t free = __atomic_load_n(&m->free, __ATOMIC_ACQUIRE);
+	uint32_t index;
+
+	do {
+		if (free == 0)
+			return NULL;
+		index = __builtin_ctzll(free);
+	} while (!__atomic_compare_exchange_n(&m->free, &free, free & ~(1ULL << index),
+					      true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	return m->buffers[m->base + index];
+}
+
+static inline void release_mix_buffer(struct mixer *m, uint32_t id)
+{
+	__atomic_fetch_or(&m->free, 1ULL << (id - m->base), __ATOMIC_RELEASE);
+}
+
+/* copy or sum the data of src with the given gain into the port buffer dst */
+static void mix_buffer(struct impl *impl, struct spa_buffer *dst,
+		       struct spa_buffer *src, float gain)
+{
+	uint32_t i, n_datas = SPA_MIN(dst->n_datas, src->n_datas);
+
+	for (i = 0; i < n_datas; i++) {
+		struct spa_data *dd = &dst->datas[i], *sd = &src->datas[i];
+		void *s;
+		uint32_t size;
+
+		if (dd->data == NULL || sd->data == NULL)
+			continue;
+
+		s = SPA_MEMBER(sd->data, sd->chunk->offset % sd->maxsize, void);
+		size = SPA_MIN(sd->chunk->size, dd->maxsize);
+		size = SPA_MIN(size, sd->maxsize - (sd->chunk->offset % sd->maxsize));
+
+		if (dd->chunk->size == 0) {
+			if (gain == 1.0f)
+				impl->ops.copy[impl->mix_format](dd->data, s, size);
+			else
+				impl->ops.copy_scale[impl->mix_format](dd->data, s, gain, size);
+			dd->chunk->size = size;
+			dd->chunk->stride = sd->chunk->stride;
+			continue;
+		}
+		if (size > dd->chunk->size) {
+			memset(SPA_MEMBER(dd->data, dd->chunk->size, void), 0, size - dd->chunk->size);
+			dd->chunk->size = size;
+		}
+		if (gain == 1.0f)
+			impl->ops.add[impl->mix_format](dd->data, s, size);
+		else
+			impl->ops.add_scale[impl->mix_format](dd->data, s, gain, size);
+	}
+}
+
+/* start a new mix in dst, the metadata is taken from the first link */
+static void mix_buffer_init(struct spa_buffer *dst, struct spa_buffer *src)
+{
+	uint32_t i;
+
+	for (i = 0; i < dst->n_metas && i < src->n_metas; i++) {
+		if (dst->metas[i].type == src->metas[i].type &&
+		    dst->metas[i].size == src->metas[i].size)
+			memcpy(dst->metas[i].data, src->metas[i].data, dst->metas[i].size);
+	}
+	for (i = 0; i < dst->n_datas; i++) {
+		dst->datas[i].chunk->offset = 0;
+		dst->datas[i].chunk->size = 0;
+	}
+}
+
+/* the node uses the buffers of the first link, the other links are dropped */
+static int schedule_mix_passthrough(struct impl *impl)
+{
+	struct pw_port *this = &impl->this;
+	struct spa_graph_node *node = &this->rt.mix_node;
+	struct spa_graph_port *p, *dst = NULL;
+	struct spa_io_buffers *io = this->rt.mix_port.io;
+	struct pw_link *link;
+
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		if (!link_is_ready(p))
+			continue;
+
+		link = p->scheduler_data;
+		if (dst == NULL && link->output && link->output->buffers == this->buffers) {
+			dst = p;
+			continue;
+		}
+		if (!impl->mixer.refused) {
+			pw_log_warn("port %p: format can't be mixed, dropping data of link %p",
+					this, link);
+			impl->mixer.refused = true;
+		}
+		/* the buffer is given back on the next pull */
+		p->io->status = SPA_STATUS_NEED_BUFFER;
+	}
+	if (dst == NULL) {
+		/* nothing to use, take whatever the first link has */
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+			*io = *p->io;
+			p->io->buffer_id = SPA_ID_INVALID;
+			break;
+		}
+		return io->status;
+	}
+
+	*io = *dst->io;
+	dst->io->buffer_id = SPA_ID_INVALID;
+
+	return io->status;
+}
+
+/* the only ready link when the node can use its buffer without a copy */
+static struct spa_graph_port *get_direct_link(struct mixer *m, struct spa_graph_node *node)
+{
+	struct spa_graph_port *p, *ready = NULL;
+	struct pw_link *link;
+
+	if (m->link_buffers == NULL)
+		return NULL;
+
+	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+		if (!link_is_ready(p))
+			continue;
+		if (ready != NULL)
+			return NULL;
+		ready = p;
+	}
+	if (ready == NULL)
+		return NULL;
+
+	link = ready->scheduler_data;
+	if (link->gain != 1.0f || link->output == NULL ||
+	    link->output->buffers != m->link_buffers ||
+	    ready->io->buffer_id >= m->base)
+		return NULL;
+
+	return ready;
+}
+
+/* The node gets the buffers of the link followed by the buffers of the port.
+ * When one link is ready and it doesn't need a gain, the node uses the buffer
+ * of the link. Otherwise the data of all links is summed into a free buffer
+ * of the port, the buffers of the links are only read and given back to the
+ * outputs on the next pull. When the node has no room for the buffers of the
+ * link, it only gets the buffers of the port. When the format can't be mixed,
+ * the node uses the buffers of the first link. */
 static int schedule_mix_input(struct spa_node *data)
 {
 	struct pw_port *this = SPA_CONTAINER_OF(data, struct pw_port, mix_node);
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct mixer *m = &impl->mixer;
 	struct spa_graph_node *node = &this->rt.mix_node;
 	struct spa_graph_port *p;
 	struct spa_io_buffers *io = this->rt.mix_port.io;
+	struct spa_buffer *dbuf = NULL, *sbuf;
+	struct pw_link *link;
+
+	if (m->n_buffers == 0)
+		return schedule_mix_passthrough(impl);
+
+	/* a buffer the node did not take or did not give back yet */
+	if (is_mix_buffer(m, io->buffer_id))
+		release_mix_buffer(m, io->buffer_id);
+
+	if ((p = get_direct_link(m, node)) != NULL) {
+		pw_log_trace("mix %p: use link %p buffer %d", node,
+				p->scheduler_data, p->io->buffer_id);
+		*io = *p->io;
+		p->io->buffer_id = SPA_ID_INVALID;
+		return io->status;
+	}
 
 	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
 		pw_log_trace("mix %p: input %p %p->%p %d %d", node,
 				p, p->io, io, p->io->status, p->io->buffer_id);
-		*io = *p->io;
-		p->io->buffer_id = SPA_ID_INVALID;
-		break;
+		if (!link_is_ready(p))
+			continue;
+
+		link = p->scheduler_data;
+		if ((sbuf = link_get_buffer(link)) != NULL) {
+			if (dbuf == NULL) {
+				if ((dbuf = dequeue_mix_buffer(m)) == NULL) {
+					pw_log_trace("mix %p: no free buffer", node);
+					break;
+				}
+				mix_buffer_init(dbuf, sbuf);
+			}
+			pw_log_trace("mix %p: mix link %p buffer %d into %d", node,
+					link, p->io->buffer_id, dbuf->id);
+			mix_buffer(impl, dbuf, sbuf, link->gain);
+		}
+		p->io->status = SPA_STATUS_NEED_BUFFER;
+	}
+
+	if (dbuf == NULL) {
+		io->status = SPA_STATUS_NEED_BUFFER;
+		io->buffer_id = SPA_ID_INVALID;
+	} else {
+		io->status = SPA_STATUS_HAVE_BUFFER;
+		io->buffer_id = dbuf->id;
 	}
 	return io->status;
 }
@@ -121,13 +390,29 @@ static int schedule_mix_input(struct spa_node *data)
 static int schedule_mix_output(struct spa_node *data)
 {
 	struct pw_port *this = SPA_CONTAINER_OF(data, struct pw_port, mix_node);
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct mixer *m = &impl->mixer;
 	struct spa_graph_node *node = &this->rt.mix_node;
 	struct spa_graph_port *p;
 	struct spa_io_buffers *io = this->rt.mix_port.io;
 
 	if (!spa_list_is_empty(&node->ports[SPA_DIRECTION_INPUT])) {
-		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link)
-			*p->io = *io;
+		/* the links keep the id of the buffer they gave us, only a
+		 * buffer of their own output can be recycled upstream */
+		spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
+			struct pw_link *link = p->scheduler_data;
+
+			p->io->status = io->status;
+			if (link->output == NULL)
+				continue;
+			if ((m->n_buffers == 0 && link->output->buffers == this->buffers) ||
+			    (io->buffer_id < m->base && link->output->buffers == m->link_buffers))
+				p->io->buffer_id = io->buffer_id;
+		}
+		if (is_mix_buffer(m, io->buffer_id)) {
+			release_mix_buffer(m, io->buffer_id);
+			io->buffer_id = SPA_ID_INVALID;
+		}
 	}
 	else {
 		io->status = SPA_STATUS_HAVE_BUFFER;
@@ -140,9 +425,16 @@ static int schedule_mix_output(struct spa_node *data)
 static int schedule_mix_reuse_buffer(struct spa_node *data, uint32_t port_id, uint32_t buffer_id)
 {
 	struct pw_port *this = SPA_CONTAINER_OF(data, struct pw_port, mix_node);
+	struct impl *impl = SPA_CONTAINER_OF(this, struct impl, this);
+	struct mixer *m = &impl->mixer;
 	struct spa_graph_node *node = &this->rt.mix_node;
 	struct spa_graph_port *p, *pp;
 
+	if (is_mix_buffer(m, buffer_id)) {
+		pw_log_trace("mix %p: reuse mix buffer %d", node, buffer_id);
+		release_mix_buffer(m, buffer_id);
+		return 0;
+	}
 	spa_list_for_each(p, &node->ports[SPA_DIRECTION_INPUT], link) {
 		if ((pp = p->peer) != NULL) {
 			pw_log_trace("mix %p: reuse buffer %d %d", node, port_id, buffer_id);
@@ -187,6 +479,10 @@ struct pw_port *pw_port_new(enum pw_direction direction,
 	this->state = PW_PORT_STATE_INIT;
 	this->io = SPA_IO_BUFFERS_INIT;
 
+	spa_audiomixer_get_ops(&impl->ops);
+	impl->mix_format = FMT_MAX;
+	pw_array_init(&impl->param_cache, 4 * sizeof(struct param_cache));
+
         if (user_data_size > 0)
 		this->user_data = SPA_MEMBER(impl, sizeof(struct impl), void);
 
@@ -414,6 +710,7 @@ int pw_port_register(struct pw_port *port,
 
 int pw_port_add(struct pw_port *port, struct pw_node *node)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	uint32_t port_id = port->port_id;
 	struct pw_core *core = node->core;
 	struct pw_type *t = &core->type;
@@ -421,6 +718,8 @@ int pw_port_add(struct pw_port *port, struct pw_node *node)
 
 	port->node = node;
 
+	init_type(&impl->type, t->map);
+
 	spa_node_port_get_info(node->node,
 			       port->direction, port_id,
 			       &port->spa_info);
@@ -534,6 +833,7 @@ static void pw_port_remove(struct pw_port *port)
 
 void pw_port_destroy(struct pw_port *port)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	struct pw_node *node = port->node;
 	struct pw_control *control, *ctemp;
 	struct pw_resource *resource, *tmp;
@@ -561,6 +861,10 @@ void pw_port_destroy(struct pw_port *port)
 	pw_port_events_free(port);
 
 	free_allocation(&port->allocation);
+	free_allocation(&impl->mix);
+
+	pw_port_clear_param_cache(port);
+	pw_array_clear(&impl->param_cache);
 
 	pw_map_clear(&port->mix_port_map);
 
@@ -657,9 +961,220 @@ int pw_port_for_each_filtered_param(struct pw_port *in_port,
 	return res;
 }
 
+static void param_cache_free(struct param_cache *c)
+{
+	uint32_t i;
+
+	for (i = 0; i < c->n_items; i++) {
+		free(c->items[i].param);
+		free(c->items[i].filter);
+		free(c->items[i].result);
+	}
+	free(c->items);
+}
+
+/** Forget the enumerated params of the port
+ *
+ * \param port a port
+ *
+ * Must be called when the params of the port may have changed. The next
+ * pw_port_enum_params_cached() will enumerate the params from the node
+ * again.
+ *
+ * \memberof pw_port
+ */
+void pw_port_clear_param_cache(struct pw_port *port)
+{
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
+	struct param_cache *c;
+
+	if (impl->param_cache.size > 0)
+		pw_log_debug("port %p: clear param cache", port);
+
+	pw_array_for_each(c, &impl->param_cache)
+		param_cache_free(c);
+	impl->param_cache.size = 0;
+}
+
+static struct param_cache *get_param_cache(struct pw_port *port, uint32_t id, int *res)
+{
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
+	struct pw_node *node = port->node;
+	struct param_cache *c, cache = { id, 0, NULL };
+	struct param_cache_item *items;
+	uint8_t buf[4096];
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod *param;
+	uint32_t index = 0;
+
+	pw_array_for_each(c, &impl->param_cache) {
+		if (c->id == id)
+			return c;
+	}
+
+	while (true) {
+		spa_pod_builder_init(&b, buf, sizeof(buf));
+		if ((*res = spa_node_port_enum_params(node->node,
+						      port->direction, port->port_id,
+						      id, &index,
+						      NULL, &param, &b)) <= 0)
+			break;
+
+		if ((items = realloc(cache.items, (cache.n_items + 1) * sizeof(*items))) == NULL) {
+			*res = -ENOMEM;
+			break;
+		}
+		cache.items = items;
+		items[cache.n_items].param = pw_spa_pod_copy(param);
+		items[cache.n_items].filter = NULL;
+		items[cache.n_items].result = NULL;
+		cache.n_items++;
+	}
+	if (*res < 0 || (c = pw_array_add(&impl->param_cache, sizeof(cache))) == NULL) {
+		if (*res == 0)
+			*res = -ENOMEM;
+		param_cache_free(&cache);
+		return NULL;
+	}
+	*c = cache;
+
+	pw_log_debug("port %p: cached %u params of %s", port, cache.n_items,
+			spa_type_map_get_type(node->core->type.map, id));
+
+	return c;
+}
+
+static int filter_item(struct param_cache_item *item, const struct spa_pod *filter,
+		       struct spa_pod **result, struct spa_pod_builder *builder)
+{
+	int res;
+
+	if (filter == NULL) {
+		*result = spa_pod_builder_deref(builder,
+			spa_pod_builder_raw_padded(builder, item->param, SPA_POD_SIZE(item->param)));
+		return 0;
+	}
+
+	if (item->filter && SPA_POD_SIZE(item->filter) == SPA_POD_SIZE(filter) &&
+	    memcmp(item->filter, filter, SPA_POD_SIZE(filter)) == 0) {
+		if (item->result == NULL)
+			return -EINVAL;
+		*result = spa_pod_builder_deref(builder,
+			spa_pod_builder_raw_padded(builder, item->result, SPA_POD_SIZE(item->result)));
+		return 0;
+	}
+
+	if ((res = spa_pod_filter(builder, result, item->param, filter)) < 0)
+		*result = NULL;
+	else if (*result == NULL)
+		return res;
+
+	free(item->filter);
+	free(item->result);
+	item->filter = pw_spa_pod_copy(filter);
+	item->result = pw_spa_pod_copy(*result);
+
+	return res;
+}
+
+/** Enumerate the params of a port, using a cache
+ *
+ * \param port a port
+ * \param id the param id to enumerate
+ * \param index the index of the param, updated to the next index
+ * \param filter an optional filter
+ * \param param result param
+ * \param builder builder for the result
+ * \return 1 when a param was returned, 0 when there are no more params
+ *	and < 0 on error
+ *
+ * This works like spa_node_port_enum_params() but only asks the node for
+ * the params the first time. Later calls are filtered from the cached
+ * params, the result of the last filter is remembered for each param.
+ *
+ * \memberof pw_port
+ */
+int pw_port_enum_params_cached(struct pw_port *port, uint32_t id, uint32_t *index,
+			       const struct spa_pod *filter, struct spa_pod **param,
+			       struct spa_pod_builder *builder)
+{
+	struct param_cache *c;
+	int res = 0;
+
+	if ((c = get_param_cache(port, id, &res)) == NULL)
+		return res;
+
+	while (*index < c->n_items) {
+		struct param_cache_item *item = &c->items[(*index)++];
+		if (filter_item(item, filter, param, builder) >= 0 && *param != NULL)
+			return 1;
+	}
+	return 0;
+}
+
+static int do_set_mixer(struct spa_loop *loop,
+			bool async, uint32_t seq, const void *data, size_t size, void *user_data)
+{
+	struct impl *impl = user_data;
+	impl->mixer = *(const struct mixer *) data;
+	return 0;
+}
+
+/* the data thread switches to the new mixer before the old buffers are freed */
+static void set_mixer(struct impl *impl, const struct mixer *mixer)
+{
+	pw_loop_invoke(impl->this.node->data_loop, do_set_mixer,
+		       SPA_ID_INVALID, mixer, sizeof(struct mixer), true, impl);
+}
+
+static void clear_mixer(struct impl *impl)
+{
+	struct mixer mixer = { 0, };
+
+	if (impl->mix.n_buffers == 0)
+		return;
+
+	set_mixer(impl, &mixer);
+	free_allocation(&impl->mix);
+}
+
+/* find the sample format the input mixer will use to sum the links */
+static uint32_t get_mix_format(struct impl *impl, const struct spa_pod *format)
+{
+	struct type *t = &impl->type;
+	struct spa_audio_info info = { 0 };
+
+	if (format == NULL || impl->this.direction != PW_DIRECTION_INPUT)
+		return FMT_MAX;
+
+	if (spa_pod_object_parse(format,
+			"I", &info.media_type,
+			"I", &info.media_subtype) < 0)
+		return FMT_MAX;
+
+	if (info.media_type != t->media_type.audio ||
+	    info.media_subtype != t->media_subtype.raw)
+		return FMT_MAX;
+
+	if (spa_format_audio_raw_parse(format, &info.info.raw, &t->format_audio) < 0)
+		return FMT_MAX;
+
+	if (info.info.raw.format == t->audio_format.S16)
+		return FMT_S16;
+	else if (info.info.raw.format == t->audio_format.F32)
+		return FMT_F32;
+	else if (info.info.raw.format == t->audio_format.S32)
+		return FMT_S32;
+	else if (info.info.raw.format == t->audio_format.F64)
+		return FMT_F64;
+
+	return FMT_MAX;
+}
+
 int pw_port_set_param(struct pw_port *port, uint32_t id, uint32_t flags,
 		      const struct spa_pod *param)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	int res;
 	struct pw_node *node = port->node;
 	struct pw_core *core = node->core;
@@ -669,23 +1184,187 @@ int pw_port_set_param(struct pw_port *port, uint32_t id, uint32_t flags,
 	pw_log_debug("port %p: set param %s: %d (%s)", port,
 			spa_type_map_get_type(t->map, id), res, spa_strerror(res));
 
+	pw_node_clear_param_cache(node);
+
 	if (id == t->param.idFormat) {
 		if (param == NULL || res < 0) {
 			free_allocation(&port->allocation);
+			clear_mixer(impl);
 			port->allocated = false;
+			impl->mix_format = FMT_MAX;
 			port_update_state (port, PW_PORT_STATE_CONFIGURE);
 		}
-		else if (!SPA_RESULT_IS_ASYNC(res)) {
-			port_update_state (port, PW_PORT_STATE_READY);
+		else {
+			impl->mix_format = get_mix_format(impl, param);
+			pw_log_debug("port %p: mix format %d", port, impl->mix_format);
+			if (!SPA_RESULT_IS_ASYNC(res))
+				port_update_state (port, PW_PORT_STATE_READY);
 		}
 	}
 	return res;
 }
 
+#define MIX_ALIGN	64
+#define MAX_MIX_BUFFERS	64u
+
+struct max_buffers {
+	struct pw_type *t;
+	uint32_t max;
+};
+
+static int parse_max_buffers(void *data, uint32_t id, uint32_t index, uint32_t next,
+			     struct spa_pod *param)
+{
+	struct max_buffers *d = data;
+	struct spa_pod_prop *prop;
+	int32_t *values;
+
+	if ((prop = spa_pod_find_prop(param, d->t->param_buffers.buffers)) == NULL ||
+	    prop->body.value.type != SPA_POD_TYPE_INT)
+		return 1;
+
+	values = SPA_POD_BODY(&prop->body.value);
+
+	switch (prop->body.flags & SPA_POD_PROP_RANGE_MASK) {
+	case SPA_POD_PROP_RANGE_NONE:
+		d->max = values[0];
+		break;
+	case SPA_POD_PROP_RANGE_MIN_MAX:
+		if (SPA_POD_PROP_N_VALUES(prop) >= 3)
+			d->max = values[2];
+		break;
+	}
+	return 1;
+}
+
+/* the number of buffers the node accepts on the port, 0 when unknown */
+static uint32_t get_max_buffers(struct impl *impl)
+{
+	struct pw_port *port = &impl->this;
+	struct max_buffers d = { &port->node->core->type, 0 };
+
+	pw_port_for_each_param(port, d.t->param.idBuffers, 0, 1, NULL,
+			       parse_max_buffers, &d);
+	return d.max;
+}
+
+/* Allocate the buffers of an input port with the same layout as the buffers
+ * of the link so that they can be shared with clients in the same way:
+ * the metadata, the chunks and the data planes of a buffer follow each
+ * other in one memory block. The first n_link buffers of the node are
+ * the buffers of the link, the mix buffers follow them. */
+static int alloc_mix_buffers(struct impl *impl, struct spa_buffer **buffers,
+			     uint32_t n_buffers, uint32_t n_link, struct mixer *mixer)
+{
+	struct pw_type *t = &impl->this.node->core->type;
+	struct spa_buffer *tmpl = buffers[0], **bufs, *bp;
+	struct pw_memblock *m;
+	size_t skel_size, meta_size = 0, chunk_offset, data_size, *data_offsets;
+	uint32_t i, j;
+	int res;
+
+	n_buffers = SPA_MIN(n_buffers, MAX_MIX_BUFFERS);
+
+	skel_size = sizeof(struct spa_buffer) +
+		tmpl->n_metas * sizeof(struct spa_meta) +
+		tmpl->n_datas * sizeof(struct spa_data);
+
+	for (i = 0; i < tmpl->n_metas; i++)
+		meta_size += tmpl->metas[i].size;
+
+	chunk_offset = meta_size;
+	data_size = chunk_offset + tmpl->n_datas * sizeof(struct spa_chunk);
+
+	data_offsets = alloca(sizeof(size_t) * tmpl->n_datas);
+	for (i = 0; i < tmpl->n_datas; i++) {
+		struct spa_data *d = &tmpl->datas[i];
+
+		if ((d->type != t->data.MemFd && d->type != t->data.MemPtr) ||
+		    d->maxsize == 0)
+			return -ENOTSUP;
+
+		data_size = SPA_ROUND_UP_N(data_size, MIX_ALIGN);
+		data_offsets[i] = data_size;
+		data_size += d->maxsize;
+	}
+	data_size = SPA_ROUND_UP_N(data_size, MIX_ALIGN);
+
+	bufs = calloc(1, (n_link + n_buffers) * sizeof(struct spa_buffer *) +
+			n_buffers * skel_size);
+	if (bufs == NULL)
+		return -ENOMEM;
+	bp = SPA_MEMBER(bufs, (n_link + n_buffers) * sizeof(struct spa_buffer *),
+			struct spa_buffer);
+
+	for (i = 0; i < n_link; i++)
+		bufs[i] = buffers[i];
+
+	if ((res = pw_memblock_alloc(PW_MEMBLOCK_FLAG_WITH_FD |
+				     PW_MEMBLOCK_FLAG_MAP_READWRITE |
+				     PW_MEMBLOCK_FLAG_SEAL, n_buffers * data_size, &m)) < 0) {
+		free(bufs);
+		return res;
+	}
+
+	for (i = 0; i < n_buffers; i++) {
+		struct spa_buffer *b;
+		struct spa_chunk *cdp;
+		void *p;
+
+		bufs[n_link + i] = b = SPA_MEMBER(bp, skel_size * i, struct spa_buffer);
+		p = SPA_MEMBER(m->ptr, data_size * i, void);
+
+		b->id = n_link + i;
+		b->n_metas = tmpl->n_metas;
+		b->metas = SPA_MEMBER(b, sizeof(struct spa_buffer), struct spa_meta);
+		for (j = 0; j < b->n_metas; j++) {
+			b->metas[j].type = tmpl->metas[j].type;
+			b->metas[j].size = tmpl->metas[j].size;
+			b->metas[j].data = p;
+			p += b->metas[j].size;
+		}
+		b->n_datas = tmpl->n_datas;
+		b->datas = SPA_MEMBER(b->metas, b->n_metas * sizeof(struct spa_meta), struct spa_data);
+
+		p = SPA_MEMBER(m->ptr, data_size * i, void);
+		cdp = SPA_MEMBER(p, chunk_offset, struct spa_chunk);
+
+		for (j = 0; j < b->n_datas; j++) {
+			struct spa_data *d = &b->datas[j];
+
+			d->type = t->data.MemFd;
+			d->flags = 0;
+			d->fd = m->fd;
+			d->mapoffset = SPA_PTRDIFF(SPA_MEMBER(p, data_offsets[j], void), m->ptr);
+			d->maxsize = tmpl->datas[j].maxsize;
+			d->data = SPA_MEMBER(m->ptr, d->mapoffset, void);
+			d->chunk = &cdp[j];
+			d->chunk->offset = 0;
+			d->chunk->size = 0;
+			d->chunk->stride = tmpl->datas[j].chunk->stride;
+		}
+	}
+	impl->mix.mem = m;
+	impl->mix.buffers = bufs;
+	impl->mix.n_buffers = n_link + n_buffers;
+
+	mixer->buffers = bufs;
+	mixer->n_buffers = n_link + n_buffers;
+	mixer->base = n_link;
+	mixer->link_buffers = n_link > 0 ? buffers : NULL;
+	mixer->free = n_buffers == 64 ? ~0ULL : (1ULL << n_buffers) - 1;
+
+	return 0;
+}
+
 int pw_port_use_buffers(struct pw_port *port, struct spa_buffer **buffers, uint32_t n_buffers)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	int res;
 	struct pw_node *node = port->node;
+	struct allocation old_mix;
+	struct mixer mixer = { 0, };
+	uint32_t max_buffers, n_link, n_mix;
 
 	if (n_buffers == 0 && port->state <= PW_PORT_STATE_READY)
 		return 0;
@@ -693,17 +1372,46 @@ int pw_port_use_buffers(struct pw_port *port, struct spa_buffer **buffers, uint3
 	if (n_buffers > 0 && port->state < PW_PORT_STATE_READY)
 		return -EIO;
 
+	old_mix = impl->mix;
+	spa_zero(impl->mix);
+
+	if (n_buffers > 0 && port->direction == PW_DIRECTION_INPUT &&
+	    impl->mix_format < FMT_MAX) {
+		/* when the node has room for them, it also gets the buffers of
+		 * the link so that a single link is not copied */
+		max_buffers = get_max_buffers(impl);
+		n_link = max_buffers > n_buffers ? n_buffers : 0;
+		n_mix = n_link > 0 ? SPA_MIN(n_buffers, max_buffers - n_link) : n_buffers;
+
+		if ((res = alloc_mix_buffers(impl, buffers, n_mix, n_link, &mixer)) < 0) {
+			pw_log_warn("port %p: can't allocate mix buffers, links will not be mixed: %s",
+					port, spa_strerror(res));
+		} else {
+			buffers = mixer.buffers;
+			n_buffers = mixer.n_buffers;
+		}
+	}
+
+	/* the data thread switches to the new buffers before the old ones
+	 * are freed */
+	if (mixer.n_buffers > 0 || old_mix.n_buffers > 0)
+		set_mixer(impl, &mixer);
+
 	res = spa_node_port_use_buffers(node->node, port->direction, port->port_id, buffers, n_buffers);
 	pw_log_debug("port %p: use %d buffers: %d (%s)", port, n_buffers, res, spa_strerror(res));
 
 	port->allocated = false;
 
 	free_allocation(&port->allocation);
+	free_allocation(&old_mix);
 
 	if (res < 0) {
+		clear_mixer(impl);
 		n_buffers = 0;
 		buffers = NULL;
 	}
+	port->buffers = buffers;
+	port->n_buffers = n_buffers;
 
 	if (n_buffers == 0)
 		port_update_state (port, PW_PORT_STATE_READY);
@@ -717,6 +1425,7 @@ int pw_port_alloc_buffers(struct pw_port *port,
 			  struct spa_pod **params, uint32_t n_params,
 			  struct spa_buffer **buffers, uint32_t *n_buffers)
 {
+	struct impl *impl = SPA_CONTAINER_OF(port, struct impl, this);
 	int res;
 	struct pw_node *node = port->node;
 
@@ -728,18 +1437,22 @@ int pw_port_alloc_buffers(struct pw_port *port,
 					  buffers, n_buffers);
 	pw_log_debug("port %p: alloc %d buffers: %d (%s)", port, *n_buffers, res, spa_strerror(res));
 
+	/* the node owns the buffers, links can't be mixed into them */
 	free_allocation(&port->allocation);
+	clear_mixer(impl);
 
 	if (res < 0) {
-		n_buffers = 0;
-		buffers = NULL;
+		port->buffers = NULL;
+		port->n_buffers = 0;
 		port->allocated = false;
 	}
 	else {
+		port->buffers = buffers;
+		port->n_buffers = *n_buffers;
 		port->allocated = true;
 	}
 
-	if (n_buffers == 0)
+	if (port->n_buffers == 0)
 		port_update_state (port, PW_PORT_STATE_READY);
 	else if (!SPA_RESULT_IS_ASYNC(res))
 		port_update_state (port, PW_PORT_STATE_PAUSED);
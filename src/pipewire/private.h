@@ -152,6 +152,7 @@ struct pw_global {
 #define pw_core_events_info_changed(c,i)	pw_core_events_emit(c, info_changed, 0, i)
 #define pw_core_events_global_added(c,g)	pw_core_events_emit(c, global_added, 0, g)
 #define pw_core_events_global_removed(c,g)	pw_core_events_emit(c, global_removed, 0, g)
+#define pw_core_events_quantum_changed(c,q)	pw_core_events_emit(c, quantum_changed, 0, q)
 
 struct pw_core {
 	struct pw_global *global;	/**< the global of the core */
@@ -192,6 +193,9 @@ struct pw_core {
 
 	long sc_pagesize;
 
+	uint32_t default_quantum;	/**< quantum when no node requests a latency */
+	uint32_t quantum;		/**< frames processed in one cycle of the graph */
+
 	struct {
 		struct spa_graph graph;
 	} rt;
@@ -209,8 +213,63 @@ struct pw_data_loop {
 
         bool running;
         pthread_t thread;
+
+	uint64_t busy_poll;		/**< max time to spin before a cycle, ns */
+	struct spa_list activation_list;	/**< watched activations, data thread */
 };
 
+int pw_data_loop_get_numa_node(struct pw_data_loop *loop);
+
+struct pw_client_node_activation;
+
+/** An activation record of a node that the data loop spins on when it
+ * busy polls */
+struct pw_data_loop_activation {
+	struct spa_list link;
+	struct pw_client_node_activation *activation;
+	uint32_t triggered;		/**< the last seen triggered count */
+};
+
+void pw_data_loop_add_activation(struct pw_data_loop *loop,
+				 struct pw_data_loop_activation *activation);
+
+void pw_data_loop_remove_activation(struct pw_data_loop *loop,
+				    struct pw_data_loop_activation *activation);
+
+struct pw_worker_pool;
+
+struct pw_worker_pool *pw_worker_pool_new(uint32_t n_workers);
+
+void pw_worker_pool_destroy(struct pw_worker_pool *pool);
+
+void pw_worker_pool_process(struct pw_worker_pool *pool, enum spa_direction direction,
+			    struct spa_graph_node **nodes, uint32_t n_nodes);
+
+struct pw_client_node_transport;
+struct pw_client_node_link;
+
+/** The client nodes that a node activates directly, shared between remote
+ * nodes and streams */
+struct pw_client_node_peers {
+	struct pw_loop *data_loop;
+	struct spa_list list;		/**< peers, main thread */
+	struct spa_list rt_list;	/**< peers, data thread */
+};
+
+void pw_client_node_peers_init(struct pw_client_node_peers *peers, struct pw_loop *data_loop);
+
+void pw_client_node_peers_clear(struct pw_client_node_peers *peers);
+
+void pw_client_node_peers_set(struct pw_client_node_peers *peers,
+			      uint32_t node_id,
+			      int signalfd,
+			      struct pw_client_node_transport *transport,
+			      uint32_t n_links,
+			      const struct pw_client_node_link *links);
+
+bool pw_client_node_peers_activate(struct pw_client_node_peers *peers,
+				   struct pw_client_node_transport *trans);
+
 #define pw_main_loop_events_emit(o,m,v,...) spa_hook_list_call(&o->listener_list, struct pw_main_loop_events, m, v, ##__VA_ARGS__)
 #define pw_main_loop_events_destroy(o) pw_main_loop_events_emit(o, destroy, 0)
 
@@ -269,6 +328,7 @@ struct pw_link {
 	struct spa_list resource_list;	/**< list of bound resources */
 
 	struct spa_io_buffers io;	/**< link io area */
+	float gain;			/**< gain applied when mixing */
 
 	struct pw_port *output;		/**< output port */
 	struct spa_list output_link;	/**< link in output port links */
@@ -337,6 +397,7 @@ struct pw_node {
 	bool enabled;			/**< if the node is enabled */
 	bool active;			/**< if the node is active */
 	bool live;			/**< if the node is live */
+	uint32_t latency;		/**< requested latency in frames or 0 */
 	struct spa_clock *clock;	/**< handle to SPA clock if any */
 	struct spa_node *node;		/**< SPA node implementation */
 
@@ -398,6 +459,9 @@ struct pw_port {
 	bool allocated;			/**< if buffers are allocated */
 	struct allocation allocation;
 
+	struct spa_buffer **buffers;	/**< buffers in use on the port */
+	uint32_t n_buffers;		/**< number of buffers in use */
+
 	struct spa_list links;		/**< list of \ref pw_link */
 
 	struct spa_list control_list[2];	/**< list of \ref pw_control indexed by direction */
@@ -585,6 +649,9 @@ int pw_core_find_format(struct pw_core *core,
 			struct spa_pod_builder *builder,
 			char **error);
 
+/** Recalculate the quantum of the graph from the latency of the nodes */
+void pw_core_update_quantum(struct pw_core *core);
+
 /** Find a ports compatible with \a other_port and the format filters */
 struct pw_port *
 pw_core_find_port(struct pw_core *core,
@@ -641,6 +708,14 @@ int pw_port_for_each_filtered_param(struct pw_port *in_port,
 						     struct spa_pod *param),
 				    void *data);
 
+/** Enumerate params of a port from a cache \memberof pw_port */
+int pw_port_enum_params_cached(struct pw_port *port, uint32_t id, uint32_t *index,
+			       const struct spa_pod *filter, struct spa_pod **param,
+			       struct spa_pod_builder *builder);
+
+/** Forget the cached params of a port \memberof pw_port */
+void pw_port_clear_param_cache(struct pw_port *port);
+
 /** Set a param on a port \memberof pw_port */
 int pw_port_set_param(struct pw_port *port, uint32_t id, uint32_t flags,
 		      const struct spa_pod *param);
@@ -664,6 +739,12 @@ void pw_node_update_state(struct pw_node *node, enum pw_node_state state, char *
 
 int pw_node_update_ports(struct pw_node *node);
 
+/** Forget the cached params of all ports of the node */
+void pw_node_clear_param_cache(struct pw_node *node);
+
+/** Configure the quantum of the graph on the node */
+int pw_node_set_quantum(struct pw_node *node, uint32_t quantum);
+
 /** Activate a link \memberof pw_link
   * Starts the negotiation of formats and buffers on \a link and then
   * starts data streaming */
@@ -22,6 +22,7 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <sys/mman.h>
 
 #include <spa/pod/parser.h>
@@ -84,6 +85,14 @@ struct node_data {
 	struct spa_source *rtsocket_source;
         struct pw_client_node_transport *trans;
 
+	bool in_cycle;			/* batch the wakeups of the server in a cycle */
+	bool need_wakeup;
+	uint64_t n_events;		/* number of events for the server */
+	uint64_t n_wakeups;		/* number of wakeups of the server */
+
+	struct pw_client_node_peers peers;
+	struct pw_data_loop_activation activation;
+
 	struct spa_node out_node_impl;
 	struct spa_graph_node out_node;
 	struct port *out_ports;
@@ -467,6 +476,7 @@ do_remove_source(struct spa_loop *loop,
 	struct node_data *d = user_data;
 
 	if (d->rtsocket_source) {
+		pw_data_loop_remove_activation(d->core->data_loop_impl, &d->activation);
 		pw_loop_destroy_source(d->core->data_loop, d->rtsocket_source);
 		d->rtsocket_source = NULL;
 	}
@@ -482,21 +492,31 @@ static void unhandle_socket(struct pw_proxy *proxy)
                        do_remove_source, 1, NULL, 0, true, data);
 }
 
+static void do_wakeup(struct node_data *data)
+{
+	uint64_t cmd = 1;
+
+	data->n_wakeups++;
+	if (write(data->rtwritefd, &cmd, 8) != 8)
+		pw_log_warn("remote %p: failed to wake up server: %m", data->remote);
+}
+
+/* wake up the server, when handling a wakeup of the server this is done once
+ * at the end so that all the events of the cycle are handled together */
+static void wakeup_server(struct node_data *data)
+{
+	data->n_events++;
+	if (data->in_cycle)
+		data->need_wakeup = true;
+	else
+		do_wakeup(data);
+}
+
 static void handle_rtnode_message(struct pw_proxy *proxy, struct pw_client_node_message *message)
 {
 	struct node_data *data = proxy->user_data;
 
 	switch (PW_CLIENT_NODE_MESSAGE_TYPE(message)) {
-	case PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT:
-		pw_log_trace("remote %p: process input", data->remote);
-		spa_graph_have_output(data->node->rt.graph, &data->in_node);
-		break;
-
-	case PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT:
-		pw_log_trace("remote %p: process output", data->remote);
-		spa_graph_need_input(data->node->rt.graph, &data->out_node);
-		break;
-
 	case PW_CLIENT_NODE_MESSAGE_PORT_REUSE_BUFFER:
 	{
 		struct pw_client_node_message_port_reuse_buffer *rb =
@@ -536,10 +556,13 @@ on_rtsocket_condition(void *user_data, int fd, enum spa_io mask)
 	if (mask & SPA_IO_IN) {
 		struct pw_client_node_message message;
 		uint64_t cmd;
+		uint32_t pending;
 
 		if (read(fd, &cmd, sizeof(uint64_t)) != sizeof(uint64_t))
 			pw_log_warn("proxy %p: read failed %m", proxy);
 
+		data->in_cycle = true;
+
 		if (cmd > 1)
 			pw_log_warn("proxy %p: %ld messages", proxy, cmd);
 
@@ -549,6 +572,28 @@ on_rtsocket_condition(void *user_data, int fd, enum spa_io mask)
 			pw_client_node_transport_parse_message(data->trans, msg);
 			handle_rtnode_message(proxy, msg);
 		}
+
+		pending = pw_client_node_transport_take_pending(data->trans);
+		if (pending & PW_CLIENT_NODE_PENDING_PROCESS_INPUT) {
+			pw_log_trace("remote %p: process input", data->remote);
+			spa_graph_have_output(data->node->rt.graph, &data->in_node);
+		}
+		if (pending & PW_CLIENT_NODE_PENDING_PROCESS_OUTPUT) {
+			pw_log_trace("remote %p: process output", data->remote);
+			spa_graph_need_input(data->node->rt.graph, &data->out_node);
+		}
+
+		if (pw_client_node_activation_awake(data->trans->activation,
+						    pw_client_node_activation_get_time())) {
+			pw_log_trace("remote %p: activated by peers", data->remote);
+			spa_graph_have_output(data->node->rt.graph, &data->in_node);
+		}
+
+		data->in_cycle = false;
+		if (data->need_wakeup) {
+			data->need_wakeup = false;
+			do_wakeup(data);
+		}
 	}
 }
 
@@ -622,6 +667,10 @@ static void clean_transport(struct pw_proxy *proxy)
 		return;
 
 	unhandle_socket(proxy);
+	pw_client_node_peers_clear(&data->peers);
+
+	pw_log_debug("remote-node %p: %" PRIu64 " events in %" PRIu64 " wakeups", proxy,
+		     data->n_events, data->n_wakeups);
 
 	spa_list_for_each(port, &data->node->input_ports, link) {
 		spa_graph_port_remove(&data->in_ports[port->port_id].output);
@@ -762,6 +811,8 @@ static void client_node_transport(void *object, uint32_t node_id,
                                                readfd,
                                                SPA_IO_ERR | SPA_IO_HUP,
                                                true, on_rtsocket_condition, proxy);
+	data->activation.activation = data->trans->activation;
+	pw_data_loop_add_activation(data->core->data_loop_impl, &data->activation);
 	if (data->node->active)
 		pw_client_node_proxy_set_active(data->node_proxy, true);
 }
@@ -829,7 +880,14 @@ static void
 client_node_set_param(void *object, uint32_t seq, uint32_t id, uint32_t flags,
 		      const struct spa_pod *param)
 {
-	pw_log_warn("set param not implemented");
+	struct pw_proxy *proxy = object;
+	struct node_data *data = proxy->user_data;
+	int res;
+
+	if ((res = spa_node_set_param(data->node->node, id, flags, param)) < 0)
+		pw_log_debug("node %p: set param failed: %s", proxy, spa_strerror(res));
+
+	pw_client_node_proxy_done(data->node_proxy, seq, res);
 }
 
 static void client_node_event(void *object, const struct spa_event *event)
@@ -841,19 +899,25 @@ static void client_node_event(void *object, const struct spa_event *event)
 static void node_need_input(void *data)
 {
 	struct node_data *d = data;
-        uint64_t cmd = 1;
-	pw_client_node_transport_add_message(d->trans,
-				&PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_NEED_INPUT));
-        write(d->rtwritefd, &cmd, 8);
+	pw_client_node_activation_finish(d->trans->activation,
+					 pw_client_node_activation_get_time());
+	pw_client_node_transport_signal(d->trans, PW_CLIENT_NODE_PENDING_NEED_INPUT);
+	wakeup_server(d);
 }
 
 static void node_have_output(void *data)
 {
 	struct node_data *d = data;
-        uint64_t cmd = 1;
-        pw_client_node_transport_add_message(d->trans,
-                               &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT));
-        write(d->rtwritefd, &cmd, 8);
+	bool direct;
+
+	pw_client_node_activation_finish(d->trans->activation,
+					 pw_client_node_activation_get_time());
+	/* the peers are activated before the server sees our output, the
+	 * server handles our messages when the peers wake it up */
+	direct = pw_client_node_peers_activate(&d->peers, d->trans);
+	pw_client_node_transport_signal(d->trans, PW_CLIENT_NODE_PENDING_HAVE_OUTPUT);
+	if (!direct)
+		wakeup_server(d);
 }
 
 static void client_node_command(void *object, uint32_t seq, const struct spa_command *command)
@@ -1195,6 +1259,21 @@ client_node_port_set_io(void *object,
 }
 
 
+static void client_node_set_activation(void *object,
+				       uint32_t node_id,
+				       int signalfd,
+				       struct pw_client_node_transport *transport,
+				       uint32_t n_links,
+				       const struct pw_client_node_link *links)
+{
+	struct pw_proxy *proxy = object;
+	struct node_data *data = proxy->user_data;
+
+	pw_log_debug("remote-node %p: activate node %u with %d links", proxy, node_id, n_links);
+
+	pw_client_node_peers_set(&data->peers, node_id, signalfd, transport, n_links, links);
+}
+
 static const struct pw_client_node_proxy_events client_node_events = {
 	PW_VERSION_CLIENT_NODE_PROXY_EVENTS,
 	.add_mem = client_node_add_mem,
@@ -1208,6 +1287,7 @@ static const struct pw_client_node_proxy_events client_node_events = {
 	.port_use_buffers = client_node_port_use_buffers,
 	.port_command = client_node_port_command,
 	.port_set_io = client_node_port_set_io,
+	.set_activation = client_node_set_activation,
 };
 
 static void do_node_init(struct pw_proxy *proxy)
@@ -1346,6 +1426,8 @@ struct pw_proxy *pw_remote_export(struct pw_remote *remote,
         pw_array_init(&data->mem_ids, 64);
         pw_array_ensure_size(&data->mem_ids, sizeof(struct mem_id) * 64);
 
+	pw_client_node_peers_init(&data->peers, data->core->data_loop);
+
 	spa_graph_node_init(&data->in_node);
 	spa_graph_node_set_implementation(&data->in_node, &data->in_node_impl);
 	spa_graph_node_init(&data->out_node);
@@ -23,8 +23,9 @@
 #include <sys/mman.h>
 #include <errno.h>
 #include <time.h>
+#include <inttypes.h>
 
-#include "spa/utils/ringbuffer.h"
+#include "spa/utils/spsc-ringbuffer.h"
 
 #include "pipewire/pipewire.h"
 #include "pipewire/private.h"
@@ -65,7 +66,7 @@ struct buffer {
 
 struct queue {
 	uint32_t ids[MAX_BUFFERS];
-	struct spa_ringbuffer ring;
+	struct spa_spsc_ringbuffer ring;
 	uint64_t incount;
 	uint64_t outcount;
 };
@@ -92,6 +93,11 @@ struct stream {
 
 	int rtwritefd;
 	struct spa_source *rtsocket_source;
+#define FLUSH_IN_CYCLE	(1 << 0)
+#define FLUSH_PENDING	(1 << 1)
+	uint32_t flush;			/* batches the wakeups of a cycle */
+	uint64_t n_events;		/* number of events for the server */
+	uint64_t n_wakeups;		/* number of wakeups of the server */
 
 	struct pw_client_node_proxy *node_proxy;
 	bool disconnecting;
@@ -100,6 +106,9 @@ struct stream {
 
 	struct pw_client_node_transport *trans;
 
+	struct pw_client_node_peers peers;
+	struct pw_data_loop_activation activation;
+
 	struct spa_source *timeout_source;
 
 	struct pw_array mem_ids;
@@ -253,25 +262,28 @@ static void clear_buffers(struct pw_stream *stream)
 		b->buffer.buffer = NULL;
 	}
 	impl->n_buffers = 0;
-	spa_ringbuffer_init(&impl->queue.ring);
-	spa_ringbuffer_init(&impl->dequeue.ring);
+	spa_spsc_ringbuffer_init(&impl->queue.ring);
+	spa_spsc_ringbuffer_init(&impl->dequeue.ring);
 
 }
 
 static inline int push_queue(struct stream *stream, struct queue *queue, struct buffer *buffer)
 {
 	uint32_t index;
-	int32_t filled;
+	int32_t avail, filled;
 
 	if (SPA_FLAG_CHECK(buffer->flags, BUFFER_FLAG_QUEUED))
 		return -EINVAL;
 
+	if ((avail = spa_spsc_ringbuffer_write_reserve(&queue->ring, MAX_BUFFERS, 1, &index)) < 0)
+		return avail;
+
 	SPA_FLAG_SET(buffer->flags, BUFFER_FLAG_QUEUED);
 	queue->incount += buffer->buffer.size;
 
-	filled = spa_ringbuffer_get_write_index(&queue->ring, &index);
 	queue->ids[index & MASK_BUFFERS] = buffer->id;
-	spa_ringbuffer_write_update(&queue->ring, index + 1);
+	spa_spsc_ringbuffer_write_commit(&queue->ring, index + 1);
+	filled = MAX_BUFFERS - avail;
 
 	pw_log_trace("stream %p: queued buffer %d %d", stream, buffer->id, filled);
 
@@ -284,11 +296,11 @@ static inline struct buffer *pop_queue(struct stream *stream, struct queue *queu
 	uint32_t index, id;
 	struct buffer *buffer;
 
-	if ((avail = spa_ringbuffer_get_read_index(&queue->ring, &index)) < MIN_QUEUED)
+	if ((avail = spa_spsc_ringbuffer_read_peek(&queue->ring, MIN_QUEUED, &index)) < MIN_QUEUED)
 		return NULL;
 
 	id = queue->ids[index & MASK_BUFFERS];
-	spa_ringbuffer_read_update(&queue->ring, index + 1);
+	spa_spsc_ringbuffer_read_release(&queue->ring, index + 1);
 
 	buffer = &stream->buffers[id];
 	queue->outcount += buffer->buffer.size;
@@ -398,6 +410,7 @@ struct pw_stream *pw_stream_new(struct pw_remote *remote,
 	this->name = strdup(name);
 	impl->type_client_node = spa_type_map_get_id(remote->core->type.map, PW_TYPE_INTERFACE__ClientNode);
 	impl->rtwritefd = -1;
+	pw_client_node_peers_init(&impl->peers, remote->core->data_loop);
 
 	str = pw_properties_get(props, "pipewire.client.reuse");
 	impl->client_reuse = str && pw_properties_parse_bool(str);
@@ -411,8 +424,8 @@ struct pw_stream *pw_stream_new(struct pw_remote *remote,
 
 	impl->pending_seq = SPA_ID_INVALID;
 
-	spa_ringbuffer_init(&impl->queue.ring);
-	spa_ringbuffer_init(&impl->dequeue.ring);
+	spa_spsc_ringbuffer_init(&impl->queue.ring);
+	spa_spsc_ringbuffer_init(&impl->dequeue.ring);
 
 	spa_list_append(&remote->stream_list, &this->link);
 
@@ -463,6 +476,8 @@ do_remove_sources(struct spa_loop *loop,
 	struct pw_stream *stream = &impl->this;
 
 	if (impl->rtsocket_source) {
+		pw_data_loop_remove_activation(stream->remote->core->data_loop_impl,
+					       &impl->activation);
 		pw_loop_destroy_source(stream->remote->core->data_loop, impl->rtsocket_source);
 		impl->rtsocket_source = NULL;
 	}
@@ -483,6 +498,9 @@ static void unhandle_socket(struct pw_stream *stream)
 	}
         pw_loop_invoke(stream->remote->core->data_loop,
                        do_remove_sources, 1, NULL, 0, true, impl);
+
+	pw_log_debug("stream %p: %" PRIu64 " events in %" PRIu64 " wakeups", stream,
+		     impl->n_events, impl->n_wakeups);
 }
 
 static void
@@ -597,37 +615,76 @@ static void add_port_update(struct pw_stream *stream, uint32_t change_mask)
 					 &impl->port_info);
 }
 
+static inline void do_wakeup(struct stream *impl)
+{
+	uint64_t cmd = 1;
+
+	__atomic_fetch_add(&impl->n_wakeups, 1, __ATOMIC_RELAXED);
+	if (write(impl->rtwritefd, &cmd, 8) != 8)
+		pw_log_warn("stream %p: failed to wake up server: %m", impl);
+}
+
+/* Wake up the server. In a cycle of the data thread, the events are
+ * collected and the server is woken up once at the end of the cycle. */
+static inline void wakeup_server(struct stream *impl)
+{
+	uint32_t flush = __atomic_load_n(&impl->flush, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&impl->n_events, 1, __ATOMIC_RELAXED);
+	do {
+		if (!(flush & FLUSH_IN_CYCLE)) {
+			do_wakeup(impl);
+			return;
+		}
+	} while (!__atomic_compare_exchange_n(&impl->flush, &flush, flush | FLUSH_PENDING,
+					      false, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+static inline void begin_cycle(struct stream *impl)
+{
+	__atomic_store_n(&impl->flush, FLUSH_IN_CYCLE, __ATOMIC_RELAXED);
+}
+
+static inline void end_cycle(struct stream *impl)
+{
+	if (__atomic_exchange_n(&impl->flush, 0, __ATOMIC_ACQUIRE) & FLUSH_PENDING)
+		do_wakeup(impl);
+}
+
 static inline void send_need_input(struct pw_stream *stream)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	uint64_t cmd = 1;
 
 	pw_log_trace("send");
-	pw_client_node_transport_add_message(impl->trans,
-			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_NEED_INPUT));
-	write(impl->rtwritefd, &cmd, 8);
+	pw_client_node_activation_finish(impl->trans->activation,
+					 pw_client_node_activation_get_time());
+	pw_client_node_transport_signal(impl->trans, PW_CLIENT_NODE_PENDING_NEED_INPUT);
+	wakeup_server(impl);
 }
 
 static inline void send_have_output(struct pw_stream *stream)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	uint64_t cmd = 1;
+	bool direct;
 
 	pw_log_trace("send");
-	pw_client_node_transport_add_message(impl->trans,
-			       &PW_CLIENT_NODE_MESSAGE_INIT(PW_CLIENT_NODE_MESSAGE_HAVE_OUTPUT));
-	write(impl->rtwritefd, &cmd, 8);
+	pw_client_node_activation_finish(impl->trans->activation,
+					 pw_client_node_activation_get_time());
+	/* the server handles our output when the peers wake it up */
+	direct = pw_client_node_peers_activate(&impl->peers, impl->trans);
+	pw_client_node_transport_signal(impl->trans, PW_CLIENT_NODE_PENDING_HAVE_OUTPUT);
+	if (!direct)
+		wakeup_server(impl);
 }
 
 static inline void send_reuse_buffer(struct pw_stream *stream, uint32_t id)
 {
 	struct stream *impl = SPA_CONTAINER_OF(stream, struct stream, this);
-	uint64_t cmd = 1;
 
 	pw_log_trace("send");
 	pw_client_node_transport_add_message(impl->trans, (struct pw_client_node_message*)
 			       &PW_CLIENT_NODE_MESSAGE_PORT_REUSE_BUFFER_INIT(impl->port_id, id));
-	write(impl->rtwritefd, &cmd, 8);
+	wakeup_server(impl);
 }
 
 static void add_async_complete(struct pw_stream *stream, uint32_t seq, int res)
@@ -754,7 +811,7 @@ static int process_output(struct pw_stream *stream)
 
 		if (!SPA_FLAG_CHECK(impl->flags, PW_STREAM_FLAG_DRIVER)) {
 			call_process(impl);
-			if (spa_ringbuffer_get_read_index(&impl->queue.ring, &index) >= MIN_QUEUED &&
+			if (spa_spsc_ringbuffer_read_peek(&impl->queue.ring, MIN_QUEUED, &index) >= MIN_QUEUED &&
 			    io->status == SPA_STATUS_NEED_BUFFER)
 				goto again;
 		}
@@ -771,16 +828,6 @@ static void handle_rtnode_message(struct pw_stream *stream, struct pw_client_nod
 	pw_log_trace("stream %p: %d", stream, PW_CLIENT_NODE_MESSAGE_TYPE(message));
 
 	switch (PW_CLIENT_NODE_MESSAGE_TYPE(message)) {
-	case PW_CLIENT_NODE_MESSAGE_PROCESS_INPUT:
-		if (process_input(stream) == SPA_STATUS_NEED_BUFFER)
-			send_need_input(stream);
-		break;
-
-	case PW_CLIENT_NODE_MESSAGE_PROCESS_OUTPUT:
-		if (process_output(stream) == SPA_STATUS_HAVE_BUFFER)
-			send_have_output(stream);
-		break;
-
 	case PW_CLIENT_NODE_MESSAGE_PORT_REUSE_BUFFER:
 	{
 		struct pw_client_node_message_port_reuse_buffer *p =
@@ -816,15 +863,37 @@ on_rtsocket_condition(void *data, int fd, enum spa_io mask)
 	if (mask & SPA_IO_IN) {
 		struct pw_client_node_message message;
 		uint64_t cmd;
+		uint32_t pending;
 
 		if (read(fd, &cmd, sizeof(uint64_t)) != sizeof(uint64_t))
 			pw_log_warn("stream %p: read failed %m", impl);
 
+		begin_cycle(impl);
+
 		while (pw_client_node_transport_next_message(impl->trans, &message) == 1) {
 			struct pw_client_node_message *msg = alloca(SPA_POD_SIZE(&message));
 			pw_client_node_transport_parse_message(impl->trans, msg);
 			handle_rtnode_message(stream, msg);
 		}
+
+		pending = pw_client_node_transport_take_pending(impl->trans);
+		if (pending & PW_CLIENT_NODE_PENDING_PROCESS_INPUT) {
+			if (process_input(stream) == SPA_STATUS_NEED_BUFFER)
+				send_need_input(stream);
+		}
+		if (pending & PW_CLIENT_NODE_PENDING_PROCESS_OUTPUT) {
+			if (process_output(stream) == SPA_STATUS_HAVE_BUFFER)
+				send_have_output(stream);
+		}
+
+		if (pw_client_node_activation_awake(impl->trans->activation,
+						    pw_client_node_activation_get_time())) {
+			pw_log_trace("stream %p: activated by peers", stream);
+			if (process_input(stream) == SPA_STATUS_NEED_BUFFER)
+				send_need_input(stream);
+		}
+
+		end_cycle(impl);
 	}
 }
 
@@ -838,6 +907,8 @@ static void handle_socket(struct pw_stream *stream, int rtreadfd, int rtwritefd)
 					       rtreadfd,
 					       SPA_IO_ERR | SPA_IO_HUP,
 					       true, on_rtsocket_condition, stream);
+	impl->activation.activation = impl->trans->activation;
+	pw_data_loop_add_activation(stream->remote->core->data_loop_impl, &impl->activation);
 
 	impl->timeout_source = pw_loop_add_timer(stream->remote->core->main_loop, on_timeout, stream);
 	interval.tv_sec = 0;
@@ -851,7 +922,13 @@ static void
 client_node_set_param(void *data, uint32_t seq, uint32_t id, uint32_t flags,
 		      const struct spa_pod *param)
 {
-	pw_log_warn("set param not implemented");
+	struct stream *impl = data;
+
+	/* streams have no node params, the application picks the size of the
+	 * buffers. This also rejects the quantum of the graph, the server
+	 * handles -ENOTSUP as a node that doesn't follow the quantum. */
+	pw_log_debug("stream %p: set param %d not supported", &impl->this, id);
+	add_async_complete(&impl->this, seq, -ENOTSUP);
 }
 
 static void client_node_event(void *data, const struct spa_event *event)
@@ -970,8 +1047,10 @@ client_node_port_set_param(void *data,
 		else
 			stream_set_state(stream, PW_STREAM_STATE_CONFIGURE, NULL);
 	}
-	else
+	else {
 		pw_log_warn("set param not implemented");
+		add_async_complete(stream, seq, -ENOTSUP);
+	}
 }
 
 static void
@@ -1149,6 +1228,7 @@ static void client_node_transport(void *data, uint32_t node_id,
 
 	stream->node_id = node_id;
 
+	pw_client_node_peers_clear(&impl->peers);
 	if (impl->trans)
 		pw_client_node_transport_destroy(impl->trans);
 	impl->trans = transport;
@@ -1205,6 +1285,20 @@ static void client_node_port_set_io(void *data,
 	add_async_complete(stream, seq, res);
 }
 
+static void client_node_set_activation(void *data,
+				       uint32_t node_id,
+				       int signalfd,
+				       struct pw_client_node_transport *transport,
+				       uint32_t n_links,
+				       const struct pw_client_node_link *links)
+{
+	struct stream *impl = data;
+
+	pw_log_debug("stream %p: activate node %u with %d links", impl, node_id, n_links);
+
+	pw_client_node_peers_set(&impl->peers, node_id, signalfd, transport, n_links, links);
+}
+
 static const struct pw_client_node_proxy_events client_node_events = {
 	PW_VERSION_CLIENT_NODE_PROXY_EVENTS,
 	.add_mem = client_node_add_mem,
@@ -1218,6 +1312,7 @@ static const struct pw_client_node_proxy_events client_node_events = {
 	.port_use_buffers = client_node_port_use_buffers,
 	.port_command = client_node_port_command,
 	.port_set_io = client_node_port_set_io,
+	.set_activation = client_node_set_activation,
 };
 
 static void on_node_proxy_destroy(void *data)
@@ -1239,6 +1334,7 @@ static void on_node_proxy_destroy(void *data)
 		free(impl->format);
 		impl->format = NULL;
 	}
+	pw_client_node_peers_clear(&impl->peers);
 	if (impl->trans) {
 		pw_client_node_transport_destroy(impl->trans);
 		impl->trans = NULL;
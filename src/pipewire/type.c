@@ -47,6 +47,7 @@ int pw_type_init(struct pw_type *type)
 	type->link = spa_type_map_get_id(type->map, PW_TYPE_INTERFACE__Link);
 	type->client = spa_type_map_get_id(type->map, PW_TYPE_INTERFACE__Client);
 	type->module = spa_type_map_get_id(type->map, PW_TYPE_INTERFACE__Module);
+	type->profiler = spa_type_map_get_id(type->map, PW_TYPE_INTERFACE__Profiler);
 
 	type->spa_log = spa_type_map_get_id(type->map, SPA_TYPE__Log);
 	type->spa_node = spa_type_map_get_id(type->map, SPA_TYPE__Node);
@@ -59,6 +59,7 @@ struct pw_type {
 	uint32_t link;
 	uint32_t client;
 	uint32_t module;
+	uint32_t profiler;
 
 	uint32_t spa_log;
 	uint32_t spa_node;
@@ -0,0 +1,224 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "pipewire/log.h"
+#include "pipewire/private.h"
+
+/** \cond */
+struct worker {
+	struct pw_worker_pool *pool;
+	pthread_t thread;
+	sem_t wakeup;
+};
+
+struct pw_worker_pool {
+	uint32_t n_workers;
+	struct worker *workers;
+
+	bool running;
+	int policy;
+	struct sched_param param;
+
+	/* the current batch, the upper 32 bits of work hold the number of
+	 * nodes and the lower 32 bits the index of the next node to process */
+	enum spa_direction direction;
+	struct spa_graph_node **nodes;
+	uint64_t work;
+	uint32_t remaining;
+	sem_t done;
+};
+/** \endcond */
+
+/* process nodes from the current batch until there are no more left, returns
+ * true when the caller processed the last node of the batch */
+static bool process_batch(struct pw_worker_pool *pool)
+{
+	bool last = false;
+
+	while (true) {
+		uint64_t work = __atomic_fetch_add(&pool->work, 1, __ATOMIC_ACQUIRE);
+		uint32_t index = work & 0xffffffff, n_nodes = work >> 32;
+
+		if (index >= n_nodes)
+			break;
+
+		spa_graph_node_process(pool->nodes[index], pool->direction);
+
+		if (__atomic_sub_fetch(&pool->remaining, 1, __ATOMIC_ACQ_REL) == 0)
+			last = true;
+	}
+	return last;
+}
+
+static void *do_work(void *user_data)
+{
+	struct worker *w = user_data;
+	struct pw_worker_pool *pool = w->pool;
+
+	pw_log_debug("worker-pool %p: worker %p enter thread", pool, w);
+
+	while (true) {
+		while (sem_wait(&w->wakeup) < 0 && errno == EINTR);
+
+		if (!__atomic_load_n(&pool->running, __ATOMIC_ACQUIRE))
+			break;
+
+		if (process_batch(pool))
+			sem_post(&pool->done);
+	}
+	pw_log_debug("worker-pool %p: worker %p leave thread", pool, w);
+
+	return NULL;
+}
+
+/** Create a new worker pool
+ * \param n_workers the number of worker threads
+ * \return a newly allocated worker pool
+ *
+ * The worker pool processes batches of independent graph nodes in parallel.
+ * The thread that submits a batch also processes nodes and waits until
+ * all nodes in the batch are done.
+ */
+struct pw_worker_pool *pw_worker_pool_new(uint32_t n_workers)
+{
+	struct pw_worker_pool *this;
+	uint32_t i;
+	int err;
+
+	this = calloc(1, sizeof(struct pw_worker_pool));
+	if (this == NULL)
+		return NULL;
+
+	pw_log_debug("worker-pool %p: new %d workers", this, n_workers);
+
+	this->workers = calloc(n_workers, sizeof(struct worker));
+	if (this->workers == NULL)
+		goto no_mem;
+
+	this->policy = SCHED_OTHER;
+	this->running = true;
+	sem_init(&this->done, 0, 0);
+
+	for (i = 0; i < n_workers; i++) {
+		struct worker *w = &this->workers[i];
+
+		w->pool = this;
+		sem_init(&w->wakeup, 0, 0);
+		if ((err = pthread_create(&w->thread, NULL, do_work, w)) != 0) {
+			pw_log_warn("worker-pool %p: can't create thread: %s", this, strerror(err));
+			sem_destroy(&w->wakeup);
+			break;
+		}
+		this->n_workers++;
+	}
+	return this;
+
+      no_mem:
+	free(this);
+	return NULL;
+}
+
+/** Destroy a worker pool
+ * \param pool the worker pool to destroy
+ *
+ * This will stop and join all worker threads.
+ */
+void pw_worker_pool_destroy(struct pw_worker_pool *pool)
+{
+	uint32_t i;
+
+	pw_log_debug("worker-pool %p: destroy", pool);
+
+	__atomic_store_n(&pool->running, false, __ATOMIC_RELEASE);
+	for (i = 0; i < pool->n_workers; i++)
+		sem_post(&pool->workers[i].wakeup);
+
+	for (i = 0; i < pool->n_workers; i++) {
+		pthread_join(pool->workers[i].thread, NULL);
+		sem_destroy(&pool->workers[i].wakeup);
+	}
+	sem_destroy(&pool->done);
+	free(pool->workers);
+	free(pool);
+}
+
+/* give the workers the same scheduling as the thread that uses them, this is
+ * usually the realtime data thread */
+static void update_scheduling(struct pw_worker_pool *pool)
+{
+	struct sched_param param;
+	int policy, err;
+	uint32_t i;
+
+	if (pthread_getschedparam(pthread_self(), &policy, &param) != 0)
+		return;
+
+	if (policy == pool->policy && param.sched_priority == pool->param.sched_priority)
+		return;
+
+	pw_log_debug("worker-pool %p: scheduling %d:%d", pool, policy, param.sched_priority);
+
+	for (i = 0; i < pool->n_workers; i++) {
+		if ((err = pthread_setschedparam(pool->workers[i].thread, policy, &param)) != 0)
+			pw_log_warn("worker-pool %p: can't set scheduling: %s", pool, strerror(err));
+	}
+	pool->policy = policy;
+	pool->param = param;
+}
+
+/** Process a batch of nodes
+ * \param pool the worker pool
+ * \param direction SPA_DIRECTION_INPUT to call process_input, SPA_DIRECTION_OUTPUT to
+ *		call process_output on the nodes
+ * \param nodes the nodes to process, they must not be linked to each other
+ * \param n_nodes the number of nodes
+ *
+ * Wakes up the workers and processes nodes until all nodes are done.
+ */
+void pw_worker_pool_process(struct pw_worker_pool *pool, enum spa_direction direction,
+			    struct spa_graph_node **nodes, uint32_t n_nodes)
+{
+	uint32_t i, n_wakeup;
+
+	if (n_nodes == 0)
+		return;
+
+	update_scheduling(pool);
+
+	pool->direction = direction;
+	pool->nodes = nodes;
+	pool->remaining = n_nodes;
+	__atomic_store_n(&pool->work, (uint64_t) n_nodes << 32, __ATOMIC_RELEASE);
+
+	/* we process nodes as well, only wake up what is needed for the rest */
+	n_wakeup = SPA_MIN(pool->n_workers, n_nodes - 1);
+	for (i = 0; i < n_wakeup; i++)
+		sem_post(&pool->workers[i].wakeup);
+
+	if (!process_batch(pool))
+		while (sem_wait(&pool->done) < 0 && errno == EINTR);
+
+	pw_log_trace("worker-pool %p: processed %d nodes with %d workers", pool, n_nodes, n_wakeup);
+}
@@ -0,0 +1,213 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+#include <extensions/client-node.h>
+
+static int n_destroyed;
+
+/* a transport like the one a client gets for a node, without ringbuffers */
+struct test_transport {
+	struct pw_client_node_transport trans;
+	struct pw_client_node_area area;
+	struct pw_client_node_activation activation;
+	struct spa_io_buffers inputs[4];
+	struct spa_io_buffers outputs[4];
+};
+
+static void transport_destroy(struct pw_client_node_transport *trans)
+{
+	n_destroyed++;
+	free(trans);
+}
+
+static struct pw_client_node_transport *make_transport(uint32_t n_inputs, uint32_t n_outputs,
+						       int32_t required)
+{
+	struct test_transport *t;
+	uint32_t i;
+
+	spa_assert_se((t = calloc(1, sizeof(struct test_transport))) != NULL);
+	t->trans.area = &t->area;
+	t->trans.activation = &t->activation;
+	t->trans.inputs = t->inputs;
+	t->trans.outputs = t->outputs;
+	t->trans.destroy = transport_destroy;
+	t->area.max_input_ports = n_inputs;
+	t->area.max_output_ports = n_outputs;
+	t->activation.required = required;
+	t->activation.pending = required;
+	for (i = 0; i < 4; i++) {
+		t->inputs[i] = SPA_IO_BUFFERS_INIT;
+		t->outputs[i] = SPA_IO_BUFFERS_INIT;
+	}
+	return &t->trans;
+}
+
+static uint64_t read_wakeups(int fd)
+{
+	uint64_t count;
+
+	if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+		spa_assert_se(errno == EAGAIN);
+		return 0;
+	}
+	return count;
+}
+
+/* a node that activates a peer with one input and a peer with two sources */
+static void test_activate(struct pw_loop *loop)
+{
+	struct pw_client_node_peers peers;
+	struct pw_client_node_transport *trans, *single, *shared;
+	struct pw_client_node_link single_links[] = { { 0, 1 } };
+	struct pw_client_node_link shared_links[] = { { 1, 0 }, { 1, 7 } };
+	int single_fd, shared_fd;
+
+	trans = make_transport(0, 2, 0);
+	single = make_transport(2, 0, 1);
+	shared = make_transport(1, 0, 2);
+	spa_assert_se((single_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) >= 0);
+	spa_assert_se((shared_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) >= 0);
+
+	pw_client_node_peers_init(&peers, loop);
+	spa_assert_se(!pw_client_node_peers_activate(&peers, trans));
+
+	pw_client_node_peers_set(&peers, 10, dup(single_fd), single, 1, single_links);
+	pw_client_node_peers_set(&peers, 11, dup(shared_fd), shared, 2, shared_links);
+
+	trans->outputs[0].status = SPA_STATUS_HAVE_BUFFER;
+	trans->outputs[0].buffer_id = 3;
+	trans->outputs[1].status = SPA_STATUS_HAVE_BUFFER;
+	trans->outputs[1].buffer_id = 5;
+
+	spa_assert_se(pw_client_node_peers_activate(&peers, trans));
+
+	/* the io is copied to the inputs of the peers, links to ports that
+	 * the peer doesn't have are ignored */
+	spa_assert_se(single->inputs[1].status == SPA_STATUS_HAVE_BUFFER);
+	spa_assert_se(single->inputs[1].buffer_id == 3);
+	spa_assert_se(single->inputs[0].buffer_id == SPA_ID_INVALID);
+	spa_assert_se(shared->inputs[0].buffer_id == 5);
+
+	/* only the peer without other sources is woken up */
+	spa_assert_se(read_wakeups(single_fd) == 1);
+	spa_assert_se(single->activation->status == PW_CLIENT_NODE_ACTIVATION_TRIGGERED);
+	spa_assert_se(single->activation->triggered == 1);
+	spa_assert_se(read_wakeups(shared_fd) == 0);
+	spa_assert_se(shared->activation->pending == 1);
+	spa_assert_se(shared->activation->status == PW_CLIENT_NODE_ACTIVATION_NOT_TRIGGERED);
+
+	/* the peer rearms when it wakes up */
+	spa_assert_se(pw_client_node_activation_awake(single->activation, 0));
+	spa_assert_se(single->activation->pending == 1);
+	spa_assert_se(!pw_client_node_activation_awake(shared->activation, 0));
+
+	/* the second cycle completes the peer with two sources */
+	spa_assert_se(pw_client_node_peers_activate(&peers, trans));
+	spa_assert_se(read_wakeups(single_fd) == 1);
+	spa_assert_se(read_wakeups(shared_fd) == 1);
+	spa_assert_se(shared->activation->pending == 0);
+
+	pw_client_node_peers_clear(&peers);
+	spa_assert_se(n_destroyed == 2);
+	spa_assert_se(!pw_client_node_peers_activate(&peers, trans));
+
+	close(single_fd);
+	close(shared_fd);
+	transport_destroy(trans);
+	n_destroyed = 0;
+
+	printf("activate: ok\n");
+}
+
+/* set_activation replaces a peer and stops activating it without fd */
+static void test_update(struct pw_loop *loop)
+{
+	struct pw_client_node_peers peers;
+	struct pw_client_node_transport *trans, *first, *second;
+	struct pw_client_node_link links[] = { { 0, 0 } };
+	int fd, first_fd, second_fd;
+
+	trans = make_transport(0, 1, 0);
+	first = make_transport(1, 0, 1);
+	second = make_transport(1, 0, 1);
+	spa_assert_se((fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) >= 0);
+
+	pw_client_node_peers_init(&peers, loop);
+
+	first_fd = dup(fd);
+	pw_client_node_peers_set(&peers, 10, first_fd, first, 1, links);
+	spa_assert_se(pw_client_node_peers_activate(&peers, trans));
+	spa_assert_se(read_wakeups(fd) == 1);
+
+	/* the old fd and transport of the peer are released */
+	second_fd = dup(fd);
+	pw_client_node_peers_set(&peers, 10, second_fd, second, 1, links);
+	spa_assert_se(n_destroyed == 1);
+	spa_assert_se(fcntl(first_fd, F_GETFD) == -1 && errno == EBADF);
+
+	spa_assert_se(pw_client_node_peers_activate(&peers, trans));
+	spa_assert_se(second->activation->triggered == 1);
+	spa_assert_se(read_wakeups(fd) == 1);
+
+	/* removing a peer we don't know is harmless */
+	pw_client_node_peers_set(&peers, 11, -1, NULL, 0, NULL);
+	spa_assert_se(n_destroyed == 1);
+
+	pw_client_node_peers_set(&peers, 10, -1, NULL, 0, NULL);
+	spa_assert_se(n_destroyed == 2);
+	spa_assert_se(fcntl(second_fd, F_GETFD) == -1 && errno == EBADF);
+	spa_assert_se(!pw_client_node_peers_activate(&peers, trans));
+
+	close(fd);
+	transport_destroy(trans);
+	n_destroyed = 0;
+
+	printf("update: ok\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_loop *loop;
+
+	setenv("SPA_PLUGIN_DIR", "build/spa/plugins", 0);
+
+	pw_init(&argc, &argv);
+
+	spa_assert_se((loop = pw_loop_new(NULL)) != NULL);
+	/* invokes run right away in the thread of the loop */
+	pw_loop_enter(loop);
+
+	test_activate(loop);
+	test_update(loop);
+
+	pw_loop_leave(loop);
+	pw_loop_destroy(loop);
+
+	return 0;
+}
@@ -0,0 +1,393 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <spa/node/node.h>
+#include <spa/pod/builder.h>
+#include <spa/param/audio/format-utils.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+
+#define N_LINKS		2
+#define N_BUFFERS	2
+#define N_SAMPLES	256
+#define MAX_BUFFERS	16
+
+struct type {
+	struct spa_type_media_type media_type;
+	struct spa_type_media_subtype media_subtype;
+	struct spa_type_format_audio format_audio;
+	struct spa_type_audio_format audio_format;
+};
+
+/* a node with one input port that accepts the buffers of the mixer */
+struct test_node {
+	struct spa_node node;
+	struct pw_type *t;
+	struct spa_port_info info;
+	uint32_t n_buffers;
+};
+
+/* the output of a link with its own buffers */
+struct test_output {
+	struct pw_port port;
+	struct spa_buffer *buffers[N_BUFFERS];
+	struct spa_buffer buffer[N_BUFFERS];
+	struct spa_data data[N_BUFFERS];
+	struct spa_chunk chunk[N_BUFFERS];
+	float samples[N_BUFFERS][N_SAMPLES];
+};
+
+static int impl_enum_params(struct spa_node *node, uint32_t id, uint32_t *index,
+			    const struct spa_pod *filter, struct spa_pod **param,
+			    struct spa_pod_builder *builder)
+{
+	return 0;
+}
+
+static int impl_set_param(struct spa_node *node, uint32_t id, uint32_t flags,
+			  const struct spa_pod *param)
+{
+	return 0;
+}
+
+static int impl_send_command(struct spa_node *node, const struct spa_command *command)
+{
+	return 0;
+}
+
+static int impl_set_callbacks(struct spa_node *node,
+			      const struct spa_node_callbacks *callbacks, void *data)
+{
+	return 0;
+}
+
+static int impl_get_n_ports(struct spa_node *node,
+			    uint32_t *n_input_ports, uint32_t *max_input_ports,
+			    uint32_t *n_output_ports, uint32_t *max_output_ports)
+{
+	*n_input_ports = *max_input_ports = 1;
+	*n_output_ports = *max_output_ports = 0;
+	return 0;
+}
+
+static int impl_get_port_ids(struct spa_node *node,
+			     uint32_t *input_ids, uint32_t n_input_ids,
+			     uint32_t *output_ids, uint32_t n_output_ids)
+{
+	if (n_input_ids > 0)
+		input_ids[0] = 0;
+	return 0;
+}
+
+static int impl_port_get_info(struct spa_node *node, enum spa_direction direction,
+			      uint32_t port_id, const struct spa_port_info **info)
+{
+	struct test_node *n = SPA_CONTAINER_OF(node, struct test_node, node);
+	*info = &n->info;
+	return 0;
+}
+
+static int impl_port_enum_params(struct spa_node *node,
+				 enum spa_direction direction, uint32_t port_id,
+				 uint32_t id, uint32_t *index,
+				 const struct spa_pod *filter,
+				 struct spa_pod **result,
+				 struct spa_pod_builder *builder)
+{
+	struct test_node *n = SPA_CONTAINER_OF(node, struct test_node, node);
+	struct pw_type *t = n->t;
+
+	if (id != t->param.idBuffers || *index > 0)
+		return 0;
+
+	*result = spa_pod_builder_object(builder,
+		t->param.idBuffers, t->param_buffers.Buffers,
+		":", t->param_buffers.size,    "i", N_SAMPLES * sizeof(float),
+		":", t->param_buffers.buffers, "iru", N_BUFFERS,
+			SPA_POD_PROP_MIN_MAX(1, MAX_BUFFERS));
+
+	(*index)++;
+	return 1;
+}
+
+static int impl_port_set_param(struct spa_node *node,
+			       enum spa_direction direction, uint32_t port_id,
+			       uint32_t id, uint32_t flags,
+			       const struct spa_pod *param)
+{
+	return 0;
+}
+
+static int impl_port_use_buffers(struct spa_node *node, enum spa_direction direction,
+				 uint32_t port_id, struct spa_buffer **buffers,
+				 uint32_t n_buffers)
+{
+	struct test_node *n = SPA_CONTAINER_OF(node, struct test_node, node);
+	n->n_buffers = n_buffers;
+	return 0;
+}
+
+static int impl_port_set_io(struct spa_node *node,
+			    enum spa_direction direction, uint32_t port_id,
+			    uint32_t id, void *data, size_t size)
+{
+	return 0;
+}
+
+static const struct spa_node test_node_impl = {
+	SPA_VERSION_NODE,
+	NULL,
+	.enum_params = impl_enum_params,
+	.set_param = impl_set_param,
+	.send_command = impl_send_command,
+	.set_callbacks = impl_set_callbacks,
+	.get_n_ports = impl_get_n_ports,
+	.get_port_ids = impl_get_port_ids,
+	.port_get_info = impl_port_get_info,
+	.port_enum_params = impl_port_enum_params,
+	.port_set_param = impl_port_set_param,
+	.port_use_buffers = impl_port_use_buffers,
+	.port_set_io = impl_port_set_io,
+};
+
+static void init_output(struct test_output *o, struct pw_type *t)
+{
+	uint32_t i;
+
+	for (i = 0; i < N_BUFFERS; i++) {
+		struct spa_buffer *b = &o->buffer[i];
+
+		o->buffers[i] = b;
+		b->id = i;
+		b->n_datas = 1;
+		b->datas = &o->data[i];
+		o->data[i].type = t->data.MemPtr;
+		o->data[i].maxsize = sizeof(o->samples[i]);
+		o->data[i].data = o->samples[i];
+		o->data[i].chunk = &o->chunk[i];
+	}
+	o->port.buffers = o->buffers;
+	o->port.n_buffers = N_BUFFERS;
+}
+
+static void add_link(struct pw_port *port, struct pw_link *link, struct test_output *o)
+{
+	link->output = &o->port;
+	link->gain = 1.0f;
+	link->io = SPA_IO_BUFFERS_INIT;
+
+	spa_graph_port_init(&link->rt.in_port, SPA_DIRECTION_INPUT, 0, 0, &link->io);
+	link->rt.in_port.scheduler_data = link;
+	spa_graph_port_add(&port->rt.mix_node, &link->rt.in_port);
+}
+
+/* let the link give a buffer filled with value to the mixer */
+static void push_buffer(struct pw_link *link, struct test_output *o, uint32_t id, float value)
+{
+	uint32_t i;
+
+	for (i = 0; i < N_SAMPLES; i++)
+		o->samples[id][i] = value;
+	o->chunk[id].offset = 0;
+	o->chunk[id].size = sizeof(o->samples[id]);
+	o->chunk[id].stride = sizeof(float);
+
+	link->io.status = SPA_STATUS_HAVE_BUFFER;
+	link->io.buffer_id = id;
+}
+
+static void check_buffer(struct spa_buffer *b, float value)
+{
+	float *samples = b->datas[0].data;
+	uint32_t i;
+
+	spa_assert_se(b->datas[0].chunk->size == N_SAMPLES * sizeof(float));
+	for (i = 0; i < N_SAMPLES; i++)
+		spa_assert_se(samples[i] == value);
+}
+
+/* the node consumed the buffer, the mixer gives it back to the links */
+static void consume(struct pw_port *port)
+{
+	port->io.status = SPA_STATUS_NEED_BUFFER;
+	spa_node_process_output(&port->mix_node);
+}
+
+static void set_format(struct pw_port *port, struct type *type, uint32_t format)
+{
+	struct pw_type *t = &port->node->core->type;
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+	struct spa_pod *param;
+
+	param = spa_pod_builder_object(&b,
+		t->param.idFormat, t->spa_format,
+		"I", type->media_type.audio,
+		"I", type->media_subtype.raw,
+		":", type->format_audio.format,   "I", format,
+		":", type->format_audio.rate,     "i", 48000,
+		":", type->format_audio.channels, "i", 1);
+
+	spa_assert_se(pw_port_set_param(port, t->param.idFormat, 0, param) == 0);
+}
+
+/* two links are summed into a buffer of the port, one link without a gain
+ * is given to the node as is */
+static void test_sum(struct test_node *n, struct pw_port *port, struct type *type,
+		     struct pw_link *links, struct test_output *outputs)
+{
+	uint32_t id;
+
+	set_format(port, type, type->audio_format.F32);
+	spa_assert_se(pw_port_use_buffers(port, outputs[0].buffers, N_BUFFERS) == 0);
+	/* the buffers of the link and the mix buffers */
+	spa_assert_se(n->n_buffers == 2 * N_BUFFERS);
+	spa_assert_se(port->buffers[0] == outputs[0].buffers[0]);
+
+	push_buffer(&links[0], &outputs[0], 1, 0.5f);
+	spa_node_process_input(&port->mix_node);
+	spa_assert_se(port->io.status == SPA_STATUS_HAVE_BUFFER);
+	spa_assert_se(port->io.buffer_id == 1);
+	consume(port);
+	spa_assert_se(links[0].io.status == SPA_STATUS_NEED_BUFFER);
+	spa_assert_se(links[0].io.buffer_id == 1);
+
+	push_buffer(&links[0], &outputs[0], 0, 0.5f);
+	push_buffer(&links[1], &outputs[1], 0, 0.25f);
+	spa_node_process_input(&port->mix_node);
+	spa_assert_se(port->io.status == SPA_STATUS_HAVE_BUFFER);
+	id = port->io.buffer_id;
+	spa_assert_se(id >= N_BUFFERS && id < n->n_buffers);
+	check_buffer(port->buffers[id], 0.75f);
+	spa_assert_se(links[0].io.status == SPA_STATUS_NEED_BUFFER);
+	spa_assert_se(links[1].io.status == SPA_STATUS_NEED_BUFFER);
+	consume(port);
+	spa_assert_se(port->io.buffer_id == SPA_ID_INVALID);
+
+	printf("sum: ok\n");
+}
+
+static void test_gain(struct test_node *n, struct pw_port *port, struct type *type,
+		      struct pw_link *links, struct test_output *outputs)
+{
+	uint32_t id;
+
+	links[0].gain = 0.5f;
+	push_buffer(&links[0], &outputs[0], 1, 0.5f);
+	spa_node_process_input(&port->mix_node);
+	id = port->io.buffer_id;
+	spa_assert_se(id >= N_BUFFERS && id < n->n_buffers);
+	check_buffer(port->buffers[id], 0.25f);
+	consume(port);
+
+	links[1].gain = 2.0f;
+	push_buffer(&links[0], &outputs[0], 0, 0.5f);
+	push_buffer(&links[1], &outputs[1], 1, 0.25f);
+	spa_node_process_input(&port->mix_node);
+	id = port->io.buffer_id;
+	spa_assert_se(id >= N_BUFFERS && id < n->n_buffers);
+	check_buffer(port->buffers[id], 0.75f);
+	consume(port);
+
+	links[0].gain = links[1].gain = 1.0f;
+
+	printf("gain: ok\n");
+}
+
+/* the node uses the buffers of the first link, the other links are dropped */
+static void test_unmixable(struct test_node *n, struct pw_port *port, struct type *type,
+			   struct pw_link *links, struct test_output *outputs)
+{
+	set_format(port, type, type->audio_format.U8);
+	spa_assert_se(pw_port_use_buffers(port, outputs[0].buffers, N_BUFFERS) == 0);
+	spa_assert_se(n->n_buffers == N_BUFFERS);
+	spa_assert_se(port->buffers == outputs[0].buffers);
+
+	push_buffer(&links[0], &outputs[0], 1, 0.5f);
+	push_buffer(&links[1], &outputs[1], 0, 0.25f);
+	spa_node_process_input(&port->mix_node);
+	spa_assert_se(port->io.status == SPA_STATUS_HAVE_BUFFER);
+	spa_assert_se(port->io.buffer_id == 1);
+	spa_assert_se(links[1].io.status == SPA_STATUS_NEED_BUFFER);
+	check_buffer(port->buffers[1], 0.5f);
+	consume(port);
+	spa_assert_se(links[0].io.buffer_id == 1);
+
+	printf("unmixable: ok\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_loop *loop;
+	struct pw_core *core;
+	struct pw_node *node;
+	struct pw_port *port;
+	struct test_node n = { 0 };
+	struct type type = { 0 };
+	struct pw_link links[N_LINKS];
+	struct test_output outputs[N_LINKS];
+	uint32_t i;
+
+	setenv("SPA_PLUGIN_DIR", "build/spa/plugins", 0);
+
+	pw_init(&argc, &argv);
+
+	spa_assert_se((loop = pw_loop_new(NULL)) != NULL);
+	spa_assert_se((core = pw_core_new(loop, NULL)) != NULL);
+
+	n.node = test_node_impl;
+	n.t = pw_core_get_type(core);
+	n.info.flags = SPA_PORT_INFO_FLAG_CAN_USE_BUFFERS;
+
+	spa_type_media_type_map(n.t->map, &type.media_type);
+	spa_type_media_subtype_map(n.t->map, &type.media_subtype);
+	spa_type_format_audio_map(n.t->map, &type.format_audio);
+	spa_type_audio_format_map(n.t->map, &type.audio_format);
+
+	spa_assert_se((node = pw_node_new(core, "test", NULL, 0)) != NULL);
+	pw_node_set_implementation(node, &n.node);
+	spa_assert_se(pw_node_update_ports(node) == 0);
+	spa_assert_se((port = pw_node_find_port(node, PW_DIRECTION_INPUT, 0)) != NULL);
+
+	memset(links, 0, sizeof(links));
+	memset(outputs, 0, sizeof(outputs));
+	for (i = 0; i < N_LINKS; i++) {
+		init_output(&outputs[i], n.t);
+		add_link(port, &links[i], &outputs[i]);
+	}
+
+	test_sum(&n, port, &type, links, outputs);
+	test_gain(&n, port, &type, links, outputs);
+	test_unmixable(&n, port, &type, links, outputs);
+
+	for (i = 0; i < N_LINKS; i++)
+		spa_graph_port_remove(&links[i].rt.in_port);
+
+	pw_node_destroy(node);
+	pw_core_destroy(core);
+	pw_loop_destroy(loop);
+
+	return 0;
+}
@@ -0,0 +1,331 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <spa/node/node.h>
+#include <spa/pod/builder.h>
+#include <spa/pod/parser.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/private.h>
+
+static const int32_t rates[] = { 44100, 48000 };
+
+/* a node with one output port that counts how often its params are
+ * enumerated */
+struct test_node {
+	struct spa_node node;
+	struct pw_type *t;
+	uint32_t rate_key;
+	struct spa_port_info info;
+	uint32_t n_enum_formats;
+	uint32_t n_enum_buffers;
+	int set_param_res;
+};
+
+static int impl_enum_params(struct spa_node *node, uint32_t id, uint32_t *index,
+			    const struct spa_pod *filter, struct spa_pod **param,
+			    struct spa_pod_builder *builder)
+{
+	return 0;
+}
+
+static int impl_set_param(struct spa_node *node, uint32_t id, uint32_t flags,
+			  const struct spa_pod *param)
+{
+	struct test_node *n = SPA_CONTAINER_OF(node, struct test_node, node);
+	return n->set_param_res;
+}
+
+static int impl_send_command(struct spa_node *node, const struct spa_command *command)
+{
+	return 0;
+}
+
+static int impl_set_callbacks(struct spa_node *node,
+			      const struct spa_node_callbacks *callbacks, void *data)
+{
+	return 0;
+}
+
+static int impl_get_n_ports(struct spa_node *node,
+			    uint32_t *n_input_ports, uint32_t *max_input_ports,
+			    uint32_t *n_output_ports, uint32_t *max_output_ports)
+{
+	*n_input_ports = *max_input_ports = 0;
+	*n_output_ports = *max_output_ports = 1;
+	return 0;
+}
+
+static int impl_get_port_ids(struct spa_node *node,
+			     uint32_t *input_ids, uint32_t n_input_ids,
+			     uint32_t *output_ids, uint32_t n_output_ids)
+{
+	if (n_output_ids > 0)
+		output_ids[0] = 0;
+	return 0;
+}
+
+static int impl_port_get_info(struct spa_node *node, enum spa_direction direction,
+			      uint32_t port_id, const struct spa_port_info **info)
+{
+	struct test_node *n = SPA_CONTAINER_OF(node, struct test_node, node);
+	*info = &n->info;
+	return 0;
+}
+
+static int impl_port_enum_params(struct spa_node *node,
+				 enum spa_direction direction, uint32_t port_id,
+				 uint32_t id, uint32_t *index,
+				 const struct spa_pod *filter,
+				 struct spa_pod **result,
+				 struct spa_pod_builder *builder)
+{
+	struct test_node *n = SPA_CONTAINER_OF(node, struct test_node, node);
+	struct pw_type *t = n->t;
+
+	/* the cache asks for unfiltered params */
+	spa_assert_se(filter == NULL);
+
+	if (id == t->param.idEnumFormat) {
+		if (*index == 0)
+			n->n_enum_formats++;
+		if (*index >= SPA_N_ELEMENTS(rates))
+			return 0;
+		*result = spa_pod_builder_object(builder,
+			t->param.idEnumFormat, t->spa_format,
+			":", n->rate_key, "i", rates[*index]);
+	}
+	else if (id == t->param.idBuffers) {
+		if (*index == 0)
+			n->n_enum_buffers++;
+		if (*index >= 1)
+			return 0;
+		*result = spa_pod_builder_object(builder,
+			t->param.idBuffers, t->param_buffers.Buffers,
+			":", t->param_buffers.size, "i", 1024);
+	}
+	else
+		return 0;
+
+	(*index)++;
+	return 1;
+}
+
+static int impl_port_set_param(struct spa_node *node,
+			       enum spa_direction direction, uint32_t port_id,
+			       uint32_t id, uint32_t flags,
+			       const struct spa_pod *param)
+{
+	return 0;
+}
+
+static int impl_port_set_io(struct spa_node *node,
+			    enum spa_direction direction, uint32_t port_id,
+			    uint32_t id, void *data, size_t size)
+{
+	return 0;
+}
+
+static const struct spa_node test_node_impl = {
+	SPA_VERSION_NODE,
+	NULL,
+	.enum_params = impl_enum_params,
+	.set_param = impl_set_param,
+	.send_command = impl_send_command,
+	.set_callbacks = impl_set_callbacks,
+	.get_n_ports = impl_get_n_ports,
+	.get_port_ids = impl_get_port_ids,
+	.port_get_info = impl_port_get_info,
+	.port_enum_params = impl_port_enum_params,
+	.port_set_param = impl_port_set_param,
+	.port_set_io = impl_port_set_io,
+};
+
+/* enumerate all EnumFormat params of the port and return the rates */
+static uint32_t enum_rates(struct test_node *n, struct pw_port *port,
+			   const struct spa_pod *filter, int32_t *result)
+{
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod *param;
+	uint32_t index = 0, count = 0;
+
+	while (true) {
+		spa_pod_builder_init(&b, buffer, sizeof(buffer));
+		if (pw_port_enum_params_cached(port, n->t->param.idEnumFormat,
+					       &index, filter, &param, &b) <= 0)
+			break;
+		spa_assert_se(spa_pod_object_parse(param, ":", n->rate_key, "i", &result[count]) >= 0);
+		count++;
+	}
+	return count;
+}
+
+static struct spa_pod *make_filter(struct test_node *n, struct spa_pod_builder *b, int32_t rate)
+{
+	return spa_pod_builder_object(b,
+		n->t->param.idEnumFormat, n->t->spa_format,
+		":", n->rate_key, "i", rate);
+}
+
+/* the node is asked for the params once, later calls use the cache */
+static void test_hit(struct test_node *n, struct pw_port *port)
+{
+	int32_t result[4];
+	uint8_t buffer[1024];
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod *param;
+	uint32_t index;
+
+	pw_node_clear_param_cache(port->node);
+	n->n_enum_formats = n->n_enum_buffers = 0;
+
+	spa_assert_se(enum_rates(n, port, NULL, result) == 2);
+	spa_assert_se(result[0] == 44100 && result[1] == 48000);
+	spa_assert_se(n->n_enum_formats == 1);
+
+	spa_assert_se(enum_rates(n, port, NULL, result) == 2);
+	spa_assert_se(result[0] == 44100 && result[1] == 48000);
+	spa_assert_se(n->n_enum_formats == 1);
+
+	/* ids are cached separately */
+	index = 0;
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	spa_assert_se(pw_port_enum_params_cached(port, n->t->param.idBuffers,
+					 &index, NULL, &param, &b) == 1);
+	spa_assert_se(n->n_enum_buffers == 1);
+	spa_assert_se(pw_port_enum_params_cached(port, n->t->param.idBuffers,
+					 &index, NULL, &param, &b) == 0);
+	index = 0;
+	spa_assert_se(pw_port_enum_params_cached(port, n->t->param.idBuffers,
+					 &index, NULL, &param, &b) == 1);
+	spa_assert_se(n->n_enum_buffers == 1);
+	spa_assert_se(n->n_enum_formats == 1);
+
+	printf("hit: ok\n");
+}
+
+/* the filter is applied to the cached params and the last result of each
+ * param is reused for the same filter */
+static void test_filter(struct test_node *n, struct pw_port *port)
+{
+	int32_t result[4];
+	uint8_t buffer[256];
+	struct spa_pod_builder b = { 0 };
+	struct spa_pod *f48000, *f22050;
+
+	pw_node_clear_param_cache(port->node);
+	n->n_enum_formats = 0;
+
+	spa_pod_builder_init(&b, buffer, sizeof(buffer));
+	f48000 = make_filter(n, &b, 48000);
+	f22050 = make_filter(n, &b, 22050);
+
+	spa_assert_se(enum_rates(n, port, f48000, result) == 1);
+	spa_assert_se(result[0] == 48000);
+	/* the memo of the same filter */
+	spa_assert_se(enum_rates(n, port, f48000, result) == 1);
+	spa_assert_se(result[0] == 48000);
+
+	/* a filter that doesn't match and its memo */
+	spa_assert_se(enum_rates(n, port, f22050, result) == 0);
+	spa_assert_se(enum_rates(n, port, f22050, result) == 0);
+
+	/* the memo was replaced and is computed again */
+	spa_assert_se(enum_rates(n, port, f48000, result) == 1);
+	spa_assert_se(result[0] == 48000);
+
+	/* the unfiltered params are still there */
+	spa_assert_se(enum_rates(n, port, NULL, result) == 2);
+	spa_assert_se(n->n_enum_formats == 1);
+
+	printf("filter: ok\n");
+}
+
+/* setting a param or a new quantum drops the cache */
+static void test_invalidate(struct test_node *n, struct pw_port *port)
+{
+	int32_t result[4];
+
+	pw_node_clear_param_cache(port->node);
+	n->n_enum_formats = 0;
+
+	spa_assert_se(enum_rates(n, port, NULL, result) == 2);
+	spa_assert_se(n->n_enum_formats == 1);
+
+	spa_assert_se(pw_port_set_param(port, n->t->param.idFormat, 0, NULL) == 0);
+	spa_assert_se(enum_rates(n, port, NULL, result) == 2);
+	spa_assert_se(n->n_enum_formats == 2);
+
+	n->set_param_res = 0;
+	spa_assert_se(pw_node_set_quantum(port->node, 256) == 0);
+	spa_assert_se(enum_rates(n, port, NULL, result) == 2);
+	spa_assert_se(n->n_enum_formats == 3);
+
+	/* a node without a quantum keeps its params */
+	n->set_param_res = -ENOTSUP;
+	spa_assert_se(pw_node_set_quantum(port->node, 512) == 0);
+	spa_assert_se(enum_rates(n, port, NULL, result) == 2);
+	spa_assert_se(n->n_enum_formats == 3);
+
+	spa_assert_se(pw_node_update_ports(port->node) == 0);
+	spa_assert_se(enum_rates(n, port, NULL, result) == 2);
+	spa_assert_se(n->n_enum_formats == 4);
+
+	printf("invalidate: ok\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct pw_loop *loop;
+	struct pw_core *core;
+	struct pw_node *node;
+	struct pw_port *port;
+	struct test_node n = { 0 };
+
+	setenv("SPA_PLUGIN_DIR", "build/spa/plugins", 0);
+
+	pw_init(&argc, &argv);
+
+	spa_assert_se((loop = pw_loop_new(NULL)) != NULL);
+	spa_assert_se((core = pw_core_new(loop, NULL)) != NULL);
+
+	n.node = test_node_impl;
+	n.t = pw_core_get_type(core);
+	n.rate_key = spa_type_map_get_id(n.t->map, "Spa:Pod:Object:Param:Format:Test:rate");
+
+	spa_assert_se((node = pw_node_new(core, "test", NULL, 0)) != NULL);
+	pw_node_set_implementation(node, &n.node);
+	spa_assert_se(pw_node_update_ports(node) == 0);
+	spa_assert_se((port = pw_node_find_port(node, PW_DIRECTION_OUTPUT, 0)) != NULL);
+
+	test_hit(&n, port);
+	test_filter(&n, port);
+	test_invalidate(&n, port);
+
+	pw_node_destroy(node);
+	pw_core_destroy(core);
+	pw_loop_destroy(loop);
+
+	return 0;
+}
@@ -0,0 +1,335 @@
+/* PipeWire
+ * Copyright (C) 2018 Wim Taymans <wim.taymans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+
+#include <pipewire/pipewire.h>
+#include <pipewire/interfaces.h>
+#include <pipewire/type.h>
+
+#define MAX_NAME	32
+
+struct node {
+	struct spa_list link;
+	uint32_t id;
+	char name[MAX_NAME];
+};
+
+struct data {
+	struct pw_main_loop *loop;
+	struct pw_core *core;
+	struct pw_type *t;
+
+	struct pw_remote *remote;
+	struct spa_hook remote_listener;
+
+	struct pw_core_proxy *core_proxy;
+
+	struct pw_registry_proxy *registry_proxy;
+	struct spa_hook registry_listener;
+
+	struct pw_proxy *profiler;
+	struct spa_hook profiler_listener;
+
+	struct spa_source *timer;
+
+	struct spa_list node_list;
+
+	void *map;
+	size_t map_size;
+	struct pw_profiler_area *area;
+	uint64_t last_time;
+	struct pw_profiler_node_stats last[PW_PROFILER_MAX_NODES];
+};
+
+static struct node *find_node(struct data *d, uint32_t id)
+{
+	struct node *n;
+	spa_list_for_each(n, &d->node_list, link) {
+		if (n->id == id)
+			return n;
+	}
+	return NULL;
+}
+
+static uint64_t get_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return SPA_TIMESPEC_TO_TIME(&ts);
+}
+
+/* the time below which \a percent of the cycles in the histogram complete */
+static uint64_t get_percentile(const uint32_t *histogram, uint64_t total, int percent)
+{
+	uint64_t count = 0, limit = (total * percent + 99) / 100;
+	uint32_t i;
+
+	for (i = 0; i < PW_PROFILER_HISTOGRAM; i++) {
+		count += histogram[i];
+		if (count >= limit)
+			return pw_profiler_bucket_time(i + 1);
+	}
+	return pw_profiler_bucket_time(PW_PROFILER_HISTOGRAM);
+}
+
+static void print_stats(struct data *d)
+{
+	uint64_t now = get_time(), elapsed = now - d->last_time;
+	uint32_t i, j, n_nodes;
+
+	if (isatty(STDOUT_FILENO))
+		printf("\033[H\033[2J");
+
+	printf("%5s %-*s %8s %6s %9s %9s %9s %9s %9s %6s\n",
+	       "ID", MAX_NAME - 8, "NAME", "CYCLES/s", "XRUNS", "WAIT(us)", "BUSY(us)",
+	       "MAX(us)", "P50(us)", "P99(us)", "BUSY%");
+
+	n_nodes = __atomic_load_n(&d->area->n_nodes, __ATOMIC_ACQUIRE);
+	for (i = 0; i < n_nodes; i++) {
+		struct pw_profiler_node_stats s, *l = &d->last[i];
+		uint32_t histogram[PW_PROFILER_HISTOGRAM];
+		uint64_t cycles, busy;
+		struct node *n;
+
+		pw_profiler_area_read(d->area, i, &s);
+		if (s.id == SPA_ID_INVALID) {
+			l->id = SPA_ID_INVALID;
+			continue;
+		}
+		/* a new node in this slot, report since the start */
+		if (l->id != s.id || s.cycles < l->cycles) {
+			memset(l, 0, sizeof(*l));
+			l->id = s.id;
+		}
+
+		cycles = s.cycles - l->cycles;
+		busy = s.busy_total - l->busy_total;
+		for (j = 0; j < PW_PROFILER_HISTOGRAM; j++)
+			histogram[j] = s.histogram[j] - l->histogram[j];
+
+		n = find_node(d, s.id);
+
+		printf("%5u %-*.*s %8.1f %6" PRIu64 " %9.1f %9.1f %9.1f %9.1f %9.1f %5.1f%%\n",
+		       s.id, MAX_NAME - 8, MAX_NAME - 8, n ? n->name : "",
+		       elapsed ? cycles * (double) SPA_NSEC_PER_SEC / elapsed : 0.0,
+		       s.xruns,
+		       cycles ? (s.wait_total - l->wait_total) / 1000.0 / cycles : 0.0,
+		       cycles ? busy / 1000.0 / cycles : 0.0,
+		       s.cycles ? s.busy_max / 1000.0 : 0.0,
+		       cycles ? get_percentile(histogram, cycles, 50) / 1000.0 : 0.0,
+		       cycles ? get_percentile(histogram, cycles, 99) / 1000.0 : 0.0,
+		       elapsed ? busy * 100.0 / elapsed : 0.0);
+
+		*l = s;
+	}
+	fflush(stdout);
+	d->last_time = now;
+}
+
+static void on_timeout(void *data, uint64_t expirations)
+{
+	struct data *d = data;
+	if (d->area)
+		print_stats(d);
+}
+
+static void profiler_event_area(void *object, int memfd, uint32_t offset, uint32_t size)
+{
+	struct data *d = object;
+	void *ptr;
+
+	if (d->area)
+		return;
+
+	if (size < sizeof(struct pw_profiler_area)) {
+		fprintf(stderr, "invalid profiler area size %u\n", size);
+		pw_main_loop_quit(d->loop);
+		return;
+	}
+	ptr = mmap(NULL, size + offset, PROT_READ, MAP_SHARED, memfd, 0);
+	if (ptr == MAP_FAILED) {
+		fprintf(stderr, "can't map profiler area: %m\n");
+		pw_main_loop_quit(d->loop);
+		return;
+	}
+	d->map = ptr;
+	d->map_size = size + offset;
+	d->area = SPA_MEMBER(ptr, offset, struct pw_profiler_area);
+	d->last_time = get_time();
+}
+
+static const struct pw_profiler_proxy_events profiler_events = {
+	PW_VERSION_PROFILER_PROXY_EVENTS,
+	.area = profiler_event_area,
+};
+
+static void registry_event_global(void *data, uint32_t id, uint32_t parent_id,
+				  uint32_t permissions, uint32_t type, uint32_t version,
+				  const struct spa_dict *props)
+{
+	struct data *d = data;
+
+	if (type == d->t->node) {
+		struct node *n;
+		const char *str;
+
+		if ((n = calloc(1, sizeof(struct node))) == NULL)
+			return;
+		n->id = id;
+		if (props && (str = spa_dict_lookup(props, "node.name")))
+			snprintf(n->name, sizeof(n->name), "%s", str);
+		spa_list_append(&d->node_list, &n->link);
+	}
+	else if (type == d->t->profiler && d->profiler == NULL) {
+		d->profiler = pw_registry_proxy_bind(d->registry_proxy, id, type,
+						     PW_VERSION_PROFILER, 0);
+		if (d->profiler == NULL)
+			return;
+
+		pw_proxy_add_proxy_listener(d->profiler, &d->profiler_listener,
+					    &profiler_events, d);
+	}
+}
+
+static void registry_event_global_remove(void *object, uint32_t id)
+{
+	struct data *d = object;
+	struct node *n;
+
+	if ((n = find_node(d, id))) {
+		spa_list_remove(&n->link);
+		free(n);
+	}
+}
+
+static const struct pw_registry_proxy_events registry_events = {
+	PW_VERSION_REGISTRY_PROXY_EVENTS,
+	.global = registry_event_global,
+	.global_remove = registry_event_global_remove,
+};
+
+static void on_sync_reply(void *_data, uint32_t seq)
+{
+	struct data *data = _data;
+
+	if (seq == 1 && data->profiler == NULL) {
+		fprintf(stderr, "no profiler found, is libpipewire-module-profiler loaded?\n");
+		pw_main_loop_quit(data->loop);
+	}
+}
+
+static void on_state_changed(void *_data, enum pw_remote_state old,
+			     enum pw_remote_state state, const char *error)
+{
+	struct data *data = _data;
+
+	switch (state) {
+	case PW_REMOTE_STATE_ERROR:
+		fprintf(stderr, "remote error: %s\n", error);
+		pw_main_loop_quit(data->loop);
+		break;
+
+	case PW_REMOTE_STATE_CONNECTED:
+		data->core_proxy = pw_remote_get_core_proxy(data->remote);
+		data->registry_proxy = pw_core_proxy_get_registry(data->core_proxy,
+								  data->t->registry,
+								  PW_VERSION_REGISTRY, 0);
+		pw_registry_proxy_add_listener(data->registry_proxy,
+					       &data->registry_listener,
+					       &registry_events, data);
+		pw_core_proxy_sync(data->core_proxy, 1);
+		break;
+
+	default:
+		break;
+	}
+}
+
+static const struct pw_remote_events remote_events = {
+	PW_VERSION_REMOTE_EVENTS,
+	.state_changed = on_state_changed,
+	.sync_reply = on_sync_reply,
+};
+
+static void do_quit(void *data, int signal_number)
+{
+	struct data *d = data;
+	pw_main_loop_quit(d->loop);
+}
+
+int main(int argc, char *argv[])
+{
+	struct data data = { 0 };
+	struct pw_loop *l;
+	struct pw_properties *props = NULL;
+	struct timespec interval = { 1, 0 };
+	struct node *n, *t;
+
+	pw_init(&argc, &argv);
+
+	data.loop = pw_main_loop_new(NULL);
+	if (data.loop == NULL)
+		return -1;
+
+	l = pw_main_loop_get_loop(data.loop);
+	pw_loop_add_signal(l, SIGINT, do_quit, &data);
+	pw_loop_add_signal(l, SIGTERM, do_quit, &data);
+
+	data.core = pw_core_new(l, NULL);
+	if (data.core == NULL)
+		return -1;
+	data.t = pw_core_get_type(data.core);
+
+	spa_list_init(&data.node_list);
+
+	if (argc > 1)
+		props = pw_properties_new(PW_REMOTE_PROP_REMOTE_NAME, argv[1], NULL);
+
+	data.remote = pw_remote_new(data.core, props, 0);
+	if (data.remote == NULL)
+		return -1;
+
+	pw_remote_add_listener(data.remote, &data.remote_listener, &remote_events, &data);
+	if (pw_remote_connect(data.remote) < 0)
+		return -1;
+
+	data.timer = pw_loop_add_timer(l, on_timeout, &data);
+	pw_loop_update_timer(l, data.timer, &interval, &interval, false);
+
+	pw_main_loop_run(data.loop);
+
+	if (data.map)
+		munmap(data.map, data.map_size);
+
+	spa_list_for_each_safe(n, t, &data.node_list, link)
+		free(n);
+
+	pw_remote_destroy(data.remote);
+	pw_core_destroy(data.core);
+	pw_main_loop_destroy(data.loop);
+
+	return 0;
+}